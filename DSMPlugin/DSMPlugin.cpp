@@ -153,6 +153,7 @@ CDSMPlugin::CDSMPlugin()
 	m_PCreateIntegratedPluginInterface = NULL;
 	//adzm 2010-05-12 - dsmplugin config
 	m_PConfig = NULL;
+	m_PGetRecordPluginInterface = NULL;
 }
 
 //
@@ -411,6 +412,7 @@ bool CDSMPlugin::LoadPlugin(char* szPlugin, bool fAllowMulti)
 	m_PCreateIntegratedPluginInterface	= (CREATEINTEGRATEDPLUGININTERFACE)	GetProcAddress(m_hPDll, "CreateIntegratedPluginInterface");
 	//adzm 2010-05-12 - dsmplugin config
 	m_PConfig         = (CONFIG)           GetProcAddress(m_hPDll, "Config");
+	m_PGetRecordPluginInterface = (GETRECORDPLUGININTERFACE) GetProcAddress(m_hPDll, "GetRecordPluginInterface");
 
 	if (m_PStartup == NULL || m_PShutdown == NULL || m_PSetParams == NULL || m_PGetParams == NULL
 		|| m_PTransformBuffer == NULL || m_PRestoreBuffer == NULL || m_PFreeBuffer == NULL)
@@ -484,6 +486,20 @@ bool CDSMPlugin::SupportsIntegrated()
 	return m_PCreateIntegratedPluginInterface != NULL;
 }
 
+IRecordPlugin* CDSMPlugin::GetRecordPluginInterface(IPlugin* pPlugin)
+{
+	if (m_PGetRecordPluginInterface && pPlugin) {
+		return m_PGetRecordPluginInterface(pPlugin);
+	} else {
+		return NULL;
+	}
+}
+
+bool CDSMPlugin::SupportsRecords()
+{
+	return m_PGetRecordPluginInterface != NULL;
+}
+
 
 //
 // Tell the plugin to do its transformation on the source data buffer
@@ -43,8 +43,13 @@
 #endif
 
 
+#ifdef _VNC_PORTABLE
+// winvnc/portable: for CRecordCipher in vncbench
+#include <windows.h>
+#else
 #include <WinSock2.h>
 #include <Windows.h>
+#endif
 
 //adzm - 2009-06-21
 class IPlugin
@@ -91,6 +96,33 @@ public:
 
 };
 
+// Record framed transport for a streaming integrated plugin.
+// Instead of transforming every send/read call, the data is cut into
+// records of up to GetMaxRecordPayload() bytes that are sealed and opened
+// in place, in buffers owned by the caller, so the plugin allocates and
+// locks nothing per call. The record layer belongs to the plugin instance
+// it was obtained from and shares its session keys.
+//
+// Record layout: [header][payload][trailer]
+class IRecordPlugin
+{
+public:
+	virtual ~IRecordPlugin() {};
+
+	virtual int GetRecordHeaderSize() = 0;
+	virtual int GetRecordTrailerSize() = 0;
+	virtual int GetMaxRecordPayload() = 0;
+
+	// Seals the nDataLen bytes at pRecord + GetRecordHeaderSize() in place,
+	// and fills in the header and trailer. Returns the record length, 0 on error.
+	virtual int SealRecord(BYTE* pRecord, int nDataLen) = 0;
+	// Returns the full length of the record starting with pHeader, 0 if invalid
+	virtual int GetRecordLength(const BYTE* pHeader) = 0;
+	// Opens a whole record in place. Returns the payload length, the payload
+	// is at pRecord + GetRecordHeaderSize(). Returns -1 on error.
+	virtual int OpenRecord(BYTE* pRecord, int nRecordLen) = 0;
+};
+
 // A plugin dll must export the following functions (with same convention)
 typedef char* (__cdecl  *DESCRIPTION)(void);
 typedef int   (__cdecl  *STARTUP)(void);
@@ -107,6 +139,8 @@ typedef IPlugin* (__cdecl  *CREATEPLUGININTERFACE)(void);
 typedef IIntegratedPlugin* (__cdecl  *CREATEINTEGRATEDPLUGININTERFACE)(void);
 //adzm 2010-05-12 - dsmplugin config
 typedef int   (__cdecl  *CONFIG)(HWND, char*, char*, char**);
+// Optional, record layer of a plugin interface (owned by that interface)
+typedef IRecordPlugin* (__cdecl  *GETRECORDPLUGININTERFACE)(IPlugin*);
 
 //
 //
@@ -144,6 +178,9 @@ public:
 	IIntegratedPlugin* CreateIntegratedPluginInterface();
 	bool SupportsIntegrated();
 
+	IRecordPlugin* GetRecordPluginInterface(IPlugin* pPlugin);
+	bool SupportsRecords();
+
 	CDSMPlugin();
 	virtual ~CDSMPlugin();
 	bool ResetPlugin(void);
@@ -183,6 +220,7 @@ private:
 	CREATEINTEGRATEDPLUGININTERFACE m_PCreateIntegratedPluginInterface;
 	//adzm 2010-05-12 - dsmplugin config
 	CONFIG m_PConfig;
+	GETRECORDPLUGININTERFACE m_PGetRecordPluginInterface;
 
 
 	//adzm - 2009-06-21 - Please do not use these! Deprecated with multithreaded DSM
@@ -0,0 +1,343 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// RecordCipher.cpp: ChaCha20-Poly1305 record sealing, see RecordCipher.h
+
+#include "RecordCipher.h"
+#include <string.h>
+
+namespace {
+
+	typedef unsigned __int64 QWORD_T;
+
+	inline DWORD Load32(const BYTE* p)
+	{
+		return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+	}
+
+	inline void Store32(BYTE* p, DWORD v)
+	{
+		p[0] = (BYTE)v; p[1] = (BYTE)(v >> 8); p[2] = (BYTE)(v >> 16); p[3] = (BYTE)(v >> 24);
+	}
+
+	inline DWORD Rotl32(DWORD v, int n)
+	{
+		return (v << n) | (v >> (32 - n));
+	}
+
+#define QUARTERROUND(a, b, c, d)						\
+	a += b; d ^= a; d = Rotl32(d, 16);					\
+	c += d; b ^= c; b = Rotl32(b, 12);					\
+	a += b; d ^= a; d = Rotl32(d, 8);					\
+	c += d; b ^= c; b = Rotl32(b, 7);
+
+	void ChaChaBlock(const DWORD input[16], BYTE output[64])
+	{
+		DWORD x[16];
+		memcpy(x, input, sizeof(x));
+		for (int i = 0; i < 10; i++) {
+			QUARTERROUND(x[0], x[4], x[8], x[12])
+			QUARTERROUND(x[1], x[5], x[9], x[13])
+			QUARTERROUND(x[2], x[6], x[10], x[14])
+			QUARTERROUND(x[3], x[7], x[11], x[15])
+			QUARTERROUND(x[0], x[5], x[10], x[15])
+			QUARTERROUND(x[1], x[6], x[11], x[12])
+			QUARTERROUND(x[2], x[7], x[8], x[13])
+			QUARTERROUND(x[3], x[4], x[9], x[14])
+		}
+		for (int i = 0; i < 16; i++)
+			Store32(output + 4 * i, x[i] + input[i]);
+	}
+
+	void ChaChaInit(DWORD state[16], const BYTE* key, const BYTE* nonce, DWORD counter)
+	{
+		state[0] = 0x61707865;
+		state[1] = 0x3320646e;
+		state[2] = 0x79622d32;
+		state[3] = 0x6b206574;
+		for (int i = 0; i < 8; i++)
+			state[4 + i] = Load32(key + 4 * i);
+		state[12] = counter;
+		state[13] = Load32(nonce);
+		state[14] = Load32(nonce + 4);
+		state[15] = Load32(nonce + 8);
+	}
+
+	// XORs the key stream into data, in place
+	void ChaChaXor(DWORD state[16], BYTE* data, int len)
+	{
+		BYTE block[64];
+		while (len > 0) {
+			ChaChaBlock(state, block);
+			state[12]++;
+			int n = len < 64 ? len : 64;
+			if (n == 64) {
+				for (int i = 0; i < 16; i++)
+					Store32(data + 4 * i, Load32(data + 4 * i) ^ Load32(block + 4 * i));
+			}
+			else {
+				for (int i = 0; i < n; i++)
+					data[i] ^= block[i];
+			}
+			data += n;
+			len -= n;
+		}
+	}
+
+	// Poly1305 with 26 bit limbs, messages are always whole 16 byte blocks
+	struct Poly1305 {
+		DWORD r[5];
+		DWORD h[5];
+		DWORD pad[4];
+
+		void Init(const BYTE* key)
+		{
+			r[0] = (Load32(key + 0)) & 0x3ffffff;
+			r[1] = (Load32(key + 3) >> 2) & 0x3ffff03;
+			r[2] = (Load32(key + 6) >> 4) & 0x3ffc0ff;
+			r[3] = (Load32(key + 9) >> 6) & 0x3f03fff;
+			r[4] = (Load32(key + 12) >> 8) & 0x00fffff;
+			memset(h, 0, sizeof(h));
+			for (int i = 0; i < 4; i++)
+				pad[i] = Load32(key + 16 + 4 * i);
+		}
+
+		void Blocks(const BYTE* m, int len)
+		{
+			const DWORD hibit = 1 << 24;
+			DWORD r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+			DWORD s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+			DWORD h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+
+			while (len >= 16) {
+				h0 += (Load32(m + 0)) & 0x3ffffff;
+				h1 += (Load32(m + 3) >> 2) & 0x3ffffff;
+				h2 += (Load32(m + 6) >> 4) & 0x3ffffff;
+				h3 += (Load32(m + 9) >> 6) & 0x3ffffff;
+				h4 += (Load32(m + 12) >> 8) | hibit;
+
+				QWORD_T d0 = (QWORD_T)h0 * r0 + (QWORD_T)h1 * s4 + (QWORD_T)h2 * s3 + (QWORD_T)h3 * s2 + (QWORD_T)h4 * s1;
+				QWORD_T d1 = (QWORD_T)h0 * r1 + (QWORD_T)h1 * r0 + (QWORD_T)h2 * s4 + (QWORD_T)h3 * s3 + (QWORD_T)h4 * s2;
+				QWORD_T d2 = (QWORD_T)h0 * r2 + (QWORD_T)h1 * r1 + (QWORD_T)h2 * r0 + (QWORD_T)h3 * s4 + (QWORD_T)h4 * s3;
+				QWORD_T d3 = (QWORD_T)h0 * r3 + (QWORD_T)h1 * r2 + (QWORD_T)h2 * r1 + (QWORD_T)h3 * r0 + (QWORD_T)h4 * s4;
+				QWORD_T d4 = (QWORD_T)h0 * r4 + (QWORD_T)h1 * r3 + (QWORD_T)h2 * r2 + (QWORD_T)h3 * r1 + (QWORD_T)h4 * r0;
+
+				DWORD c = (DWORD)(d0 >> 26); h0 = (DWORD)d0 & 0x3ffffff;
+				d1 += c; c = (DWORD)(d1 >> 26); h1 = (DWORD)d1 & 0x3ffffff;
+				d2 += c; c = (DWORD)(d2 >> 26); h2 = (DWORD)d2 & 0x3ffffff;
+				d3 += c; c = (DWORD)(d3 >> 26); h3 = (DWORD)d3 & 0x3ffffff;
+				d4 += c; c = (DWORD)(d4 >> 26); h4 = (DWORD)d4 & 0x3ffffff;
+				h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+				h1 += c;
+
+				m += 16;
+				len -= 16;
+			}
+			h[0] = h0; h[1] = h1; h[2] = h2; h[3] = h3; h[4] = h4;
+		}
+
+		// Pads the tail of a message with zeros to a whole block
+		void PaddedBlocks(const BYTE* m, int len)
+		{
+			int whole = len & ~15;
+			Blocks(m, whole);
+			if (len > whole) {
+				BYTE block[16];
+				memset(block, 0, sizeof(block));
+				memcpy(block, m + whole, len - whole);
+				Blocks(block, 16);
+			}
+		}
+
+		void Finish(BYTE* tag)
+		{
+			DWORD h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+			DWORD c;
+
+			c = h1 >> 26; h1 &= 0x3ffffff;
+			h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+			h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+			h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+			h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+			h1 += c;
+
+			// h - p, keep it when it did not go negative
+			DWORD g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+			DWORD g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+			DWORD g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+			DWORD g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+			DWORD g4 = h4 + c - (1 << 26);
+
+			DWORD mask = (g4 >> 31) - 1;
+			g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+			mask = ~mask;
+			h0 = (h0 & mask) | g0;
+			h1 = (h1 & mask) | g1;
+			h2 = (h2 & mask) | g2;
+			h3 = (h3 & mask) | g3;
+			h4 = (h4 & mask) | g4;
+
+			h0 = (h0 | (h1 << 26));
+			h1 = ((h1 >> 6) | (h2 << 20));
+			h2 = ((h2 >> 12) | (h3 << 14));
+			h3 = ((h3 >> 18) | (h4 << 8));
+
+			QWORD_T f;
+			f = (QWORD_T)h0 + pad[0]; h0 = (DWORD)f;
+			f = (QWORD_T)h1 + pad[1] + (f >> 32); h1 = (DWORD)f;
+			f = (QWORD_T)h2 + pad[2] + (f >> 32); h2 = (DWORD)f;
+			f = (QWORD_T)h3 + pad[3] + (f >> 32); h3 = (DWORD)f;
+
+			Store32(tag + 0, h0);
+			Store32(tag + 4, h1);
+			Store32(tag + 8, h2);
+			Store32(tag + 12, h3);
+		}
+	};
+
+	// Nonce prefixes, one per direction
+	const DWORD DIRECTION_SERVER = 0x53525652; // "RVRS"
+	const DWORD DIRECTION_VIEWER = 0x52574956; // "VIWR"
+
+}
+
+CRecordCipher::CRecordCipher(int nMaxPayload)
+{
+	if (nMaxPayload <= 0)
+		nMaxPayload = DEFAULT_MAX_PAYLOAD;
+	if (nMaxPayload > LIMIT_MAX_PAYLOAD)
+		nMaxPayload = LIMIT_MAX_PAYLOAD;
+	m_nMaxPayload = nMaxPayload;
+	memset(m_key, 0, sizeof(m_key));
+	m_fKeySet = false;
+	m_dwSealDirection = DIRECTION_SERVER;
+	m_dwOpenDirection = DIRECTION_VIEWER;
+	m_nSealSequence = 0;
+	m_nOpenSequence = 0;
+}
+
+CRecordCipher::~CRecordCipher()
+{
+	// Do not leave the key behind in freed memory
+	volatile BYTE* p = m_key;
+	for (int i = 0; i < KEY_SIZE; i++)
+		p[i] = 0;
+}
+
+void CRecordCipher::SetKey(const BYTE* pKey, bool bServer)
+{
+	memcpy(m_key, pKey, KEY_SIZE);
+	m_fKeySet = true;
+	m_dwSealDirection = bServer ? DIRECTION_SERVER : DIRECTION_VIEWER;
+	m_dwOpenDirection = bServer ? DIRECTION_VIEWER : DIRECTION_SERVER;
+	m_nSealSequence = 0;
+	m_nOpenSequence = 0;
+}
+
+void CRecordCipher::MakeNonce(DWORD dwDirection, unsigned __int64 nSequence, BYTE* pNonce)
+{
+	Store32(pNonce, dwDirection);
+	Store32(pNonce + 4, (DWORD)nSequence);
+	Store32(pNonce + 8, (DWORD)(nSequence >> 32));
+}
+
+void CRecordCipher::ComputeTag(const BYTE* pNonce, const BYTE* pHeader, const BYTE* pData, int nDataLen, BYTE* pTag)
+{
+	// One time Poly1305 key from block 0 of the key stream
+	DWORD state[16];
+	BYTE polyKey[64];
+	ChaChaInit(state, m_key, pNonce, 0);
+	ChaChaBlock(state, polyKey);
+
+	Poly1305 poly;
+	poly.Init(polyKey);
+	poly.PaddedBlocks(pHeader, HEADER_SIZE);
+	poly.PaddedBlocks(pData, nDataLen);
+
+	BYTE lengths[16];
+	Store32(lengths + 0, HEADER_SIZE);
+	Store32(lengths + 4, 0);
+	Store32(lengths + 8, (DWORD)nDataLen);
+	Store32(lengths + 12, 0);
+	poly.Blocks(lengths, 16);
+	poly.Finish(pTag);
+}
+
+int CRecordCipher::SealRecord(BYTE* pRecord, int nDataLen)
+{
+	if (!m_fKeySet || nDataLen < 0 || nDataLen > m_nMaxPayload)
+		return 0;
+
+	pRecord[0] = (BYTE)(nDataLen >> 24);
+	pRecord[1] = (BYTE)(nDataLen >> 16);
+	pRecord[2] = (BYTE)(nDataLen >> 8);
+	pRecord[3] = (BYTE)nDataLen;
+
+	BYTE nonce[12];
+	MakeNonce(m_dwSealDirection, m_nSealSequence++, nonce);
+
+	BYTE* pData = pRecord + HEADER_SIZE;
+	DWORD state[16];
+	ChaChaInit(state, m_key, nonce, 1);
+	ChaChaXor(state, pData, nDataLen);
+	ComputeTag(nonce, pRecord, pData, nDataLen, pData + nDataLen);
+
+	return HEADER_SIZE + nDataLen + TAG_SIZE;
+}
+
+int CRecordCipher::GetRecordLength(const BYTE* pHeader)
+{
+	DWORD nDataLen = ((DWORD)pHeader[0] << 24) | ((DWORD)pHeader[1] << 16) | ((DWORD)pHeader[2] << 8) | pHeader[3];
+	if (nDataLen > (DWORD)m_nMaxPayload)
+		return 0;
+	return HEADER_SIZE + (int)nDataLen + TAG_SIZE;
+}
+
+int CRecordCipher::OpenRecord(BYTE* pRecord, int nRecordLen)
+{
+	if (!m_fKeySet || nRecordLen < HEADER_SIZE + TAG_SIZE || GetRecordLength(pRecord) != nRecordLen)
+		return -1;
+
+	int nDataLen = nRecordLen - HEADER_SIZE - TAG_SIZE;
+	BYTE* pData = pRecord + HEADER_SIZE;
+
+	BYTE nonce[12];
+	MakeNonce(m_dwOpenDirection, m_nOpenSequence, nonce);
+
+	BYTE tag[TAG_SIZE];
+	ComputeTag(nonce, pRecord, pData, nDataLen, tag);
+
+	BYTE diff = 0;
+	for (int i = 0; i < TAG_SIZE; i++)
+		diff |= tag[i] ^ pData[nDataLen + i];
+	if (diff != 0)
+		return -1;
+
+	m_nOpenSequence++;
+	DWORD state[16];
+	ChaChaInit(state, m_key, nonce, 1);
+	ChaChaXor(state, pData, nDataLen);
+
+	return nDataLen;
+}
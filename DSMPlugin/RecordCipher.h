@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// RecordCipher.h: reference IRecordPlugin implementation.
+//
+// ChaCha20-Poly1305 (RFC 8439) over records of
+//   [payload length, 4 bytes big endian][ciphertext][16 bytes tag]
+// The length is authenticated as additional data. The nonce is the
+// direction and a record counter, so the counters never go over the wire
+// and a replayed, dropped or reordered record fails to open.
+//
+// A plugin embeds this class next to its handshake and hands the session
+// key to SetKey(). winvnc and the viewer only see IRecordPlugin through
+// the plugin DLL and do not build this file; vncbench uses it to measure
+// the record path.
+
+#if !defined(RecordCipher_H)
+#define RecordCipher_H
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "DSMPlugin.h"
+
+class CRecordCipher : public IRecordPlugin
+{
+public:
+	enum {
+		KEY_SIZE = 32,
+		HEADER_SIZE = 4,
+		TAG_SIZE = 16,
+		DEFAULT_MAX_PAYLOAD = 32 * 1024,
+		LIMIT_MAX_PAYLOAD = 1024 * 1024
+	};
+
+	CRecordCipher(int nMaxPayload = DEFAULT_MAX_PAYLOAD);
+	virtual ~CRecordCipher();
+
+	// Both ends use the same key, bServer picks the nonce of each direction
+	void SetKey(const BYTE* pKey, bool bServer);
+
+	virtual int GetRecordHeaderSize() { return HEADER_SIZE; };
+	virtual int GetRecordTrailerSize() { return TAG_SIZE; };
+	virtual int GetMaxRecordPayload() { return m_nMaxPayload; };
+
+	virtual int SealRecord(BYTE* pRecord, int nDataLen);
+	virtual int GetRecordLength(const BYTE* pHeader);
+	virtual int OpenRecord(BYTE* pRecord, int nRecordLen);
+
+private:
+	void MakeNonce(DWORD dwDirection, unsigned __int64 nSequence, BYTE* pNonce);
+	void ComputeTag(const BYTE* pNonce, const BYTE* pHeader, const BYTE* pData, int nDataLen, BYTE* pTag);
+
+	BYTE m_key[KEY_SIZE];
+	bool m_fKeySet;
+	DWORD m_dwSealDirection;
+	DWORD m_dwOpenDirection;
+	unsigned __int64 m_nSealSequence;
+	unsigned __int64 m_nOpenSequence;
+	int m_nMaxPayload;
+};
+
+#endif
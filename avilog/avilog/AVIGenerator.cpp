@@ -75,7 +75,10 @@ void CAVIGenerator::SetBitmapHeader(LPBITMAPINFOHEADER lpbih)
 	memcpy(&m_bih,lpbih, sizeof(BITMAPINFOHEADER));
 	//m_bih.biHeight=-m_bih.biHeight;
 	m_bih.biCompression=BI_RGB;
-	tempbuffer= new unsigned char[m_bih.biSizeImage];
+	// DIB rows are DWORD aligned, the padding stays zero
+	int frameSize=(m_bih.biWidth*m_bih.biBitCount+31)/32*4*abs(m_bih.biHeight);
+	tempbuffer= new unsigned char[frameSize];
+	memset(tempbuffer,0,frameSize);
 	m_bih.biSizeImage=0;
 }
 
@@ -344,15 +347,23 @@ HRESULT CAVIGenerator::AddFrame(BYTE *bmBits)
 	DWORD newtime = GetTimeFunction();
 	if ((newtime-oldtime)<(1000/m_dwRate)) return 0;
 	oldtime=newtime;
+	return WriteFrame(bmBits);
+}
+
+HRESULT CAVIGenerator::WriteFrame(BYTE *bmBits, int stride)
+{
 	HRESULT hr;
 	int width=m_bih.biWidth*m_bih.biBitCount/8;
+	int rowBytes=(m_bih.biWidth*m_bih.biBitCount+31)/32*4;
+	if (stride==0)
+		stride=width;
 	unsigned char *temp;
 	temp=tempbuffer;//+(abs(m_bih.biHeight)-1)*(m_bih.biWidth)*m_bih.biBitCount/8;
 	for (int i=0;i<(abs(m_bih.biHeight));i++)
 	{
 		memcpy(temp,bmBits,width);
-		temp+=width;
-		bmBits+=width;
+		temp+=rowBytes;
+		bmBits+=stride;
 	}
 
 	// compress bitmap
@@ -360,7 +371,7 @@ HRESULT CAVIGenerator::AddFrame(BYTE *bmBits)
 		m_lFrame,						// time of this frame
 		1,						// number to write
 		tempbuffer,					// image buffer
-		m_bih.biSizeImage,		// size of this frame
+		rowBytes*abs(m_bih.biHeight),		// size of this frame
 		AVIIF_KEYFRAME,			// flags....
 		NULL,
 		NULL);
@@ -92,6 +92,9 @@ public:
 	The data pointed by bmBits has to be compatible with the bitmap description of the movie.
 	*/
 	HRESULT AddFrame(BYTE* bmBits);
+	//! Adds a frame whatever the time since the last one, for movies written offline.
+	//! stride is the source's bytes per row, 0 for rows packed without padding
+	HRESULT WriteFrame(BYTE* bmBits, int stride = 0);
 	//! Release ressources allocated for movie and close file.
 	void ReleaseEngine();
 	//@}
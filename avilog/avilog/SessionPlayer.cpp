@@ -0,0 +1,257 @@
+// SessionPlayer.cpp: implementation of the CSessionPlayer class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "SessionPlayer.h"
+#ifndef _VNC_PORTABLE
+#include "AVIGenerator.h"
+#endif
+
+CSessionPlayer::CSessionPlayer()
+: m_file(NULL), m_dctx(NULL), m_size(0), m_end(0), m_next(0),
+  m_time(0), m_frameNumber(0), m_started(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+CSessionPlayer::~CSessionPlayer()
+{
+	Close();
+}
+
+bool CSessionPlayer::Open(LPCTSTR sFile)
+{
+	Close();
+	if (fopen_s(&m_file, sFile, "rb") != 0 || m_file == NULL) {
+		m_file = NULL;
+		return false;
+	}
+	if (fread(&m_header, 1, sizeof(m_header), m_file) != sizeof(m_header) ||
+		memcmp(m_header.magic, SESSION_FILE_MAGIC, sizeof(m_header.magic)) != 0 ||
+		m_header.version != SESSION_VERSION ||
+		m_header.width == 0 || m_header.height == 0 || m_header.bitsPerPixel < 8 ||
+		m_header.stride < m_header.width * (m_header.bitsPerPixel / 8)) {
+		Close();
+		return false;
+	}
+	m_dctx = ZSTD_createDCtx();
+	if (m_dctx == NULL) {
+		Close();
+		return false;
+	}
+	_fseeki64(m_file, 0, SEEK_END);
+	m_size = _ftelli64(m_file);
+
+	if (!ReadIndex())
+		ScanIndex();
+	if (m_index.empty()) {
+		Close();
+		return false;
+	}
+	m_frame.assign((size_t)m_header.stride * m_header.height, 0);
+	m_next = m_index[0].offset;
+	return true;
+}
+
+void CSessionPlayer::Close()
+{
+	if (m_file != NULL) {
+		fclose(m_file);
+		m_file = NULL;
+	}
+	if (m_dctx != NULL) {
+		ZSTD_freeDCtx(m_dctx);
+		m_dctx = NULL;
+	}
+	m_index.clear();
+	m_frame.clear();
+	m_time = 0;
+	m_frameNumber = 0;
+	m_started = false;
+}
+
+bool CSessionPlayer::ReadIndex()
+{
+	SessionTrailer trailer;
+	if (m_size < sizeof(m_header) + sizeof(trailer))
+		return false;
+	_fseeki64(m_file, m_size - sizeof(trailer), SEEK_SET);
+	if (fread(&trailer, 1, sizeof(trailer), m_file) != sizeof(trailer) ||
+		memcmp(trailer.magic, SESSION_INDEX_MAGIC, sizeof(trailer.magic)) != 0 ||
+		trailer.indexOffset < sizeof(m_header) ||
+		trailer.indexOffset + (DWORD64)trailer.count * sizeof(SessionIndexEntry) + sizeof(trailer) != m_size)
+		return false;
+
+	m_index.resize(trailer.count);
+	_fseeki64(m_file, trailer.indexOffset, SEEK_SET);
+	if (trailer.count != 0 &&
+		fread(&m_index[0], sizeof(SessionIndexEntry), trailer.count, m_file) != trailer.count) {
+		m_index.clear();
+		return false;
+	}
+	m_end = trailer.indexOffset;
+	return true;
+}
+
+void CSessionPlayer::ScanIndex()
+{
+	// Walk the frames up to the first one that is cut off, the
+	// rest of a recording that was not closed is lost anyway
+	m_index.clear();
+	m_end = m_size;
+	DWORD frame = 0;
+	DWORD64 offset = sizeof(m_header);
+	SessionFrameHeader header;
+	while (ReadFrameHeader(offset, header)) {
+		if (header.flags & SESSION_FRAME_KEY) {
+			SessionIndexEntry entry;
+			entry.frame = frame;
+			entry.time = header.time;
+			entry.offset = offset;
+			m_index.push_back(entry);
+		}
+		offset += sizeof(header) + header.size;
+		frame++;
+	}
+	m_end = offset;
+}
+
+bool CSessionPlayer::ReadFrameHeader(DWORD64 offset, SessionFrameHeader &header)
+{
+	if (offset + sizeof(header) > m_end)
+		return false;
+	_fseeki64(m_file, offset, SEEK_SET);
+	if (fread(&header, 1, sizeof(header), m_file) != sizeof(header))
+		return false;
+	return header.magic == SESSION_FRAME_MAGIC &&
+		   offset + sizeof(header) + header.size <= m_end;
+}
+
+bool CSessionPlayer::ReadFrame()
+{
+	SessionFrameHeader header;
+	if (m_file == NULL || !ReadFrameHeader(m_next, header))
+		return false;
+	if (!ApplyFrame(header))
+		return false;
+	if (m_started)
+		m_frameNumber++;
+	m_started = true;
+	m_next += sizeof(header) + header.size;
+	m_time = header.time;
+	return true;
+}
+
+bool CSessionPlayer::ApplyFrame(const SessionFrameHeader &header)
+{
+	// The file position is just past the header
+	if (m_packed.size() < header.size)
+		m_packed.resize(header.size);
+	if (header.size != 0 && fread(&m_packed[0], 1, header.size, m_file) != header.size)
+		return false;
+	if (m_raw.size() < header.rawSize)
+		m_raw.resize(header.rawSize);
+	if (header.rawSize != 0) {
+		size_t raw = ZSTD_decompressDCtx(m_dctx, &m_raw[0], header.rawSize, &m_packed[0], header.size);
+		if (ZSTD_isError(raw) || raw != header.rawSize)
+			return false;
+	}
+
+	const int bytesPerPixel = m_header.bitsPerPixel / 8;
+	size_t pos = 0;
+	for (DWORD i = 0; i < header.rects; i++) {
+		SessionRect r;
+		if (pos + sizeof(r) > header.rawSize)
+			return false;
+		memcpy(&r, &m_raw[pos], sizeof(r));
+		pos += sizeof(r);
+		size_t rowBytes = (size_t)r.w * bytesPerPixel;
+		if ((DWORD)r.x + r.w > m_header.width || (DWORD)r.y + r.h > m_header.height ||
+			pos + rowBytes * r.h > header.rawSize)
+			return false;
+		BYTE *dst = &m_frame[(size_t)r.y * m_header.stride + (size_t)r.x * bytesPerPixel];
+		for (int y = 0; y < r.h; y++) {
+			memcpy(dst, &m_raw[pos], rowBytes);
+			pos += rowBytes;
+			dst += m_header.stride;
+		}
+	}
+	return true;
+}
+
+bool CSessionPlayer::NextTime(DWORD &time)
+{
+	SessionFrameHeader header;
+	if (m_file == NULL || !ReadFrameHeader(m_next, header))
+		return false;
+	time = header.time;
+	return true;
+}
+
+bool CSessionPlayer::Seek(DWORD time)
+{
+	if (m_file == NULL)
+		return false;
+
+	// Last keyframe at or before time, the first one if time is earlier
+	size_t key = 0;
+	for (size_t i = 1; i < m_index.size() && m_index[i].time <= time; i++)
+		key = i;
+
+	m_next = m_index[key].offset;
+	m_frameNumber = m_index[key].frame;
+	m_started = false;
+	if (!ReadFrame())
+		return false;
+
+	SessionFrameHeader header;
+	while (ReadFrameHeader(m_next, header) && header.time <= time) {
+		if (!ReadFrame())
+			return false;
+	}
+	return true;
+}
+
+#ifndef _VNC_PORTABLE
+HRESULT ConvertSessionToAvi(LPCTSTR sSession, LPCTSTR sFileName, LPCTSTR sPath)
+{
+	CSessionPlayer player;
+	if (!player.Open(sSession))
+		return E_FAIL;
+	const SessionFileHeader &header = player.GetHeader();
+
+	BITMAPINFOHEADER bih;
+	memset(&bih, 0, sizeof(bih));
+	bih.biSize = sizeof(bih);
+	bih.biWidth = header.width;
+	bih.biHeight = -(LONG)header.height;
+	bih.biPlanes = 1;
+	bih.biBitCount = (WORD)header.bitsPerPixel;
+	bih.biCompression = BI_RGB;
+
+	CAVIGenerator avi(sFileName, sPath, &bih, header.rate);
+	HRESULT hr = avi.InitEngine();
+	if (FAILED(hr)) {
+		avi.ReleaseEngine();
+		return hr;
+	}
+
+	// One AVI frame per 1/rate s of recording, a frame is repeated
+	// until the time of the next one
+	DWORD written = 0;
+	bool more = player.ReadFrame();
+	while (more && SUCCEEDED(hr)) {
+		DWORD until;
+		if (!player.NextTime(until))
+			until = player.GetTime() + 1;
+		while (SUCCEEDED(hr) && (DWORD64)written * 1000 < (DWORD64)until * header.rate) {
+			hr = avi.WriteFrame((BYTE *)player.GetFrame(), header.stride);
+			written++;
+		}
+		more = player.ReadFrame();
+	}
+	avi.ReleaseEngine();
+	return hr;
+}
+#endif // _VNC_PORTABLE
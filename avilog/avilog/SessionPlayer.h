@@ -0,0 +1,77 @@
+// SessionPlayer.h: playback of session recordings
+//
+// Reads what CSessionRecorder writes into a framebuffer of the
+// recorded size. Seeking starts at the last keyframe before the
+// target and applies the delta frames up to it.
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(_AVILOG_SESSIONPLAYER)
+#define _AVILOG_SESSIONPLAYER
+#pragma once
+
+#include "SessionRecorder.h"
+
+////////////////////////////////////////
+// class CSessionPlayer;
+//
+// One recording, one framebuffer. Not
+// thread-safe.
+//
+class CSessionPlayer
+{
+public:
+	CSessionPlayer();
+	~CSessionPlayer();
+
+	// Opens a recording, rebuilding the keyframe index when the
+	// recorder did not close it
+	bool Open(LPCTSTR sFile);
+	void Close();
+
+	const SessionFileHeader &GetHeader() const { return m_header; };
+	// Frame as of the last ReadFrame() or Seek()
+	const BYTE *GetFrame() const { return m_frame.empty() ? NULL : &m_frame[0]; };
+	DWORD GetTime() const { return m_time; };
+	DWORD GetFrameNumber() const { return m_frameNumber; };
+	// Time of the last keyframe, the length is only known after playing to the end
+	DWORD GetLastKeyTime() const { return m_index.empty() ? 0 : m_index.back().time; };
+
+	// Applies the next frame, false at the end or on corrupt data
+	bool ReadFrame();
+	// Time of the frame ReadFrame() applies next, false at the end
+	bool NextTime(DWORD &time);
+	// Moves to the last frame at or before time (ms)
+	bool Seek(DWORD time);
+
+private:
+	CSessionPlayer(const CSessionPlayer &);
+	CSessionPlayer &operator=(const CSessionPlayer &);
+
+	bool ReadIndex();
+	void ScanIndex();
+	bool ReadFrameHeader(DWORD64 offset, SessionFrameHeader &header);
+	bool ApplyFrame(const SessionFrameHeader &header);
+
+	FILE *m_file;
+	SessionFileHeader m_header;
+	ZSTD_DCtx *m_dctx;
+	std::vector<SessionIndexEntry> m_index;
+	std::vector<BYTE> m_frame;
+	std::vector<BYTE> m_raw;
+	std::vector<BYTE> m_packed;
+	DWORD64 m_size;				// of the file
+	DWORD64 m_end;				// end of the frames
+	DWORD64 m_next;				// offset of the next frame
+	DWORD m_time;
+	DWORD m_frameNumber;
+	bool m_started;				// a keyframe has been applied
+};
+
+// Writes a recording out as an AVI in sPath through CAVIGenerator,
+// repeating frames to keep the recorded timing. vncbench -avi runs it.
+// Video for Windows only, not in the portable build.
+#ifndef _VNC_PORTABLE
+HRESULT ConvertSessionToAvi(LPCTSTR sSession, LPCTSTR sFileName, LPCTSTR sPath);
+#endif
+
+#endif // _AVILOG_SESSIONPLAYER
@@ -0,0 +1,199 @@
+// SessionRecorder.cpp: implementation of the CSessionRecorder class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "SessionRecorder.h"
+
+CSessionRecorder::CSessionRecorder()
+: m_file(NULL), m_cctx(NULL), m_offset(0), m_frames(0),
+  m_start(0), m_lastFrame(0), m_lastKey(0), m_deltaBytes(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+CSessionRecorder::~CSessionRecorder()
+{
+	Close();
+}
+
+bool CSessionRecorder::Open(LPCTSTR sFile, int width, int height, int bitsPerPixel,
+							int stride, DWORD dwRate)
+{
+	Close();
+	if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF ||
+		bitsPerPixel < 8 || stride < width * bitsPerPixel / 8 || dwRate == 0)
+		return false;
+
+	if (fopen_s(&m_file, sFile, "wb") != 0 || m_file == NULL) {
+		m_file = NULL;
+		return false;
+	}
+	m_cctx = ZSTD_createCCtx();
+	if (m_cctx == NULL) {
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	memcpy(m_header.magic, SESSION_FILE_MAGIC, sizeof(m_header.magic));
+	m_header.version = SESSION_VERSION;
+	m_header.width = width;
+	m_header.height = height;
+	m_header.bitsPerPixel = bitsPerPixel;
+	m_header.stride = stride;
+	m_header.rate = dwRate;
+
+	m_index.clear();
+	m_offset = 0;
+	m_frames = 0;
+	m_lastKey = 0;
+	m_deltaBytes = 0;
+	if (!Write(&m_header, sizeof(m_header))) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CSessionRecorder::Close()
+{
+	if (m_file != NULL) {
+		SessionTrailer trailer;
+		trailer.indexOffset = m_offset;
+		trailer.count = (DWORD)m_index.size();
+		memcpy(trailer.magic, SESSION_INDEX_MAGIC, sizeof(trailer.magic));
+		// A recording without the trailer is still read by scanning
+		if (m_index.empty() || Write(&m_index[0], m_index.size() * sizeof(SessionIndexEntry)))
+			Write(&trailer, sizeof(trailer));
+		if (m_file != NULL)
+			fclose(m_file);
+		m_file = NULL;
+	}
+	if (m_cctx != NULL) {
+		ZSTD_freeCCtx(m_cctx);
+		m_cctx = NULL;
+	}
+	m_index.clear();
+}
+
+bool CSessionRecorder::FrameDue() const
+{
+	if (m_file == NULL)
+		return false;
+	if (m_frames == 0)
+		return true;
+	return GetTickCount() - m_lastFrame >= 1000 / m_header.rate;
+}
+
+bool CSessionRecorder::AddFrame(const BYTE *bits, const RECT *rects, int count)
+{
+	if (m_file == NULL)
+		return false;
+
+	DWORD now = GetTickCount();
+	if (m_frames == 0)
+		m_start = now;
+	DWORD time = now - m_start;
+	m_lastFrame = now;
+
+	// A keyframe when the interval is up, or as soon as the deltas
+	// since the last one hold as much as a full frame would
+	DWORD64 frameBytes = (DWORD64)m_header.width * m_header.height * (m_header.bitsPerPixel / 8);
+	if (m_frames == 0 || time - m_lastKey >= KEYFRAME_INTERVAL || m_deltaBytes >= frameBytes) {
+		RECT full = { 0, 0, (LONG)m_header.width, (LONG)m_header.height };
+		return WriteFrame(SESSION_FRAME_KEY, time, bits, &full, 1);
+	}
+	if (count == 0)
+		return true;
+	return WriteFrame(0, time, bits, rects, count);
+}
+
+bool CSessionRecorder::WriteFrame(DWORD flags, DWORD time, const BYTE *bits,
+								  const RECT *rects, int count)
+{
+	const int bytesPerPixel = m_header.bitsPerPixel / 8;
+
+	// Payload: the clipped rects and their rows
+	m_raw.clear();
+	DWORD nrects = 0;
+	for (int i = 0; i < count; i++) {
+		LONG left = rects[i].left < 0 ? 0 : rects[i].left;
+		LONG top = rects[i].top < 0 ? 0 : rects[i].top;
+		LONG right = rects[i].right > (LONG)m_header.width ? (LONG)m_header.width : rects[i].right;
+		LONG bottom = rects[i].bottom > (LONG)m_header.height ? (LONG)m_header.height : rects[i].bottom;
+		if (right <= left || bottom <= top)
+			continue;
+
+		SessionRect r;
+		r.x = (WORD)left;
+		r.y = (WORD)top;
+		r.w = (WORD)(right - left);
+		r.h = (WORD)(bottom - top);
+		size_t rowBytes = (size_t)r.w * bytesPerPixel;
+		size_t pos = m_raw.size();
+		m_raw.resize(pos + sizeof(r) + rowBytes * r.h);
+		memcpy(&m_raw[pos], &r, sizeof(r));
+		BYTE *dst = &m_raw[pos + sizeof(r)];
+		const BYTE *src = bits + (size_t)top * m_header.stride + (size_t)left * bytesPerPixel;
+		for (int y = 0; y < r.h; y++) {
+			memcpy(dst, src, rowBytes);
+			dst += rowBytes;
+			src += m_header.stride;
+		}
+		nrects++;
+	}
+	if (nrects == 0 && !(flags & SESSION_FRAME_KEY))
+		return true;
+
+	size_t bound = ZSTD_compressBound(m_raw.size());
+	if (m_packed.size() < bound)
+		m_packed.resize(bound);
+	size_t packed = ZSTD_compressCCtx(m_cctx, m_packed.empty() ? NULL : &m_packed[0], bound,
+									  m_raw.empty() ? NULL : &m_raw[0], m_raw.size(),
+									  COMPRESSION_LEVEL);
+	if (ZSTD_isError(packed)) {
+		Close();
+		return false;
+	}
+
+	SessionFrameHeader header;
+	header.magic = SESSION_FRAME_MAGIC;
+	header.flags = flags;
+	header.time = time;
+	header.rects = nrects;
+	header.rawSize = (DWORD)m_raw.size();
+	header.size = (DWORD)packed;
+
+	DWORD64 offset = m_offset;
+	if (!Write(&header, sizeof(header)) || !Write(&m_packed[0], packed)) {
+		Close();
+		return false;
+	}
+
+	if (flags & SESSION_FRAME_KEY) {
+		SessionIndexEntry entry;
+		entry.frame = m_frames;
+		entry.time = time;
+		entry.offset = offset;
+		m_index.push_back(entry);
+		m_lastKey = time;
+		m_deltaBytes = 0;
+	}
+	else
+		m_deltaBytes += m_raw.size();
+	m_frames++;
+	return true;
+}
+
+bool CSessionRecorder::Write(const void *data, size_t size)
+{
+	if (fwrite(data, 1, size, m_file) != size) {
+		// Closes without the index, the frames written so far stay readable
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+	m_offset += size;
+	return true;
+}
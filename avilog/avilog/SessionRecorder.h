@@ -0,0 +1,141 @@
+// SessionRecorder.h: session recordings of the changed rects
+//
+// A recording holds a keyframe with the whole framebuffer every
+// few seconds and, between them, only the rects that changed. Each
+// frame is zstd compressed on its own, so a player can start at any
+// keyframe. The keyframe index written on close makes the file
+// seekable; a recording that was not closed is still readable, the
+// player rebuilds the index by walking the frames.
+//
+// File layout, little endian:
+//
+//   SessionFileHeader
+//   frames:  SessionFrameHeader, zstd(payload)
+//            payload: per rect a SessionRect, then h rows of w pixels
+//   index:   SessionIndexEntry[count]
+//   SessionTrailer
+//
+// Rows are stored top down, as in the server's framebuffer.
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(_AVILOG_SESSIONRECORDER)
+#define _AVILOG_SESSIONRECORDER
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#ifdef _INTERNALLIB
+#include <zstd.h>
+#else
+#include "../../zstd/lib/zstd.h"
+#endif
+
+#define SESSION_FILE_MAGIC		"UVNCREC1"
+#define SESSION_INDEX_MAGIC		"UVNCIDX1"
+#define SESSION_FRAME_MAGIC		0x314D5246		// "FRM1"
+#define SESSION_VERSION			1
+#define SESSION_FRAME_KEY		0x0001
+
+#pragma pack(push, 1)
+struct SessionFileHeader
+{
+	char magic[8];
+	DWORD version;
+	DWORD width;
+	DWORD height;
+	DWORD bitsPerPixel;
+	DWORD stride;			// bytes per row of a frame
+	DWORD rate;				// frames per second the recorder took at most
+};
+
+struct SessionFrameHeader
+{
+	DWORD magic;
+	DWORD flags;
+	DWORD time;				// ms since the start of the recording
+	DWORD rects;
+	DWORD rawSize;			// payload size
+	DWORD size;				// compressed size that follows
+};
+
+struct SessionRect
+{
+	WORD x, y, w, h;
+};
+
+struct SessionIndexEntry
+{
+	DWORD frame;
+	DWORD time;
+	DWORD64 offset;			// of the SessionFrameHeader
+};
+
+struct SessionTrailer
+{
+	DWORD64 indexOffset;
+	DWORD count;
+	char magic[8];
+};
+#pragma pack(pop)
+
+////////////////////////////////////////
+// class CSessionRecorder;
+//
+// Writes a recording frame by frame.
+// The caller collects the changed area
+// between frames and passes its rects
+// when FrameDue() says a frame may be
+// written. One thread at a time.
+//
+class CSessionRecorder
+{
+public:
+	enum {
+		KEYFRAME_INTERVAL = 10000,		// ms
+		COMPRESSION_LEVEL = 3
+	};
+
+	CSessionRecorder();
+	~CSessionRecorder();
+
+	// Creates sFile for frames of width x height, stride bytes per row.
+	// At most dwRate frames per second are written.
+	bool Open(LPCTSTR sFile, int width, int height, int bitsPerPixel,
+			  int stride, DWORD dwRate);
+	// Writes the keyframe index and closes the file
+	void Close();
+	bool IsOpen() const { return m_file != NULL; };
+
+	// True when the rate allows the next frame
+	bool FrameDue() const;
+	// Writes the rects of bits that changed since the last frame.
+	// The whole of bits is written instead when a keyframe is due.
+	// False on a write error, the file is closed then.
+	bool AddFrame(const BYTE *bits, const RECT *rects, int count);
+
+	DWORD GetFrameCount() const { return m_frames; };
+
+private:
+	CSessionRecorder(const CSessionRecorder &);
+	CSessionRecorder &operator=(const CSessionRecorder &);
+
+	bool WriteFrame(DWORD flags, DWORD time, const BYTE *bits,
+					const RECT *rects, int count);
+	bool Write(const void *data, size_t size);
+
+	FILE *m_file;
+	SessionFileHeader m_header;
+	ZSTD_CCtx *m_cctx;
+	std::vector<BYTE> m_raw;
+	std::vector<BYTE> m_packed;
+	std::vector<SessionIndexEntry> m_index;
+	DWORD64 m_offset;			// of the next write
+	DWORD m_frames;
+	DWORD m_start;				// tick count of the first frame
+	DWORD m_lastFrame;
+	DWORD m_lastKey;			// time of the last keyframe
+	DWORD64 m_deltaBytes;		// raw bytes since the last keyframe
+};
+
+#endif // _AVILOG_SESSIONRECORDER
@@ -0,0 +1,218 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "BufferPool.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+	enum {
+		MIN_CLASS_SHIFT = 12,				// 4KB
+		NUM_CLASSES = 17,					// up to 256MB
+		MAX_CACHED_PER_CLASS = 4,
+		MAX_CACHED_BYTES = 64 * 1024 * 1024,
+		UNPOOLED = 0xFF
+	};
+
+	// Sits in front of every block, 16 bytes keep the data aligned for SSE
+	struct BlockHeader {
+		size_t capacity;
+		union {
+			BlockHeader *next;
+			unsigned char sizeClass;
+		};
+	};
+	const size_t HEADER_SIZE = 16;
+
+	struct Pool {
+		CRITICAL_SECTION lock;
+		BlockHeader *freeList[NUM_CLASSES];
+		int freeCount[NUM_CLASSES];
+		BufferPool::Stats stats;
+
+		Pool() {
+			InitializeCriticalSection(&lock);
+			memset(freeList, 0, sizeof(freeList));
+			memset(freeCount, 0, sizeof(freeCount));
+			memset(&stats, 0, sizeof(stats));
+		}
+	};
+
+	// Built on first use, so globals that allocate while they are
+	// constructed find it ready. Never destroyed, buffers owned by
+	// other globals may come back late.
+	Pool &ThePool()
+	{
+		static Pool *instance = new Pool;
+		return *instance;
+	}
+
+	inline int SizeClass(size_t size)
+	{
+		size_t classSize = (size_t)1 << MIN_CLASS_SHIFT;
+		for (int i = 0; i < NUM_CLASSES; i++) {
+			if (size <= classSize)
+				return i;
+			classSize <<= 1;
+		}
+		return -1;
+	}
+
+	inline size_t ClassSize(int sizeClass)
+	{
+		return (size_t)1 << (MIN_CLASS_SHIFT + sizeClass);
+	}
+
+	inline void UpdatePeak(Pool &pool)
+	{
+		size_t total = pool.stats.bytesInUse + pool.stats.bytesCached;
+		if (total > pool.stats.peakBytes)
+			pool.stats.peakBytes = total;
+	}
+
+}
+
+BYTE *
+BufferPool::Alloc(size_t size, size_t *capacity)
+{
+	Pool &pool = ThePool();
+	int sizeClass = SizeClass(size);
+	size_t blockSize = sizeClass < 0 ? size : ClassSize(sizeClass);
+	BlockHeader *block = NULL;
+
+	EnterCriticalSection(&pool.lock);
+	pool.stats.requests++;
+	if (sizeClass >= 0 && pool.freeList[sizeClass] != NULL) {
+		block = pool.freeList[sizeClass];
+		pool.freeList[sizeClass] = block->next;
+		pool.freeCount[sizeClass]--;
+		pool.stats.bytesCached -= blockSize;
+		pool.stats.bytesInUse += blockSize;
+		pool.stats.hits++;
+	}
+	LeaveCriticalSection(&pool.lock);
+
+	if (block == NULL) {
+		block = (BlockHeader *)malloc(HEADER_SIZE + blockSize);
+		if (block == NULL)
+			return NULL;
+		block->capacity = blockSize;
+		EnterCriticalSection(&pool.lock);
+		pool.stats.heapAllocs++;
+		pool.stats.bytesInUse += blockSize;
+		UpdatePeak(pool);
+		LeaveCriticalSection(&pool.lock);
+	}
+
+	block->sizeClass = sizeClass < 0 ? (unsigned char)UNPOOLED : (unsigned char)sizeClass;
+	if (capacity != NULL)
+		*capacity = blockSize;
+	return (BYTE *)block + HEADER_SIZE;
+}
+
+void
+BufferPool::Free(void *buf)
+{
+	if (buf == NULL)
+		return;
+	Pool &pool = ThePool();
+	BlockHeader *block = (BlockHeader *)((BYTE *)buf - HEADER_SIZE);
+	int sizeClass = block->sizeClass;
+	size_t blockSize = block->capacity;
+
+	EnterCriticalSection(&pool.lock);
+	pool.stats.bytesInUse -= blockSize;
+	if (sizeClass != UNPOOLED &&
+		pool.freeCount[sizeClass] < MAX_CACHED_PER_CLASS &&
+		pool.stats.bytesCached + blockSize <= MAX_CACHED_BYTES) {
+		block->next = pool.freeList[sizeClass];
+		pool.freeList[sizeClass] = block;
+		pool.freeCount[sizeClass]++;
+		pool.stats.bytesCached += blockSize;
+		block = NULL;
+	}
+	else {
+		pool.stats.heapFrees++;
+	}
+	LeaveCriticalSection(&pool.lock);
+
+	if (block != NULL)
+		free(block);
+}
+
+void
+BufferPool::Trim()
+{
+	Pool &pool = ThePool();
+	BlockHeader *freeList[NUM_CLASSES];
+
+	EnterCriticalSection(&pool.lock);
+	for (int i = 0; i < NUM_CLASSES; i++) {
+		freeList[i] = pool.freeList[i];
+		pool.stats.heapFrees += pool.freeCount[i];
+		pool.freeList[i] = NULL;
+		pool.freeCount[i] = 0;
+	}
+	pool.stats.bytesCached = 0;
+	LeaveCriticalSection(&pool.lock);
+
+	for (int i = 0; i < NUM_CLASSES; i++) {
+		while (freeList[i] != NULL) {
+			BlockHeader *next = freeList[i]->next;
+			free(freeList[i]);
+			freeList[i] = next;
+		}
+	}
+}
+
+void
+BufferPool::GetStats(Stats &stats)
+{
+	Pool &pool = ThePool();
+	EnterCriticalSection(&pool.lock);
+	stats = pool.stats;
+	LeaveCriticalSection(&pool.lock);
+}
+
+BYTE *
+PooledBuffer::Reserve(size_t size)
+{
+	if (size <= m_size)
+		return m_data;
+	Release();
+	m_data = BufferPool::Alloc(size, &m_size);
+	if (m_data == NULL)
+		m_size = 0;
+	return m_data;
+}
+
+void
+PooledBuffer::Release()
+{
+	BufferPool::Free(m_data);
+	m_data = NULL;
+	m_size = 0;
+}
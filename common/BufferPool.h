@@ -0,0 +1,101 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_UVNC_BUFFERPOOL)
+#define _UVNC_BUFFERPOOL
+#pragma once
+
+////////////////////////////////////////
+// class BufferPool;
+//
+// Process wide pool for the scratch
+// buffers of the encoders and decoders.
+//
+// Sizes are rounded up to power of two
+// classes from 4KB to 256MB, so a buffer
+// that grows a little at a time is not
+// reallocated on every rect, and a freed
+// block fits the next request of its
+// class. Bigger requests bypass the pool.
+//
+// Every class caches a few free blocks,
+// with a global cap on the cached bytes,
+// so what the pool keeps beyond the
+// blocks in use stays bounded on servers
+// that run for days. vncbench "pool"
+// reports the heap traffic once warm.
+//
+// Thread-safe.
+//
+class BufferPool
+{
+public:
+	struct Stats {
+		unsigned __int64 requests;		// Alloc() calls
+		unsigned __int64 hits;			// served from a cached block
+		unsigned __int64 heapAllocs;	// blocks taken from the heap
+		unsigned __int64 heapFrees;		// blocks given back to the heap
+		size_t bytesInUse;				// handed out and not yet freed
+		size_t bytesCached;				// free blocks kept for reuse
+		size_t peakBytes;				// highest bytesInUse + bytesCached
+	};
+
+	// Returns a block of at least size bytes, or NULL.
+	// capacity receives the usable size of the block.
+	static BYTE *Alloc(size_t size, size_t *capacity = NULL);
+	// Gives a block from Alloc() back, NULL is ignored
+	static void Free(void *buf);
+	// Releases all cached blocks to the heap
+	static void Trim();
+	static void GetStats(Stats &stats);
+};
+
+////////////////////////////////////////
+// class PooledBuffer;
+//
+// Grow-only scratch buffer backed by the
+// pool, for the "CheckBufferSize" pattern.
+// Contents are not kept when it grows.
+//
+class PooledBuffer
+{
+public:
+	PooledBuffer() : m_data(NULL), m_size(0) {};
+	~PooledBuffer() { Release(); };
+
+	BYTE *Reserve(size_t size);
+	void Release();
+
+	BYTE *Data() const { return m_data; };
+	size_t Size() const { return m_size; };
+
+private:
+	PooledBuffer(const PooledBuffer &);
+	PooledBuffer &operator=(const PooledBuffer &);
+
+	BYTE *m_data;
+	size_t m_size;
+};
+
+#endif // _UVNC_BUFFERPOOL
@@ -42,6 +42,7 @@
 #include <rdr/MemInStream.h>
 #include <rdr/ZlibOutStream.h>
 #include <rdr/ZlibInStream.h>
+#include <rdr/Exception.h>
 #ifdef _INTERNALLIB
 #include <zlib.h>
 #include <zstd.h>
@@ -307,6 +308,7 @@ ClipboardData::ClipboardData()
 	, m_pDataRTF(NULL)
 	, m_pDataHTML(NULL)
 	, m_pDataDIB(NULL)
+	, m_pPayload(NULL)
 {
 }
 
@@ -326,6 +328,213 @@ void ClipboardData::FreeData()
 	m_pDataRTF = NULL;
 	m_pDataHTML = NULL;
 	m_pDataDIB = NULL;
+
+	if (m_pPayload) {
+		m_pPayload->Release();
+		m_pPayload = NULL;
+	}
+}
+
+ClipboardPayload* ClipboardData::GetPayload(CARD32 formats)
+{
+	if (m_pPayload && m_pPayload->GetFormats() != formats) {
+		m_pPayload->Release();
+		m_pPayload = NULL;
+	}
+	if (!m_pPayload) {
+		m_pPayload = ClipboardPayload::Create(*this, formats);
+	}
+	return m_pPayload;
+}
+
+void ClipboardData::WriteFormats(rdr::OutStream& os, CARD32 formats) const
+{
+	if (formats & clipText) {
+		os.writeU32(m_lengthText);
+		os.writeBytes(m_pDataText, m_lengthText);
+	}
+	if (formats & clipRTF) {
+		os.writeU32(m_lengthRTF);
+		os.writeBytes(m_pDataRTF, m_lengthRTF);
+	}
+	if (formats & clipHTML) {
+		os.writeU32(m_lengthHTML);
+		os.writeBytes(m_pDataHTML, m_lengthHTML);
+	}
+	if (formats & clipDIB) {
+		os.writeU32(m_lengthDIB);
+		os.writeBytes(m_pDataDIB, m_lengthDIB);
+	}
+}
+
+int ClipboardData::GetFormatsLength(CARD32 formats) const
+{
+	int length = 0;
+	if (formats & clipText) length += 4 + m_lengthText;
+	if (formats & clipRTF) length += 4 + m_lengthRTF;
+	if (formats & clipHTML) length += 4 + m_lengthHTML;
+	if (formats & clipDIB) length += 4 + m_lengthDIB;
+	return length;
+}
+
+////////////////////////////////////////
+// class ClipboardCompressor;
+//
+// The one thread that compresses the
+// payloads, oldest first. Started with
+// the first payload and kept for the
+// life of the process.
+//
+class ClipboardCompressor {
+public:
+	static ClipboardCompressor& Get();
+
+	// Takes a reference to payload until it is compressed
+	void Queue(ClipboardPayload* payload);
+
+private:
+	ClipboardCompressor();
+
+	static DWORD WINAPI WorkerThread(LPVOID param);
+
+	CRITICAL_SECTION m_lock;
+	std::vector<ClipboardPayload*> m_queue;	// under m_lock
+	HANDLE m_work;				// semaphore, one count per queued payload
+	HANDLE m_thread;
+};
+
+ClipboardCompressor& ClipboardCompressor::Get()
+{
+	static ClipboardCompressor compressor;
+	return compressor;
+}
+
+ClipboardCompressor::ClipboardCompressor()
+	: m_thread(NULL)
+{
+	InitializeCriticalSection(&m_lock);
+	m_work = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+}
+
+void ClipboardCompressor::Queue(ClipboardPayload* payload)
+{
+	payload->AddRef();
+
+	EnterCriticalSection(&m_lock);
+	if (m_thread == NULL && m_work != NULL)
+		m_thread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+	bool queued = m_thread != NULL;
+	if (queued)
+		m_queue.push_back(payload);
+	LeaveCriticalSection(&m_lock);
+
+	if (queued) {
+		ReleaseSemaphore(m_work, 1, NULL);
+	} else {
+		payload->Compress();
+		payload->Release();
+	}
+}
+
+DWORD WINAPI ClipboardCompressor::WorkerThread(LPVOID param)
+{
+	ClipboardCompressor* compressor = (ClipboardCompressor*)param;
+
+	for (;;) {
+		WaitForSingleObject(compressor->m_work, INFINITE);
+
+		EnterCriticalSection(&compressor->m_lock);
+		ClipboardPayload* payload = compressor->m_queue.front();
+		compressor->m_queue.erase(compressor->m_queue.begin());
+		LeaveCriticalSection(&compressor->m_lock);
+
+		payload->Compress();
+		payload->Release();
+	}
+	return 0;
+}
+
+ClipboardPayload::ClipboardPayload(CARD32 formats)
+	: m_refs(1)
+	, m_ready(0)
+	, m_bFailed(false)
+	, m_formats(formats)
+	, m_pRaw(NULL)
+{
+	InitializeCriticalSection(&m_lock);
+}
+
+ClipboardPayload::~ClipboardPayload()
+{
+	delete m_pRaw;
+	for (size_t i = 0; i < m_waiters.size(); i++)
+		CloseHandle(m_waiters[i]);
+	DeleteCriticalSection(&m_lock);
+}
+
+ClipboardPayload* ClipboardPayload::Create(const ClipboardData& clipboardData, CARD32 formats)
+{
+	ClipboardPayload* payload = new ClipboardPayload(formats);
+
+	// A copy for the worker, the clipboard data is gone by the time it runs
+	payload->m_pRaw = new rdr::MemOutStream(clipboardData.GetFormatsLength(formats) + 1);
+	clipboardData.WriteFormats(*payload->m_pRaw, formats);
+
+	ClipboardCompressor::Get().Queue(payload);
+	return payload;
+}
+
+void ClipboardPayload::NotifyWhenReady(HANDLE hEvent)
+{
+	EnterCriticalSection(&m_lock);
+	HANDLE hCopy = NULL;
+	if (!IsReady() &&
+		DuplicateHandle(GetCurrentProcess(), hEvent, GetCurrentProcess(), &hCopy, 0, FALSE, DUPLICATE_SAME_ACCESS))
+		m_waiters.push_back(hCopy);
+	LeaveCriticalSection(&m_lock);
+	if (hCopy == NULL)
+		SetEvent(hEvent);
+}
+
+void ClipboardPayload::AddRef()
+{
+	InterlockedIncrement(&m_refs);
+}
+
+void ClipboardPayload::Release()
+{
+	if (InterlockedDecrement(&m_refs) == 0) {
+		delete this;
+	}
+}
+
+void ClipboardPayload::Compress()
+{
+	// Nobody but the worker holds it any more, a newer clipboard
+	// replaced it
+	if (m_refs == 1) {
+		m_bFailed = true;
+	} else {
+		try {
+			rdr::ZlibOutStream compressedStream(&m_compressed, 0, 9); //Z_BEST_COMPRESSION
+			compressedStream.writeBytes(m_pRaw->data(), m_pRaw->length());
+			compressedStream.flush();
+		} catch (rdr::Exception&) {
+			m_bFailed = true;
+		}
+	}
+
+	delete m_pRaw;
+	m_pRaw = NULL;
+
+	EnterCriticalSection(&m_lock);
+	InterlockedExchange(&m_ready, 1);
+	for (size_t i = 0; i < m_waiters.size(); i++) {
+		SetEvent(m_waiters[i]);
+		CloseHandle(m_waiters[i]);
+	}
+	m_waiters.clear();
+	LeaveCriticalSection(&m_lock);
 }
 
 bool ClipboardData::Load(HWND hwndOwner) // will return false on failure
@@ -636,7 +845,23 @@ Clipboard::Clipboard(CARD32 caps)
 	, m_bNeedToProvide(false)
 	, m_bNeedToNotify(false)
 	, m_notifiedRemoteFormats(0)
+	, m_bCompressAsync(false)
+	, m_pPayload(NULL)
+	, m_hProvideReady(NULL)
+{
+}
+
+Clipboard::~Clipboard()
+{
+	ReleasePayload();
+}
+
+void Clipboard::ReleasePayload()
 {
+	if (m_pPayload) {
+		m_pPayload->Release();
+		m_pPayload = NULL;
+	}
 }
 
 // returns true if something changed
@@ -675,65 +900,65 @@ bool Clipboard::UpdateClipTextEx(ClipboardData& clipboardData, CARD32 overrideFl
 		extendedClipboardDataMessage.AddFlag(clipProvide);
 		extendedClipboardDataNotifyMessage.AddFlag(clipNotify);
 
-		rdr::MemOutStream memStream;
-		{
-			rdr::ZlibOutStream compressedStream(&memStream, 0, 9); //Z_BEST_COMPRESSION
+		ReleasePayload();
 
-			if (clipboardData.m_lengthText != 0) {
-				extendedClipboardDataNotifyMessage.AddFlag(clipText);
+		CARD32 provideFormats = 0;
 
-				if (clipboardData.m_lengthText <= settings.m_nLimitText || (overrideFlags & clipText)) {
-					compressedStream.writeU32(clipboardData.m_lengthText);
-					compressedStream.writeBytes(clipboardData.m_pDataText, clipboardData.m_lengthText);
-					extendedClipboardDataMessage.AddFlag(clipText);
-					m_bNeedToProvide = true;
-				} else if (!(overrideFlags & clipRequest)){
-					m_bNeedToNotify = true;
-				}
-			}
-			if (clipboardData.m_lengthRTF != 0) {
-				extendedClipboardDataNotifyMessage.AddFlag(clipRTF);
-
-				if (clipboardData.m_lengthRTF <= settings.m_nLimitRTF || (overrideFlags & clipRTF)) {
-					compressedStream.writeU32(clipboardData.m_lengthRTF);
-					compressedStream.writeBytes(clipboardData.m_pDataRTF, clipboardData.m_lengthRTF);
-					extendedClipboardDataMessage.AddFlag(clipRTF);
-					m_bNeedToProvide = true;
-				} else if (!(overrideFlags & clipRequest)) {
-					m_bNeedToNotify = true;
-				}
+		if (clipboardData.m_lengthText != 0) {
+			extendedClipboardDataNotifyMessage.AddFlag(clipText);
+
+			if (clipboardData.m_lengthText <= settings.m_nLimitText || (overrideFlags & clipText)) {
+				provideFormats |= clipText;
+			} else if (!(overrideFlags & clipRequest)){
+				m_bNeedToNotify = true;
 			}
-			if (clipboardData.m_lengthHTML != 0) {
-				extendedClipboardDataNotifyMessage.AddFlag(clipHTML);
-
-				if (clipboardData.m_lengthHTML <= settings.m_nLimitHTML || (overrideFlags & clipHTML)) {
-					compressedStream.writeU32(clipboardData.m_lengthHTML);
-					compressedStream.writeBytes(clipboardData.m_pDataHTML, clipboardData.m_lengthHTML);
-					extendedClipboardDataMessage.AddFlag(clipHTML);
-					m_bNeedToProvide = true;
-				} else if (!(overrideFlags & clipRequest)) {
-					m_bNeedToNotify = true;
-				}
+		}
+		if (clipboardData.m_lengthRTF != 0) {
+			extendedClipboardDataNotifyMessage.AddFlag(clipRTF);
+
+			if (clipboardData.m_lengthRTF <= settings.m_nLimitRTF || (overrideFlags & clipRTF)) {
+				provideFormats |= clipRTF;
+			} else if (!(overrideFlags & clipRequest)) {
+				m_bNeedToNotify = true;
 			}
-			if (clipboardData.m_lengthDIB != 0) {
-				extendedClipboardDataNotifyMessage.AddFlag(clipDIB);
-
-				if (clipboardData.m_lengthDIB <= settings.m_nLimitDIB || (overrideFlags & clipDIB)) {
-					compressedStream.writeU32(clipboardData.m_lengthDIB);
-					compressedStream.writeBytes(clipboardData.m_pDataDIB, clipboardData.m_lengthDIB);
-					extendedClipboardDataMessage.AddFlag(clipDIB);
-					m_bNeedToProvide = true;
-				} else if (!(overrideFlags & clipRequest)) {
-					m_bNeedToNotify = true;
-				}
+		}
+		if (clipboardData.m_lengthHTML != 0) {
+			extendedClipboardDataNotifyMessage.AddFlag(clipHTML);
+
+			if (clipboardData.m_lengthHTML <= settings.m_nLimitHTML || (overrideFlags & clipHTML)) {
+				provideFormats |= clipHTML;
+			} else if (!(overrideFlags & clipRequest)) {
+				m_bNeedToNotify = true;
 			}
+		}
+		if (clipboardData.m_lengthDIB != 0) {
+			extendedClipboardDataNotifyMessage.AddFlag(clipDIB);
 
-			compressedStream.flush();
+			if (clipboardData.m_lengthDIB <= settings.m_nLimitDIB || (overrideFlags & clipDIB)) {
+				provideFormats |= clipDIB;
+			} else if (!(overrideFlags & clipRequest)) {
+				m_bNeedToNotify = true;
+			}
 		}
 
-		if (m_bNeedToProvide) {
-			extendedClipboardDataMessage.AppendBytes((BYTE*)memStream.data(), memStream.length());
-			memStream.clear();
+		if (provideFormats != 0) {
+			extendedClipboardDataMessage.AddFlag(provideFormats);
+			m_bNeedToProvide = true;
+
+			if (!m_bCompressAsync) {
+				rdr::MemOutStream memStream;
+				{
+					rdr::ZlibOutStream compressedStream(&memStream, 0, 9); //Z_BEST_COMPRESSION
+					clipboardData.WriteFormats(compressedStream, provideFormats);
+					compressedStream.flush();
+				}
+				extendedClipboardDataMessage.AppendBytes((BYTE*)memStream.data(), memStream.length());
+			} else if (settings.m_bSupportsEx) {
+				m_pPayload = clipboardData.GetPayload(provideFormats);
+				m_pPayload->AddRef();
+				if (m_hProvideReady)
+					m_pPayload->NotifyWhenReady(m_hProvideReady);
+			}
 		}
 
 		m_strLastCutText = "";
@@ -37,6 +37,7 @@
 #include <winsock2.h>
 #include <windows.h>
 #include <string>
+#include <vector>
 #include <rdr/MemOutStream.h>
 #include "rfb.h"
 
@@ -126,6 +127,8 @@ struct ClipboardHolder {
 	bool m_bIsOpen;
 };
 
+class ClipboardPayload;
+
 struct ClipboardData {
 	ClipboardData();
 
@@ -145,16 +148,84 @@ struct ClipboardData {
 
 	void FreeData();
 
+	// The compressed formats, shared by every client that takes the same
+	// ones. Compression starts on the first call. Not AddRef'd for the caller.
+	ClipboardPayload* GetPayload(CARD32 formats);
+
+	// [CARD32 length][data] for each of the formats, in flag order
+	void WriteFormats(rdr::OutStream& os, CARD32 formats) const;
+	int GetFormatsLength(CARD32 formats) const;
+
 	bool Load(HWND hwndOwner); // will return false on failure
 
 	bool Restore(HWND hwndOwner, ExtendedClipboardDataMessage& extendedClipboardDataMessage);
+
+protected:
+	ClipboardPayload* m_pPayload;
+};
+
+////////////////////////////////////////
+// class ClipboardPayload;
+//
+// The zlib stream of a provide message,
+// compressed by the clipboard worker
+// thread. A large bitmap then holds up
+// neither the clipboard owner nor the
+// update thread of the client that
+// sends it.
+//
+// Refcounted, the data is read only once
+// IsReady().
+//
+class ClipboardPayload {
+public:
+	// Copies the formats of clipboardData and queues the compression
+	static ClipboardPayload* Create(const ClipboardData& clipboardData, CARD32 formats);
+
+	void AddRef();
+	void Release();
+
+	CARD32 GetFormats() const { return m_formats; };
+	bool IsReady() const { return m_ready != 0; };
+	bool Failed() const { return m_bFailed; };
+
+	// Sets hEvent once the payload is ready, at once if it is. The
+	// payload keeps a duplicate of the handle until then.
+	void NotifyWhenReady(HANDLE hEvent);
+
+	const BYTE* GetData() { return (const BYTE*)m_compressed.data(); };
+	int GetLength() { return m_compressed.length(); };
+
+protected:
+	friend class ClipboardCompressor;
+
+	ClipboardPayload(CARD32 formats);
+	~ClipboardPayload();
+
+	// On the worker thread
+	void Compress();
+
+	volatile LONG m_refs;
+	volatile LONG m_ready;
+	bool m_bFailed;
+	CARD32 m_formats;
+	rdr::MemOutStream* m_pRaw;		// freed once compressed
+	rdr::MemOutStream m_compressed;
+
+	CRITICAL_SECTION m_lock;
+	std::vector<HANDLE> m_waiters;	// under m_lock, set when ready
 };
 
 struct Clipboard {
 	Clipboard(CARD32 caps);
+	~Clipboard();
 
 	bool UpdateClipTextEx(ClipboardData& clipboardData, CARD32 overrideFlags = 0); // returns true if something changed
 
+	// The provide message is complete: its payload, if any, is compressed
+	bool IsProvideReady() const { return m_bNeedToProvide && (!m_pPayload || m_pPayload->IsReady()); };
+	void ReleasePayload();
+
 	ClipboardSettings settings;
 	DWORD m_crc;
 	std::string m_strLastCutText; // for non-extended clipboards
@@ -164,6 +235,13 @@ struct Clipboard {
 
 	CARD32 m_notifiedRemoteFormats;
 
+	// The provided formats are compressed by the clipboard worker and
+	// left out of extendedClipboardDataMessage, the sender appends m_pPayload.
+	// m_hProvideReady, if set, is set when m_pPayload is ready.
+	bool m_bCompressAsync;
+	ClipboardPayload* m_pPayload;
+	HANDLE m_hProvideReady;
+
 	ExtendedClipboardDataMessage extendedClipboardDataMessage;
 	ExtendedClipboardDataMessage extendedClipboardDataNotifyMessage;
 };
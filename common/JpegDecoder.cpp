@@ -0,0 +1,397 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "JpegDecoder.h"
+
+namespace {
+
+	// Scanlines handed to libjpeg per call
+	enum { ROW_BATCH = 16 };
+
+	const JOCTET g_eoi[2] = { 0xFF, JPEG_EOI };
+
+	template <class T>
+	inline void ConvertRow(const BYTE *src, BYTE *dst, int w, const JpegPixelFormat &fmt)
+	{
+		T *p = (T *)dst;
+		for (int x = 0; x < w; x++, src += 3)
+			p[x] = (T)(fmt.red[src[0]] | fmt.green[src[1]] | fmt.blue[src[2]]);
+	}
+
+}
+
+void
+JpegPixelFormat::Set(int bitsPerPixel,
+					 int redMax, int greenMax, int blueMax,
+					 int redShift, int greenShift, int blueShift)
+{
+	bytesPerPixel = bitsPerPixel / 8;
+	if (bytesPerPixel != 1 && bytesPerPixel != 2 && bytesPerPixel != 4)
+		bytesPerPixel = 0;
+
+	for (int i = 0; i < 256; i++) {
+		red[i] = (DWORD)((i * (redMax + 1)) >> 8) << redShift;
+		green[i] = (DWORD)((i * (greenMax + 1)) >> 8) << greenShift;
+		blue[i] = (DWORD)((i * (blueMax + 1)) >> 8) << blueShift;
+	}
+
+	colorSpace = JCS_UNKNOWN;
+#ifdef JCS_EXTENSIONS
+	// The framebuffer is little endian, so these are the byte orders
+	if (bytesPerPixel == 4 && redMax == 255 && greenMax == 255 && blueMax == 255) {
+		if (redShift == 0 && greenShift == 8 && blueShift == 16)
+			colorSpace = JCS_EXT_RGBX;
+		else if (redShift == 16 && greenShift == 8 && blueShift == 0)
+			colorSpace = JCS_EXT_BGRX;
+	}
+#endif
+}
+
+JpegDecoder::JpegDecoder()
+{
+	m_cinfo.err = jpeg_std_error(&m_err.pub);
+	m_err.pub.error_exit = ErrorExit;
+	m_err.pub.output_message = OutputMessage;
+	jpeg_create_decompress(&m_cinfo);
+
+	m_src.pub.init_source = InitSource;
+	m_src.pub.fill_input_buffer = FillInputBuffer;
+	m_src.pub.skip_input_data = SkipInputData;
+	m_src.pub.resync_to_restart = jpeg_resync_to_restart;
+	m_src.pub.term_source = TermSource;
+	m_src.pub.next_input_byte = NULL;
+	m_src.pub.bytes_in_buffer = 0;
+	m_src.error = false;
+	m_cinfo.src = &m_src.pub;
+}
+
+JpegDecoder::~JpegDecoder()
+{
+	jpeg_destroy_decompress(&m_cinfo);
+}
+
+void
+JpegDecoder::InitSource(j_decompress_ptr cinfo)
+{
+}
+
+// Out of data: flag the rect and end the image, libjpeg fills
+// the missing rows itself
+boolean
+JpegDecoder::FillInputBuffer(j_decompress_ptr cinfo)
+{
+	SourceManager *src = (SourceManager *)cinfo->src;
+	src->error = true;
+	src->pub.next_input_byte = g_eoi;
+	src->pub.bytes_in_buffer = sizeof(g_eoi);
+	return TRUE;
+}
+
+void
+JpegDecoder::SkipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+	SourceManager *src = (SourceManager *)cinfo->src;
+	if (numBytes <= 0)
+		return;
+	if ((size_t)numBytes > src->pub.bytes_in_buffer) {
+		FillInputBuffer(cinfo);
+		return;
+	}
+	src->pub.next_input_byte += (size_t)numBytes;
+	src->pub.bytes_in_buffer -= (size_t)numBytes;
+}
+
+void
+JpegDecoder::TermSource(j_decompress_ptr cinfo)
+{
+}
+
+void
+JpegDecoder::ErrorExit(j_common_ptr cinfo)
+{
+	ErrorManager *err = (ErrorManager *)cinfo->err;
+	longjmp(err->jump, 1);
+}
+
+// The default writes warnings to stderr
+void
+JpegDecoder::OutputMessage(j_common_ptr cinfo)
+{
+}
+
+bool
+JpegDecoder::Decode(const BYTE *src, size_t srcLen, int w, int h,
+					const JpegPixelFormat &fmt, BYTE *dst, int dstStride)
+{
+	if (w <= 0 || h <= 0 || srcLen == 0 || fmt.bytesPerPixel == 0)
+		return false;
+
+	m_src.pub.next_input_byte = src;
+	m_src.pub.bytes_in_buffer = srcLen;
+	m_src.error = false;
+
+	// Only members are used after the jump
+	if (setjmp(m_err.jump)) {
+		jpeg_abort_decompress(&m_cinfo);
+		return false;
+	}
+
+	jpeg_read_header(&m_cinfo, TRUE);
+	m_cinfo.out_color_space = fmt.colorSpace != JCS_UNKNOWN ? fmt.colorSpace : JCS_RGB;
+	jpeg_start_decompress(&m_cinfo);
+
+	if ((int)m_cinfo.output_width != w || (int)m_cinfo.output_height != h ||
+		m_cinfo.output_components != (fmt.colorSpace != JCS_UNKNOWN ? 4 : 3) ||
+		!ReadRows(w, h, fmt, dst, dstStride)) {
+		jpeg_abort_decompress(&m_cinfo);
+		return false;
+	}
+
+	jpeg_finish_decompress(&m_cinfo);
+	return true;
+}
+
+bool
+JpegDecoder::ReadRows(int w, int h, const JpegPixelFormat &fmt, BYTE *dst, int dstStride)
+{
+	JSAMPROW rows[ROW_BATCH];
+
+	// libjpeg writes the framebuffer rows
+	if (fmt.colorSpace != JCS_UNKNOWN) {
+		while (m_cinfo.output_scanline < m_cinfo.output_height) {
+			int y = m_cinfo.output_scanline;
+			int n = h - y < ROW_BATCH ? h - y : ROW_BATCH;
+			for (int i = 0; i < n; i++)
+				rows[i] = (JSAMPROW)(dst + (size_t)(y + i) * dstStride);
+			jpeg_read_scanlines(&m_cinfo, rows, n);
+			if (m_src.error)
+				return false;
+		}
+		return true;
+	}
+
+	// RGB rows, converted with the format tables
+	BYTE *buf = m_rows.Reserve((size_t)w * 3 * ROW_BATCH);
+	if (buf == NULL)
+		return false;
+	for (int i = 0; i < ROW_BATCH; i++)
+		rows[i] = (JSAMPROW)(buf + (size_t)i * w * 3);
+
+	while (m_cinfo.output_scanline < m_cinfo.output_height) {
+		int y = m_cinfo.output_scanline;
+		int n = (int)jpeg_read_scanlines(&m_cinfo, rows, ROW_BATCH);
+		if (m_src.error)
+			return false;
+		for (int i = 0; i < n; i++) {
+			BYTE *d = dst + (size_t)(y + i) * dstStride;
+			switch (fmt.bytesPerPixel) {
+			case 1:
+				ConvertRow<BYTE>(rows[i], d, w, fmt);
+				break;
+			case 2:
+				ConvertRow<WORD>(rows[i], d, w, fmt);
+				break;
+			case 4:
+				ConvertRow<DWORD>(rows[i], d, w, fmt);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+JpegDecodePool *
+JpegDecodePool::Create()
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	if (si.dwNumberOfProcessors < 2)
+		return NULL;
+
+	// The reader thread decodes too while it waits in Flush()
+	int workers = (int)si.dwNumberOfProcessors - 1;
+	if (workers > MAX_WORKERS)
+		workers = MAX_WORKERS;
+
+	JpegDecodePool *pool = new JpegDecodePool(workers);
+	if (pool->m_workers == 0) {
+		delete pool;
+		return NULL;
+	}
+	return pool;
+}
+
+JpegDecodePool::JpegDecodePool(int workers)
+	: m_count(0), m_next(0), m_outstanding(0), m_quit(false), m_workers(0), m_started(0)
+{
+	InitializeCriticalSection(&m_lock);
+	m_work = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	m_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (m_work == NULL || m_done == NULL)
+		return;
+
+	for (int i = 0; i < workers; i++) {
+		m_threads[m_workers] = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+		if (m_threads[m_workers] == NULL)
+			break;
+		m_workers++;
+	}
+}
+
+JpegDecodePool::~JpegDecodePool()
+{
+	// The framebuffer may be gone, the rects are dropped
+	Wait();
+	m_count = 0;
+	m_quit = true;
+	if (m_workers > 0) {
+		ReleaseSemaphore(m_work, m_workers, NULL);
+		WaitForMultipleObjects(m_workers, m_threads, TRUE, INFINITE);
+		for (int i = 0; i < m_workers; i++)
+			CloseHandle(m_threads[i]);
+	}
+	if (m_work)
+		CloseHandle(m_work);
+	if (m_done)
+		CloseHandle(m_done);
+	DeleteCriticalSection(&m_lock);
+}
+
+DWORD WINAPI
+JpegDecodePool::WorkerThread(LPVOID param)
+{
+	JpegDecodePool *pool = (JpegDecodePool *)param;
+	JpegDecoder &decoder = pool->m_decoders[InterlockedIncrement(&pool->m_started) - 1];
+
+	for (;;) {
+		WaitForSingleObject(pool->m_work, INFINITE);
+		if (pool->m_quit)
+			break;
+		// A job taken by Flush() leaves a count behind, then there
+		// is nothing to run
+		pool->RunJobs(decoder);
+	}
+	return 0;
+}
+
+void
+JpegDecodePool::RunJobs(JpegDecoder &decoder)
+{
+	for (;;) {
+		EnterCriticalSection(&m_lock);
+		int i = m_next < m_count ? m_next++ : -1;
+		LeaveCriticalSection(&m_lock);
+		if (i < 0)
+			return;
+
+		Job &job = m_jobs[i];
+		int tileStride = job.w * m_format.bytesPerPixel;
+		BYTE *tile = job.tile.Reserve((size_t)tileStride * job.h);
+		job.ok = tile != NULL &&
+				 decoder.Decode(job.data.Data(), job.srcLen, job.w, job.h,
+								m_format, tile, tileStride);
+		if (InterlockedDecrement(&m_outstanding) == 0)
+			SetEvent(m_done);
+	}
+}
+
+BYTE *
+JpegDecodePool::Reserve(size_t size)
+{
+	if (m_count == MAX_JOBS)
+		return NULL;
+	return m_jobs[m_count].data.Reserve(size);
+}
+
+void
+JpegDecodePool::Submit(size_t srcLen, int w, int h, BYTE *dst, int dstStride,
+					   int x, int y)
+{
+	Job &job = m_jobs[m_count];
+	job.srcLen = srcLen;
+	job.w = w;
+	job.h = h;
+	job.dst = dst;
+	job.dstStride = dstStride;
+	job.x = x;
+	job.y = y;
+	job.ok = false;
+
+	// Counted before a worker can see it
+	InterlockedIncrement(&m_outstanding);
+	EnterCriticalSection(&m_lock);
+	m_count++;
+	LeaveCriticalSection(&m_lock);
+	ReleaseSemaphore(m_work, 1, NULL);
+}
+
+bool
+JpegDecodePool::Overlaps(int x, int y, int w, int h) const
+{
+	for (int i = 0; i < m_count; i++) {
+		const Job &job = m_jobs[i];
+		if (x < job.x + job.w && job.x < x + w &&
+			y < job.y + job.h && job.y < y + h)
+			return true;
+	}
+	return false;
+}
+
+int
+JpegDecodePool::Wait()
+{
+	if (m_count == 0)
+		return 0;
+
+	RunJobs(m_decoders[MAX_WORKERS]);
+	// m_done may still be set from an earlier batch
+	while (m_outstanding > 0)
+		WaitForSingleObject(m_done, INFINITE);
+
+	int failed = 0;
+	for (int i = 0; i < m_count; i++) {
+		if (!m_jobs[i].ok)
+			failed++;
+	}
+	return failed;
+}
+
+void
+JpegDecodePool::Draw()
+{
+	for (int i = 0; i < m_count; i++) {
+		const Job &job = m_jobs[i];
+		if (!job.ok)
+			continue;
+		int rowBytes = job.w * m_format.bytesPerPixel;
+		for (int y = 0; y < job.h; y++)
+			memcpy(job.dst + (size_t)y * job.dstStride, job.tile.Data() + (size_t)y * rowBytes, rowBytes);
+	}
+
+	EnterCriticalSection(&m_lock);
+	m_count = 0;
+	m_next = 0;
+	LeaveCriticalSection(&m_lock);
+}
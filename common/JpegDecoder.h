@@ -0,0 +1,210 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_UVNC_JPEGDECODER)
+#define _UVNC_JPEGDECODER
+#pragma once
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "BufferPool.h"
+
+extern "C"
+{
+#ifdef _INTERNALLIB
+#include <jpeglib.h>
+#else
+#include "libjpeg-turbo-win/jpeglib.h"
+#endif
+}
+
+////////////////////////////////////////
+// struct JpegPixelFormat;
+//
+// Destination format of a decode, as
+// per channel lookup tables. A pixel is
+// red[r] | green[g] | blue[b], the same
+// value ConvertPixel_to_bpp_from_32()
+// computes, stored in 1, 2 or 4 bytes.
+//
+struct JpegPixelFormat
+{
+	JpegPixelFormat() : bytesPerPixel(0), colorSpace(JCS_UNKNOWN) {};
+
+	// From the fields of an rfbPixelFormat
+	void Set(int bitsPerPixel,
+			 int redMax, int greenMax, int blueMax,
+			 int redShift, int greenShift, int blueShift);
+
+	int bytesPerPixel;
+	// JCS_EXT_RGBX or JCS_EXT_BGRX when libjpeg can write the
+	// rows itself, JCS_UNKNOWN otherwise
+	J_COLOR_SPACE colorSpace;
+	DWORD red[256];
+	DWORD green[256];
+	DWORD blue[256];
+};
+
+////////////////////////////////////////
+// class JpegDecoder;
+//
+// A decompressor that is created once
+// and reused for every rect, with its
+// own source and error managers, so
+// there is no static state and one
+// decoder per thread can run at once.
+//
+// Corrupt data makes Decode() return
+// false, libjpeg errors never exit the
+// process.
+//
+class JpegDecoder
+{
+public:
+	JpegDecoder();
+	~JpegDecoder();
+
+	// Decodes a w x h JPEG image into dst, dstStride bytes per row.
+	// Rows decoded before an error are left in dst.
+	bool Decode(const BYTE *src, size_t srcLen, int w, int h,
+				const JpegPixelFormat &fmt, BYTE *dst, int dstStride);
+
+private:
+	JpegDecoder(const JpegDecoder &);
+	JpegDecoder &operator=(const JpegDecoder &);
+
+	struct SourceManager {
+		jpeg_source_mgr pub;
+		bool error;
+	};
+	struct ErrorManager {
+		jpeg_error_mgr pub;
+		jmp_buf jump;
+	};
+
+	static void InitSource(j_decompress_ptr cinfo);
+	static boolean FillInputBuffer(j_decompress_ptr cinfo);
+	static void SkipInputData(j_decompress_ptr cinfo, long numBytes);
+	static void TermSource(j_decompress_ptr cinfo);
+	static void ErrorExit(j_common_ptr cinfo);
+	static void OutputMessage(j_common_ptr cinfo);
+
+	bool ReadRows(int w, int h, const JpegPixelFormat &fmt, BYTE *dst, int dstStride);
+
+	jpeg_decompress_struct m_cinfo;
+	SourceManager m_src;
+	ErrorManager m_err;
+	PooledBuffer m_rows;
+};
+
+////////////////////////////////////////
+// class JpegDecodePool;
+//
+// Decodes the JPEG rects of an update
+// on worker threads, while the caller
+// goes on reading the stream.
+//
+// The caller reads the compressed data
+// into Reserve(), queues it with Submit()
+// and flushes the pool before it touches
+// the framebuffer under a queued rect,
+// before the update is shown and when
+// the pool is Full(). A flush is Wait(),
+// which decodes queued rects on the
+// calling thread as well, then Draw()
+// with the framebuffer locked.
+//
+// The workers decode into tiles of their
+// own; only Draw(), on the reader thread,
+// writes the framebuffer.
+//
+// Not thread-safe, one reader thread
+// drives the pool.
+//
+class JpegDecodePool
+{
+public:
+	enum { MAX_WORKERS = 4, MAX_JOBS = 16 };
+
+	// NULL on a single CPU, decoding in line is as fast there
+	static JpegDecodePool *Create();
+	~JpegDecodePool();
+
+	// Only while nothing is queued
+	void SetFormat(const JpegPixelFormat &fmt) { m_format = fmt; };
+
+	// Buffer for the compressed data of the next rect, or NULL.
+	// Only while not Full().
+	BYTE *Reserve(size_t size);
+	// Queues the rect reserved last
+	void Submit(size_t srcLen, int w, int h, BYTE *dst, int dstStride,
+				int x, int y);
+
+	bool Pending() const { return m_count > 0; };
+	bool Full() const { return m_count == MAX_JOBS; };
+	// True if x,y,w,h intersects a queued rect
+	bool Overlaps(int x, int y, int w, int h) const;
+	// Waits for all queued rects, returns how many failed to decode
+	int Wait();
+	// Copies the rects decoded by Wait() into the framebuffer and
+	// empties the pool. Failed rects are left out.
+	void Draw();
+
+private:
+	JpegDecodePool(int workers);
+	JpegDecodePool(const JpegDecodePool &);
+	JpegDecodePool &operator=(const JpegDecodePool &);
+
+	struct Job {
+		PooledBuffer data;
+		PooledBuffer tile;		// w * h pixels, decoded
+		size_t srcLen;
+		int w, h;
+		BYTE *dst;
+		int dstStride;
+		int x, y;
+		bool ok;
+	};
+
+	static DWORD WINAPI WorkerThread(LPVOID param);
+	// Decodes queued jobs until none is left to take
+	void RunJobs(JpegDecoder &decoder);
+
+	JpegPixelFormat m_format;
+	Job m_jobs[MAX_JOBS];
+	int m_count;			// queued since the last Flush()
+	int m_next;				// next job to take, under m_lock
+	volatile LONG m_outstanding;
+	CRITICAL_SECTION m_lock;
+	HANDLE m_work;			// semaphore, one count per queued job
+	HANDLE m_done;			// set when m_outstanding drops to 0
+	volatile bool m_quit;
+
+	int m_workers;
+	volatile LONG m_started;	// hands each worker its decoder
+	HANDLE m_threads[MAX_WORKERS];
+	JpegDecoder m_decoders[MAX_WORKERS + 1];	// the last one for Flush()
+};
+
+#endif // _UVNC_JPEGDECODER
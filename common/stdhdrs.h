@@ -22,6 +22,10 @@
 //
 ////////////////////////////////////////////////////////////////////////////
  
+#ifdef _VNC_PORTABLE
+// The encoders built outside Windows, see winvnc/portable
+#include "../winvnc/portable/stdhdrs.h"
+#else
 //#define _Gii
 #ifdef _Gii
 #ifndef WINVER                  // Specifies that the minimum required platform is Windows 7.
@@ -68,3 +72,4 @@
 #endif
 #endif
 
+#endif // _VNC_PORTABLE
@@ -30,6 +30,10 @@
 #else
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#define INVALID_SOCKET (-1)
+typedef long long LONGLONG;
 #endif
 
 // XXX should use autoconf HAVE_SYS_SELECT_H
@@ -43,14 +47,21 @@
 using namespace rdr;
 
 enum { DEFAULT_BUF_SIZE = 8192,
-       MIN_BULK_SIZE = 1024 };
+       DEFAULT_MAX_BUF_SIZE = 4 << 20,
+       MIN_BULK_SIZE = 1024,
+       // Reads in a row that fill the buffer before it doubles
+       GROW_AFTER_FULL_READS = 2 };
 
 FdInStream::FdInStream(int fd_, int timeout_, int bufSize_)
   : fd(fd_), timeout(timeout_), blockCallback(0), blockCallbackArg(0),
     timing(false), timeWaitedIn100us(5), timedKbits(0),
-    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0)
+    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE),
+    maxBufSize(DEFAULT_MAX_BUF_SIZE), fullReads(0), offset(0)
 {
 	ptr = end = start = new U8[bufSize];
+	if (maxBufSize < bufSize)
+		maxBufSize = bufSize;
+	resetStats();
 
 	// sf@2002
 	m_fDSMMode = false;
@@ -66,15 +77,21 @@ FdInStream::FdInStream(int fd_, void (*blockCallback_)(void*),
   : fd(fd_), timeout(0), blockCallback(blockCallback_),
     blockCallbackArg(blockCallbackArg_),
     timing(false), timeWaitedIn100us(5), timedKbits(0),
-    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0)
+    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE),
+    maxBufSize(DEFAULT_MAX_BUF_SIZE), fullReads(0), offset(0)
 {
 	ptr = end = start = new U8[bufSize];
+	if (maxBufSize < bufSize)
+		maxBufSize = bufSize;
+	resetStats();
 	
 	// sf@2002
 	m_fDSMMode = false;
 	m_fReadFromNetRectBuf = false;
 	m_nNetRectBufOffset = 0;
 	m_nReadSize = 0;
+
+	m_nBytesRead = 0; // For stats
 }
 
 FdInStream::~FdInStream()
@@ -110,8 +127,24 @@ void FdInStream::readBytes(void* data, int length)
 	length -= n;
 	ptr += n;
 
+	// The buffer is empty now if there is more to read. Outside DSM mode
+	// the socket read also fills it with the data after the block, the
+	// DSM plugin wants the socket left at the end of the block.
+	bool readAhead = length > 0 && !m_fDSMMode && !m_fReadFromNetRectBuf;
+	if (readAhead) {
+		offset += (int)(ptr - start);
+		ptr = end = start;
+	}
+
 	while (length > 0) {
-		n = readWithTimeoutOrCallback(dataPtr, length);
+		int space = readAhead ? bufSize : 0;
+		n = readWithTimeoutOrCallback(dataPtr, length, start, space);
+		if (n > length) {
+			end = start + (n - length);
+			n = length;
+		}
+		if (readAhead)
+			noteRead(n + (int)(end - start), length + space);
 		dataPtr += n;
 		length -= n;
 		offset += n;
@@ -121,8 +154,11 @@ void FdInStream::readBytes(void* data, int length)
 
 int FdInStream::overrun(int itemSize, int nItems)
 {
-  if (itemSize > bufSize)
-    throw Exception("FdInStream overrun: max itemSize exceeded");
+  if (itemSize > bufSize) {
+    if (itemSize > maxBufSize)
+      throw Exception("FdInStream overrun: max itemSize exceeded");
+    resize(itemSize);
+  }
 
   if (end - ptr != 0)
     memmove(start, ptr, end - ptr);
@@ -132,8 +168,10 @@ int FdInStream::overrun(int itemSize, int nItems)
   ptr = start;
 
   while (end < start + itemSize) {
-    int n = readWithTimeoutOrCallback((U8*)end, (int)(start + bufSize - end));
+    int space = (int)(start + bufSize - end);
+    int n = readWithTimeoutOrCallback((U8*)end, space);
     end += n;
+    noteRead(n, space);
   }
 
   if (itemSize * nItems > end - ptr)
@@ -200,15 +238,17 @@ LONGLONG
 Passedusecs()
 {
   LARGE_INTEGER counts, countsPerSec;
-  static LONGLONG usecPerCount = 0;
+  static LONGLONG countsPerSecond = 0;
   LONGLONG usecs=0;
 
   if (QueryPerformanceCounter(&counts)) {
-    if (usecPerCount == 0) {
+    if (countsPerSecond == 0) {
       QueryPerformanceFrequency(&countsPerSec);
-      usecPerCount = 1000000000000000000 / countsPerSec.QuadPart;
+      countsPerSecond = countsPerSec.QuadPart;
     }
-    usecs = (LONGLONG)(counts.QuadPart * usecPerCount /1000000000000);
+    // Whole seconds first, counts * 1000000 overflows after some uptime
+    usecs = counts.QuadPart / countsPerSecond * 1000000 +
+            counts.QuadPart % countsPerSecond * 1000000 / countsPerSecond;
 
   } else {
     struct timeb tb;
@@ -217,23 +257,59 @@ Passedusecs()
   }
   return usecs;
 }
+#else
+LONGLONG 
+Passedusecs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (LONGLONG)tv.tv_sec * 1000000 + tv.tv_usec;
+}
 #endif
 
-int FdInStream::readWithTimeoutOrCallback(void* buf, int len)
+int FdInStream::socketRead(void* buf, int len, void* buf2, int len2)
+{
+#ifdef _WIN32
+  if (len2 > 0) {
+    WSABUF bufs[2];
+    bufs[0].buf = (char*)buf;
+    bufs[0].len = len;
+    bufs[1].buf = (char*)buf2;
+    bufs[1].len = len2;
+    DWORD received = 0, flags = 0;
+    if (WSARecv(fd, bufs, 2, &received, &flags, NULL, NULL) == SOCKET_ERROR)
+      return -1;
+    return (int)received;
+  }
+  return ::read(fd, buf, len);
+#else
+  if (len2 > 0) {
+    struct iovec iov[2];
+    iov[0].iov_base = buf;
+    iov[0].iov_len = len;
+    iov[1].iov_base = buf2;
+    iov[1].iov_len = len2;
+    return (int)::readv(fd, iov, 2);
+  }
+  return (int)::read(fd, buf, len);
+#endif
+}
+
+int FdInStream::readWithTimeoutOrCallback(void* buf, int len, void* buf2, int len2)
 {
   /*struct timeval before = {0, 0}, after; // before will not get initialized if the condition is false
   if (timing)
     gettimeofday_(&before, NULL);*/
-  LONGLONG before =0, after; // before will not get initialized if the condition is false
-  if (timing)
-    before=Passedusecs();
+  LONGLONG before = Passedusecs(), after;
 
   if (fd==INVALID_SOCKET) 
 	  throw SystemException("read",errno);
 
   int n=0;
-  if (!m_fReadFromNetRectBuf)
+  // Without a timeout or callback the poll changes nothing, recv() blocks
+  if (!m_fReadFromNetRectBuf && (timeout || blockCallback))
   {
+	  stats.waits++;
 	  n = checkReadable(fd, timeout);
 	  
 	  if (n < 0) throw SystemException("select",errno);
@@ -273,7 +349,7 @@ int FdInStream::readWithTimeoutOrCallback(void* buf, int len)
 		fAlreadyCounted = true;
 	}
 	else
-		n = ::read(fd, buf, len);
+		n = socketRead(buf, len, buf2, len2);
 
     if (n != -1 || errno != EINTR)
       break;
@@ -291,10 +367,17 @@ int FdInStream::readWithTimeoutOrCallback(void* buf, int len)
   // sf@2002 - stats
   m_nBytesRead += n;
 
+  after = Passedusecs();
+  stats.reads++;
+  stats.bytes += n;
+  stats.blockedUs += after - before;
+  if (n > len)
+    stats.vectored++;
+  if (n > stats.largestRead)
+    stats.largestRead = n;
+
   if (timing)
   {
-    after=Passedusecs();
-
     LONGLONG newTimeWaited = (after- before)/100;
     int newKbits = n * 8 / 1000;
     if (newTimeWaited > newKbits*1000) newTimeWaited = newKbits*1000;
@@ -353,6 +436,47 @@ void FdInStream::stopTiming()
     timeWaitedIn100us = timedKbits/2; // upper limit 20Mbit/s
 }
 
+void FdInStream::noteRead(int n, int space)
+{
+  if (n < space) {
+    fullReads = 0;
+    return;
+  }
+  // The socket had more than the buffer could take
+  if (++fullReads >= GROW_AFTER_FULL_READS && bufSize < maxBufSize) {
+    resize(bufSize > maxBufSize / 2 ? maxBufSize : bufSize * 2);
+    fullReads = 0;
+  }
+}
+
+void FdInStream::resize(int size)
+{
+  int n = (int)(end - ptr);
+  U8* newStart = new U8[size];
+  memcpy(newStart, ptr, n);
+  offset += (int)(ptr - start);
+  delete [] start;
+  ptr = start = newStart;
+  end = start + n;
+  bufSize = size;
+  stats.grows++;
+}
+
+void FdInStream::setMaxBufSize(int size)
+{
+  maxBufSize = size < bufSize ? bufSize : size;
+}
+
+bool FdInStream::setSocketBufferSize(int size)
+{
+  return setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size)) == 0;
+}
+
+void FdInStream::resetStats()
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
 unsigned int FdInStream::kbitsPerSecond()
 {
   // The following calculation will overflow 32-bit arithmetic if we have
@@ -19,6 +19,12 @@
 //
 // FdInStream streams from a file descriptor.
 //
+// The buffer starts at bufSize and doubles, up to maxBufSize, while reads
+// keep filling it, so bulk updates are read in a few large recv() calls.
+// readBytes() of a large block reads into the caller's memory and the
+// buffer in one vectored call (WSARecv/readv), the data after the block
+// is not left in the socket.
+//
 
 #ifndef __RDR_FDINSTREAM_H__
 #define __RDR_FDINSTREAM_H__
@@ -33,6 +39,17 @@ namespace rdr {
 
   public:
 
+    // Read counters since construction or resetStats()
+    struct Stats {
+      unsigned __int64 reads;      // socket reads that returned data
+      unsigned __int64 bytes;      // bytes they returned
+      unsigned __int64 vectored;   // reads that also filled the buffer
+      unsigned __int64 waits;      // select() calls, for a timeout or callback
+      unsigned __int64 blockedUs;  // time spent in select() and recv()
+      int largestRead;
+      int grows;                   // buffer doublings
+    };
+
     FdInStream(int fd, int timeout=0, int bufSize=0);
     FdInStream(int fd, void (*blockCallback)(void*), void* blockCallbackArg=0,
 		  int bufSize=0);
@@ -54,12 +71,29 @@ namespace rdr {
 	__int64 GetBytesRead() {return m_nBytesRead;};
 	int Check_if_buffer_has_data();
 
+    // Limit for the buffer growth, at least the current size
+    void setMaxBufSize(int size);
+    int getBufSize() { return bufSize; }
+    // SO_RCVBUF of the socket. On Windows this turns off the receive
+    // window autotuning, so only set it for a known bandwidth.
+    bool setSocketBufferSize(int size);
+
+    const Stats& getStats() { return stats; }
+    void resetStats();
+    int bytesPerRead() { return stats.reads ? (int)(stats.bytes / stats.reads) : 0; }
+
   protected:
     int overrun(int itemSize, int nItems);
 
   private:
     int checkReadable(int fd, int timeout);
-    int readWithTimeoutOrCallback(void* buf, int len);
+    // Reads into buf, and with buf2 into buf2 once buf is full
+    int readWithTimeoutOrCallback(void* buf, int len, void* buf2=0, int len2=0);
+    int socketRead(void* buf, int len, void* buf2, int len2);
+    // Reallocates the buffer, keeping the unread data
+    void resize(int size);
+    // Counts reads that fill the space they were given, grows on a run
+    void noteRead(int n, int space);
 
     int fd;
     int timeout;
@@ -71,8 +105,11 @@ namespace rdr {
     unsigned int timedKbits;
 
     int bufSize;
+    int maxBufSize;
+    int fullReads;
     int offset;
     U8* start;
+    Stats stats;
 
 	// sf@2002 - DSMPlugin hack
 	bool m_fDSMMode;
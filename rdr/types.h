@@ -21,6 +21,10 @@
 
 #pragma once
 
+#ifdef _VNC_PORTABLE
+// __int64 and the secure CRT calls outside Windows, see winvnc/portable
+#include "../winvnc/portable/stdhdrs.h"
+#endif
 
 namespace rdr
 {
@@ -22,35 +22,37 @@
 
 using namespace rdr;
 
-enum { DEFAULT_BUF_SIZE = 0x10000 };
-
-xzOutStream::xzOutStream(OutStream* os, int bufSize_)
-  : underlying(os), bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0), ls(NULL)
-{
-	SetCompressLevel(6);
-
-	ptr = start = new U8[bufSize];
-	end = start + bufSize;
-}
-
-xzOutStream::~xzOutStream()
-{
-  try {
-    flush();
-  } catch (Exception&) {
-  }
-  delete [] start;
+enum {
+	DEFAULT_BUF_SIZE = 0x10000,
+	// Smallest Block of a parallel update
+	PARALLEL_MIN_BLOCK = 0x80000,
+	// Input buffered per job slot before a batch is cut into Blocks
+	PARALLEL_BATCH_PER_SLOT = 0x200000,
+	MAX_SLOTS = 8
+};
+
+namespace rdr {
+
+	// One independent Block of a parallel batch. The lzma_stream is kept,
+	// so the encoder memory is reused from batch to batch.
+	struct xzBlockJob {
+		const U8* in;
+		size_t inSize;
+		U8* out;
+		size_t outSize;
+		size_t outLen;
+		bool failed;
+		lzma_stream strm;
+		lzma_block block;
+		lzma_options_lzma lzmaOptions;
+		lzma_options_delta deltaOptions;
+		lzma_filter filters[3];
+	};
 
-  if (ls) {
-	  lzma_end(ls);
-	  delete ls;
-  }
 }
 
-void xzOutStream::SetCompressLevel(int compression)
+static void SetLzmaOptions(lzma_options_lzma* opt, int compression)
 {
-	if (ls) return;
-	
 	/*
 	if (lzma_lzma_preset(&ls_options, compressionLevel)) {
 		fprintf (stderr, "lzma_lzma_preset error\n");
@@ -59,19 +61,19 @@ void xzOutStream::SetCompressLevel(int compression)
 	}
 	*/
 
-	memset(&ls_options, 0, sizeof(ls_options));
-	ls_options.preset_dict = NULL;
-	ls_options.preset_dict_size = 0;
+	memset(opt, 0, sizeof(*opt));
+	opt->preset_dict = NULL;
+	opt->preset_dict_size = 0;
 	
 	// default
-	ls_options.mode = LZMA_MODE_NORMAL;
-	ls_options.depth = 0;
-	ls_options.dict_size = 0x00200000; //22
-	ls_options.mf = LZMA_MF_HC4;
-	ls_options.nice_len = 0x80;
-	ls_options.lc = 2; // 2 high bits
-	ls_options.lp = 0;
-	ls_options.pb = 0; // 1 byte
+	opt->mode = LZMA_MODE_NORMAL;
+	opt->depth = 0;
+	opt->dict_size = 0x00200000; //22
+	opt->mf = LZMA_MF_HC4;
+	opt->nice_len = 0x80;
+	opt->lc = 2; // 2 high bits
+	opt->lp = 0;
+	opt->pb = 0; // 1 byte
 	
 	uint8_t dictionary_sizes[] = {
 		18,			// 0		256kb
@@ -86,21 +88,141 @@ void xzOutStream::SetCompressLevel(int compression)
 		24			// 9		16mb
 	};
 
-	ls_options.dict_size = uint32_t(1) << dictionary_sizes[compression];
+	opt->dict_size = uint32_t(1) << dictionary_sizes[compression];
 		
 
 	if (compression <= 3) {
-		ls_options.mode = LZMA_MODE_FAST;
+		opt->mode = LZMA_MODE_FAST;
 	}
 
 	if (compression >= 6) {
-		ls_options.nice_len = 0xC0;
+		opt->nice_len = 0xC0;
 	}
 
 	if (compression >= 8) {
-		ls_options.nice_len = 0x111;
-		ls_options.depth = 0x200;
+		opt->nice_len = 0x111;
+		opt->depth = 0x200;
+	}
+}
+
+// [delta] + LZMA2 + terminator
+static void SetFilters(lzma_filter* filters, lzma_options_lzma* lzma,
+					   lzma_options_delta* delta, int deltaDistance)
+{
+	int n = 0;
+	if (deltaDistance > 0) {
+		memset(delta, 0, sizeof(*delta));
+		delta->type = LZMA_DELTA_TYPE_BYTE;
+		delta->dist = deltaDistance;
+		filters[n].id = LZMA_FILTER_DELTA;
+		filters[n].options = delta;
+		n++;
 	}
+	filters[n].id = LZMA_FILTER_LZMA2;
+	filters[n].options = lzma;
+	n++;
+	filters[n].id = LZMA_VLI_UNKNOWN; //LZMA_VLI_UNKNOWN Lables End Of Filter List;
+	filters[n].options = NULL;
+}
+
+static void InitBlock(lzma_block* block, lzma_filter* filters)
+{
+	memset(block, 0, sizeof(*block));
+	block->version = 0;
+	block->check = LZMA_CHECK_NONE;
+	block->filters = filters;
+	block->compressed_size = LZMA_VLI_UNKNOWN;
+	block->uncompressed_size = LZMA_VLI_UNKNOWN;
+}
+
+// Compresses job->in into one complete Block in job->out, which the
+// caller sized for the worst case
+static void EncodeJob(xzBlockJob* job)
+{
+	job->failed = true;
+	job->outLen = 0;
+
+	InitBlock(&job->block, job->filters);
+	if (lzma_block_header_size(&job->block) != LZMA_OK ||
+		lzma_block_header_encode(&job->block, job->out) != LZMA_OK ||
+		lzma_block_encoder(&job->strm, &job->block) != LZMA_OK)
+		return;
+
+	job->strm.next_in = job->in;
+	job->strm.avail_in = job->inSize;
+	job->strm.next_out = job->out + job->block.header_size;
+	job->strm.avail_out = job->outSize - job->block.header_size;
+
+	lzma_ret rc;
+	do {
+		rc = lzma_code(&job->strm, LZMA_FINISH);
+	} while (rc == LZMA_OK && job->strm.avail_out != 0);
+	if (rc != LZMA_STREAM_END)
+		return;
+
+	job->outLen = job->outSize - job->strm.avail_out;
+	job->failed = false;
+}
+
+static void EncodeJobs(void* param, int index)
+{
+	EncodeJob(&((xzBlockJob*)param)[index]);
+}
+
+xzOutStream::xzOutStream(OutStream* os, int bufSize_)
+  : underlying(os), bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0), ls(NULL),
+    headerWritten(false), blockOpen(false), blockPending(false), blockDataSize(0), compressLevel(6),
+    deltaDistance(0), blockLevel(-1), blockDelta(0), runner(NULL), slots(1), jobs(NULL)
+{
+	ptr = start = new U8[bufSize];
+	end = start + bufSize;
+}
+
+xzOutStream::~xzOutStream()
+{
+  try {
+    flush();
+  } catch (Exception&) {
+  }
+  delete [] start;
+
+  if (ls) {
+	  lzma_end(ls);
+	  delete ls;
+  }
+
+  if (jobs) {
+	  for (int i = 0; i < MAX_SLOTS; i++) {
+		  lzma_end(&jobs[i].strm);
+		  delete [] jobs[i].out;
+	  }
+	  delete [] jobs;
+  }
+}
+
+void xzOutStream::SetCompressLevel(int compression)
+{
+	if (compression < 0) compression = 0;
+	if (compression > 9) compression = 9;
+	compressLevel = compression;
+}
+
+void xzOutStream::SetDeltaDistance(int distance)
+{
+	if (distance < 0 || distance > LZMA_DELTA_DIST_MAX)
+		distance = 0;
+	deltaDistance = distance;
+}
+
+void xzOutStream::SetJobRunner(xzJobRunner runner_, int slots_)
+{
+	if (slots_ > MAX_SLOTS) slots_ = MAX_SLOTS;
+	if (runner_ == NULL || slots_ < 2) {
+		runner_ = NULL;
+		slots_ = 1;
+	}
+	runner = runner_;
+	slots = slots_;
 }
 
 void xzOutStream::ensure_stream_codec()
@@ -110,114 +232,240 @@ void xzOutStream::ensure_stream_codec()
 	ls = new lzma_stream;
 
 	memset(ls, 0, sizeof(lzma_stream));
-	lzma_ret rc = LZMA_OK;
+}
 
-	lzma_filter filters[2] = 
-	{
-		{LZMA_FILTER_LZMA2, &ls_options},
-		{LZMA_VLI_UNKNOWN, NULL} //LZMA_VLI_UNKNOWN Lables End Of Filter List;
-	};
+void xzOutStream::write_stream_header()
+{
+	if (headerWritten) return;
+
+	lzma_stream_flags flags;
+	memset(&flags, 0, sizeof(flags));
+	flags.version = 0;
+	flags.check = LZMA_CHECK_NONE;
+
+	U8 header[LZMA_STREAM_HEADER_SIZE];
+	if (lzma_stream_header_encode(&flags, header) != LZMA_OK)
+		throw Exception("xzOutStream: lzma_stream_header_encode failed");
+	underlying->writeBytes(header, LZMA_STREAM_HEADER_SIZE);
+	headerWritten = true;
+}
+
+// Opens the shared Block, closing it first if the settings changed
+void xzOutStream::begin_block()
+{
+	ensure_stream_codec();
+
+	if (blockOpen && (blockLevel != compressLevel || blockDelta != deltaDistance))
+		end_block();
+	if (blockOpen) return;
+
+	write_stream_header();
+
+	SetLzmaOptions(&ls_options, compressLevel);
+	SetFilters(filters, &ls_options, &delta_options, deltaDistance);
+	InitBlock(&block, filters);
 
-	rc = lzma_stream_encoder(ls, filters, LZMA_CHECK_NONE);
+	U8 header[LZMA_BLOCK_HEADER_SIZE_MAX];
+	if (lzma_block_header_size(&block) != LZMA_OK ||
+		lzma_block_header_encode(&block, header) != LZMA_OK)
+		throw Exception("xzOutStream: lzma_block_header_encode failed");
+
+	// lzma_block_encoder would refuse LZMA_SYNC_FLUSH, the raw encoder
+	// takes it and leaves the Block framing to us
+	lzma_ret rc = lzma_raw_encoder(ls, filters);
 	if (rc != LZMA_OK) {
-		fprintf (stderr, "lzma_stream_encoder error: %d\n", (int) rc);
-		throw Exception("xzOutStream: lzma_stream_encoder failed");
-		return;
+		fprintf (stderr, "lzma_raw_encoder error: %d\n", (int) rc);
+		throw Exception("xzOutStream: lzma_raw_encoder failed");
 	}
+
+	underlying->writeBytes(header, block.header_size);
+	blockOpen = true;
+	blockDataSize = 0;
+	blockLevel = compressLevel;
+	blockDelta = deltaDistance;
 }
 
-void xzOutStream::setUnderlying(OutStream* os)
+void xzOutStream::end_block()
 {
-  underlying = os;
+	if (!blockOpen) return;
+	code_block(NULL, 0, LZMA_FINISH);
+
+	// Block Padding, the header size is a multiple of four already and
+	// LZMA_CHECK_NONE adds no Check field
+	static const U8 padding[3] = { 0, 0, 0 };
+	int pad = (int)((4 - (blockDataSize & 3)) & 3);
+	if (pad)
+		underlying->writeBytes(padding, pad);
+	blockOpen = false;
 }
 
-int xzOutStream::length()
+// Feeds data to the shared Block. LZMA_RUN returns once all of it is
+// consumed, the flush actions once they completed.
+void xzOutStream::code_block(const U8* data, size_t len, lzma_action action)
 {
-  return (int)(offset + ptr - start);
+	ls->next_in = data;
+	ls->avail_in = len;
+
+	for (;;) {
+		underlying->check(1);
+		ls->next_out = underlying->getptr();
+		ls->avail_out = underlying->getend() - underlying->getptr();
+
+		lzma_ret rc = lzma_code(ls, action);
+		if ((rc != LZMA_OK) && (rc != LZMA_STREAM_END)) {
+			fprintf (stderr, "lzma_code error: %d\n", (int) rc);
+			throw Exception("xzOutStream: compress failed");
+		}
+
+		blockDataSize += ls->next_out - underlying->getptr();
+		underlying->setptr(ls->next_out);
+
+		if (action == LZMA_RUN) {
+			if (ls->avail_in == 0 && ls->avail_out != 0)
+				break;
+		} else if (rc == LZMA_STREAM_END) {
+			break;
+		}
+	}
+
+	blockPending = (action == LZMA_RUN);
 }
 
-void xzOutStream::flush()
+// An update smaller than the dictionary stays in the shared Block, which
+// still holds what came before it
+bool xzOutStream::use_parallel(size_t len)
+{
+	if (runner == NULL || len < 2 * PARALLEL_MIN_BLOCK)
+		return false;
+	lzma_options_lzma opt;
+	SetLzmaOptions(&opt, compressLevel);
+	return len >= opt.dict_size;
+}
+
+// Cuts a large update into independent Blocks and compresses them through
+// the job runner. The dictionary of each Block is capped to its input,
+// which also caps the memory per job.
+void xzOutStream::encode_parallel(const U8* data, size_t len)
 {
 	ensure_stream_codec();
-	
-	ls->next_in = start;
-	ls->avail_in = ptr - start;
+	end_block();
+	write_stream_header();
 
-	//    fprintf(stderr,"zos flush: avail_in %d\n",zs->avail_in);
+	if (!jobs) {
+		jobs = new xzBlockJob[MAX_SLOTS];
+		memset(jobs, 0, sizeof(xzBlockJob) * MAX_SLOTS);
+	}
 
-	while (ls->avail_in != 0) {
+	int n = (int)(len / PARALLEL_MIN_BLOCK);
+	if (n > slots) n = slots;
+	size_t chunk = (len + n - 1) / n;
+
+	for (int i = 0; i < n; i++) {
+		xzBlockJob* job = &jobs[i];
+		job->in = data + i * chunk;
+		job->inSize = (i == n - 1) ? len - i * chunk : chunk;
+
+		SetLzmaOptions(&job->lzmaOptions, compressLevel);
+		while (job->lzmaOptions.dict_size / 2 >= job->inSize &&
+			   job->lzmaOptions.dict_size / 2 >= LZMA_DICT_SIZE_MIN)
+			job->lzmaOptions.dict_size /= 2;
+		SetFilters(job->filters, &job->lzmaOptions, &job->deltaOptions, deltaDistance);
+
+		size_t need = LZMA_BLOCK_HEADER_SIZE_MAX + lzma_block_buffer_bound(job->inSize);
+		if (job->outSize < need) {
+			delete [] job->out;
+			job->out = NULL;
+			job->outSize = 0;
+			job->out = new U8[need];
+			job->outSize = need;
+		}
+	}
 
-		do {
-			underlying->check(1);
-			ls->next_out = underlying->getptr();
-			ls->avail_out = underlying->getend() - underlying->getptr();
+	runner(EncodeJobs, jobs, n);
 
-			//        fprintf(stderr,"zos flush: calling deflate, avail_in %d, avail_out %d\n",
-			//                zs->avail_in,zs->avail_out);
-			lzma_ret rc = lzma_code(ls, LZMA_SYNC_FLUSH);
-			if ((rc != LZMA_OK) && (rc != LZMA_STREAM_END)) {
-				fprintf (stderr, "lzma_code flush error: %d\n", (int) rc);
-				throw Exception("xzOutStream: compress flush failed");
-			}
+	bool failed = false;
+	for (int i = 0; i < n; i++)
+		failed |= jobs[i].failed;
 
-			//        fprintf(stderr,"zos flush: after deflate: %d bytes\n",
-			//                zs->next_out-underlying->getptr());
+	if (failed) {
+		// Nothing was written yet, fall back to the shared Block
+		begin_block();
+		code_block(data, len, LZMA_SYNC_FLUSH);
+		return;
+	}
+
+	for (int i = 0; i < n; i++)
+		underlying->writeBytes(jobs[i].out, (int)jobs[i].outLen);
+}
 
-			underlying->setptr(ls->next_out);
-		} while (ls->avail_out == 0);
+void xzOutStream::setUnderlying(OutStream* os)
+{
+  underlying = os;
+}
+
+int xzOutStream::length()
+{
+  return (int)(offset + ptr - start);
+}
+
+void xzOutStream::flush()
+{
+	size_t len = ptr - start;
+
+	if (use_parallel(len)) {
+		encode_parallel(start, len);
+	} else if (len != 0) {
+		begin_block();
+		code_block(start, len, LZMA_SYNC_FLUSH);
+	} else if (blockPending) {
+		code_block(NULL, 0, LZMA_SYNC_FLUSH);
 	}
 	
-	offset += (int)(ptr - start);
+	offset += (int)len;
 	ptr = start;
 }
 
+// Only reached with a job runner, where a batch is collected before it is
+// compressed
+void xzOutStream::grow_buffer(int itemSize)
+{
+	int len = (int)(ptr - start);
+	int newSize = bufSize * 2;
+	while (newSize < len + itemSize)
+		newSize *= 2;
+
+	U8* newStart = new U8[newSize];
+	memcpy(newStart, start, len);
+	delete [] start;
+	start = newStart;
+	ptr = start + len;
+	end = start + newSize;
+	bufSize = newSize;
+}
+
 int xzOutStream::overrun(int itemSize, int nItems)
 {
 	//    fprintf(stderr,"xzOutStream overrun\n");
 
-	ensure_stream_codec();
-
-	if (itemSize > bufSize)
+	if (itemSize > bufSize && runner == NULL)
 		throw Exception("xzOutStream overrun: max itemSize exceeded");
 
-	
 	while (end - ptr < itemSize) {
-		ls->next_in = start;
-		ls->avail_in = ptr - start;
-
-		do {
-			underlying->check(1);
-			ls->next_out = underlying->getptr();
-			ls->avail_out = underlying->getend() - underlying->getptr();
-
-			//        fprintf(stderr,"zos overrun: calling deflate, avail_in %d, avail_out %d\n",
-			//                zs->avail_in,zs->avail_out);
+		size_t len = ptr - start;
 
-			lzma_ret rc = lzma_code(ls, LZMA_RUN);
-			if ((rc != LZMA_OK) && (rc != LZMA_STREAM_END)) {
-				fprintf (stderr, "lzma_code error: %d\n", (int) rc);
-				throw Exception("xzOutStream: compress failed");
-			}
-
-			//        fprintf(stderr,"zos overrun: after deflate: %d bytes\n",
-			//                zs->next_out-underlying->getptr());
-
-			underlying->setptr(ls->next_out);
-		} while (ls->avail_out == 0);
-
-		// output buffer not full
+		if (runner != NULL && (int)len + itemSize <= slots * PARALLEL_BATCH_PER_SLOT) {
+			grow_buffer(itemSize);
+			break;
+		}
 
-		if (ls->avail_in == 0) {
-			offset += (int)(ptr - start);
-			ptr = start;
+		if (use_parallel(len)) {
+			encode_parallel(start, len);
 		} else {
-			// but didn't consume all the data?  try shifting what's left to the
-			// start of the buffer.
-			fprintf(stderr,"lzma out buf not full, but in data not consumed\n");
-			memmove(start, ls->next_in, ptr - ls->next_in);
-			offset += (int)(ls->next_in - start);
-			ptr -= ls->next_in - start;
+			begin_block();
+			code_block(start, len, LZMA_RUN);
 		}
+		offset += (int)len;
+		ptr = start;
 	}
 	
 	if (itemSize * nItems > end - ptr)
@@ -19,7 +19,22 @@
 
 //
 // xzOutStream streams to a compressed data stream (underlying), compressing
-// with zlib on the fly.
+// with xz on the fly.
+//
+// The .xz Stream is framed here rather than by lzma_stream_encoder, so every
+// Block can use its own filter chain: a level or delta change closes the
+// open Block and the next one starts with the new settings. Updates share
+// one open Block, sync flushed after each update, so the dictionary carries
+// over from update to update. Its data comes from lzma_raw_encoder, which
+// takes LZMA_SYNC_FLUSH; the Block Header and Padding are written here.
+//
+// With a job runner, an update at least as large as the dictionary is cut
+// into independent Blocks compressed in parallel. Such an update would
+// have replaced most of the shared dictionary anyway, smaller ones never
+// give it up.
+//
+// The Stream is never finished, the viewer's stream decoder reads Blocks
+// as they come.
 //
 #ifdef _XZ
 #ifndef __RDR_xzOutStream_H__
@@ -37,6 +52,13 @@
 
 namespace rdr {
 
+  struct xzBlockJob;
+
+  // Calls fn(param, i) for every i in [0, count) and returns when all of
+  // them are done
+  typedef void (*xzJobFn)(void* param, int index);
+  typedef void (*xzJobRunner)(xzJobFn fn, void* param, int count);
+
   class xzOutStream : public OutStream {
 
   public:
@@ -45,7 +67,13 @@ namespace rdr {
     xzOutStream(OutStream* os=0, int bufSize=0);
     virtual ~xzOutStream();
 
+	// Both take effect at the next Block
 	void SetCompressLevel(int compression);
+	// Delta pre-filter distance (bytes per pixel), 0 disables it
+	void SetDeltaDistance(int distance);
+	// Where parallel Blocks run and how many jobs it runs at once,
+	// NULL or fewer than 2 keeps every update in the shared Block
+	void SetJobRunner(xzJobRunner runner, int slots);
 
     void setUnderlying(OutStream* os);
     void flush();
@@ -54,6 +82,13 @@ namespace rdr {
   private:
 
     void ensure_stream_codec();
+    void write_stream_header();
+    void begin_block();
+    void end_block();
+    void code_block(const U8* data, size_t len, lzma_action action);
+    bool use_parallel(size_t len);
+    void encode_parallel(const U8* data, size_t len);
+    void grow_buffer(int itemSize);
 
     int overrun(int itemSize, int nItems);
 
@@ -63,7 +98,21 @@ namespace rdr {
 #ifdef _XZ
 	lzma_stream* ls;
 	lzma_options_lzma ls_options;
+	lzma_options_delta delta_options;
+	lzma_filter filters[3];
+	lzma_block block;
 #endif
+	bool headerWritten;
+	bool blockOpen;
+	bool blockPending;
+	lzma_vli blockDataSize;
+	int compressLevel;
+	int deltaDistance;
+	int blockLevel;
+	int blockDelta;
+	xzJobRunner runner;
+	int slots;
+	xzBlockJob* jobs;
     U8* start;
   };
 
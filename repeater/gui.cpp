@@ -27,6 +27,7 @@
 #include "resources.h"
 #include "resource.h"
 #include "repeater.h"
+#include "shaper_functions.h"
 
 
 int main_test();
@@ -186,6 +187,7 @@ static int win_main(HINSTANCE hInstance, HINSTANCE hPrevInstance,
         LPSTR lpszCmdLine, int nCmdShow) {
 
 	InitializeCriticalSection( &cs );
+	Shaper_init();
 	Read_settings();
 
 	DWORD iID;
@@ -0,0 +1,238 @@
+#include "repeater.h"
+#include "shaper_functions.h"
+
+#define SHAPER_BURST_MS 100				// bucket depth, in ms of the rate
+#define SHAPER_MIN_BURST 16384
+#define SHAPER_QUANTUM 16384			// bytes per bulk session per round
+#define SHAPER_IDLE_MS 50				// not asking that long = not backlogged
+#define SHAPER_RATE_WINDOW 500
+#define SHAPER_INTERACTIVE_RATE 65536	// bytes/s
+#define SHAPER_INTERACTIVE_HOLD 200		// ms the reserve is kept after use
+#define SHAPER_MAX_WAIT 50
+
+typedef struct _shapersession
+{
+	BOOL active;
+	LONGLONG tokens;
+	DWORD last;
+	long deficit;
+	BOOL bulk;				// class of the last take
+	DWORD lastask;
+	long window_bytes;
+	DWORD window_start;
+	long rate;
+	long waits;
+}shapersession;
+
+static shapersession sessions[MAX_LIST];
+static LONGLONG global_tokens;
+static DWORD global_last;
+static long global_window_bytes;
+static DWORD global_window_start;
+static long global_rate;
+static DWORD interactive_last;
+static CRITICAL_SECTION shaper_cs;
+
+static LONGLONG
+Burst(long rate)
+{
+	LONGLONG burst=(LONGLONG)rate*SHAPER_BURST_MS/1000;
+	if (burst<SHAPER_MIN_BURST) burst=SHAPER_MIN_BURST;
+	return burst;
+}
+
+static void
+Refill(LONGLONG *tokens, DWORD *last, long rate, DWORD now)
+{
+	DWORD elapsed=now-*last;
+	if (elapsed==0) return;
+	*tokens+=(LONGLONG)rate*elapsed/1000;
+	if (*tokens>Burst(rate)) *tokens=Burst(rate);
+	*last=now;
+}
+
+static void
+UpdateRate(long *window_bytes, DWORD *window_start, long *rate, DWORD now)
+{
+	DWORD elapsed=now-*window_start;
+	if (elapsed<SHAPER_RATE_WINDOW) return;
+	*rate=(*rate+(long)((LONGLONG)*window_bytes*1000/elapsed))/2;
+	*window_bytes=0;
+	*window_start=now;
+}
+
+static DWORD
+WaitFor(LONGLONG need, long rate)
+{
+	LONGLONG wait=need*1000/rate+1;
+	if (wait>SHAPER_MAX_WAIT) wait=SHAPER_MAX_WAIT;
+	return (DWORD)wait;
+}
+
+// True while a backlogged bulk session has credit left in this round.
+// Sessions that stopped asking lose their credit, as in DRR an empty
+// queue does.
+static BOOL
+BulkCreditLeft(DWORD now)
+{
+	int i;
+	BOOL left=false;
+	for (i=0;i<MAX_LIST;i++)
+	{
+		if (!sessions[i].active || !sessions[i].bulk) continue;
+		if (now-sessions[i].lastask>SHAPER_IDLE_MS) sessions[i].deficit=0;
+		else if (sessions[i].deficit>0) left=true;
+	}
+	return left;
+}
+
+static void
+NewRound(DWORD now)
+{
+	int i;
+	for (i=0;i<MAX_LIST;i++)
+	{
+		if (!sessions[i].active || !sessions[i].bulk) continue;
+		if (now-sessions[i].lastask<=SHAPER_IDLE_MS) sessions[i].deficit+=SHAPER_QUANTUM;
+	}
+}
+
+void
+Shaper_init()
+{
+	InitializeCriticalSection(&shaper_cs);
+	memset(sessions,0,sizeof(sessions));
+	global_tokens=0;
+	global_last=timeGetTime();
+	global_window_bytes=0;
+	global_window_start=global_last;
+	global_rate=0;
+	interactive_last=global_last-SHAPER_INTERACTIVE_HOLD;
+}
+
+void
+Shaper_open(int slot)
+{
+	DWORD now=timeGetTime();
+	EnterCriticalSection(&shaper_cs);
+	memset(&sessions[slot],0,sizeof(shapersession));
+	sessions[slot].active=true;
+	sessions[slot].last=now;
+	sessions[slot].lastask=now;
+	sessions[slot].window_start=now;
+	LeaveCriticalSection(&shaper_cs);
+}
+
+void
+Shaper_close(int slot)
+{
+	EnterCriticalSection(&shaper_cs);
+	sessions[slot].active=false;
+	LeaveCriticalSection(&shaper_cs);
+}
+
+int
+Shaper_take(int slot, int want, DWORD *wait)
+{
+	shapersession *s=&sessions[slot];
+	long slimit=saved_session_limit*1000;
+	long glimit=saved_global_limit*1000;
+	LONGLONG allow=want;
+	DWORD now=timeGetTime();
+
+	*wait=0;
+	if (want<=0) return 0;
+	EnterCriticalSection(&shaper_cs);
+	UpdateRate(&s->window_bytes,&s->window_start,&s->rate,now);
+	UpdateRate(&global_window_bytes,&global_window_start,&global_rate,now);
+	s->lastask=now;
+	s->bulk=s->rate>=SHAPER_INTERACTIVE_RATE;
+
+	if (slimit>0)
+	{
+		Refill(&s->tokens,&s->last,slimit,now);
+		if (allow>s->tokens) allow=s->tokens;
+		if (allow<=0)
+		{
+			*wait=WaitFor(min(want,SHAPER_QUANTUM)-s->tokens,slimit);
+			goto held;
+		}
+	}
+	if (glimit>0)
+	{
+		LONGLONG avail;
+		Refill(&global_tokens,&global_last,glimit,now);
+		avail=global_tokens;
+		if (s->bulk)
+		{
+			// Keep a part of the bucket for interactive sessions
+			if (now-interactive_last<SHAPER_INTERACTIVE_HOLD) avail-=Burst(glimit)/4;
+			if (s->deficit<=0 && !BulkCreditLeft(now)) NewRound(now);
+			if (avail>s->deficit) avail=s->deficit;
+		}
+		if (allow>avail) allow=avail;
+		if (allow<=0)
+		{
+			// Out of credit while others still have some, their turn
+			if (s->bulk && s->deficit<=0) *wait=1;
+			else *wait=WaitFor(min(want,SHAPER_QUANTUM)-avail,glimit);
+			goto held;
+		}
+		global_tokens-=allow;
+		if (s->bulk) s->deficit-=(long)allow;
+		else interactive_last=now;
+	}
+	if (slimit>0) s->tokens-=allow;
+	s->window_bytes+=(long)allow;
+	global_window_bytes+=(long)allow;
+	LeaveCriticalSection(&shaper_cs);
+	return (int)allow;
+
+held:
+	s->waits++;
+	LeaveCriticalSection(&shaper_cs);
+	return 0;
+}
+
+void
+Shaper_refund(int slot, int bytes)
+{
+	shapersession *s=&sessions[slot];
+	if (bytes<=0) return;
+	EnterCriticalSection(&shaper_cs);
+	if (saved_session_limit>0) s->tokens+=bytes;
+	if (saved_global_limit>0)
+	{
+		global_tokens+=bytes;
+		if (s->bulk) s->deficit+=bytes;
+	}
+	s->window_bytes-=bytes;
+	global_window_bytes-=bytes;
+	LeaveCriticalSection(&shaper_cs);
+}
+
+void
+Shaper_info(int slot, pshaperinfo info)
+{
+	shapersession *s=&sessions[slot];
+	DWORD now=timeGetTime();
+	EnterCriticalSection(&shaper_cs);
+	UpdateRate(&s->window_bytes,&s->window_start,&s->rate,now);
+	info->rate=s->rate;
+	info->limit=saved_session_limit*1000;
+	info->interactive=s->rate<SHAPER_INTERACTIVE_RATE;
+	info->waits=s->waits;
+	LeaveCriticalSection(&shaper_cs);
+}
+
+long
+Shaper_global_rate()
+{
+	long rate;
+	DWORD now=timeGetTime();
+	EnterCriticalSection(&shaper_cs);
+	UpdateRate(&global_window_bytes,&global_window_start,&global_rate,now);
+	rate=global_rate;
+	LeaveCriticalSection(&shaper_cs);
+	return rate;
+}
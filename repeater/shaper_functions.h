@@ -0,0 +1,39 @@
+// Bandwidth shaping of the repeated sessions
+//
+// Every session has its own token bucket, all of them share a global
+// one. Sessions that forward little (typing, a moving cursor) are
+// interactive: they take global tokens first and a part of the bucket
+// is kept for them. Bulk sessions (file transfers, video) share what is
+// left by deficit round robin, one quantum each per round.
+//
+// Limits are saved_session_limit and saved_global_limit in kB/s, 0 is
+// no limit. They are read on every call, a change applies at once.
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+typedef struct _shaperinfo
+{
+	long rate;				// bytes/s forwarded, smoothed
+	long limit;				// bytes/s, 0 = none
+	BOOL interactive;
+	long waits;				// times the session was held back
+}shaperinfo,*pshaperinfo;
+
+void Shaper_init();
+void Shaper_open(int slot);
+void Shaper_close(int slot);
+// Bytes of <want> the session may send now, 0 = try again in *wait ms
+int  Shaper_take(int slot, int want, DWORD *wait);
+// Part of the last take that was not sent
+void Shaper_refund(int slot, int bytes);
+void Shaper_info(int slot, pshaperinfo info);
+long Shaper_global_rate();
+
+extern int saved_session_limit;
+extern int saved_global_limit;
+
+#ifdef __cplusplus
+ }
+#endif
@@ -1,4 +1,5 @@
 #include "repeater.h"
+#include "shaper_functions.h"
 int f_debug=1;
 
 BOOL ParseDisplay(LPTSTR display, int size, LPTSTR phost, int hostlen, int *pport) 
@@ -308,6 +309,10 @@ DWORD WINAPI do_repeater(LPVOID lpParam)
     fd_set *ifds, *ofds;
     struct timeval *tmo;
 //    struct timeval win32_tmo;
+    struct timeval shaper_tmo;
+    DWORD shaper_wait=0;
+    DWORD lwait=0, rwait=0;
+    int allowed;
 	
 	SOCKET local_in=0;
 	SOCKET local_out=0;
@@ -393,6 +398,7 @@ DWORD WINAPI do_repeater(LPVOID lpParam)
 	DWORD stop=0;
 	int measure_counter=0;
 	long temp_bytes=0;
+	Shaper_open(viewer_nummer);
 
     while ( f_local || f_remote ) {
 	if (measure_counter==0) start=timeGetTime();
@@ -400,6 +406,12 @@ DWORD WINAPI do_repeater(LPVOID lpParam)
 	FD_ZERO( ifds );
 	FD_ZERO( ofds );
 	tmo = NULL;
+	/* data held back by the shaper, come back for it */
+	if ( 0 < shaper_wait ) {
+	    shaper_tmo.tv_sec = 0;
+	    shaper_tmo.tv_usec = shaper_wait * 1000;
+	    tmo = &shaper_tmo;
+	}
 
 	/** prepare for reading local input **/
 	if ( f_local && (lbuf_len < sizeof(lbuf)) ) {
@@ -414,11 +426,16 @@ DWORD WINAPI do_repeater(LPVOID lpParam)
 	/* FD_SET( local_out, ofds ); */
 	/* FD_SET( remote, ofds ); */
 	
-	if ( select( nfds, ifds, ofds, NULL, tmo ) == -1 ) {
+	/* Winsock refuses a select() without sockets, both buffers are full */
+	if ( ifds->fd_count == 0 ) {
+	    Sleep( shaper_wait ? shaper_wait : 1 );
+	}
+	else if ( select( nfds, ifds, ofds, NULL, tmo ) == -1 ) {
 	    /* some error */
 	    error( "select() failed, %d\n", socket_errno());
 		goto error;
 	}
+	lwait = rwait = 0;
 	/* fake ifds if local is stdio handle because
            select() of Winsock does not accept stdio
            handle. */
@@ -467,40 +484,45 @@ DWORD WINAPI do_repeater(LPVOID lpParam)
 	}
 	
 	/* flush data in buffer to socket */
-	if ( 0 < lbuf_len ) {
-	    len = send(remote, lbuf, lbuf_len, 0);
+	if ( 0 < lbuf_len && 0 < (allowed = Shaper_take(viewer_nummer, lbuf_len, &lwait)) ) {
+	    len = send(remote, lbuf, allowed, 0);
 	    if ( 1 < f_debug )		/* more verbose */
-		report_bytes( ">>>", lbuf, lbuf_len);
+		report_bytes( ">>>", lbuf, allowed);
 	    if ( len == -1 ) {
 		debug("send() failed, %d\n", socket_errno());
 		goto error;
 	    } else if ( 0 < len ) {
+		Shaper_refund(viewer_nummer, allowed - len);
 		/* move data on to top of buffer */
 		Viewers[viewer_nummer].sendbytes+=len;
 		temp_bytes+=len;
 		lbuf_len -= len;
 		if ( 0 < lbuf_len )
-		    memcpy( lbuf, lbuf+len, lbuf_len );
+		    memmove( lbuf, lbuf+len, lbuf_len );
 		assert( 0 <= lbuf_len );
 	    }
 	}
 	
 	/* flush data in buffer to local output */
-	if ( 0 < rbuf_len ) {
+	if ( 0 < rbuf_len && 0 < (allowed = Shaper_take(viewer_nummer, rbuf_len, &rwait)) ) {
 
-		len = send( local_out, rbuf, rbuf_len, 0);
+		len = send( local_out, rbuf, allowed, 0);
 	    if ( len == -1 ) {
 		debug("output (local) failed, errno=%d\n", errno);
 		goto error;
 	    } 
 		else
 		{
+		Shaper_refund(viewer_nummer, allowed - len);
 	    rbuf_len -= len;
-	    if ( len < rbuf_len )
-		memcpy( rbuf, rbuf+len, rbuf_len );
+	    /* the shaper sends part of the buffer, keep the rest in order */
+	    if ( 0 < rbuf_len )
+		memmove( rbuf, rbuf+len, rbuf_len );
 	    assert( 0 <= rbuf_len );
 		}
 	}
+	shaper_wait = lwait;
+	if ( rwait && (!shaper_wait || rwait < shaper_wait) ) shaper_wait = rwait;
 	if (measure_counter==10) 
 		{
 			stop=timeGetTime();
@@ -530,6 +552,7 @@ error:
 	_itoa_s(st.wSecond,buf,10);
 	strcat_s(stop_msg,buf);
 	strcat_s(stop_msg," ");
+	Shaper_close(viewer_nummer);
 	LogStats_access(start_msg,stop_msg,code,viewer_nummer,server_nummer,Viewers[viewer_nummer].sendbytes+Viewers[viewer_nummer].recvbytes);
 	//LogStats(code,recvbytes,sendbytes);
 	f_remote = 0;			/* no more read from socket */
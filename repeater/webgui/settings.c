@@ -9,6 +9,7 @@
 #include "webfs.h"
 #include "wsfdata.h"
 #include "webgui.h"
+#include "../shaper_functions.h"
 
 extern int saved_mode2;
 extern int saved_mode1;
@@ -186,6 +187,8 @@ Read_settings()
 		strcpy_s(saved_password, 64, "adminadmi2");
 		saved_portHTTP=80;
 		saved_usecom=0;
+		saved_session_limit=0;
+		saved_global_limit=0;
 		Save_settings();
 	}
 	else
@@ -210,6 +213,11 @@ Read_settings()
 		ReadFile(hFile,saved_password,64,&readbytes,NULL);
 		ReadFile(hFile,&saved_portHTTP,sizeof(int),&readbytes,NULL);
 		ReadFile(hFile,&saved_usecom,sizeof(int),&readbytes,NULL);
+		// older files end here
+		saved_session_limit=0;
+		saved_global_limit=0;
+		ReadFile(hFile,&saved_session_limit,sizeof(int),&readbytes,NULL);
+		ReadFile(hFile,&saved_global_limit,sizeof(int),&readbytes,NULL);
 		
 		test=strchr(saved_sample1,ch);
 		pos=saved_sample1;
@@ -302,6 +310,8 @@ Save_settings()
 		WriteFile(hFile,saved_password,64,&readbytes,NULL);
 		WriteFile(hFile,&saved_portHTTP,sizeof(int),&readbytes,NULL);
 		WriteFile(hFile,&saved_usecom,sizeof(int),&readbytes,NULL);
+		WriteFile(hFile,&saved_session_limit,sizeof(int),&readbytes,NULL);
+		WriteFile(hFile,&saved_global_limit,sizeof(int),&readbytes,NULL);
 		CloseHandle(hFile);
 
 
@@ -474,6 +484,7 @@ list_connections(wi_sess * sess,char *txt)
 	char temp[10];
 	int i;
 	int j;
+	shaperinfo info;
 	strcpy_s(txt, 4000, "<table class=\"style2\" style=\"width: 800px\">");
 	strcat_s(txt,4000,"<tr>");
 		strcat_s(txt,4000,"<td style=\"width: 40px; height: 23px\" class=\"style3\">Slot</td>");
@@ -483,6 +494,8 @@ list_connections(wi_sess * sess,char *txt)
 		strcat_s(txt,4000,"<td style=\"width: 200px; height: 23px\" class=\"style3\">Server</td>");
 		strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\" class=\"style3\">Total kb</td>");
 		strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\" class=\"style3\">kb/s</td>");
+		strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\" class=\"style3\">Limit kb/s</td>");
+		strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\" class=\"style3\">Class</td>");
 		strcat_s(txt,4000,"<td style=\"width: 250px; height: 23px\" class=\"style3\">comment</td>");
 	strcat_s(txt,4000,"</tr>");
 	wi_printf(sess, "%s", txt );
@@ -525,11 +538,22 @@ list_connections(wi_sess * sess,char *txt)
 			strcat_s(txt,4000,temp);	
 			strcat_s(txt,4000,"</td>");
 
-			_itoa_s(Viewers[i].average,temp, 10, 10);
+			Shaper_info(i,&info);
+			_itoa_s(info.rate/1000,temp, 10, 10);
 			strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\"class=\"style3\">");
 			strcat_s(txt,4000,temp);	
 			strcat_s(txt,4000,"</td>");
 
+			if (info.limit) _itoa_s(info.limit/1000,temp, 10, 10);
+			else strcpy_s(temp, 10, "-");
+			strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\"class=\"style3\">");
+			strcat_s(txt,4000,temp);	
+			strcat_s(txt,4000,"</td>");
+
+			strcat_s(txt,4000,"<td style=\"width: 75px; height: 23px\"class=\"style3\">");
+			strcat_s(txt,4000,info.interactive ? "interactive" : "bulk");
+			strcat_s(txt,4000,"</td>");
+
 			strcat_s(txt,4000,"<td style=\"width: 250px; height: 23px\"class=\"style3\">");
 			if ( lookup_comment(Viewers[i].code)!=NULL) strcat_s(txt,4000,lookup_comment(Viewers[i].code));	
 			strcat_s(txt,4000,"</td>");
@@ -67,4 +67,6 @@ extern int rule3;
 
 extern int notwebstopped;
 extern int notstopped;
-extern int saved_usecom;
\ No newline at end of file
+extern int saved_usecom;
+extern int saved_session_limit;
+extern int saved_global_limit;
\ No newline at end of file
@@ -35,6 +35,7 @@
 #include "webfs.h"
 #include "wsfdata.h"
 #include "webgui.h"
+#include "../shaper_functions.h"
 int saved_mode2;
 int saved_mode1;
 int saved_keepalive;
@@ -47,6 +48,8 @@ int saved_usecom=0;
 int saved_allow;
 int saved_refuse;
 int saved_refuse2;
+int saved_session_limit=0;
+int saved_global_limit=0;
 char saved_sample1[1024];
 char saved_sample2[1024];
 char saved_sample3[1024];
@@ -223,6 +226,34 @@ sport_ssi(wi_sess * sess, EOFILE * eofile)
 
 
 
+/* SSI
+ *
+ * slimit_ssi routine stub
+ */
+
+int
+slimit_ssi(wi_sess * sess, EOFILE * eofile)
+{
+   wi_printf(sess, "value=\"%i\"",saved_session_limit);
+   return 0;
+}
+
+
+
+/* SSI
+ *
+ * glimit_ssi routine stub
+ */
+
+int
+glimit_ssi(wi_sess * sess, EOFILE * eofile)
+{
+   wi_printf(sess, "value=\"%i\"",saved_global_limit);
+   return 0;
+}
+
+
+
 /* SSI
  *
  * vport_ssi routine stub
@@ -362,6 +393,9 @@ memory_ssi(wi_sess * sess, EOFILE * eofile)
 	wi_printf(sess, "Listen Port Server: %i<br>", saved_portB);
 	wi_printf(sess, "Web Server        : %i<br>", saved_portHTTP);
 	wi_printf(sess, "Use comment as extra viewer check: %i<br>", saved_usecom);
+	wi_printf(sess, "Session limit kb/s: %i<br>", saved_session_limit);
+	wi_printf(sess, "Total limit kb/s  : %i<br>", saved_global_limit);
+	wi_printf(sess, "Total kb/s        : %i<br>", Shaper_global_rate()/1000);
    wi_printf(sess, "<br>");
 
    wi_printf(sess, "Connections: <br>");
@@ -394,7 +428,7 @@ wi_cvariables(wi_sess * sess, int token)
 
    switch(token)
    {
-   case MEMHITS_VAR31:
+   case MEMHITS_VAR33:
       e = wi_putlong(sess, (u_long)(wi_totalblocks));
       break;
    }
@@ -605,6 +639,8 @@ testaction_cgi(wi_sess * sess,  EOFILE * eofile)
 	char *   id_on;
 	char *   id_con;
 	char *	 web_port;
+	char *   session_limit;
+	char *   global_limit;
 
 
 
@@ -622,6 +658,10 @@ testaction_cgi(wi_sess * sess,  EOFILE * eofile)
    if (server_port) saved_portA=atoi(server_port);
    viewer_port = wi_formvalue(sess, "viewer_port");  
    if (viewer_port) saved_portB=atoi(viewer_port);
+   session_limit = wi_formvalue(sess, "session_limit");
+   if (session_limit) saved_session_limit=atoi(session_limit);
+   global_limit = wi_formvalue(sess, "global_limit");
+   if (global_limit) saved_global_limit=atoi(global_limit);
 
    allow_on = wi_formvalue(sess, "allow_on"); 
    if (allow_on) saved_allow=true;
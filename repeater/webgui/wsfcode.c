@@ -277,6 +277,34 @@ keepalive_ssi(wi_sess * sess, EOFILE * eofile)
 
 
 
+/* SSI
+ *
+ * slimit_ssi routine stub
+ */
+
+int
+slimit_ssi(wi_sess * sess, EOFILE * eofile)
+{
+   /* Add your code here */
+   return 0;
+}
+
+
+
+/* SSI
+ *
+ * glimit_ssi routine stub
+ */
+
+int
+glimit_ssi(wi_sess * sess, EOFILE * eofile)
+{
+   /* Add your code here */
+   return 0;
+}
+
+
+
 /* PUSH
  *
  * pushtest_func routine stub
@@ -447,7 +475,7 @@ wi_cvariables(wi_sess * sess, int token)
 
    switch(token)
    {
-   case MEMHITS_VAR31:
+   case MEMHITS_VAR33:
       e = wi_putlong(sess, (u_long)(wi_totalblocks));
       break;
    }
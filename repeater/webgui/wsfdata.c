@@ -406,166 +406,207 @@ unsigned char settings_html3[] = {
 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x3e, 0x26, 
 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 
 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 
-0x09, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 
-0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 
-0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 
-0x78, 0x22, 0x3e, 0x4f, 0x6e, 0x6c, 0x79, 0x20, 0x61, 0x6c, 0x6c, 0x6f, 
-0x77, 0x20, 0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 
-0x73, 0x20, 0x74, 0x6f, 0x3a, 0x3c, 0x62, 0x72, 0x3e, 0x46, 0x6f, 0x72, 
-0x6d, 0x61, 0x74, 0x20, 0x69, 0x70, 0x20, 0x6f, 0x72, 0x20, 0x0d, 0x0a, 
-0x09, 0x09, 0x09, 0x72, 0x61, 0x6e, 0x67, 0x65, 0x26, 0x6e, 0x62, 0x73, 
-0x70, 0x3b, 0x20, 0x3a, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x70, 
-0x6f, 0x72, 0x74, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 
-0x73, 0x70, 0x3b, 0x20, 0x3b, 0x20, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x31, 
-0x32, 0x33, 0x2e, 0x31, 0x32, 0x33, 0x2e, 0x31, 0x32, 0x33, 0x2e, 0x31, 
-0x32, 0x33, 0x3a, 0x35, 0x38, 0x30, 0x30, 0x3b, 0x31, 0x36, 0x35, 0x2e, 
-0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x3a, 0x32, 0x33, 0x30, 0x30, 
-0x3c, 0x62, 0x72, 0x3e, 0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x2e, 
-0x31, 0x36, 0x35, 0x3a, 0x32, 0x33, 0x30, 0x30, 0x20, 0x2d, 0x26, 0x67, 
-0x74, 0x3b, 0x20, 0x3c, 0x62, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
-0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x31, 
-0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x2e, 0x78, 
-0x20, 0x70, 0x6f, 0x72, 0x74, 0x20, 0x32, 0x33, 0x30, 0x30, 0x3c, 0x62, 
-0x72, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
+0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 
+0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 
+0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x4c, 
+0x69, 0x6d, 0x69, 0x74, 0x20, 0x70, 0x65, 0x72, 0x20, 0x73, 0x65, 0x73, 
+0x73, 0x69, 0x6f, 0x6e, 0x20, 0x6b, 0x62, 0x2f, 0x73, 0x20, 0x28, 0x30, 
+0x20, 0x3d, 0x20, 0x6e, 0x6f, 0x6e, 0x65, 0x29, 0x3a, 0x3c, 0x2f, 0x74, 
+0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 
+0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 
+0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
+0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 
+0x22, 0x73, 0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x5f, 0x6c, 0x69, 0x6d, 
+0x69, 0x74, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 
+0x78, 0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 
+0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x73, 
+0x6c, 0x69, 0x6d, 0x69, 0x74, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 
+0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 
+0x64, 0x74, 0x68, 0x3a, 0x20, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x3c, 
+0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 
+0x3e, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 
+0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 
+0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
-0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 
-0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 
-0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x62, 0x6f, 0x78, 0x22, 0x20, 
-0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x5f, 
-0x6f, 0x6e, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x3d, 0x22, 0x61, 
-0x6c, 0x6c, 0x6f, 0x77, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x3c, 0x21, 0x2d, 
-0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 
-0x6c, 0x65, 0x3d, 0x22, 0x61, 0x63, 0x6f, 0x6e, 0x2e, 0x73, 0x73, 0x69, 
-0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x3e, 0x20, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 
-0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 
-0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 
-0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 
-0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 
-0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x5f, 0x63, 0x6f, 0x6e, 0x22, 0x20, 0x74, 
-0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x3c, 
-0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 
-0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x61, 0x63, 0x6f, 0x6e, 0x73, 0x2e, 
-0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 
-0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 
-0x30, 0x30, 0x70, 0x78, 0x3b, 0x20, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 
-0x3a, 0x20, 0x36, 0x30, 0x70, 0x78, 0x3b, 0x22, 0x3e, 0x3c, 0x2f, 0x74, 
-0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 
-0x0a, 0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 
+0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 
+0x3e, 0x4c, 0x69, 0x6d, 0x69, 0x74, 0x20, 0x61, 0x6c, 0x6c, 0x20, 0x73, 
+0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x6b, 0x62, 0x2f, 0x73, 
+0x20, 0x28, 0x30, 0x20, 0x3d, 0x20, 0x6e, 0x6f, 0x6e, 0x65, 0x29, 0x3a, 
+0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 
+0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 
+0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 
+0x09, 0x09, 0x09, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 
+0x6d, 0x65, 0x3d, 0x22, 0x67, 0x6c, 0x6f, 0x62, 0x61, 0x6c, 0x5f, 0x6c, 
+0x69, 0x6d, 0x69, 0x74, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 
+0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 
+0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 
+0x22, 0x67, 0x6c, 0x69, 0x6d, 0x69, 0x74, 0x2e, 0x73, 0x73, 0x69, 0x22, 
+0x20, 0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 
+0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x35, 0x30, 0x70, 0x78, 0x22, 
+0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 
+0x74, 0x64, 0x3e, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x3c, 0x2f, 0x74, 
+0x64, 0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 
+0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 
+0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 
+0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 
+0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x4f, 0x6e, 0x6c, 0x79, 0x20, 
+0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x20, 0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 
+0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x74, 0x6f, 0x3a, 0x3c, 0x62, 0x72, 
+0x3e, 0x46, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x69, 0x70, 0x20, 0x6f, 
+0x72, 0x20, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x72, 0x61, 0x6e, 0x67, 0x65, 
+0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x3a, 0x26, 0x6e, 0x62, 0x73, 
+0x70, 0x3b, 0x20, 0x70, 0x6f, 0x72, 0x74, 0x26, 0x6e, 0x62, 0x73, 0x70, 
+0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x3b, 0x20, 0x0d, 0x0a, 
+0x09, 0x09, 0x09, 0x31, 0x32, 0x33, 0x2e, 0x31, 0x32, 0x33, 0x2e, 0x31, 
+0x32, 0x33, 0x2e, 0x31, 0x32, 0x33, 0x3a, 0x35, 0x38, 0x30, 0x30, 0x3b, 
+0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x3a, 
+0x32, 0x33, 0x30, 0x30, 0x3c, 0x62, 0x72, 0x3e, 0x31, 0x36, 0x35, 0x2e, 
+0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x3a, 0x32, 0x33, 0x30, 0x30, 
+0x20, 0x2d, 0x26, 0x67, 0x74, 0x3b, 0x20, 0x3c, 0x62, 0x72, 0x3e, 0x0d, 
+0x0a, 0x09, 0x09, 0x09, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x65, 0x64, 0x20, 
+0x74, 0x6f, 0x20, 0x31, 0x36, 0x35, 0x2e, 0x31, 0x36, 0x35, 0x2e, 0x31, 
+0x36, 0x35, 0x2e, 0x78, 0x20, 0x70, 0x6f, 0x72, 0x74, 0x20, 0x32, 0x33, 
+0x30, 0x30, 0x3c, 0x62, 0x72, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 
 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 
-0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 
-0x35, 0x70, 0x78, 0x22, 0x3e, 0x52, 0x65, 0x66, 0x75, 0x73, 0x65, 0x20, 
-0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 
-0x74, 0x6f, 0x3a, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 
-0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 
-0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 
-0x3e, 0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 
-0x65, 0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x62, 0x6f, 0x78, 0x22, 
-0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x72, 0x65, 0x66, 0x75, 0x73, 
-0x65, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x3d, 
-0x22, 0x72, 0x65, 0x66, 0x75, 0x73, 0x65, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 
-0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 
-0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x72, 0x63, 0x6f, 0x6e, 0x2e, 
-0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x20, 0x3e, 0x20, 0x3c, 
+0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 
+0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 
+0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x62, 
+0x6f, 0x78, 0x22, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x61, 0x6c, 
+0x6c, 0x6f, 0x77, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 
+0x65, 0x3d, 0x22, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x5f, 0x6f, 0x6e, 0x22, 
+0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 
+0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x61, 0x63, 0x6f, 0x6e, 
+0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x3e, 0x20, 0x3c, 
 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 
 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 
 0x68, 0x3a, 0x20, 0x33, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 
 0x09, 0x09, 0x09, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 
-0x6d, 0x65, 0x3d, 0x22, 0x72, 0x65, 0x66, 0x75, 0x73, 0x65, 0x5f, 0x63, 
-0x6f, 0x6e, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 
-0x78, 0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 
-0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x72, 
-0x63, 0x6f, 0x6e, 0x73, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 
-0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 
-0x74, 0x68, 0x3a, 0x20, 0x33, 0x30, 0x30, 0x70, 0x78, 0x3b, 0x20, 0x68, 
-0x65, 0x69, 0x67, 0x68, 0x74, 0x3a, 0x20, 0x36, 0x30, 0x70, 0x78, 0x3b, 
-0x22, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 
-0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 
-0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 
-0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 
-0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x4f, 0x6e, 0x6c, 0x79, 0x20, 0x61, 
-0x6c, 0x6c, 0x6f, 0x77, 0x20, 0x49, 0x44, 0x3a, 0x3c, 0x2f, 0x74, 0x64, 
-0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 
-0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 
-0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 
-0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 
-0x6b, 0x62, 0x6f, 0x78, 0x22, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 
-0x69, 0x64, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 
-0x3d, 0x22, 0x69, 0x64, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x3c, 0x21, 0x2d, 
-0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 
-0x6c, 0x65, 0x3d, 0x22, 0x61, 0x69, 0x64, 0x2e, 0x73, 0x73, 0x69, 0x22, 
-0x20, 0x2d, 0x2d, 0x3e, 0x3e, 0x20, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 
-0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 
-0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x35, 
-0x30, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x69, 
-0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x69, 
-0x64, 0x5f, 0x63, 0x6f, 0x6e, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 
-0x22, 0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 
-0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 
-0x3d, 0x22, 0x61, 0x69, 0x64, 0x73, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 
-0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
-0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x30, 0x30, 0x70, 0x78, 0x3b, 
-0x20, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3a, 0x20, 0x36, 0x30, 0x70, 
-0x78, 0x3b, 0x22, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 
-0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x0d, 0x0a, 
-0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 
-0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 
-0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 
-0x57, 0x65, 0x62, 0x20, 0x47, 0x75, 0x69, 0x20, 0x50, 0x6f, 0x72, 0x74, 
-0x3a, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 
-0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 
-0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x20, 
-0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 
-0x22, 0x77, 0x65, 0x62, 0x5f, 0x70, 0x6f, 0x72, 0x74, 0x22, 0x20, 0x74, 
-0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x20, 
-0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 
-0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x65, 0x62, 0x70, 0x6f, 
-0x72, 0x74, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x20, 
-0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 
-0x3a, 0x20, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 0x2f, 0x74, 
-0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 
-0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 
-0x20, 0x33, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 
-0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 
+0x6d, 0x65, 0x3d, 0x22, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x5f, 0x63, 0x6f, 
+0x6e, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 0x78, 
+0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 
+0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x61, 0x63, 
+0x6f, 0x6e, 0x73, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 
+0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 
+0x68, 0x3a, 0x20, 0x33, 0x30, 0x30, 0x70, 0x78, 0x3b, 0x20, 0x68, 0x65, 
+0x69, 0x67, 0x68, 0x74, 0x3a, 0x20, 0x36, 0x30, 0x70, 0x78, 0x3b, 0x22, 
+0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 
+0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 
 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 
 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 
-0x3a, 0x20, 0x33, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x55, 0x73, 0x65, 
-0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74, 0x2e, 0x74, 0x78, 0x74, 
-0x20, 0x74, 0x6f, 0x20, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x20, 0x76, 0x69, 
-0x65, 0x77, 0x65, 0x72, 0x20, 0x61, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 
-0x3c, 0x62, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x49, 0x44, 0x2b, 
-0x41, 0x4c, 0x4b, 0x3a, 0x31, 0x33, 0x34, 0x35, 0x26, 0x6e, 0x62, 0x73, 
-0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 
-0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 
-0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 
-0x70, 0x3b, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74, 0x2e, 0x74, 
-0x78, 0x74, 0x20, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x31, 0x33, 0x34, 0x35, 
-0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 
-0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x41, 0x4c, 0x4b, 0x3c, 0x2f, 
+0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x52, 0x65, 0x66, 
+0x75, 0x73, 0x65, 0x20, 0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x69, 
+0x6f, 0x6e, 0x73, 0x20, 0x74, 0x6f, 0x3a, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 
+0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 
+0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 
+0x32, 0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 
+0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 0x6b, 
+0x62, 0x6f, 0x78, 0x22, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x72, 
+0x65, 0x66, 0x75, 0x73, 0x65, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 0x61, 
+0x6c, 0x75, 0x65, 0x3d, 0x22, 0x72, 0x65, 0x66, 0x75, 0x73, 0x65, 0x5f, 
+0x6f, 0x6e, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 
+0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x72, 
+0x63, 0x6f, 0x6e, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 
+0x20, 0x3e, 0x20, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 
+0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 
+0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x35, 0x30, 0x70, 0x78, 
+0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x69, 0x6e, 0x70, 0x75, 
+0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x72, 0x65, 0x66, 0x75, 
+0x73, 0x65, 0x5f, 0x63, 0x6f, 0x6e, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 
+0x3d, 0x22, 0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 
+0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 
+0x65, 0x3d, 0x22, 0x72, 0x63, 0x6f, 0x6e, 0x73, 0x2e, 0x73, 0x73, 0x69, 
+0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 
+0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x30, 0x30, 0x70, 
+0x78, 0x3b, 0x20, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3a, 0x20, 0x36, 
+0x30, 0x70, 0x78, 0x3b, 0x22, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 
+0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 
+0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 
+0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 
+0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 0x70, 0x78, 0x22, 0x3e, 0x4f, 0x6e, 
+0x6c, 0x79, 0x20, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x20, 0x49, 0x44, 0x3a, 
+0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 
+0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 
+0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 
+0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 
+0x63, 0x68, 0x65, 0x63, 0x6b, 0x62, 0x6f, 0x78, 0x22, 0x20, 0x6e, 0x61, 
+0x6d, 0x65, 0x3d, 0x22, 0x69, 0x64, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 
+0x61, 0x6c, 0x75, 0x65, 0x3d, 0x22, 0x69, 0x64, 0x5f, 0x6f, 0x6e, 0x22, 
+0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 
+0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x61, 0x69, 0x64, 0x2e, 
+0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x3e, 0x20, 0x3c, 0x2f, 
 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 
 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 
-0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 0x20, 0x3c, 0x69, 0x6e, 
-0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x63, 0x68, 
-0x65, 0x63, 0x6b, 0x62, 0x6f, 0x78, 0x22, 0x20, 0x6e, 0x61, 0x6d, 0x65, 
-0x3d, 0x22, 0x75, 0x63, 0x6f, 0x6d, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x76, 
-0x61, 0x6c, 0x75, 0x65, 0x3d, 0x22, 0x75, 0x63, 0x6f, 0x6d, 0x5f, 0x6f, 
-0x6e, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 
-0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x75, 0x63, 
-0x6f, 0x6d, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x3e, 
+0x3a, 0x20, 0x33, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 
+0x09, 0x09, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 
+0x65, 0x3d, 0x22, 0x69, 0x64, 0x5f, 0x63, 0x6f, 0x6e, 0x22, 0x20, 0x74, 
+0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 0x78, 0x74, 0x22, 0x20, 0x3c, 
+0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 
+0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x61, 0x69, 0x64, 0x73, 0x2e, 0x73, 
+0x73, 0x69, 0x22, 0x20, 0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 
+0x65, 0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x30, 
+0x30, 0x70, 0x78, 0x3b, 0x20, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3a, 
+0x20, 0x36, 0x30, 0x70, 0x78, 0x3b, 0x22, 0x3e, 0x3c, 0x2f, 0x74, 0x64, 
+0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 
+0x09, 0x09, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 
+0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 
+0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x32, 0x37, 0x35, 
+0x70, 0x78, 0x22, 0x3e, 0x57, 0x65, 0x62, 0x20, 0x47, 0x75, 0x69, 0x20, 
+0x50, 0x6f, 0x72, 0x74, 0x3a, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 
+0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 
+0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 
+0x78, 0x22, 0x3e, 0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x6e, 
+0x61, 0x6d, 0x65, 0x3d, 0x22, 0x77, 0x65, 0x62, 0x5f, 0x70, 0x6f, 0x72, 
+0x74, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x74, 0x65, 0x78, 
+0x74, 0x22, 0x20, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 0x69, 0x6e, 0x63, 
+0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
+0x65, 0x62, 0x70, 0x6f, 0x72, 0x74, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 
+0x2d, 0x2d, 0x3e, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
+0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 
 0x20, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 0x3c, 
 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 0x69, 
 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x35, 0x30, 0x70, 0x78, 0x22, 0x3e, 
 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x0d, 
-0x0a, 0x09, 0x09, 0x0d, 0x0a, 0x09, 0x3c, 0x2f, 0x74, 0x61, 0x62, 0x6c, 
-0x65, 0x3e, 0x0d, 0x0a, 0x09, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 
-0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x68, 0x69, 0x64, 0x64, 0x65, 0x6e, 
-0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x68, 0x69, 0x64, 0x64, 
-0x65, 0x6e, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x20, 0x3c, 0x69, 0x6e, 0x70, 
-0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 0x73, 0x75, 0x62, 
-0x6d, 0x69, 0x74, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x3d, 0x22, 
-0x53, 0x61, 0x76, 0x65, 0x20, 0x53, 0x65, 0x74, 0x74, 0x69, 0x6e, 0x67, 
-0x73, 0x22, 0x3e, 0x0d, 0x0a, 0x3c, 0x2f, 0x66, 0x6f, 0x72, 0x6d, 0x3e, 
-0x0d, 0x0a, 0x0d, 0x0a, 0x3c, 0x2f, 0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0d, 
-0x0a, 0x0d, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 0x0d, 0x0a, 
+0x0a, 0x09, 0x09, 0x3c, 0x74, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
+0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
+0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x37, 0x35, 0x70, 0x78, 0x22, 
+0x3e, 0x55, 0x73, 0x65, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74, 
+0x2e, 0x74, 0x78, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x63, 0x68, 0x65, 0x63, 
+0x6b, 0x20, 0x76, 0x69, 0x65, 0x77, 0x65, 0x72, 0x20, 0x61, 0x63, 0x63, 
+0x65, 0x73, 0x73, 0x3a, 0x3c, 0x62, 0x72, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 
+0x09, 0x49, 0x44, 0x2b, 0x41, 0x4c, 0x4b, 0x3a, 0x31, 0x33, 0x34, 0x35, 
+0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 
+0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 
+0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 
+0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 
+0x6e, 0x74, 0x2e, 0x74, 0x78, 0x74, 0x20, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
+0x31, 0x33, 0x34, 0x35, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 
+0x62, 0x73, 0x70, 0x3b, 0x26, 0x6e, 0x62, 0x73, 0x70, 0x3b, 0x20, 0x41, 
+0x4c, 0x4b, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x09, 
+0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3d, 0x22, 0x77, 
+0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x32, 0x70, 0x78, 0x22, 0x3e, 
+0x20, 0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 
+0x3d, 0x22, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x62, 0x6f, 0x78, 0x22, 0x20, 
+0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x75, 0x63, 0x6f, 0x6d, 0x5f, 0x6f, 
+0x6e, 0x22, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x3d, 0x22, 0x75, 0x63, 
+0x6f, 0x6d, 0x5f, 0x6f, 0x6e, 0x22, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x23, 
+0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x65, 
+0x3d, 0x22, 0x75, 0x63, 0x6f, 0x6d, 0x2e, 0x73, 0x73, 0x69, 0x22, 0x20, 
+0x2d, 0x2d, 0x3e, 0x3e, 0x20, 0x3c, 0x2f, 0x74, 0x64, 0x3e, 0x0d, 0x0a, 
+0x09, 0x09, 0x09, 0x3c, 0x74, 0x64, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 
+0x3d, 0x22, 0x77, 0x69, 0x64, 0x74, 0x68, 0x3a, 0x20, 0x33, 0x35, 0x30, 
+0x70, 0x78, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x74, 0x72, 
+0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x09, 0x09, 0x0d, 0x0a, 0x09, 0x3c, 0x2f, 
+0x74, 0x61, 0x62, 0x6c, 0x65, 0x3e, 0x0d, 0x0a, 0x09, 0x3c, 0x69, 0x6e, 
+0x70, 0x75, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x3d, 0x22, 0x68, 0x69, 
+0x64, 0x64, 0x65, 0x6e, 0x22, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x22, 
+0x68, 0x69, 0x64, 0x64, 0x65, 0x6e, 0x22, 0x3e, 0x0d, 0x0a, 0x09, 0x20, 
+0x3c, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3d, 
+0x22, 0x73, 0x75, 0x62, 0x6d, 0x69, 0x74, 0x22, 0x20, 0x76, 0x61, 0x6c, 
+0x75, 0x65, 0x3d, 0x22, 0x53, 0x61, 0x76, 0x65, 0x20, 0x53, 0x65, 0x74, 
+0x74, 0x69, 0x6e, 0x67, 0x73, 0x22, 0x3e, 0x0d, 0x0a, 0x3c, 0x2f, 0x66, 
+0x6f, 0x72, 0x6d, 0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x3c, 0x2f, 0x62, 0x6f, 
+0x64, 0x79, 0x3e, 0x0d, 0x0a, 0x0d, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d, 
+0x6c, 0x3e, 0x0d, 0x0a, 
 
 };
 
@@ -1069,7 +1110,7 @@ unsigned char server_access_txt11[] = {
 0x22, 0x20, 0x2d, 0x2d, 0x3e, 
 };
 
-em_file efslist[38] = {
+em_file efslist[40] = {
 {	&efslist[1],   /* list link */
 	"index.html",   /* name of file */
    index_html1,   /* C data array */
@@ -1087,7 +1128,7 @@ em_file efslist[38] = {
 {	&efslist[3],   /* list link */
 	"settings.html",   /* name of file */
    settings_html3,   /* C data array */
-   3876,        /* length of original file data */
+   4360,        /* length of original file data */
    NULL,        /* SSI/CGI data routine */
 	(EMF_AUTH ),	/* flags  */
 },
@@ -1281,48 +1322,62 @@ em_file efslist[38] = {
 	(EMF_SSI ),	/* flags  */
 },
 {	&efslist[31],   /* list link */
+	"slimit.ssi",   /* name of file */
+   NULL,	     /* name of data array */
+   0,	        /* length of original file data */
+   slimit_ssi,	     /* SSI/CGI data routine */
+	(EMF_SSI ),	/* flags  */
+},
+{	&efslist[32],   /* list link */
+	"glimit.ssi",   /* name of file */
+   NULL,	     /* name of data array */
+   0,	        /* length of original file data */
+   glimit_ssi,	     /* SSI/CGI data routine */
+	(EMF_SSI ),	/* flags  */
+},
+{	&efslist[33],   /* list link */
 	"memhits.var",   /* name of file */
    NULL,	     /* name of data array */
-   MEMHITS_VAR31,	     /* overload length w/ token */
+   MEMHITS_VAR33,	     /* overload length w/ token */
    NULL,	     /* SSI/CGI data routine */
 	(EMF_CEXP ),	/* flags  */
 },
-{	&efslist[32],   /* list link */
+{	&efslist[34],   /* list link */
 	"pushtest.htm",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
    pushtest_func,	     /* SSI/CGI data routine */
 	(EMF_PUSH ),	/* flags  */
 },
-{	&efslist[33],   /* list link */
+{	&efslist[35],   /* list link */
 	"testaction.cgi",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
    testaction_cgi,	     /* SSI/CGI data routine */
 	(EMF_FORM ),	/* flags  */
 },
-{	&efslist[34],   /* list link */
+{	&efslist[36],   /* list link */
 	"testaction2.cgi",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
    testaction2_cgi,	     /* SSI/CGI data routine */
 	(EMF_FORM ),	/* flags  */
 },
-{	&efslist[35],   /* list link */
+{	&efslist[37],   /* list link */
 	"testaction3.cgi",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
    testaction3_cgi,	     /* SSI/CGI data routine */
 	(EMF_FORM ),	/* flags  */
 },
-{	&efslist[36],   /* list link */
+{	&efslist[38],   /* list link */
 	"testaction4.cgi",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
    testaction4_cgi,	     /* SSI/CGI data routine */
 	(EMF_FORM ),	/* flags  */
 },
-{	&efslist[37],   /* list link */
+{	&efslist[39],   /* list link */
 	"testaction5.cgi",   /* name of file */
    NULL,	     /* name of data array */
    0,	        /* length of original file data */
@@ -1080,11 +1080,18 @@ typedef enum {
 typedef struct {
     CARD8 type;			/* always rfbServerCutText */
     CARD8 pad1;
-    CARD16 flags; // reserved - always 0
+    CARD16 flags; // rfbPluginStreaming* below, 0 from older peers
 } rfbNotifyPluginStreamingMsg;
 
 #define sz_rfbNotifyPluginStreamingMsg	4
 
+// The sender's plugin has a record layer (IRecordPlugin) and can read
+// record framed data.
+#define rfbPluginStreamingRecordsSupported	0x0001
+// Everything the sender writes after this message is record framed. Only
+// sent after the peer announced rfbPluginStreamingRecordsSupported.
+#define rfbPluginStreamingRecordsFollow		0x0002
+
 /*-----------------------------------------------------------------------------
  * // Modif sf@2002
  * FileTransferMsg - The client sends FileTransfer message.
@@ -1619,4 +1626,5 @@ typedef union {
 	rfbRequestSessionMsg rs;
 	rfbSetSessionMsg ss;
     rfbSetDesktopSizeMsg sdm;
+	rfbNotifyPluginStreamingMsg nsd;
 } rfbClientToServerMsg;
@@ -25,6 +25,8 @@
 // GET_IMAGE_INTO_BUF should be some code which gets a rectangle of pixel data
 // into the given buffer.  EXTRA_ARGS can be defined to pass any other
 // arguments needed by GET_IMAGE_INTO_BUF.
+// TILE_ENCODED, if defined, is told the size of every tile written and the
+// size it has when it goes out raw.
 //
 // Note that the buf argument to XZ_ENCODE needs to be at least one pixel
 // bigger than the largest tile of pixel data, since the XZ encoding
@@ -41,6 +43,10 @@ using namespace rdr;
 /* __RFB_CONCAT2 concatenates its two arguments.  __RFB_CONCAT2E does the same
    but also expands its arguments if they are macros */
 
+#ifndef TILE_ENCODED
+#define TILE_ENCODED(rawBytes,bytes)
+#endif
+
 #ifndef __RFB_CONCAT2E
 #define __RFB_CONCAT2(a,b) a##b
 #define __RFB_CONCAT2E(a,b) __RFB_CONCAT2(a,b)
@@ -160,7 +166,9 @@ void XZ_ENCODE (int x, int y, int w, int h, rdr::OutStream* os,
 
       GET_IMAGE_INTO_BUF(tx,ty,tw,th,buf);
 
+      int tileStart = xzos->length();
       XZ_ENCODE_TILE((PIXEL_T*)buf, tw, th, xzos);
+      TILE_ENCODED(1 + tw*th*(BPPOUT/8), xzos->length() - tileStart);
     }
   }
 }
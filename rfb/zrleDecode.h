@@ -22,12 +22,16 @@
 // Before including this file, you must define a number of CPP macros.
 //
 // BPP should be 8, 16 or 32 depending on the bits per pixel.
-// FILL_RECT
-// IMAGE_RECT
+// IMAGE_RECT draws a tile decoded to buf.
+//
+// When fb is given, tiles are decoded straight into it (fbStride is its
+// scanline in pixels) and IMAGE_RECT is not used. ZYWRLE tiles are still
+// decoded and synthesized in buf, then copied to fb.
 
 #include <rdr/ZlibInStream.h>
 #include <rdr/ZstdInStream.h>
 #include <rdr/InStream.h>
+#include <rdr/Exception.h>
 #include <assert.h>
 
 using namespace rdr;
@@ -45,6 +49,200 @@ using namespace rdr;
 #define __RFB_CONCAT3E(a,b,c) __RFB_CONCAT3(a,b,c)
 #endif
 
+#ifndef ZRLE_DECODE_ONCE
+#define ZRLE_DECODE_ONCE
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZRLE_DECODE_SSE2
+#endif
+
+// Byte cursor over the buffer of the zlib/zstd stream, the run lengths,
+// indices and pixels are read without going through check() for every
+// byte. sync() gives the position back before the stream is used directly.
+template <class myInStream>
+class ZrleByteReader {
+public:
+  ZrleByteReader(myInStream* is_) : is(is_) { load(); }
+
+  inline void load() { p = is->getptr(); e = is->getend(); }
+  inline void sync() { is->setptr(p); }
+
+  inline U8 next() {
+    if (p == e) refill(1);
+    return *p++;
+  }
+
+  // At least n bytes from the returned pointer on, n is small
+  inline const U8* need(int n) {
+    if (e - p < n) refill(n);
+    return p;
+  }
+  inline void advance(int n) { p += n; }
+
+  inline int runLength(int max) {
+    int len = 1;
+    int b;
+    do {
+      b = next();
+      len += b;
+      if (len > max)
+        throw Exception("ZRLE run past the end of the tile");
+    } while (b == 255);
+    return len;
+  }
+
+private:
+  void refill(int n) {
+    is->setptr(p);
+    is->check(n);
+    load();
+  }
+
+  myInStream* is;
+  const U8* p;
+  const U8* e;
+};
+
+// Pixel of BYTES bytes at OFFSET in T, as readOpaque24A/24B do
+template <int BYTES, int OFFSET, class T>
+inline T zrleGetPixel(const U8* p)
+{
+  T r = 0;
+  memcpy((U8*)&r + OFFSET, p, BYTES);
+  return r;
+}
+
+template <int BYTES, int OFFSET, class T, class myInStream>
+inline T zrleReadPixel(ZrleByteReader<myInStream>& rd)
+{
+  T r = zrleGetPixel<BYTES, OFFSET, T>(rd.need(BYTES));
+  rd.advance(BYTES);
+  return r;
+}
+
+#ifdef ZRLE_DECODE_SSE2
+inline __m128i zrleSplat(U8 pix) { return _mm_set1_epi8((char)pix); }
+inline __m128i zrleSplat(U16 pix) { return _mm_set1_epi16((short)pix); }
+inline __m128i zrleSplat(U32 pix) { return _mm_set1_epi32((int)pix); }
+
+inline __m128i zrleSelect(__m128i m, __m128i c0, __m128i c1)
+{
+  return _mm_or_si128(_mm_and_si128(m, c1), _mm_andnot_si128(m, c0));
+}
+
+// Eight pixels from the bits of b, msb first, a set bit selects c1
+inline void zrleSelect8(U32* dst, int b, __m128i c0, __m128i c1)
+{
+  const __m128i hi = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+  const __m128i lo = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+  __m128i v = _mm_set1_epi32(b);
+  _mm_storeu_si128((__m128i*)dst,
+                   zrleSelect(_mm_cmpeq_epi32(_mm_and_si128(v, hi), hi), c0, c1));
+  _mm_storeu_si128((__m128i*)(dst + 4),
+                   zrleSelect(_mm_cmpeq_epi32(_mm_and_si128(v, lo), lo), c0, c1));
+}
+
+inline void zrleSelect8(U16* dst, int b, __m128i c0, __m128i c1)
+{
+  const __m128i bits = _mm_set_epi16(0x01, 0x02, 0x04, 0x08,
+                                     0x10, 0x20, 0x40, 0x80);
+  __m128i m = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((short)b), bits), bits);
+  _mm_storeu_si128((__m128i*)dst, zrleSelect(m, c0, c1));
+}
+
+inline void zrleSelect8(U8* dst, int b, __m128i c0, __m128i c1)
+{
+  const __m128i bits = _mm_set_epi16(0x01, 0x02, 0x04, 0x08,
+                                     0x10, 0x20, 0x40, 0x80);
+  __m128i m = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((short)b), bits), bits);
+  _mm_storel_epi64((__m128i*)dst, zrleSelect(_mm_packs_epi16(m, m), c0, c1));
+}
+#endif
+
+// n pixels of pix. Runs of 8 bytes or more are written with wide stores,
+// the last one overlapping the one before it.
+template <class T>
+inline void zrleFill(T* p, int n, T pix)
+{
+#ifdef ZRLE_DECODE_SSE2
+  const int PER_VECTOR = 16 / sizeof(T);
+  const int PER_HALF = 8 / sizeof(T);
+  if (n >= PER_VECTOR) {
+    __m128i v = zrleSplat(pix);
+    T* last = p + n - PER_VECTOR;
+    for (; p < last; p += PER_VECTOR)
+      _mm_storeu_si128((__m128i*)p, v);
+    _mm_storeu_si128((__m128i*)last, v);
+    return;
+  }
+  if (n >= PER_HALF) {
+    __m128i v = zrleSplat(pix);
+    _mm_storel_epi64((__m128i*)p, v);
+    _mm_storel_epi64((__m128i*)(p + n - PER_HALF), v);
+    return;
+  }
+#endif
+  while (n-- > 0) *p++ = pix;
+}
+
+// One row of n packed pixels of bppp bits, msb first
+template <class T>
+inline void zrleUnpackRow(T* dst, const U8* src, int n, int bppp, const T* palette)
+{
+  int i = 0;
+  switch (bppp) {
+  case 1:
+#ifdef ZRLE_DECODE_SSE2
+    {
+      __m128i c0 = zrleSplat(palette[0]);
+      __m128i c1 = zrleSplat(palette[1]);
+      for (; i + 8 <= n; i += 8)
+        zrleSelect8(dst + i, *src++, c0, c1);
+    }
+#else
+    for (; i + 8 <= n; i += 8) {
+      int b = *src++;
+      dst[i]     = palette[(b >> 7) & 1]; dst[i + 1] = palette[(b >> 6) & 1];
+      dst[i + 2] = palette[(b >> 5) & 1]; dst[i + 3] = palette[(b >> 4) & 1];
+      dst[i + 4] = palette[(b >> 3) & 1]; dst[i + 5] = palette[(b >> 2) & 1];
+      dst[i + 6] = palette[(b >> 1) & 1]; dst[i + 7] = palette[b & 1];
+    }
+#endif
+    break;
+  case 2:
+    for (; i + 4 <= n; i += 4) {
+      int b = *src++;
+      dst[i]     = palette[b >> 6];
+      dst[i + 1] = palette[(b >> 4) & 3];
+      dst[i + 2] = palette[(b >> 2) & 3];
+      dst[i + 3] = palette[b & 3];
+    }
+    break;
+  case 4:
+    for (; i + 2 <= n; i += 2) {
+      int b = *src++;
+      dst[i]     = palette[b >> 4];
+      dst[i + 1] = palette[b & 15];
+    }
+    break;
+  default:
+    for (; i < n; i++)
+      dst[i] = palette[src[i] & 127];
+    return;
+  }
+
+  // Partial last byte
+  if (i < n) {
+    int b = *src;
+    int mask = (1 << bppp) - 1;
+    for (int nbits = 8 - bppp; i < n; i++, nbits -= bppp)
+      dst[i] = palette[(b >> nbits) & mask];
+  }
+}
+
+#endif // ZRLE_DECODE_ONCE
+
 #undef END_FIX
 #if ZYWRLE_ENDIAN == ENDIAN_LITTLE
 #  define END_FIX LE
@@ -56,21 +254,28 @@ using namespace rdr;
 
 #ifdef CPIXEL
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,BPP)
-#define READ_PIXEL __RFB_CONCAT2E(readOpaque,CPIXEL)
 #define ZRLE_DECODE_BPP __RFB_CONCAT3E(zrleDecode,CPIXEL,END_FIX)
 #define BPPOUT BPP
+#define ZRLE_CPIXEL_OFFSET_24A 0
+#define ZRLE_CPIXEL_OFFSET_24B 1
+#define CPIXEL_BYTES 3
+#define CPIXEL_OFFSET __RFB_CONCAT2E(ZRLE_CPIXEL_OFFSET_,CPIXEL)
 #elif BPP==15
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,16)
-#define READ_PIXEL __RFB_CONCAT2E(readOpaque,16)
 #define ZRLE_DECODE_BPP __RFB_CONCAT3E(zrleDecode,BPP,END_FIX)
 #define BPPOUT 16
+#define CPIXEL_BYTES 2
+#define CPIXEL_OFFSET 0
 #else
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,BPP)
-#define READ_PIXEL __RFB_CONCAT2E(readOpaque,BPP)
 #define ZRLE_DECODE_BPP __RFB_CONCAT3E(zrleDecode,BPP,END_FIX)
 #define BPPOUT BPP
+#define CPIXEL_BYTES (BPP / 8)
+#define CPIXEL_OFFSET 0
 #endif
 
+#define READ_PIXEL(rd) zrleReadPixel<CPIXEL_BYTES, CPIXEL_OFFSET, PIXEL_T>(rd)
+
 #if BPP!=8
 #define ZYWRLE_DECODE
 #include <rfb/zywrletemplate.c>
@@ -78,10 +283,11 @@ using namespace rdr;
 
 template <class myInStream>
 void ZRLE_DECODE_BPP (int x, int y, int w, int h, rdr::InStream* is,
-	myInStream* zis, PIXEL_T* buf)
+	myInStream* zis, PIXEL_T* buf, PIXEL_T* fb, int fbStride)
 {
   int length = is->readU32();
   zis->setUnderlying(is, length);
+  ZrleByteReader<myInStream> rd(zis);
 
   for (int ty = y; ty < y+h; ty += rfbZRLETileHeight) {
     int th = rfbZRLETileHeight;
@@ -90,45 +296,65 @@ void ZRLE_DECODE_BPP (int x, int y, int w, int h, rdr::InStream* is,
       int tw = rfbZRLETileWidth;
       if (tw > x+w-tx) tw = x+w-tx;
 
+      omni_mutex_lock l(m_bitmapdcMutex);
+
+      // With ZYWRLE a raw tile is followed by the real tile, which holds
+      // the wavelet coefficients
+      bool wavelet = false;
+      int mode = rd.next();
 #if BPP!=8
-top:
+      if (mode == 0 && zywrle_level > 0) {
+        wavelet = true;
+        mode = rd.next();
+      }
 #endif
-      int mode = zis->readU8();
-      BOOL rle = mode & 128;
+      int rle = mode & 128;
       int palSize = mode & 127;
       PIXEL_T palette[128];
 
-      //        fprintf(stderr,"rle %d palSize %d\n",rle,palSize);
-
       for (int i = 0; i < palSize; i++) {
-        palette[i] = zis->READ_PIXEL();
+        palette[i] = READ_PIXEL(rd);
       }
 
-      if (palSize == 1) {
-        PIXEL_T* ptr = buf;
-        for (int i = 0; i < tw*th; i++) {
-			*ptr++ = palette[0];
-		}
-		goto draw;
+      PIXEL_T* dst = buf;
+      int stride = tw;
+      if (fb != NULL && !wavelet) {
+        dst = fb + ty * fbStride + tx;
+        stride = fbStride;
       }
 
-      if (!rle) {
+      if (palSize == 1) {
+
+        // solid
+
+        if (stride == tw) {
+          zrleFill(dst, tw * th, palette[0]);
+        } else {
+          for (int i = 0; i < th; i++)
+            zrleFill(dst + i * stride, tw, palette[0]);
+        }
+
+      } else if (!rle) {
         if (palSize == 0) {
 
           // raw
 
-#if BPP!=8
-          if( (zywrle_level>0)&& !(zywrle_level & 0x80) ){
-			zywrle_level |= 0x80;
-			goto top;
-		  }else
-#endif
 #ifdef CPIXEL
-          for (PIXEL_T* ptr = buf; ptr < buf+tw*th; ptr++) {
-            *ptr = zis->READ_PIXEL();
+          for (int i = 0; i < th; i++) {
+            PIXEL_T* ptr = dst + i * stride;
+            for (int j = 0; j < tw; j++) {
+              ptr[j] = READ_PIXEL(rd);
+            }
           }
 #else
-          zis->readBytes(buf, tw * th * (BPPOUT / 8));
+          rd.sync();
+          if (stride == tw) {
+            zis->readBytes(dst, tw * th * (BPPOUT / 8));
+          } else {
+            for (int i = 0; i < th; i++)
+              zis->readBytes(dst + i * stride, tw * (BPPOUT / 8));
+          }
+          rd.load();
 #endif
 
         } else {
@@ -136,151 +362,95 @@ top:
           // packed pixels
           int bppp = ((palSize > 16) ? 8 :
                       ((palSize > 4) ? 4 : ((palSize > 2) ? 2 : 1)));
-
-          PIXEL_T* ptr = buf;
+          int rowBytes = (tw * bppp + 7) / 8;
 
           for (int i = 0; i < th; i++) {
-            PIXEL_T* eol = ptr + tw;
-            U8 byte = 0;
-            U8 nbits = 0;
-
-            while (ptr < eol) {
-              if (nbits == 0) {
-                byte = zis->readU8();
-                nbits = 8;
-              }
-              nbits -= bppp;
-              U8 index = (byte >> nbits) & ((1 << bppp) - 1) & 127;
-              *ptr++ = palette[index];
-            }
+            zrleUnpackRow(dst + i * stride, rd.need(rowBytes), tw, bppp, palette);
+            rd.advance(rowBytes);
           }
         }
 
-#ifdef FAVOUR_FILL_RECT
-       //fprintf(stderr,"copying data to screen %dx%d at %d,%d\n",tw,th,tx,ty);
-        IMAGE_RECT(tx,ty,tw,th,buf);
-#endif
-
       } else {
 
-        if (palSize == 0) {
-
-          // plain RLE
-
-          PIXEL_T* ptr = buf;
-          PIXEL_T* end = ptr + th * tw;	    
-          while (ptr < end) {
-            PIXEL_T pix = zis->READ_PIXEL();
-            int len = 1;
-            int b;
-            do {
-              b = zis->readU8();
-              len += b;
-            } while (b == 255);
-
-            assert(len <= end - ptr);
-
-#ifdef FAVOUR_FILL_RECT
-            int i = ptr - buf;
-            ptr += len;
-
-            int runX = i % tw;
-            int runY = i / tw;
-
-            if (runX + len > tw) {
-              if (runX != 0) {
-                FILL_RECT(tx+runX, ty+runY, tw-runX, 1, pix);
-                len -= tw-runX;
-                runX = 0;
-                runY++;
-              }
-
-              if (len > tw) {
-                FILL_RECT(tx, ty+runY, tw, len/tw, pix);
-                runY += len / tw;
-                len = len % tw;
+        // plain RLE and palette RLE, runs go on over the end of the rows
+        int rowLen = tw;
+        if (stride == tw) rowLen = tw * th;
+        PIXEL_T* row = dst;
+        int col = 0;
+        int left = tw * th;
+
+        while (left > 0) {
+          PIXEL_T pix;
+          int len;
+          if (palSize == 0) {
+            pix = READ_PIXEL(rd);
+            len = rd.runLength(left);
+          } else {
+            int index = rd.next();
+            if (!(index & 128)) {
+              // single pixel
+              row[col] = palette[index];
+              left--;
+              if (++col == rowLen) {
+                row += stride;
+                col = 0;
               }
+              continue;
             }
-
-            if (len != 0) {
-              FILL_RECT(tx+runX, ty+runY, len, 1, pix);
-            }
-#else
-            while (len-- > 0) *ptr++ = pix;
-#endif
-
+            len = rd.runLength(left);
+            pix = palette[index & 127];
           }
-        } else {
-
-          // palette RLE
-
-          PIXEL_T* ptr = buf;
-          PIXEL_T* end = ptr + th * tw;
-          while (ptr < end) {
-            int index = zis->readU8();
-            int len = 1;
-            if (index & 128) {
-              int b;
-              do {
-                b = zis->readU8();
-                len += b;
-              } while (b == 255);
-
-              assert(len <= end - ptr);
-            }
-
-            index &= 127;
-
-            PIXEL_T pix = palette[index];
-
-#ifdef FAVOUR_FILL_RECT
-            int i = ptr - buf;
-            ptr += len;
-
-            int runX = i % tw;
-            int runY = i / tw;
-
-            if (runX + len > tw) {
-              if (runX != 0) {
-                FILL_RECT(tx+runX, ty+runY, tw-runX, 1, pix);
-                len -= tw-runX;
-                runX = 0;
-                runY++;
-              }
-
-              if (len > tw) {
-                FILL_RECT(tx, ty+runY, tw, len/tw, pix);
-                runY += len / tw;
-                len = len % tw;
-              }
+          left -= len;
+
+#ifdef ZRLE_DECODE_SSE2
+          // A short run is one 16 byte store, the pixels written past its
+          // end are written again by the runs that follow in the row
+          if (len <= 16 / (int)sizeof(PIXEL_T) &&
+              col + 16 / (int)sizeof(PIXEL_T) <= rowLen) {
+            _mm_storeu_si128((__m128i*)(row + col), zrleSplat(pix));
+            col += len;
+            if (col == rowLen) {
+              row += stride;
+              col = 0;
             }
+            continue;
+          }
+#endif
 
-            if (len != 0) {
-              FILL_RECT(tx+runX, ty+runY, len, 1, pix);
+          while (len > 0) {
+            int n = rowLen - col;
+            if (n > len) n = len;
+            zrleFill(row + col, n, pix);
+            col += n;
+            len -= n;
+            if (col == rowLen) {
+              row += stride;
+              col = 0;
             }
-#else
-            while (len-- > 0) *ptr++ = pix;
-#endif
           }
         }
       }
 
-#ifndef FAVOUR_FILL_RECT
-      //fprintf(stderr,"copying data to screen %dx%d at %d,%d\n",tw,th,tx,ty);
-draw:
-	  omni_mutex_lock l(m_bitmapdcMutex);
 #if BPP!=8
-      if( zywrle_level & 0x80 ){
-	    zywrle_level &= 0x7F;
-		ZYWRLE_SYNTHESIZE( buf, buf, tw, th, tw, zywrle_level, zywrleBuf );
-	  }
-#endif
-      IMAGE_RECT(tx,ty,tw,th,buf);
-	   if (initialupdate_counter < 4) if (!directx_used)InvalidateRect(m_hwndcn, NULL, FALSE);
+      if (wavelet) {
+        // In place, the synthesis leaves the bytes outside the colour
+        // channels as they were in buf
+        ZYWRLE_SYNTHESIZE(buf, buf, tw, th, tw, zywrle_level, zywrleBuf);
+        if (fb != NULL) {
+          PIXEL_T* out = fb + ty * fbStride + tx;
+          for (int i = 0; i < th; i++)
+            memcpy(out + i * fbStride, buf + i * tw, tw * (BPPOUT / 8));
+        }
+      }
 #endif
+      if (fb == NULL) {
+        IMAGE_RECT(tx,ty,tw,th,buf);
+      }
+      if (initialupdate_counter < 4) if (!directx_used)InvalidateRect(m_hwndcn, NULL, FALSE);
     }
   }
 
+  rd.sync();
   zis->reset();
 }
 
@@ -288,3 +458,5 @@ draw:
 #undef READ_PIXEL
 #undef PIXEL_T
 #undef BPPOUT
+#undef CPIXEL_BYTES
+#undef CPIXEL_OFFSET
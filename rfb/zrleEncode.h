@@ -30,6 +30,10 @@
 // bigger than the largest tile of pixel data, since the ZRLE encoding
 // algorithm writes to the position one past the end of the pixel data.
 //
+// The state argument is a ZrleTileState owned by the caller, it keeps the
+// palette table and the output buffer of a tile from one tile to the next.
+// When PixelScan.h is included first, solid tiles are found with SSE2.
+//
 
 #include <rdr/OutStream.h>
 #include <assert.h>
@@ -60,19 +64,19 @@ using namespace rdr;
 
 #ifdef CPIXEL
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,BPP)
-#define WRITE_PIXEL __RFB_CONCAT2E(writeOpaque,CPIXEL)
+#define PUT_PIXEL __RFB_CONCAT2E(putOpaque,CPIXEL)
 #define ZRLE_ENCODE __RFB_CONCAT3E(zrleEncode,CPIXEL,END_FIX)
 #define ZRLE_ENCODE_TILE __RFB_CONCAT3E(zrleEncodeTile,CPIXEL,END_FIX)
 #define BPPOUT 24
 #elif BPP==15
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,16)
-#define WRITE_PIXEL __RFB_CONCAT2E(writeOpaque,16)
+#define PUT_PIXEL __RFB_CONCAT2E(putOpaque,16)
 #define ZRLE_ENCODE __RFB_CONCAT3E(zrleEncode,BPP,END_FIX)
 #define ZRLE_ENCODE_TILE __RFB_CONCAT3E(zrleEncodeTile,BPP,END_FIX)
 #define BPPOUT 16
 #else
 #define PIXEL_T __RFB_CONCAT2E(rdr::U,BPP)
-#define WRITE_PIXEL __RFB_CONCAT2E(writeOpaque,BPP)
+#define PUT_PIXEL __RFB_CONCAT2E(putOpaque,BPP)
 #define ZRLE_ENCODE __RFB_CONCAT3E(zrleEncode,BPP,END_FIX)
 #define ZRLE_ENCODE_TILE __RFB_CONCAT3E(zrleEncodeTile,BPP,END_FIX)
 #define BPPOUT BPP
@@ -88,15 +92,29 @@ int zywrle_level = 1;
 int zywrleBuf[rfbZRLETileWidth*rfbZRLETileHeight];
 
 // The PaletteHelper class helps us build up the palette from pixel data by
-// storing a reverse index using a simple hash-table
+// storing a reverse index using a simple hash-table.  A slot holds its
+// palette index in the low byte and the generation that wrote it in the
+// high byte, so reset() starts a new table without clearing it (the table
+// is only cleared when the generation wraps, every 255 tiles).
 
 class PaletteHelper {
 public:
-  enum { MAX_SIZE = 127 };
+  enum { MAX_SIZE = 127, TABLE_SIZE = 4096+MAX_SIZE };
 
   PaletteHelper()
   {
-    memset(index, 255, sizeof(index));
+    memset(slot, 0, sizeof(slot));
+    generation = 0;
+    reset();
+  }
+
+  inline void reset()
+  {
+    if (++generation == 256) {
+      memset(slot, 0, sizeof(slot));
+      generation = 1;
+    }
+    tag = (rdr::U16)(generation << 8);
     size = 0;
   }
 
@@ -105,39 +123,102 @@ public:
     return (pix ^ (pix >> 17)) & 4095;
   }
 
-  inline void insert(rdr::U32 pix)
+  // Returns the palette index of pix, or -1 once the palette is full
+
+  inline int insert(rdr::U32 pix)
   {
     if (size < MAX_SIZE) {
       int i = hash(pix);
-      while (index[i] != 255 && key[i] != pix)
+      while ((slot[i] & 0xFF00) == tag && key[i] != pix)
         i++;
-      if (index[i] != 255) return;
+      if ((slot[i] & 0xFF00) == tag) return slot[i] & 0xFF;
 
-      index[i] = size;
+      slot[i] = tag | size;
       key[i] = pix;
       palette[size] = pix;
+      return size++;
     }
     size++;
-  }
-
-  inline int lookup(rdr::U32 pix)
-  {
-    assert(size <= MAX_SIZE);
-    int i = hash(pix);
-    while (index[i] != 255 && key[i] != pix)
-      i++;
-    if (index[i] != 255) return index[i];
     return -1;
   }
 
   rdr::U32 palette[MAX_SIZE];
-  rdr::U8 index[4096+MAX_SIZE];
-  rdr::U32 key[4096+MAX_SIZE];
+  rdr::U16 slot[TABLE_SIZE];
+  rdr::U32 key[TABLE_SIZE];
+  rdr::U16 tag;
+  int generation;
   int size;
 };
+
+// Kept by the encoder from tile to tile.  The first pass over a tile
+// records every run with its palette index, so writing the tile needs no
+// palette lookups.  Once the palette overflows only raw or plain RLE is
+// left, the rest of the runs are counted and not recorded.  The tile is assembled in out and handed to the stream
+// with one writeBytes(), the worst case being RLE of single 32 bit pixels
+// (5 bytes each) after the header and a palette.
+
+struct ZrleTileState {
+  enum { TILE_PIXELS = rfbZRLETileWidth*rfbZRLETileHeight,
+         OUT_SIZE = 1 + 4*PaletteHelper::MAX_SIZE + 5*TILE_PIXELS };
+  PaletteHelper ph;
+  rdr::U16 runLength[TILE_PIXELS];
+  rdr::U8 runIndex[TILE_PIXELS];
+  rdr::U8 out[OUT_SIZE];
+};
+
+// putOpaqueN() store a pixel like OutStream::writeOpaqueN()
+
+inline void putOpaque8(rdr::U8*& p, rdr::U32 u) { *p++ = (rdr::U8)u; }
+inline void putOpaque16(rdr::U8*& p, rdr::U32 u) { rdr::U16 v = (rdr::U16)u;
+                                                    memcpy(p, &v, 2); p += 2; }
+inline void putOpaque32(rdr::U8*& p, rdr::U32 u) { memcpy(p, &u, 4); p += 4; }
+inline void putOpaque24A(rdr::U8*& p, rdr::U32 u) { memcpy(p, &u, 3); p += 3; }
+inline void putOpaque24B(rdr::U8*& p, rdr::U32 u) { memcpy(p, (rdr::U8*)&u + 1, 3);
+                                                     p += 3; }
+
+// Leading pixels of p[0..n) equal to pix, and the pixels of p[1..n) that
+// differ from the one before them.  SSE2 when PixelScan.h is included.
+
+template <class T>
+inline int zrleRun(const T* p, int n, T pix)
+{
+#ifdef _WINVNC_PIXELSCAN
+  return PixelScan::Run(p, n, pix);
+#else
+  int i = 0;
+  while (i < n && p[i] == pix) i++;
+  return i;
 #endif
+}
 
-void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os);
+template <class T>
+inline int zrleChanges(const T* p, int n)
+{
+#ifdef _WINVNC_PIXELSCAN
+  return PixelScan::Changes(p, n);
+#else
+  int changes = 0;
+  for (int i = 1; i < n; i++)
+    if (p[i] != p[i-1]) changes++;
+  return changes;
+#endif
+}
+
+// RLE run length: len-1 as a series of 255s and a final byte
+
+inline void putRunLength(rdr::U8*& p, int len)
+{
+  len -= 1;
+  while (len >= 255) {
+    *p++ = 255;
+    len -= 255;
+  }
+  *p++ = (rdr::U8)len;
+}
+#endif
+
+void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os,
+                       ZrleTileState* state);
 
 #if BPP!=8
 #define ZYWRLE_ENCODE
@@ -145,7 +226,8 @@ void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os);
 #endif
 
 template <class myOutStream>
-void ZRLE_ENCODE (int x, int y, int w, int h, rdr::OutStream* os,myOutStream* zos, void* buf
+void ZRLE_ENCODE (int x, int y, int w, int h, rdr::OutStream* os,myOutStream* zos, void* buf,
+                  ZrleTileState* state
                   EXTRA_ARGS
                   )
 {
@@ -160,35 +242,62 @@ void ZRLE_ENCODE (int x, int y, int w, int h, rdr::OutStream* os,myOutStream* zo
 
       GET_IMAGE_INTO_BUF(tx,ty,tw,th,buf);
 
-      ZRLE_ENCODE_TILE((PIXEL_T*)buf, tw, th, zos);
+      ZRLE_ENCODE_TILE((PIXEL_T*)buf, tw, th, zos, state);
     }
   }
   zos->flush();
 }
 
 
-void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os)
+void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os,
+                       ZrleTileState* state)
 {
+  rdr::U8* out = state->out;
+
+#ifdef _WINVNC_PIXELSCAN
+  // Most tiles of a desktop are solid, one SSE2 pass finds them
+
+  if (PixelScan::Equal(data, w * h, data[0])) {
+    *out++ = 1;
+    PUT_PIXEL(out, data[0]);
+    os->writeBytes(state->out, (int)(out - state->out));
+    return;
+  }
+#endif
+
   // First find the palette and the number of runs
 
-  PaletteHelper ph;
+  PaletteHelper& ph = state->ph;
+  ph.reset();
 
   int runs = 0;
   int singlePixels = 0;
+  int nRuns = 0;
+  rdr::U16* runLength = state->runLength;
+  rdr::U8* runIndex = state->runIndex;
 
   PIXEL_T* ptr = data;
   PIXEL_T* end = ptr + h * w;
   *end = ~*(end-1); // one past the end is different so the while loop ends
 
   while (ptr < end) {
+    PIXEL_T* runStart = ptr;
     PIXEL_T pix = *ptr;
     if (*++ptr != pix) {
       singlePixels++;
     } else {
-      while (*++ptr == pix) ;
+      ptr += 1 + zrleRun(ptr + 1, (int)(end - ptr - 1), pix);
       runs++;
     }
-    ph.insert(pix);
+    int index = ph.insert(pix);
+    if (index < 0) {
+      // No palette any more, plain RLE only needs the number of runs
+      if (ptr < end)
+        runs += 1 + zrleChanges(ptr, (int)(end - ptr));
+      break;
+    }
+    runLength[nRuns] = (rdr::U16)(ptr - runStart);
+    runIndex[nRuns++] = (rdr::U8)index;
   }
 
   //fprintf(stderr,"runs %d, single pixels %d, paletteSize %d\n",
@@ -197,8 +306,9 @@ void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os)
   // Solid tile is a special case
 
   if (ph.size == 1) {
-    os->writeU8(1);
-    os->WRITE_PIXEL(ph.palette[0]);
+    *out++ = 1;
+    PUT_PIXEL(out, ph.palette[0]);
+    os->writeBytes(state->out, (int)(out - state->out));
     return;
   }
 
@@ -248,43 +358,42 @@ void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os)
 
   if (!usePalette) ph.size = 0;
 
-  os->writeU8((useRle ? 128 : 0) | ph.size);
+  *out++ = (useRle ? 128 : 0) | ph.size;
 
   for (int i = 0; i < ph.size; i++) {
-    os->WRITE_PIXEL(ph.palette[i]);
+    PUT_PIXEL(out, ph.palette[i]);
   }
 
   if (useRle) {
 
     PIXEL_T* ptr = data;
-    PIXEL_T* end = ptr + w * h;
-    PIXEL_T* runStart;
-    PIXEL_T pix;
-    while (ptr < end) {
-      runStart = ptr;
-      pix = *ptr++;
-      while (*ptr == pix && ptr < end)
-        ptr++;
-      int len = (int)(ptr - runStart);
-      if (len <= 2 && usePalette) {
-        int index = ph.lookup(pix);
-        if (len == 2)
-          os->writeU8(index);
-        os->writeU8(index);
-        continue;
-      }
+    for (int r = 0; r < nRuns; r++) {
+      int len = runLength[r];
       if (usePalette) {
-        int index = ph.lookup(pix);
-        os->writeU8(index | 128);
+        rdr::U8 index = runIndex[r];
+        if (len <= 2) {
+          if (len == 2)
+            *out++ = index;
+          *out++ = index;
+          continue;
+        }
+        *out++ = index | 128;
       } else {
-        os->WRITE_PIXEL(pix);
+        PUT_PIXEL(out, *ptr);
+        ptr += len;
       }
-      len -= 1;
-      while (len >= 255) {
-        os->writeU8(255);
-        len -= 255;
+      putRunLength(out, len);
+    }
+
+    // The runs after a palette overflow, which were only counted
+    if (!usePalette) {
+      while (ptr < end) {
+        PIXEL_T pix = *ptr;
+        int len = 1 + zrleRun(ptr + 1, (int)(end - ptr - 1), pix);
+        PUT_PIXEL(out, pix);
+        putRunLength(out, len);
+        ptr += len;
       }
-      os->writeU8(len);
     }
 
   } else {
@@ -293,33 +402,37 @@ void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os)
 
     if (usePalette) {
 
-      // packed pixels
+      // packed pixels, from the recorded runs
 
       assert (ph.size < 17);
 
       int bppp = bitsPerPackedPixel[ph.size-1];
 
-      PIXEL_T* ptr = data;
+      int r = 0;
+      int left = runLength[0];
+      U8 index = runIndex[0];
 
       for (int i = 0; i < h; i++) {
         U8 nbits = 0;
         U8 byte = 0;
 
-        PIXEL_T* eol = ptr + w;
-
-        while (ptr < eol) {
-          PIXEL_T pix = *ptr++;
-          U8 index = ph.lookup(pix);
+        for (int x = 0; x < w; x++) {
+          if (left == 0) {
+            r++;
+            left = runLength[r];
+            index = runIndex[r];
+          }
+          left--;
           byte = (byte << bppp) | index;
           nbits += bppp;
           if (nbits >= 8) {
-            os->writeU8(byte);
+            *out++ = byte;
             nbits = 0;
           }
         }
         if (nbits > 0) {
           byte <<= 8 - nbits;
-          os->writeU8(byte);
+          *out++ = byte;
         }
       }
     } else {
@@ -328,25 +441,34 @@ void ZRLE_ENCODE_TILE (PIXEL_T* data, int w, int h, rdr::OutStream* os)
 
 #if BPP!=8
       if( (zywrle_level>0)&& !(zywrle_level & 0x80) ){
+		  // the header goes first, the nested call reuses the buffer
+		  os->writeBytes(state->out, (int)(out - state->out));
 		  ZYWRLE_ANALYZE( data, data, w, h, w, zywrle_level, zywrleBuf );
 		  zywrle_level |= 0x80;
-		  ZRLE_ENCODE_TILE( data, w, h, os );
+		  ZRLE_ENCODE_TILE( data, w, h, os, state );
 		  zywrle_level &= 0x7F;
+		  return;
 	  }else
 #endif
 #ifdef CPIXEL
       for (PIXEL_T* ptr = data; ptr < data+w*h; ptr++) {
-        os->WRITE_PIXEL(*ptr);
+        PUT_PIXEL(out, *ptr);
       }
 #else
-      os->writeBytes(data, w*h*(BPPOUT/8));
+      {
+        os->writeBytes(state->out, (int)(out - state->out));
+        os->writeBytes(data, w*h*(BPPOUT/8));
+        return;
+      }
 #endif
     }
   }
+
+  os->writeBytes(state->out, (int)(out - state->out));
 }
 
 #undef PIXEL_T
-#undef WRITE_PIXEL
+#undef PUT_PIXEL
 #undef ZRLE_ENCODE
 #undef ZRLE_ENCODE_TILE
 #undef BPPOUT
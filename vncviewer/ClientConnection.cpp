@@ -56,6 +56,7 @@ extern "C" {
 
 #include <DSMPlugin/DSMPlugin.h> // sf@2002
 #include "common/win32_helpers.h"
+#include "common/ScopeGuard.h"
 #include "display.h"
 #include "Snapshot.h"
 #include <CommCtrl.h>
@@ -68,6 +69,8 @@ extern "C" {
 #pragma comment(lib, "imm32.lib")
 
 #define INITIALNETBUFSIZE 4096
+// Largest read ReadRectBytes() serves from the FdInStream window
+#define RECT_INPLACE_MAX 4096
 #ifdef _XZ
 #define MAX_ENCODINGS (LASTENCODING+67)
 #else
@@ -355,10 +358,14 @@ void ClientConnection::Init(VNCviewerApp *pApp)
 	m_netbufsize = 0;
 	m_zlibbuf = NULL;
 	m_zlibbufsize = 0;
+	m_jpegDecoder = NULL;
+	m_jpegPool = NULL;
+	m_jpegPoolChecked = false;
 	// adzm - 2010-07 - Fix clipboard hangs
 	m_hwndNextViewer = (HWND)INVALID_HANDLE_VALUE;
 	m_pApp = pApp;
 	m_dormant = 0;
+	m_updateRequestsPending = 0;
 	m_hBitmapDC = NULL;
 	//m_hBitmap = NULL;
 	m_hPalette = NULL;
@@ -418,6 +425,18 @@ void ClientConnection::Init(VNCviewerApp *pApp)
 	//adzm 2010-05-10
 	m_pIntegratedPluginInterface = NULL;
 
+	m_pRecordPlugin = NULL;
+	m_fRecordsIn = false;
+	m_fRecordsOut = false;
+	m_fServerReadsRecords = false;
+	m_pRecordOutBuf = NULL;
+	m_pRecordInBuf = NULL;
+	m_nRecordOutLen = 0;
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+	m_nRecordInBufSize = 0;
+	m_nRecordOutBufSize = 0;
+
 	// ZlibHex
 	ultraVncZRaw = new UltraVncZ();
 	ultraVncZEncoded = new UltraVncZ();
@@ -1660,6 +1679,7 @@ void ClientConnection::SetDSMPluginStuff()
 {
 	//adzm - 2009-06-21
 	if (m_pPluginInterface) {
+		ResetRecords();
 		delete m_pPluginInterface;
 		m_pPluginInterface = NULL;
 		//adzm 2010-05-10
@@ -4395,6 +4415,7 @@ void ClientConnection::SuspendThread()
 	}
 	m_fPluginStreamingIn = false;
 	m_fPluginStreamingOut = false;
+	ResetRecords();
 }
 void
 ClientConnection::CloseWindows()
@@ -4424,11 +4445,16 @@ ClientConnection::~ClientConnection()
 
 	//adzm - 2009-06-21
 	if (m_pPluginInterface) {
+		ResetRecords();
 		delete m_pPluginInterface;
 		m_pPluginInterface = NULL;
 		//adzm 2010-05-10
 		m_pIntegratedPluginInterface = NULL;
 	}
+	if (m_pRecordOutBuf)
+		delete [] m_pRecordOutBuf;
+	if (m_pRecordInBuf)
+		delete [] m_pRecordInBuf;
 
 	// Modif sf@2002 - DSMPlugin handling
 	if (m_pDSMPlugin != NULL)
@@ -4442,8 +4468,12 @@ ClientConnection::~ClientConnection()
 	if (xzis)
 		delete(xzis);
 #endif
-    if (fis)
+    if (fis) {
+		const rdr::FdInStream::Stats &stats = fis->getStats();
+		vnclog.Print(2, _T("Socket reads %I64u, %d bytes per read, %I64u vectored, largest %d, buffer %d, %I64u ms blocked\n"),
+			stats.reads, fis->bytesPerRead(), stats.vectored, stats.largestRead, fis->getBufSize(), stats.blockedUs / 1000);
       delete fis;
+	}
 
 	if (ultraVncZRaw)
 		delete ultraVncZRaw;
@@ -4456,6 +4486,10 @@ ClientConnection::~ClientConnection()
 	if (m_pXZNetRectBuf != NULL)
 		delete [] m_pXZNetRectBuf;
 #endif
+	if (m_jpegPool)
+		delete m_jpegPool;
+	if (m_jpegDecoder)
+		delete m_jpegDecoder;
 
 
 	if (m_sock != INVALID_SOCKET) {
@@ -4468,7 +4502,7 @@ ClientConnection::~ClientConnection()
 
 	if (m_desktopName != NULL) delete [] m_desktopName;
 	if (m_desktopName_viewonly != NULL) delete [] m_desktopName_viewonly;
-	delete [] m_netbuf;
+	BufferPool::Free(m_netbuf);
 
 	if (m_DIBbitsCache!=NULL) delete []m_DIBbitsCache;
 	m_DIBbitsCache=NULL;
@@ -4493,14 +4527,14 @@ ClientConnection::~ClientConnection()
 	if (m_membitmap != NULL) {DeleteObject(m_membitmap);m_membitmap = NULL;}
 //	if (flash) delete flash;
 	m_pApp->DeregisterConnection(this);
-	if (m_zipbuf!=NULL)
-		delete [] m_zipbuf;
-	if (m_filezipbuf!=NULL)
-		delete [] m_filezipbuf;
-	if (m_filechunkbuf!=NULL)
-		delete [] m_filechunkbuf;
-	if (m_zlibbuf!=NULL)
-		delete [] m_zlibbuf;
+	BufferPool::Free(m_zipbuf);
+	BufferPool::Free(m_filezipbuf);
+	BufferPool::Free(m_filechunkbuf);
+	BufferPool::Free(m_zlibbuf);
+	BufferPool::Stats poolstats;
+	BufferPool::GetStats(poolstats);
+	vnclog.Print(2, _T("buffer pool: %I64u requests %I64u hits %I64u heap allocs, peak %u KB\n"),
+		poolstats.requests, poolstats.hits, poolstats.heapAllocs, (unsigned int)(poolstats.peakBytes / 1024));
 	if (m_hwndTBwin!= 0)
 		DestroyWindow(m_hwndTBwin);
 	if (rcSource!=NULL)
@@ -5331,13 +5365,26 @@ void* ClientConnection::run_undetached(void* arg) {
 
 				// adzm 2010-09 - Notify streaming DSM plugin support
                 case rfbNotifyPluginStreaming:
-                    if (sz_rfbNotifyPluginStreamingMsg > 1)
                     {
                   	rfbNotifyPluginStreamingMsg nspm;
+					memset(&nspm, 0, sizeof(nspm));
+                    if (sz_rfbNotifyPluginStreamingMsg > 1)
+                    {
                 	ReadExact(((char *) &nspm)+m_nTO, sz_rfbNotifyPluginStreamingMsg-m_nTO);
                     }
 					m_fPluginStreamingIn = true;
-					PostMessage(m_hwndcn, WM_NOTIFYPLUGINSTREAMING, NULL, NULL);
+					CARD16 flags = Swap16IfLE(nspm.flags);
+					if (flags & rfbPluginStreamingRecordsSupported)
+						m_fServerReadsRecords = true;
+					if (flags & rfbPluginStreamingRecordsFollow)
+					{
+						// Second notify, the server switched its output to records
+						if (!SetRecordsIn())
+							throw WarningException(sz_L69);
+					}
+					else
+						PostMessage(m_hwndcn, WM_NOTIFYPLUGINSTREAMING, NULL, NULL);
+                    }
                     break;
 				default:
 						  vnclog.Print(3, _T("Unknown message type x%02x\n"), msgType );
@@ -5359,6 +5406,7 @@ void* ClientConnection::run_undetached(void* arg) {
 			// m_pFileTransfer->m_fFileTransferRunning = false;
 			// m_pTextChat->m_fTextChatRunning = false;
 			if (m_pPluginInterface) {
+				ResetRecords();
 				delete m_pPluginInterface;
 				m_pPluginInterface = NULL;
 				//adzm 2010-05-10
@@ -5457,6 +5505,7 @@ void ClientConnection::Internal_SendFramebufferUpdateRequest(int x, int y, int w
     fur.w = Swap16IfLE(w);
     fur.h = Swap16IfLE(h);
 	fps.update();
+	InterlockedIncrement(&m_updateRequestsPending);
     WriteExact_timeout((char *)&fur, sz_rfbFramebufferUpdateRequestMsg, rfbFramebufferUpdateRequest,5);
 }
 
@@ -5574,8 +5623,15 @@ void ClientConnection::Internal_SendAppropriateFramebufferUpdateRequest()
 	}
 	else
 	{
-		if (m_dormant!=1)
+		if (m_dormant!=1) {
+			// One request for the update just read, so a server that folds
+			// requests together never runs dry, then top up to the configured
+			// depth: the server sends the next update while this one is still
+			// on the wire, one round trip no longer caps the frame rate.
 			Internal_SendIncrementalFramebufferUpdateRequest();
+			for (LONG n = m_updateRequestsPending; n < m_opts.m_requestsInFlight; n++)
+				Internal_SendIncrementalFramebufferUpdateRequest();
+		}
 		if (m_dormant == 2) m_dormant = 1;
 	}
 }
@@ -5650,6 +5706,10 @@ inline void ClientConnection::ReadScreenUpdate()
 {
 	//adzm 2010-07-04
 	bool bSentUpdateRequest = false;
+	// This update answers one of the requests in flight
+	LONG pending = m_updateRequestsPending;
+	while (pending > 0 && InterlockedCompareExchange(&m_updateRequestsPending, pending - 1, pending) != pending)
+		pending = m_updateRequestsPending;
 	if (m_opts.m_preemptiveUpdates && !m_pendingFormatChange) {
 		bSentUpdateRequest = true;
 		//PostMessage(m_hwndcn, WM_REGIONUPDATED, NULL, NULL);
@@ -5671,6 +5731,8 @@ inline void ClientConnection::ReadScreenUpdate()
     //if (sut.nRects == 0) return;  XXX tjr removed this - is this OK?
 
 	bool bNeedVnc4Fix = false;
+	// No JPEG rect may still be decoding when the update is left
+	ON_BLOCK_EXIT_OBJ(*this, &ClientConnection::FlushJpegJobs);
 	for (UINT iCurrentRect=0; iCurrentRect < sut.nRects; iCurrentRect++)
 	{
 		rfbFramebufferUpdateRectHeader surh;
@@ -5681,6 +5743,10 @@ inline void ClientConnection::ReadScreenUpdate()
 		surh.r.h = Swap16IfLE(surh.r.h);
 		surh.encoding = Swap32IfLE(surh.encoding);
 
+		// Only Tight rects go on while JPEG rects decode on the pool
+		if (surh.encoding != rfbEncodingTight && surh.encoding != rfbEncodingTightZstd && FlushJpegJobs())
+			SoftCursorUnlockScreen();
+
 #if 1
 		/* vnc4server in debian jessie and wheezy offers pixel format bgr101111
 			if the color depth is 32. This means it is necessary to send whole
@@ -6105,9 +6171,14 @@ inline void ClientConnection::ReadScreenUpdate()
 			ReleaseDC(m_TrafficMonitor,hdcX);
 		}
 
-		SoftCursorUnlockScreen();
+		// The cursor stays hidden over JPEG rects that are still decoding
+		if (m_jpegPool == NULL || !m_jpegPool->Pending())
+			SoftCursorUnlockScreen();
 	}
 
+	if (FlushJpegJobs())
+		SoftCursorUnlockScreen();
+
 	if (m_opts.m_Directx)
 	{
 		InvalidateRect(m_hwndcn, NULL, TRUE);
@@ -6428,7 +6499,11 @@ void ClientConnection::ReadExact(char *inbuf, int wanted)
 		// sf@2002 - DSM Plugin
 		if (m_fUsePlugin)
 		{
-			if (m_pDSMPlugin->IsEnabled())
+			if (m_pDSMPlugin->IsEnabled() && m_fRecordsIn)
+			{
+				ReadRecordData(inbuf, wanted);
+			}
+			else if (m_pDSMPlugin->IsEnabled())
 			{
 				//omni_mutex_lock l(m_pDSMPlugin->m_RestMutex);
 				//adzm - 2009-06-21
@@ -6495,6 +6570,197 @@ void ClientConnection::ReadExact(char *inbuf, int wanted)
 	}
 }
 
+// Used by the Hextile, RRE and CoRRE decoders, which read many tiny fields.
+// Instead of a ReadExact() (and a plugin restore) per field, the data is
+// parsed where it already is: the restored DSM rect buffer, the opened
+// DSM record, or the FdInStream window. A streaming plugin restores data
+// per read, so there the bytes still go through ReadExact().
+const CARD8 *ClientConnection::ReadRectBytes(int bytes)
+{
+	if (bytes <= 0)
+		return (CARD8 *)m_netbuf;
+
+	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
+	{
+		if (m_fRecordsIn && m_nRecordInEnd - m_nRecordInPos >= bytes)
+		{
+			// Within the current record
+			const CARD8 *p = m_pRecordInBuf + m_nRecordInPos;
+			m_nRecordInPos += bytes;
+			return p;
+		}
+		omni_mutex_conditional_lock l(m_pDSMPlugin->m_RestMutex, m_pPluginInterface ? false : true);
+		if (m_fReadFromNetRectBuf)
+		{
+			if (m_nNetRectBufOffset + bytes > (int)m_nReadSize)
+				throw ErrorException(sz_L69);
+			const CARD8 *p = (const CARD8 *)m_pNetRectBuf + m_nNetRectBufOffset;
+			m_nNetRectBufOffset += bytes;
+			if (m_nNetRectBufOffset == m_nReadSize)
+			{
+				// Next ReadExact calls should read the socket
+				m_fReadFromNetRectBuf = false;
+				m_nNetRectBufOffset = 0;
+			}
+			return p;
+		}
+	}
+	else if (bytes <= RECT_INPLACE_MAX)
+	{
+		try
+		{
+			fis->check(bytes);
+			const CARD8 *p = fis->getptr();
+			fis->setptr(p + bytes);
+			return p;
+		}
+		catch (rdr::Exception& e)
+		{
+			vnclog.Print(0, "rdr::Exception (2): %s\n",e.str());
+			if (m_hwndStatus)SetDlgItemText(m_hwndStatus,IDC_STATUS,sz_L67);
+			throw ErrorException(sz_L69);
+		}
+	}
+
+	CheckBufferSize(bytes);
+	ReadExact(m_netbuf, bytes);
+	return (const CARD8 *)m_netbuf;
+}
+
+//
+// Record framed streaming
+//
+// Once switched, a direction carries only records of the plugin's record
+// layer, sealed and opened in place in two buffers allocated once per
+// connection. The per call TransformBuffer/RestoreBuffer are not used.
+//
+bool ClientConnection::SupportsRecords()
+{
+	return m_fUsePlugin && m_pIntegratedPluginInterface != NULL && m_pDSMPlugin->SupportsRecords();
+}
+
+void ClientConnection::ResetRecords()
+{
+	m_pRecordPlugin = NULL;
+	m_fRecordsIn = false;
+	m_fRecordsOut = false;
+	m_fServerReadsRecords = false;
+	m_nRecordOutLen = 0;
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+}
+
+bool ClientConnection::SetRecordsIn()
+{
+	if (!SupportsRecords())
+		return false;
+	if (m_pRecordPlugin == NULL)
+		m_pRecordPlugin = m_pDSMPlugin->GetRecordPluginInterface(m_pIntegratedPluginInterface);
+	if (m_pRecordPlugin == NULL)
+		return false;
+	int nSize = m_pRecordPlugin->GetRecordHeaderSize() + m_pRecordPlugin->GetMaxRecordPayload() + m_pRecordPlugin->GetRecordTrailerSize();
+	// Kept for the connection, grown if a record layer needs more
+	if (m_nRecordInBufSize < nSize) {
+		delete [] m_pRecordInBuf;
+		m_pRecordInBuf = new BYTE[nSize];
+		m_nRecordInBufSize = nSize;
+	}
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+	m_fRecordsIn = true;
+	vnclog.Print(1, _T("DSMPlugin: incoming data is record framed\n"));
+	return true;
+}
+
+bool ClientConnection::SetRecordsOut()
+{
+	if (!SupportsRecords())
+		return false;
+	if (m_pRecordPlugin == NULL)
+		m_pRecordPlugin = m_pDSMPlugin->GetRecordPluginInterface(m_pIntegratedPluginInterface);
+	if (m_pRecordPlugin == NULL)
+		return false;
+	int nSize = m_pRecordPlugin->GetRecordHeaderSize() + m_pRecordPlugin->GetMaxRecordPayload() + m_pRecordPlugin->GetRecordTrailerSize();
+	if (m_nRecordOutBufSize < nSize) {
+		delete [] m_pRecordOutBuf;
+		m_pRecordOutBuf = new BYTE[nSize];
+		m_nRecordOutBufSize = nSize;
+	}
+	m_nRecordOutLen = 0;
+	m_fRecordsOut = true;
+	vnclog.Print(1, _T("DSMPlugin: outgoing data is record framed\n"));
+	return true;
+}
+
+// Called with m_writeMutex held
+bool ClientConnection::WriteRecordData(char *buf, int bytes, bool bQueue, bool bTimeout, int timeout)
+{
+	BYTE* pPayload = m_pRecordOutBuf + m_pRecordPlugin->GetRecordHeaderSize();
+	int nMax = m_pRecordPlugin->GetMaxRecordPayload();
+
+	while (bytes > 0)
+	{
+		int n = nMax - m_nRecordOutLen;
+		if (n > bytes) n = bytes;
+		memcpy(pPayload + m_nRecordOutLen, buf, n);
+		m_nRecordOutLen += n;
+		buf += n;
+		bytes -= n;
+		if (m_nRecordOutLen == nMax && !FlushRecord(true, bTimeout, timeout))
+			return false;
+	}
+	if (!bQueue)
+		return FlushRecord(false, bTimeout, timeout);
+	return true;
+}
+
+bool ClientConnection::FlushRecord(bool bQueue, bool bTimeout, int timeout)
+{
+	if (m_nRecordOutLen == 0)
+		return bQueue ? true : Write(NULL, 0, false, bTimeout, timeout);
+
+	int nRecordLen = m_pRecordPlugin->SealRecord(m_pRecordOutBuf, m_nRecordOutLen);
+	m_nRecordOutLen = 0;
+	if (nRecordLen <= 0)
+		throw WarningException(sz_L68);
+	return Write((char*)m_pRecordOutBuf, nRecordLen, bQueue, bTimeout, timeout);
+}
+
+void ClientConnection::ReadRecordData(char *buf, int bytes)
+{
+	while (bytes > 0)
+	{
+		if (m_nRecordInPos == m_nRecordInEnd)
+		{
+			// Next record: the header tells how much follows
+			int nHeader = m_pRecordPlugin->GetRecordHeaderSize();
+			fis->readBytes(m_pRecordInBuf, nHeader);
+			int nRecordLen = m_pRecordPlugin->GetRecordLength(m_pRecordInBuf);
+			if (nRecordLen < nHeader || nRecordLen > m_nRecordInBufSize)
+			{
+				vnclog.Print(0, _T("DSMPlugin: invalid record length\n"));
+				throw WarningException(sz_L66);
+			}
+			fis->readBytes(m_pRecordInBuf + nHeader, nRecordLen - nHeader);
+			int nDataLen = m_pRecordPlugin->OpenRecord(m_pRecordInBuf, nRecordLen);
+			if (nDataLen < 0)
+			{
+				vnclog.Print(0, _T("DSMPlugin: OpenRecord failed\n"));
+				throw WarningException(sz_L66);
+			}
+			m_nRecordInPos = nHeader;
+			m_nRecordInEnd = nHeader + nDataLen;
+			continue;
+		}
+		int n = m_nRecordInEnd - m_nRecordInPos;
+		if (n > bytes) n = bytes;
+		memcpy(buf, m_pRecordInBuf + m_nRecordInPos, n);
+		m_nRecordInPos += n;
+		buf += n;
+		bytes -= n;
+	}
+}
+
 //adzm 2009-06-21
 void ClientConnection::ReadExactProtocolVersion(char *inbuf, int wanted, bool& fNotEncrypted)
 {
@@ -6869,6 +7135,10 @@ bool ClientConnection::FlushOutstandingWriteQueue(char*& buf2, int& bytes2, bool
 
 bool ClientConnection::FlushWriteQueue(bool bTimeout, int timeout)
 {
+	if (m_fRecordsOut) {
+		omni_mutex_lock l(m_writeMutex);
+		if (!FlushRecord(true, bTimeout, timeout)) return false;
+	}
 	return Write(NULL, 0, false, bTimeout, timeout);
 }
 
@@ -6880,6 +7150,9 @@ bool ClientConnection::WriteTransformed(char *buf, int bytes, bool bQueue)
 	omni_mutex_lock l(m_writeMutex);
 	//vnclog.Print(10, _T("  writing %d bytes\n"), bytes);
 
+	if (m_fRecordsOut)
+		return WriteRecordData(buf, bytes, bQueue, false, 0);
+
 	// sf@2002 - DSM Plugin
 	char *pBuffer = buf;
 	if (m_fUsePlugin)
@@ -6942,6 +7215,11 @@ void ClientConnection::WriteTransformed_timeout(char *buf, int bytes,int timeout
 	omni_mutex_lock l(m_writeMutex);
 	//vnclog.Print(10, _T("  writing %d bytes\n"), bytes);
 
+	if (m_fRecordsOut) {
+		WriteRecordData(buf, bytes, bQueue, true, timeout);
+		return;
+	}
+
 	// sf@2002 - DSM Plugin
 	char *pBuffer = buf;
 	if (m_fUsePlugin)
@@ -6996,17 +7274,19 @@ void ClientConnection::CheckBufferSize(UINT bufsize)
 
 	omni_mutex_lock l(m_bufferMutex);
 
-	char *newbuf = new char[bufsize+256];
+	// The pool rounds up to its size classes, so a slowly growing
+	// rect size does not reallocate every time
+	size_t capacity;
+	char *newbuf = (char *)BufferPool::Alloc(bufsize+256, &capacity);
 	if (newbuf == NULL) {
 		throw ErrorException(sz_L70);
 	}
 
 	// Only if we're successful...
 
-	if (m_netbuf != NULL)
-		delete [] m_netbuf;
+	BufferPool::Free(m_netbuf);
 	m_netbuf = newbuf;
-	m_netbufsize=bufsize + 256;
+	m_netbufsize = (UINT)capacity;
 	vnclog.Print(4, _T("bufsize expanded to %d\n"), m_netbufsize);
 }
 
@@ -7028,17 +7308,17 @@ void ClientConnection::CheckZipBufferSize(int bufsize)
 
 	omni_mutex_lock l(m_ZipBufferMutex);
 
-	newbuf = (unsigned char *)new char[bufsize + 256];
+	size_t capacity;
+	newbuf = BufferPool::Alloc(bufsize + 256, &capacity);
 	if (newbuf == NULL) {
 		throw ErrorException(sz_L71);
 	}
 
 	// Only if we're successful...
 
-	if (m_zipbuf != NULL)
-		delete [] m_zipbuf;
+	BufferPool::Free(m_zipbuf);
 	m_zipbuf = newbuf;
-	m_zipbufsize = bufsize + 256;
+	m_zipbufsize = (int)capacity;
 	vnclog.Print(4, _T("zipbufsize expanded to %d\n"), m_zipbufsize);
 }
 
@@ -7056,17 +7336,17 @@ void ClientConnection::CheckFileZipBufferSize(int bufsize)
 
 	omni_mutex_lock l(m_FileZipBufferMutex);
 
-	newbuf = (unsigned char *)new char[bufsize + 256];
+	size_t capacity;
+	newbuf = BufferPool::Alloc(bufsize + 256, &capacity);
 	if (newbuf == NULL) {
 		throw ErrorException(sz_L71);
 	}
 
 	// Only if we're successful...
 
-	if (m_filezipbuf != NULL)
-		delete [] m_filezipbuf;
+	BufferPool::Free(m_filezipbuf);
 	m_filezipbuf = newbuf;
-	m_filezipbufsize = bufsize + 256;
+	m_filezipbufsize = (int)capacity;
 	vnclog.Print(4, _T("zipbufsize expanded to %d\n"), m_filezipbufsize);
 }
 
@@ -7084,15 +7364,15 @@ void ClientConnection::CheckFileChunkBufferSize(UINT bufsize)
 
 	omni_mutex_lock l(m_FileChunkBufferMutex);
 
-	newbuf = (unsigned char *)new char[bufsize + 256];
+	size_t capacity;
+	newbuf = BufferPool::Alloc(bufsize + 256, &capacity);
 	if (newbuf == NULL) {
 		throw ErrorException(sz_L71);
 	}
 
-	if (m_filechunkbuf != NULL)
-		delete [] m_filechunkbuf;
+	BufferPool::Free(m_filechunkbuf);
 	m_filechunkbuf = newbuf;
-	m_filechunkbufsize = bufsize + 256;
+	m_filechunkbufsize = (UINT)capacity;
 	vnclog.Print(4, _T("m_filechunkbufsize expanded to %d\n"), m_filechunkbufsize);
 }
 
@@ -9704,9 +9984,30 @@ void ClientConnection::NotifyPluginStreamingSupport()
     memset(&msg, 0, sizeof(rfbNotifyPluginStreamingMsg));
 	msg.type = rfbNotifyPluginStreaming;
 
-	//adzm 2010-09 - minimize packets. SendExact flushes the queue.
-	WriteExact((char *)&msg, sz_rfbNotifyPluginStreamingMsg, rfbNotifyPluginStreaming);
-	m_fPluginStreamingOut = true;
+	// When both ends have a record layer, our output switches to records
+	// right after this message, nothing may be written in between
+	bool fRecords = m_fServerReadsRecords && SupportsRecords();
+	CARD16 flags = 0;
+	if (SupportsRecords())
+		flags |= rfbPluginStreamingRecordsSupported;
+	if (fRecords)
+		flags |= rfbPluginStreamingRecordsFollow;
+	msg.flags = Swap16IfLE(flags);
+
+	EnterCriticalSection(&crit);
+	try {
+		omni_mutex_lock l(m_writeMutex);
+		//adzm 2010-09 - minimize packets. SendExact flushes the queue.
+		WriteExact((char *)&msg, sz_rfbNotifyPluginStreamingMsg, rfbNotifyPluginStreaming);
+		m_fPluginStreamingOut = true;
+		if (fRecords)
+			SetRecordsOut();
+	}
+	catch (...) {
+		LeaveCriticalSection(&crit);
+		throw;
+	}
+	LeaveCriticalSection(&crit);
 }
 
 static HWND hList=NULL;  // List View identifier
@@ -36,6 +36,8 @@
 #include "KeyMapjap.h"
 #include <rdr/types.h>
 #include "../common/UltraVncZ.h"
+#include "../common/BufferPool.h"
+#include "../common/JpegDecoder.h"
 #ifdef _INTERNALLIB
 #include <zlib.h>
 #include <zstd.h>
@@ -326,7 +328,6 @@ private:
 	void ReadRawRect(rfbFramebufferUpdateRectHeader *pfburh);
 	void ReadUltraRect(rfbFramebufferUpdateRectHeader *pfburh);
 	void ReadUltra2Rect(rfbFramebufferUpdateRectHeader *pfburh);
-	void DecompressJpegRect(BYTE *src, int srclen, BYTE *dst, int dst_size,int w, int h,rfbPixelFormat m_remoteformat);
 	void ReadUltraZip(rfbFramebufferUpdateRectHeader *pfburh,HRGN *prgn);
 	void ReadCopyRect(rfbFramebufferUpdateRectHeader *pfburh);
     void ReadRRERect(rfbFramebufferUpdateRectHeader *pfburh);
@@ -383,6 +384,10 @@ private:
 	void FilterGradient32 (int numRows);
 	void FilterPalette (int numRows);
 	void DecompressJpegRect(int x, int y, int w, int h);
+	// Decoders for the Tight and Ultra2 JPEG rects, created on first use
+	JpegDecoder *GetJpegDecoder();
+	BYTE *JpegRectDestination(int x, int y, int w, int h, int &stride);
+	bool FlushJpegJobs();
 
 	// Tight ClientConnectionCursor.cpp
 	bool prevCursorSet;
@@ -610,6 +615,28 @@ private:
 	BYTE* RestoreBufferStep1(BYTE* pDataBuffer, int nDataLen, int* nRestoredDataLen);
 	BYTE* RestoreBufferStep2(BYTE* pDataBuffer, int nDataLen, int* nRestoredDataLen);
 
+	// Record framed streaming, see IRecordPlugin. Outgoing data is
+	// collected in m_pRecordOutBuf and sealed in place, incoming records
+	// are opened in place in m_pRecordInBuf.
+	IRecordPlugin* m_pRecordPlugin;
+	bool m_fRecordsIn;
+	bool m_fRecordsOut;
+	bool m_fServerReadsRecords;
+	BYTE* m_pRecordOutBuf;
+	int m_nRecordOutLen;
+	BYTE* m_pRecordInBuf;
+	int m_nRecordInPos;
+	int m_nRecordInEnd;
+	int m_nRecordInBufSize;
+	int m_nRecordOutBufSize;
+	bool SupportsRecords();
+	bool SetRecordsIn();
+	bool SetRecordsOut();
+	void ResetRecords();
+	bool WriteRecordData(char *buf, int bytes, bool bQueue, bool bTimeout, int timeout);
+	bool FlushRecord(bool bQueue, bool bTimeout, int timeout);
+	void ReadRecordData(char *buf, int bytes);
+
 	BYTE* m_pNetRectBuf;
 	bool m_fReadFromNetRectBuf;  // 
 	int m_nNetRectBufOffset;
@@ -683,6 +710,9 @@ private:
 	// while dormant.
 	void SetDormant(int newstate);
 	int m_dormant;
+	// Update requests sent but not answered yet, as far as this side
+	// can tell. The server may fold several into one update.
+	volatile LONG m_updateRequestsPending;
 	void processIdleTimer(HWND hwnd);
 
 	// The number of bytes required to hold at least one pixel.
@@ -750,22 +780,22 @@ private:
 	void zrleDecode(int x, int y, int w, int h, bool use_zstd);
 	template <class myInStream>
 	void zrleDecode8NE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U8* buf);
+		myInStream* zis, rdr::U8* buf, rdr::U8* fb, int fbStride);
 	template <class myInStream>
 	void zrleDecode15LE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U16* buf);
+		myInStream* zis, rdr::U16* buf, rdr::U16* fb, int fbStride);
 	template <class myInStream>
 	void zrleDecode16LE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U16* buf);
+		myInStream* zis, rdr::U16* buf, rdr::U16* fb, int fbStride);
 	template <class myInStream>
 	void zrleDecode24ALE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U32* buf);
+		myInStream* zis, rdr::U32* buf, rdr::U32* fb, int fbStride);
 	template <class myInStream>
 	void zrleDecode24BLE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U32* buf);
+		myInStream* zis, rdr::U32* buf, rdr::U32* fb, int fbStride);
 	template <class myInStream>
 	void zrleDecode32LE(int x, int y, int w, int h, rdr::InStream* is,
-		myInStream* zis, rdr::U32* buf);
+		myInStream* zis, rdr::U32* buf, rdr::U32* fb, int fbStride);
 	long zywrle;
 	long zywrle_level;
 	int zywrleBuf[rfbZRLETileWidth*rfbZRLETileHeight];
@@ -827,7 +857,10 @@ private:
 	bool directx_used;
 
 
-	jpeg_source_mgr m_jpegSrcManager;
+	JpegDecoder *m_jpegDecoder;
+	JpegDecodePool *m_jpegPool;
+	bool m_jpegPoolChecked;
+	JpegPixelFormat m_jpegFormat;
 	bool desktopsize_requested;
 	int ShowToolbar;
 	bool ExtDesktop;
@@ -853,6 +886,11 @@ public:
 	HWND m_hwndMain;
 	HANDLE rcth;
 	void ReadExact(char *buf, int bytes);
+	// Next bytes of rect data, in place when already buffered.
+	// Only valid until the next read.
+	const CARD8 *ReadRectBytes(int bytes);
+	// RRE/CoRRE subrects parsed per ReadRectBytes() call
+	enum { RRE_SUBRECT_CHUNK = 256 };
 	bool new_ultra_server;
 	void Save_Latest_Connection();	
 	bool tbWM_Set;
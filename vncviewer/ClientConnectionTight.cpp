@@ -51,6 +51,11 @@ void ClientConnection::ReadTightRect(rfbFramebufferUpdateRectHeader *pfburh, boo
     comp_ctl >>= 1;
   }
 
+  /* Rects drawn on this thread must not race a JPEG rect still decoding. */
+  if (comp_ctl != rfbTightJpeg && m_jpegPool &&
+      m_jpegPool->Overlaps(pfburh->r.x, pfburh->r.y, pfburh->r.w, pfburh->r.h))
+    FlushJpegJobs();
+
   /* Handle solid rectangles. */
   BYTE colorpointer[4];
   if (comp_ctl == rfbTightFill) {
@@ -473,147 +478,89 @@ void ClientConnection::FilterPalette (int numRows)
 // JPEG decompression code.
 //
 
-static bool jpegError;
-//
-// A "Source manager" for the JPEG library.
-//
-
-static struct jpeg_source_mgr jpegSrcManager;
-static JOCTET *jpegBufferPtr;
-static size_t jpegBufferLen;
-
-static void JpegInitSource(j_decompress_ptr cinfo);
-static boolean JpegFillInputBuffer(j_decompress_ptr cinfo);
-static void JpegSkipInputData(j_decompress_ptr cinfo, long num_bytes);
-static void JpegTermSource(j_decompress_ptr cinfo);
-
-static void
-JpegInitSource(j_decompress_ptr cinfo)
+JpegDecoder *ClientConnection::GetJpegDecoder()
 {
-	jpegError = false;
+  if (m_jpegDecoder == NULL)
+    m_jpegDecoder = new JpegDecoder;
+  return m_jpegDecoder;
 }
 
-static boolean
-JpegFillInputBuffer(j_decompress_ptr cinfo)
+// Where a JPEG rect goes in the DIB, NULL if it does not fit
+BYTE *ClientConnection::JpegRectDestination(int x, int y, int w, int h, int &stride)
 {
-	jpegError = true;
-	jpegSrcManager.bytes_in_buffer = jpegBufferLen;
-	jpegSrcManager.next_input_byte = (JOCTET *)jpegBufferPtr;
-
-	return TRUE;
+  if (!m_DIBbits || x < 0 || y < 0 || w <= 0 || h <= 0 ||
+      x + w > m_si.framebufferWidth || y + h > m_si.framebufferHeight)
+    return NULL;
+
+  int bytesPerPixel = m_myFormat.bitsPerPixel / 8;
+  stride = m_si.framebufferWidth * bytesPerPixel;
+  //8bit pitch need to be taken in account
+  if (stride % 4)
+    stride += 4 - stride % 4;
+  return (BYTE *)m_DIBbits + (size_t)y * stride + x * bytesPerPixel;
 }
 
-static void
-JpegSkipInputData(j_decompress_ptr cinfo, long num_bytes)
+// Waits for the JPEG rects still decoding on the pool and draws
+// them, true if there were any
+bool ClientConnection::FlushJpegJobs()
 {
-	if (num_bytes < 0 || (size_t)num_bytes > jpegSrcManager.bytes_in_buffer) {
-		jpegError = true;
-		jpegSrcManager.bytes_in_buffer = jpegBufferLen;
-		jpegSrcManager.next_input_byte = (JOCTET *)jpegBufferPtr;
-	}
-	else {
-		jpegSrcManager.next_input_byte += (size_t)num_bytes;
-		jpegSrcManager.bytes_in_buffer -= (size_t)num_bytes;
-	}
-}
-
-static void
-JpegTermSource(j_decompress_ptr cinfo)
-{
-	/* No work necessary here. */
+  if (m_jpegPool == NULL || !m_jpegPool->Pending())
+    return false;
+  int failed = m_jpegPool->Wait();
+  {
+    omni_mutex_lock l(m_bitmapdcMutex);
+    m_jpegPool->Draw();
+  }
+  if (failed > 0)
+    vnclog.Print(0, _T("Tight Encoding: Wrong JPEG data received.\n"));
+  return true;
 }
 
-/*static void
-JpegSetSrcManager(j_decompress_ptr cinfo, char *compressedData, int compressedLen)
-{
-jpegBufferPtr = (JOCTET *)compressedData;
-jpegBufferLen = (size_t)compressedLen;
-
-jpegSrcManager.init_source = JpegInitSource;
-jpegSrcManager.fill_input_buffer = JpegFillInputBuffer;
-jpegSrcManager.skip_input_data = JpegSkipInputData;
-jpegSrcManager.resync_to_restart = jpeg_resync_to_restart;
-jpegSrcManager.term_source = JpegTermSource;
-jpegSrcManager.next_input_byte = jpegBufferPtr;
-jpegSrcManager.bytes_in_buffer = jpegBufferLen;
-
-cinfo->src = &jpegSrcManager;
-}*/
-
-
-/*static void JpegSetSrcManager(j_decompress_ptr cinfo, char *compressedData,
-							  int compressedLen);*/
-
 void ClientConnection::DecompressJpegRect(int x, int y, int w, int h)
 {
-  struct jpeg_decompress_struct cinfo;
-  struct jpeg_error_mgr jerr;
-
   int compressedLen = (int)ReadCompactLen();
   if (compressedLen <= 0) {
     vnclog.Print(0, _T("Incorrect data received from the server.\n"));
     return;
   }
 
-  CheckBufferSize(compressedLen);
-  ReadExact(m_netbuf, compressedLen);
-
-  cinfo.err = jpeg_std_error(&jerr);
-  jpeg_create_decompress(&cinfo);
-
-  //JpegSetSrcManager(&cinfo, m_netbuf, compressedLen);
-
-  jpegBufferPtr = (JOCTET *)m_netbuf;
-  jpegBufferLen = (size_t)compressedLen;
-
-  m_jpegSrcManager.init_source = JpegInitSource;
-  m_jpegSrcManager.fill_input_buffer = JpegFillInputBuffer;
-  m_jpegSrcManager.skip_input_data = JpegSkipInputData;
-  m_jpegSrcManager.resync_to_restart = jpeg_resync_to_restart;
-  m_jpegSrcManager.term_source = JpegTermSource;
-  m_jpegSrcManager.next_input_byte = jpegBufferPtr;
-  m_jpegSrcManager.bytes_in_buffer = jpegBufferLen;
-
-  cinfo.src = &m_jpegSrcManager;
-
-  jpeg_read_header(&cinfo, TRUE);
-  cinfo.out_color_space = JCS_RGB;
-
-  jpeg_start_decompress(&cinfo);
-  if ((int)cinfo.output_width != w || (int)cinfo.output_height != h ||
-      cinfo.output_components != 3) {
-    vnclog.Print(0, _T("Tight Encoding: Wrong JPEG data received.\n"));
-    jpeg_destroy_decompress(&cinfo);
-    return;
+  if (!m_jpegPoolChecked) {
+    m_jpegPool = JpegDecodePool::Create();
+    m_jpegPoolChecked = true;
+  }
+  // The format only changes between updates, after the pool is flushed
+  if (m_jpegPool == NULL || !m_jpegPool->Pending()) {
+    m_jpegFormat.Set(m_myFormat.bitsPerPixel,
+                     m_myFormat.redMax, m_myFormat.greenMax, m_myFormat.blueMax,
+                     m_myFormat.redShift, m_myFormat.greenShift, m_myFormat.blueShift);
+    if (m_jpegPool)
+      m_jpegPool->SetFormat(m_jpegFormat);
   }
 
-  omni_mutex_lock l(m_bitmapdcMutex);
-
-  // Two scanlines: for 24bit and COLORREF samples
-  // adzm 2010-08 - Increase zlib buffer size (from TightVNC)
-  const int maxRowWidth = 8192;
-  CheckZlibBufferSize(2*maxRowWidth*4);
-
-  JSAMPROW rowPointer[1];
-  rowPointer[0] = (JSAMPROW)m_zlibbuf;
-
-  COLORREF *pixelPtr;
-  for (int dy = 0; cinfo.output_scanline < cinfo.output_height; dy++) {
-    jpeg_read_scanlines(&cinfo, rowPointer, 1);
-    if (jpegError) {
-      break;
-    }
-    pixelPtr = (COLORREF *)&m_zlibbuf[maxRowWidth*4];
-    for (int dx = 0; dx < w; dx++) {
-      *pixelPtr++ = COLOR_FROM_PIXEL24_ADDRESS(&m_zlibbuf[dx*3]);
+  int stride = 0;
+  BYTE *dst = JpegRectDestination(x, y, w, h, stride);
+
+  // Decoded on the pool while the next rects are read. The cache
+  // and DirectX want the pixels of each rect before the next one.
+  if (dst != NULL && m_jpegPool && !m_opts.m_fEnableCache && !directx_used) {
+    if (m_jpegPool->Full() || m_jpegPool->Overlaps(x, y, w, h))
+      FlushJpegJobs();
+    BYTE *buf = m_jpegPool->Reserve(compressedLen);
+    if (buf != NULL) {
+      ReadExact((char *)buf, compressedLen);
+      m_jpegPool->Submit(compressedLen, w, h, dst, stride, x, y);
+      return;
     }
-    SETPIXELS_NOCONV(&m_zlibbuf[maxRowWidth*4], x, y + dy, w, 1);
   }
 
-  if (!jpegError)
-    jpeg_finish_decompress(&cinfo);
+  CheckBufferSize(compressedLen);
+  ReadExact(m_netbuf, compressedLen);
+  if (dst == NULL)
+    return;
 
-  jpeg_destroy_decompress(&cinfo);
+  omni_mutex_lock l(m_bitmapdcMutex);
+  if (!GetJpegDecoder()->Decode((BYTE *)m_netbuf, compressedLen, w, h, m_jpegFormat, dst, stride))
+    vnclog.Print(0, _T("Tight Encoding: Wrong JPEG data received.\n"));
 }
 
 
@@ -94,19 +94,19 @@ void ClientConnection::CheckZlibBufferSize(int bufsize)
 	omni_mutex_lock l(m_zlibBufferMutex);
 
 
-	newbuf = (unsigned char *)new char[bufsize+256];
-	ZeroMemory(newbuf, bufsize+256);
+	size_t capacity;
+	newbuf = BufferPool::Alloc(bufsize+256, &capacity);
 	
 	if (newbuf == NULL) {
 		throw ErrorException("Insufficient memory to allocate zlib buffer.");
 	}
+	ZeroMemory(newbuf, capacity);
 
 	// Only if we're successful...
 
-	if (m_zlibbuf != NULL)
-		delete [] m_zlibbuf;
+	BufferPool::Free(m_zlibbuf);
 	m_zlibbuf = newbuf;
-	m_zlibbufsize=bufsize + 256;
+	m_zlibbufsize = (int)capacity;
 	vnclog.Print(4, _T("zlibbufsize expanded to %d\n"), m_zlibbufsize);
 
 
@@ -117,6 +117,7 @@ SessionDialog::SessionDialog(VNCOptions* pOpt, ClientConnection* pCC, CDSMPlugin
 	JapKeyboard = m_pOpt->m_JapKeyboard;
 	quickoption = m_pOpt->m_quickoption;
 	preemptiveUpdates = m_pOpt->m_preemptiveUpdates;
+	requestsInFlight = m_pOpt->m_requestsInFlight;
 	FullScreen = m_pOpt->m_FullScreen;
 	Directx = m_pOpt->m_Directx;
 	SavePos = m_pOpt->m_SavePos;
@@ -645,6 +646,7 @@ bool SessionDialog::connect(HWND hwnd)
 	m_pOpt->m_JapKeyboard = JapKeyboard;
 	m_pOpt->m_quickoption = quickoption;
 	m_pOpt->m_preemptiveUpdates = preemptiveUpdates;
+	m_pOpt->m_requestsInFlight = requestsInFlight;
 	m_pOpt->m_FullScreen = FullScreen;
 	m_pOpt->m_Directx = Directx;
 	m_pOpt->m_SavePos = SavePos;
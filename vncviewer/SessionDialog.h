@@ -106,6 +106,7 @@ public:
 	bool Emul3Buttons; 
 	bool JapKeyboard;
 	bool preemptiveUpdates;
+	int  requestsInFlight;
 	bool FullScreen;
 	bool SavePos;
 	bool SaveSize;
@@ -1527,6 +1527,7 @@ void SessionDialog::StartListener()
 	m_pOpt->m_JapKeyboard = JapKeyboard;
 	m_pOpt->m_quickoption = quickoption;
 	m_pOpt->m_preemptiveUpdates = preemptiveUpdates;
+	m_pOpt->m_requestsInFlight = requestsInFlight;
 	m_pOpt->m_FullScreen = FullScreen;
 	m_pOpt->m_Directx = Directx;
 	m_pOpt->m_SavePos = SavePos;
@@ -237,6 +237,7 @@ VNCOptions::VNCOptions()
 	m_fAutoAcceptNoDSM = false;
 	m_fRequireEncryption = false;
 	m_preemptiveUpdates = false;
+	m_requestsInFlight = 1;
 	m_saved_scale_num = 100;
 	m_saved_scale_den = 100;
 	m_saved_scaling = false;
@@ -443,6 +444,7 @@ VNCOptions& VNCOptions::operator=(VNCOptions& s)
 
 	//adzm 2010-07-04
 	m_preemptiveUpdates = s.m_preemptiveUpdates;
+	m_requestsInFlight = s.m_requestsInFlight;
 
 	return *this;
 }
@@ -984,6 +986,19 @@ void VNCOptions::SetFromCommandLine(LPTSTR szCmdLine) {
 			//adzm 2010-07-04
 			m_preemptiveUpdates = true;
 		}
+		else if (SwitchMatch(args[j], _T("requestsinflight")))
+		{
+			if (++j == i) {
+				ArgError(sz_D22);
+				continue;
+			}
+			if (_stscanf_s(args[j], _T("%d"), &m_requestsInFlight) != 1) {
+				ArgError(sz_D23);
+				continue;
+			}
+			if (m_requestsInFlight < 1) m_requestsInFlight = 1;
+			if (m_requestsInFlight > MAX_REQUESTS_IN_FLIGHT) m_requestsInFlight = MAX_REQUESTS_IN_FLIGHT;
+		}
 		else if (SwitchMatch(args[j], _T("enablecache")))
 		{
 			//adzm 2010-08
@@ -1179,6 +1194,7 @@ void VNCOptions::Save(char* fname)
 
 	//adzm 2010-07-04
 	saveInt("PreemptiveUpdates", m_preemptiveUpdates, fname);
+	saveInt("RequestsInFlight", m_requestsInFlight, fname);
 }
 
 void VNCOptions::Load(char* fname)
@@ -1303,10 +1319,14 @@ void VNCOptions::Load(char* fname)
 
 	//adzm 2010-07-04
 	m_preemptiveUpdates = readInt("PreemptiveUpdates", (int)m_preemptiveUpdates, fname) ? true : false;
+
+	m_requestsInFlight = readInt("RequestsInFlight", m_requestsInFlight, fname);
+	if (m_requestsInFlight < 1) m_requestsInFlight = 1;
+	if (m_requestsInFlight > MAX_REQUESTS_IN_FLIGHT) m_requestsInFlight = MAX_REQUESTS_IN_FLIGHT;
 }
 
 void VNCOptions::ShowUsage(LPTSTR info) {
-	TCHAR msg[1024];
+	TCHAR msg[2048];
 	TCHAR* tmpinf = _T("");
 	if (info != NULL)
 		tmpinf = info;
@@ -1326,6 +1346,7 @@ void VNCOptions::ShowUsage(LPTSTR info) {
 			"      [/encodings xz zrle ...]  (in order of priority)\r\n"
 			"      [/autoacceptincoming] [/autoacceptnodsm] [/disablesponsor]\r\n" //adzm 2009-06-21, adzm 2009-07-19
 			"      [/requireencryption] [/enablecache] [/throttlemouse n] [/socketkeepalivetimeout n]\r\n" //adzm 2010-05-12
+			"      [/requestsinflight n]\r\n"
 			"For full details see documentation."),
 		tmpinf);
 	MessageBox(NULL, msg, sz_A2, MB_OK | MB_ICONINFORMATION | MB_TOPMOST);
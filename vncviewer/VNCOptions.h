@@ -37,6 +37,8 @@
 #define NOCURSOR 0
 #define DOTCURSOR 1
 #define NORMALCURSOR 2
+// Update requests the viewer keeps at the server
+#define MAX_REQUESTS_IN_FLIGHT 8
 
 class VNCOptions
 {
@@ -142,6 +144,7 @@ public:
 	bool m_fAutoAcceptNoDSM;
 	bool m_fRequireEncryption;
 	bool m_preemptiveUpdates;
+	int m_requestsInFlight;
 	void CheckProxyAndHost();
 #ifdef _Gii
 	bool m_giiEnable;
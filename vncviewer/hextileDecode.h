@@ -0,0 +1,125 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// hextileDecode.h: the Hextile decoder of ClientConnection.
+//
+// Included by ClientConnectionHextile.cpp, and by vncbench's
+// RectDecodeBench.cpp inside a namespace, with a ClientConnection there
+// that has what the decoder uses: m_myFormat, m_bitmapdcMutex,
+// ReadRectBytes(), FillSolidRect_ultra() and SETPIXELS.
+
+void ClientConnection::ReadHextileRect(rfbFramebufferUpdateRectHeader *pfburh)
+{
+	switch (m_myFormat.bitsPerPixel) {
+	case 8:
+		HandleHextileEncoding8(pfburh->r.x, pfburh->r.y, pfburh->r.w, pfburh->r.h);
+		break;
+	case 16:
+		HandleHextileEncoding16(pfburh->r.x, pfburh->r.y, pfburh->r.w, pfburh->r.h);
+		break;
+	case 32:
+		HandleHextileEncoding32(pfburh->r.x, pfburh->r.y, pfburh->r.w, pfburh->r.h);
+		break;
+	}
+}
+
+
+// The tiles are parsed straight from the input buffer (see ReadRectBytes),
+// and a tile with subrects is painted into a local 16x16 block that is
+// converted to the framebuffer once, instead of one fill per subrect.
+#define DEFINE_HEXTILE(bpp)                                                   \
+void ClientConnection::HandleHextileEncoding##bpp(int rx, int ry, int rw, int rh)                    \
+{                                                                             \
+    CARD##bpp bg = 0, fg = 0;                                                 \
+    CARD##bpp tile[16 * 16];                                                  \
+    int i, j, k;                                                              \
+    const CARD8 *ptr;                                                         \
+    int x, y, w, h;                                                           \
+    int sx, sy, sw, sh;                                                       \
+    CARD8 subencoding;                                                        \
+    CARD8 nSubrects;                                                          \
+                                                                              \
+    /* One lock for the whole rect, not one per row of tiles */               \
+    omni_mutex_lock l(m_bitmapdcMutex);                                       \
+    for (y = ry; y < ry+rh; y += 16) {                                        \
+        for (x = rx; x < rx+rw; x += 16) {                                    \
+            w = h = 16;                                                       \
+            if (rx+rw - x < 16)                                               \
+                w = rx+rw - x;                                                \
+            if (ry+rh - y < 16)                                               \
+                h = ry+rh - y;                                                \
+                                                                              \
+            subencoding = *ReadRectBytes(1);                                  \
+                                                                              \
+            if (subencoding & rfbHextileRaw) {                                \
+                ptr = ReadRectBytes(w * h * (bpp / 8));                       \
+                SETPIXELS(ptr, bpp, x,y,w,h)                                  \
+                continue;                                                     \
+            }                                                                 \
+                                                                              \
+            if (subencoding & rfbHextileBackgroundSpecified)                  \
+                memcpy(&bg, ReadRectBytes(bpp/8), bpp/8);                     \
+                                                                              \
+            if (subencoding & rfbHextileForegroundSpecified)                  \
+                memcpy(&fg, ReadRectBytes(bpp/8), bpp/8);                     \
+                                                                              \
+            if (!(subencoding & rfbHextileAnySubrects)) {                     \
+                FillSolidRect_ultra(x,y,w,h, m_myFormat.bitsPerPixel,(BYTE*)&bg);\
+                continue;                                                     \
+            }                                                                 \
+                                                                              \
+            nSubrects = *ReadRectBytes(1);                                    \
+            bool coloured = (subencoding & rfbHextileSubrectsColoured) != 0;  \
+            int subRectSize = coloured ? 2 + (bpp / 8) : 2;                   \
+            ptr = ReadRectBytes(nSubrects * subRectSize);                     \
+                                                                              \
+            for (i = 0; i < w * h; i++)                                       \
+                tile[i] = bg;                                                 \
+                                                                              \
+            for (i = 0; i < nSubrects; i++) {                                 \
+                if (coloured) {                                               \
+                    memcpy(&fg, ptr, bpp/8);                                  \
+                    ptr += (bpp/8);                                           \
+                }                                                             \
+                sx = *ptr >> 4;                                               \
+                sy = *ptr++ & 0x0f;                                           \
+                sw = (*ptr >> 4) + 1;                                         \
+                sh = (*ptr++ & 0x0f) + 1;                                     \
+                /* Clip, a broken server must not write outside the tile */   \
+                if (sx + sw > w) sw = w - sx;                                 \
+                if (sy + sh > h) sh = h - sy;                                 \
+                for (j = sy; j < sy + sh; j++) {                              \
+                    CARD##bpp *row = tile + j * w;                            \
+                    for (k = sx; k < sx + sw; k++)                            \
+                        row[k] = fg;                                          \
+                }                                                             \
+            }                                                                 \
+            SETPIXELS(tile, bpp, x,y,w,h)                                     \
+        }                                                                     \
+    }                                                                         \
+}
+
+DEFINE_HEXTILE(8)
+DEFINE_HEXTILE(16)
+DEFINE_HEXTILE(32)
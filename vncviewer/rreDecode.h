@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// rreDecode.h: the RRE decoder of ClientConnection.
+//
+// Included by ClientConnectionRRE.cpp, and by vncbench's RectDecodeBench.cpp
+// inside a namespace, see hextileDecode.h. Also uses m_minPixelBytes,
+// ErrorException and sz_L70.
+
+void ClientConnection::ReadRRERect(rfbFramebufferUpdateRectHeader *pfburh)
+{
+	// An RRE rect is always followed by a background color
+	// For speed's sake we read them together into a buffer.
+	char tmpbuf[sz_rfbRREHeader+4];			// biggest pixel is 4 bytes long
+    rfbRREHeader *prreh = (rfbRREHeader *) tmpbuf;
+	CARD8 *pcolor = (CARD8 *) tmpbuf + sz_rfbRREHeader;
+	memcpy(tmpbuf, ReadRectBytes(sz_rfbRREHeader + m_minPixelBytes), sz_rfbRREHeader + m_minPixelBytes);
+
+	prreh->nSubrects = Swap32IfLE(prreh->nSubrects);
+	
+	// No other threads can use bitmap DC
+	omni_mutex_lock l(m_bitmapdcMutex);
+		
+	// Draw the background of the rectangle
+	FillSolidRect_ultra(pfburh->r.x, pfburh->r.y, pfburh->r.w, pfburh->r.h, m_myFormat.bitsPerPixel,pcolor);
+	
+    if (prreh->nSubrects == 0) return;
+	if (prreh->nSubrects > 20000000) 
+		throw ErrorException(sz_L70);
+	
+	// Draw the sub-rectangles
+    rfbRectangle rect, *pRect;
+	// The size of an RRE subrect including color info
+	int subRectSize = m_minPixelBytes + sz_rfbRectangle;
+    
+	// Parse the subrects in place, a chunk at a time, instead of
+	// reading them all into m_netbuf first
+	CARD32 left = prreh->nSubrects;
+	while (left > 0) {
+		CARD32 n = left < RRE_SUBRECT_CHUNK ? left : RRE_SUBRECT_CHUNK;
+		BYTE *p = (BYTE *) ReadRectBytes(subRectSize * n);
+		for (CARD32 i = 0; i < n; i++) {
+			pRect = (rfbRectangle *) (p + m_minPixelBytes);
+
+			rect.x = (CARD16) (Swap16IfLE(pRect->x) + pfburh->r.x);
+			rect.y = (CARD16) (Swap16IfLE(pRect->y) + pfburh->r.y);
+			rect.w = Swap16IfLE(pRect->w);
+			rect.h = Swap16IfLE(pRect->h);
+
+			FillSolidRect_ultra(rect.x, rect.y, rect.w, rect.h, m_myFormat.bitsPerPixel,p);
+			p+=subRectSize;
+		}
+		left -= n;
+	}
+}
@@ -210,6 +210,7 @@ void SessionDialog::SaveToFile(char *fname, bool asDefault)
 	saveInt("nohotkeys",			NoHotKeys,		fname); //disable hotkeys
 	saveInt("sponsor",				g_disable_sponsor,	fname);
 	saveInt("PreemptiveUpdates",	preemptiveUpdates, fname);
+	saveInt("RequestsInFlight",		requestsInFlight, fname);
 }
 void SessionDialog::LoadFromFile(char *fname)
 {
@@ -296,6 +297,9 @@ void SessionDialog::LoadFromFile(char *fname)
   fAutoAcceptNoDSM = readInt("AutoAcceptNoDSM", (int)fAutoAcceptNoDSM, fname) ? true : false;
   fRequireEncryption = readInt("RequireEncryption", (int)fRequireEncryption, fname) ? true : false;
   preemptiveUpdates = readInt("PreemptiveUpdates", (int)preemptiveUpdates, fname) ? true : false;
+  requestsInFlight = readInt("RequestsInFlight", requestsInFlight, fname);
+  if (requestsInFlight < 1) requestsInFlight = 1;
+  if (requestsInFlight > MAX_REQUESTS_IN_FLIGHT) requestsInFlight = MAX_REQUESTS_IN_FLIGHT;
 
   GetPrivateProfileString("connection", "proxyhost", "", m_proxyhost, MAX_HOST_NAME_LEN, fname);
   m_proxyport = GetPrivateProfileInt("connection", "proxyport", 0, fname);
@@ -388,6 +392,7 @@ void SessionDialog::SetDefaults()
 	fAutoAcceptNoDSM = false;
 	fRequireEncryption = false;
 	preemptiveUpdates = false;
+	requestsInFlight = 1;
 	scale_num = 100;
 	scale_den = 100;
 	scaling = false; 
@@ -11,8 +11,6 @@
 
 // Instantiate the decoding function for 8, 16 and 32 BPP
 
-//#define FAVOUR_FILL_RECT
-
 #define zrleDecode ClientConnection::zrleDecode
 
 #define ENDIAN_LITTLE 0
@@ -22,21 +20,16 @@
 #define ZYWRLE_ENDIAN ENDIAN_NO
 #define IMAGE_RECT(x,y,w,h,data)                \
     SETPIXELS(m_netbuf,8,x,y,w,h)
-#define FILL_RECT(x,y,w,h,pix)                          \
-    FillSolidRect_ultra(x,y,w,h, m_myFormat.bitsPerPixel,(BYTE*)&pix)
 
 #include <rfb/zrleDecode.h>
 #undef BPP
 #undef ZYWRLE_ENDIAN
 #undef IMAGE_RECT
-#undef FILL_RECT
 
 #define BPP 16
 #define ZYWRLE_ENDIAN ENDIAN_LITTLE
 #define IMAGE_RECT(x,y,w,h,data)                \
     SETPIXELS(m_netbuf,16,x,y,w,h)
-#define FILL_RECT(x,y,w,h,pix)                          \
-    FillSolidRect_ultra(x,y,w,h, m_myFormat.bitsPerPixel,(BYTE*)&pix)
 
 #include <rfb/zrleDecode.h>
 #undef BPP
@@ -47,12 +40,9 @@
 #undef BPP
 #undef ZYWRLE_ENDIAN
 #undef IMAGE_RECT
-#undef FILL_RECT
 
 #define IMAGE_RECT(x,y,w,h,data)                \
     SETPIXELS(m_netbuf,32,x,y,w,h)
-#define FILL_RECT(x,y,w,h,pix)                          \
-    FillSolidRect_ultra(x,y,w,h, m_myFormat.bitsPerPixel,(BYTE*)&pix)
 
 
 #define BPP 32
@@ -67,7 +57,6 @@
 #undef BPP
 #undef ZYWRLE_ENDIAN
 #undef IMAGE_RECT
-#undef FILL_RECT
 
 #undef zrleDecode
 
@@ -75,6 +64,20 @@ void ClientConnection::zrleDecode(int x, int y, int w, int h, bool use_zstd)
 {
   try {
     CheckBufferSize(rfbZRLETileWidth * rfbZRLETileHeight * 4);
+
+    // The tiles are decoded in place when the rect lies in the DIB, which
+    // has the pixel format and scanline ConvertAll() writes with
+    rdr::U8* fb = NULL;
+    int fbStride = 0;
+    if (m_DIBbits && x >= 0 && y >= 0 &&
+        x + w <= m_si.framebufferWidth && y + h <= m_si.framebufferHeight) {
+      int bytesPerPixel = m_myFormat.bitsPerPixel / 8;
+      int bytesPerRow = m_si.framebufferWidth * bytesPerPixel;
+      if (bytesPerRow % 4)
+        bytesPerRow += 4 - bytesPerRow % 4;
+      fb = (rdr::U8*)m_DIBbits;
+      fbStride = bytesPerRow / bytesPerPixel;
+    }
     //omni_mutex_lock l(m_bitmapdcMutex);
 
 	if( zywrle ){
@@ -94,15 +97,15 @@ void ClientConnection::zrleDecode(int x, int y, int w, int h, bool use_zstd)
 		switch (m_myFormat.bitsPerPixel) {
 
 		case 8:
-			zrleDecode8NE(x, y, w, h, fis, zis, (rdr::U8*)m_netbuf);
+			zrleDecode8NE(x, y, w, h, fis, zis, (rdr::U8*)m_netbuf, (rdr::U8*)fb, fbStride);
 			break;
 
 		case 16:
 			if (m_myFormat.greenMax > 0x1F) {
-				zrleDecode16LE(x, y, w, h, fis, zis, (rdr::U16*)m_netbuf);
+				zrleDecode16LE(x, y, w, h, fis, zis, (rdr::U16*)m_netbuf, (rdr::U16*)fb, fbStride);
 			}
 			else {
-				zrleDecode15LE(x, y, w, h, fis, zis, (rdr::U16*)m_netbuf);
+				zrleDecode15LE(x, y, w, h, fis, zis, (rdr::U16*)m_netbuf, (rdr::U16*)fb, fbStride);
 			}
 			break;
 
@@ -119,16 +122,16 @@ void ClientConnection::zrleDecode(int x, int y, int w, int h, bool use_zstd)
 			if ((fitsInLS3Bytes && !m_myFormat.bigEndian) ||
 				(fitsInMS3Bytes && m_myFormat.bigEndian))
 			{
-				zrleDecode24ALE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf);
+				zrleDecode24ALE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			else if ((fitsInLS3Bytes && m_myFormat.bigEndian) ||
 				(fitsInMS3Bytes && !m_myFormat.bigEndian))
 			{
-				zrleDecode24BLE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf);
+				zrleDecode24BLE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			else
 			{
-				zrleDecode32LE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf);
+				zrleDecode32LE(x, y, w, h, fis, zis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			break;
 		}
@@ -137,15 +140,15 @@ void ClientConnection::zrleDecode(int x, int y, int w, int h, bool use_zstd)
 		switch (m_myFormat.bitsPerPixel) {
 
 		case 8:
-			zrleDecode8NE(x, y, w, h, fis, zstdis, (rdr::U8*)m_netbuf);
+			zrleDecode8NE(x, y, w, h, fis, zstdis, (rdr::U8*)m_netbuf, (rdr::U8*)fb, fbStride);
 			break;
 
 		case 16:
 			if (m_myFormat.greenMax > 0x1F) {
-				zrleDecode16LE(x, y, w, h, fis, zstdis, (rdr::U16*)m_netbuf);
+				zrleDecode16LE(x, y, w, h, fis, zstdis, (rdr::U16*)m_netbuf, (rdr::U16*)fb, fbStride);
 			}
 			else {
-				zrleDecode15LE(x, y, w, h, fis, zstdis, (rdr::U16*)m_netbuf);
+				zrleDecode15LE(x, y, w, h, fis, zstdis, (rdr::U16*)m_netbuf, (rdr::U16*)fb, fbStride);
 			}
 			break;
 
@@ -162,16 +165,16 @@ void ClientConnection::zrleDecode(int x, int y, int w, int h, bool use_zstd)
 			if ((fitsInLS3Bytes && !m_myFormat.bigEndian) ||
 				(fitsInMS3Bytes && m_myFormat.bigEndian))
 			{
-				zrleDecode24ALE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf);
+				zrleDecode24ALE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			else if ((fitsInLS3Bytes && m_myFormat.bigEndian) ||
 				(fitsInMS3Bytes && !m_myFormat.bigEndian))
 			{
-				zrleDecode24BLE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf);
+				zrleDecode24BLE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			else
 			{
-				zrleDecode32LE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf);
+				zrleDecode32LE(x, y, w, h, fis, zstdis, (rdr::U32*)m_netbuf, (rdr::U32*)fb, fbStride);
 			}
 			break;
 		}
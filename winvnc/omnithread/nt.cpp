@@ -45,6 +45,8 @@ static void get_time_now(unsigned long* abs_sec, unsigned long* abs_nsec);
 omni_mutex::omni_mutex(void)
 {
     InitializeCriticalSection(&crit);
+    owner = 0;
+    depth = 0;
 }
 
 omni_mutex::~omni_mutex(void)
@@ -51,14 +51,25 @@
 extern "C" OMNI_THREAD_WRAPPER;
 
 #define OMNI_MUTEX_IMPLEMENTATION			\
-    CRITICAL_SECTION crit;
+    CRITICAL_SECTION crit;				\
+    volatile DWORD owner;				\
+    int depth;
 
+// owner and depth change only with crit entered, by the thread that
+// holds it, so only that thread can read its own id back from owner
 #define OMNI_MUTEX_LOCK_IMPLEMENTATION                  \
-    EnterCriticalSection(&crit);
+    EnterCriticalSection(&crit);			\
+    owner = GetCurrentThreadId();			\
+    depth++;
 
 #define OMNI_MUTEX_UNLOCK_IMPLEMENTATION                \
+    if (--depth == 0)					\
+	owner = 0;					\
     LeaveCriticalSection(&crit);
 
+#define OMNI_MUTEX_HELD_IMPLEMENTATION                  \
+    return owner == GetCurrentThreadId() ? depth : 0;
+
 #define OMNI_CONDITION_IMPLEMENTATION			\
     CRITICAL_SECTION crit;				\
     omni_thread* waiting_head;				\
@@ -220,6 +220,10 @@ public:
     inline void release(void) { unlock(); }
 	// the names lock and unlock are preferred over acquire and release
 	// since we are attempting to be as POSIX-like as possible.
+#ifdef OMNI_MUTEX_HELD_IMPLEMENTATION
+    // How many times the calling thread holds it, 0 when it does not
+    inline int held(void)     { OMNI_MUTEX_HELD_IMPLEMENTATION }
+#endif
 
     friend class omni_condition;
 
@@ -0,0 +1,15 @@
+// config.h: the bundled liblzma's configuration for the portable build,
+// the Windows one with POSIX threads and sysconf()
+
+#include "../../../xz-5.2.1/windows/config.h"
+
+#undef MYTHREAD_WIN95
+#undef MYTHREAD_VISTA
+#define MYTHREAD_POSIX 1
+#define HAVE_CLOCK_GETTIME 1
+#define HAVE_DECL_CLOCK_MONOTONIC 1
+#define TUKLIB_CPUCORES_SYSCONF 1
+#define TUKLIB_PHYSMEM_SYSCONF 1
+
+#undef SIZEOF_SIZE_T
+#define SIZEOF_SIZE_T __SIZEOF_SIZE_T__
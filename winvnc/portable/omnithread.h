@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// omnithread.h: omni_mutex for the portable build, see stdhdrs.h. The
+// headers the encoders include hold mutexes; nothing else of
+// omnithread is used there.
+
+#if !defined(_PORTABLE_OMNITHREAD)
+#define _PORTABLE_OMNITHREAD
+#pragma once
+
+#include "stdhdrs.h"
+
+class omni_mutex
+{
+public:
+	omni_mutex() { InitializeCriticalSection(&m_crit); }
+	~omni_mutex() { DeleteCriticalSection(&m_crit); }
+	void lock() { EnterCriticalSection(&m_crit); }
+	void unlock() { LeaveCriticalSection(&m_crit); }
+	void acquire() { lock(); }
+	void release() { unlock(); }
+
+private:
+	omni_mutex(const omni_mutex &);
+	omni_mutex &operator=(const omni_mutex &);
+	CRITICAL_SECTION m_crit;
+};
+
+class omni_mutex_lock
+{
+public:
+	omni_mutex_lock(omni_mutex &m) : m_mutex(m) { m_mutex.lock(); }
+	~omni_mutex_lock() { m_mutex.unlock(); }
+
+private:
+	omni_mutex_lock(const omni_mutex_lock &);
+	omni_mutex_lock &operator=(const omni_mutex_lock &);
+	omni_mutex &m_mutex;
+};
+
+#endif // _PORTABLE_OMNITHREAD
@@ -0,0 +1,271 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// stdhdrs.cpp: the Win32 calls of stdhdrs.h on pthreads.
+
+#include "stdhdrs.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+VNCLog vnclog;
+
+void InitializeCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&cs->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutex_destroy(&cs->mutex);
+}
+
+namespace {
+	// What a HANDLE points to. A wait returns once count is above
+	// zero: the event is set, the semaphore has a unit or the thread
+	// has returned. A wait on an auto reset event or a semaphore takes
+	// the unit.
+	struct PortableHandle
+	{
+		enum Kind { EVENT, SEMAPHORE, THREAD };
+
+		PortableHandle(Kind k, LONG initial, LONG maximum, bool manual)
+		: kind(k), count(initial), maximum(maximum), manualReset(manual), refs(1)
+		{
+			pthread_mutex_init(&mutex, NULL);
+			pthread_cond_init(&cond, NULL);
+		}
+		~PortableHandle()
+		{
+			pthread_cond_destroy(&cond);
+			pthread_mutex_destroy(&mutex);
+		}
+
+		// The handle and a running thread each hold a reference
+		void Unref()
+		{
+			pthread_mutex_lock(&mutex);
+			bool last = --refs == 0;
+			pthread_mutex_unlock(&mutex);
+			if (last)
+				delete this;
+		}
+
+		Kind kind;
+		LONG count;
+		LONG maximum;
+		bool manualReset;
+		int refs;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		LPTHREAD_START_ROUTINE start;
+		LPVOID param;
+	};
+
+	void *ThreadMain(void *arg)
+	{
+		PortableHandle *h = (PortableHandle *)arg;
+		h->start(h->param);
+		pthread_mutex_lock(&h->mutex);
+		h->count = 1;
+		pthread_cond_broadcast(&h->cond);
+		pthread_mutex_unlock(&h->mutex);
+		h->Unref();
+		return NULL;
+	}
+
+	LONGLONG Now(clockid_t clock)
+	{
+		struct timespec ts;
+		clock_gettime(clock, &ts);
+		return (LONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+}
+
+HANDLE CreateEvent(void *, BOOL manualReset, BOOL initialState, LPCSTR)
+{
+	return new PortableHandle(PortableHandle::EVENT, initialState ? 1 : 0, 1, manualReset != FALSE);
+}
+
+BOOL SetEvent(HANDLE event)
+{
+	PortableHandle *h = (PortableHandle *)event;
+	pthread_mutex_lock(&h->mutex);
+	h->count = 1;
+	pthread_cond_broadcast(&h->cond);
+	pthread_mutex_unlock(&h->mutex);
+	return TRUE;
+}
+
+BOOL ResetEvent(HANDLE event)
+{
+	PortableHandle *h = (PortableHandle *)event;
+	pthread_mutex_lock(&h->mutex);
+	h->count = 0;
+	pthread_mutex_unlock(&h->mutex);
+	return TRUE;
+}
+
+HANDLE CreateSemaphore(void *, LONG initialCount, LONG maximumCount, LPCSTR)
+{
+	return new PortableHandle(PortableHandle::SEMAPHORE, initialCount, maximumCount, false);
+}
+
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG releaseCount, LONG *previousCount)
+{
+	PortableHandle *h = (PortableHandle *)semaphore;
+	pthread_mutex_lock(&h->mutex);
+	if (previousCount != NULL)
+		*previousCount = h->count;
+	bool ok = releaseCount > 0 && releaseCount <= h->maximum - h->count;
+	if (ok) {
+		h->count += releaseCount;
+		pthread_cond_broadcast(&h->cond);
+	}
+	pthread_mutex_unlock(&h->mutex);
+	return ok ? TRUE : FALSE;
+}
+
+HANDLE CreateThread(void *, size_t stackSize, LPTHREAD_START_ROUTINE start,
+					LPVOID param, DWORD, DWORD *threadId)
+{
+	PortableHandle *h = new PortableHandle(PortableHandle::THREAD, 0, 1, true);
+	h->start = start;
+	h->param = param;
+	h->refs = 2;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (stackSize != 0)
+		pthread_attr_setstacksize(&attr, stackSize);
+	pthread_t thread;
+	int rc = pthread_create(&thread, &attr, ThreadMain, h);
+	pthread_attr_destroy(&attr);
+	if (rc != 0) {
+		delete h;
+		return NULL;
+	}
+	if (threadId != NULL)
+		*threadId = 0;
+	return h;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+	PortableHandle *h = (PortableHandle *)handle;
+	LONGLONG deadline = Now(CLOCK_REALTIME) + (LONGLONG)milliseconds * 1000000;
+	struct timespec ts;
+	ts.tv_sec = (time_t)(deadline / 1000000000);
+	ts.tv_nsec = (long)(deadline % 1000000000);
+
+	DWORD result = WAIT_OBJECT_0;
+	pthread_mutex_lock(&h->mutex);
+	while (h->count == 0) {
+		if (milliseconds == INFINITE)
+			pthread_cond_wait(&h->cond, &h->mutex);
+		else if (pthread_cond_timedwait(&h->cond, &h->mutex, &ts) == ETIMEDOUT) {
+			result = WAIT_TIMEOUT;
+			break;
+		}
+	}
+	if (result == WAIT_OBJECT_0 && !h->manualReset)
+		h->count--;
+	pthread_mutex_unlock(&h->mutex);
+	return result;
+}
+
+// One wait after the other for all of them, polled for any of them
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE *handles, BOOL waitAll, DWORD milliseconds)
+{
+	DWORD start = GetTickCount();
+	for (;;) {
+		for (DWORD i = 0; i < count; i++) {
+			DWORD left = INFINITE;
+			if (milliseconds != INFINITE) {
+				DWORD elapsed = GetTickCount() - start;
+				left = elapsed < milliseconds ? milliseconds - elapsed : 0;
+			}
+			if (!waitAll)
+				left = 0;
+			DWORD result = WaitForSingleObject(handles[i], left);
+			if (!waitAll && result == WAIT_OBJECT_0)
+				return WAIT_OBJECT_0 + i;
+			if (waitAll && result != WAIT_OBJECT_0)
+				return result;
+		}
+		if (waitAll)
+			return WAIT_OBJECT_0;
+		if (milliseconds != INFINITE && GetTickCount() - start >= milliseconds)
+			return WAIT_TIMEOUT;
+		Sleep(1);
+	}
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+	if (handle == NULL)
+		return FALSE;
+	((PortableHandle *)handle)->Unref();
+	return TRUE;
+}
+
+void GetSystemInfo(SYSTEM_INFO *si)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	si->dwNumberOfProcessors = n > 0 ? (DWORD)n : 1;
+}
+
+DWORD GetTickCount()
+{
+	return (DWORD)(Now(CLOCK_MONOTONIC) / 1000000);
+}
+
+DWORD GetCurrentThreadId()
+{
+	return (DWORD)syscall(SYS_gettid);
+}
+
+void Sleep(DWORD milliseconds)
+{
+	struct timespec ts;
+	ts.tv_sec = milliseconds / 1000;
+	ts.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+	nanosleep(&ts, NULL);
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+	counter->QuadPart = Now(CLOCK_MONOTONIC);
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+	frequency->QuadPart = 1000000000;
+	return TRUE;
+}
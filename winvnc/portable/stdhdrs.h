@@ -0,0 +1,265 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// stdhdrs.h: what the encoders take from Win32 and winvnc, for the
+// portable build (_VNC_PORTABLE). winvnc/stdhdrs.h includes this one
+// instead of the Windows headers there.
+//
+// Only the types and calls the encoder, rdr and vncbench sources use
+// are here. Critical sections, events, semaphores and threads are
+// pthread based, in stdhdrs.cpp. Logging is compiled out.
+
+#if !defined(_PORTABLE_STDHDRS)
+#define _PORTABLE_STDHDRS
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef uint64_t DWORD64;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef long long LONGLONG;
+typedef int INT;
+typedef char CHAR;
+typedef char TCHAR;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+typedef const char *LPCTSTR;
+typedef void *LPVOID;
+typedef BYTE *LPBYTE;
+typedef DWORD *LPDWORD;
+typedef uintptr_t UINT_PTR;
+typedef intptr_t INT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef LONG HRESULT;
+typedef void *HANDLE;
+typedef void *HWND;
+typedef void *HDC;
+typedef void *HMODULE;
+#define VOID void
+#define __int64 long long
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define MAXPATH 256
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WINAPI
+#define CALLBACK
+#define __cdecl
+#define __stdcall
+#define __forceinline inline __attribute__((always_inline))
+#define __debugbreak() __builtin_trap()
+#define _TRUNCATE ((size_t)-1)
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define SUCCEEDED(hr) ((HRESULT)(hr) >= 0)
+#define FAILED(hr) ((HRESULT)(hr) < 0)
+
+// The windows.h min() and max() macros
+using std::min;
+using std::max;
+
+typedef struct tagRECT {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT, *LPRECT;
+
+inline BOOL SetRect(RECT *rect, int left, int top, int right, int bottom)
+{
+	rect->left = left;
+	rect->top = top;
+	rect->right = right;
+	rect->bottom = bottom;
+	return TRUE;
+}
+
+// No window to repaint
+inline BOOL InvalidateRect(HWND, const RECT *, BOOL) { return TRUE; }
+
+typedef struct tagPOINT {
+	LONG x;
+	LONG y;
+} POINT;
+
+typedef struct tagRGBQUAD {
+	BYTE rgbBlue;
+	BYTE rgbGreen;
+	BYTE rgbRed;
+	BYTE rgbReserved;
+} RGBQUAD;
+
+typedef union _LARGE_INTEGER {
+	struct {
+		DWORD LowPart;
+		LONG HighPart;
+	} u;
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _SYSTEM_INFO {
+	DWORD dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+// A recursive mutex, as a Win32 critical section is
+typedef struct _CRITICAL_SECTION {
+	pthread_mutex_t mutex;
+} CRITICAL_SECTION;
+
+void InitializeCriticalSection(CRITICAL_SECTION *cs);
+void DeleteCriticalSection(CRITICAL_SECTION *cs);
+inline void EnterCriticalSection(CRITICAL_SECTION *cs) { pthread_mutex_lock(&cs->mutex); }
+inline void LeaveCriticalSection(CRITICAL_SECTION *cs) { pthread_mutex_unlock(&cs->mutex); }
+
+inline LONG InterlockedIncrement(volatile LONG *p) { return __sync_add_and_fetch(p, 1); }
+inline LONG InterlockedDecrement(volatile LONG *p) { return __sync_sub_and_fetch(p, 1); }
+inline LONG InterlockedExchangeAdd(volatile LONG *p, LONG v) { return __sync_fetch_and_add(p, v); }
+
+// Events, semaphores and threads are HANDLEs to one kind of object,
+// closed with CloseHandle()
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID param);
+HANDLE CreateEvent(void *security, BOOL manualReset, BOOL initialState, LPCSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+HANDLE CreateSemaphore(void *security, LONG initialCount, LONG maximumCount, LPCSTR name);
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG releaseCount, LONG *previousCount);
+HANDLE CreateThread(void *security, size_t stackSize, LPTHREAD_START_ROUTINE start,
+					LPVOID param, DWORD flags, DWORD *threadId);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE *handles, BOOL waitAll, DWORD milliseconds);
+BOOL CloseHandle(HANDLE handle);
+
+void GetSystemInfo(SYSTEM_INFO *si);
+DWORD GetTickCount();
+DWORD GetCurrentThreadId();
+void Sleep(DWORD milliseconds);
+BOOL QueryPerformanceCounter(LARGE_INTEGER *counter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency);
+#define timeGetTime GetTickCount
+#define GetTimeFunction GetTickCount
+
+#define ZeroMemory(p, size) memset((p), 0, (size))
+#define CopyMemory(d, s, size) memcpy((d), (s), (size))
+
+// The secure CRT calls as far as they are used
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#define _snprintf snprintf
+#define _snprintf_s(buffer, size, count, ...) snprintf(buffer, size, __VA_ARGS__)
+#define strcpy_s(dest, ...) PortableStrcpy(dest, __VA_ARGS__)
+#define strcat_s(dest, ...) PortableStrcat(dest, __VA_ARGS__)
+#define _fseeki64 fseeko
+#define _ftelli64 ftello
+inline int fopen_s(FILE **file, const char *name, const char *mode)
+{
+	*file = fopen(name, mode);
+	return *file != NULL ? 0 : 1;
+}
+inline int PortableStrcpy(char *dest, size_t size, const char *src)
+{
+	snprintf(dest, size, "%s", src);
+	return 0;
+}
+template <size_t SIZE>
+inline int PortableStrcpy(char (&dest)[SIZE], const char *src) { return PortableStrcpy(dest, SIZE, src); }
+inline int PortableStrcat(char *dest, size_t size, const char *src)
+{
+	size_t n = strlen(dest);
+	return n < size ? PortableStrcpy(dest + n, size - n, src) : 1;
+}
+template <size_t SIZE>
+inline int PortableStrcat(char (&dest)[SIZE], const char *src) { return PortableStrcat(dest, SIZE, src); }
+inline int strncat_s(char *dest, size_t size, const char *src, size_t count)
+{
+	size_t n = strlen(dest);
+	if (n >= size)
+		return 1;
+	strncat(dest, src, min(count, size - n - 1));
+	return 0;
+}
+template <size_t SIZE>
+inline int strncat_s(char (&dest)[SIZE], const char *src, size_t count) { return strncat_s(dest, SIZE, src, count); }
+inline int strerror_s(char *buffer, size_t size, int err)
+{
+	snprintf(buffer, size, "%s", strerror(err));
+	return 0;
+}
+inline int sprintf_s(char *buffer, size_t size, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buffer, size, format, args);
+	va_end(args);
+	return n;
+}
+template <size_t SIZE>
+inline int sprintf_s(char (&buffer)[SIZE], const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buffer, SIZE, format, args);
+	va_end(args);
+	return n;
+}
+
+// Logging, compiled out
+class VNCLog
+{
+public:
+	void Print(int, const char *, ...) {}
+};
+extern VNCLog vnclog;
+
+#define LL_NONE		0
+#define LL_STATE	0
+#define LL_CLIENTS	1
+#define LL_CONNERR	0
+#define LL_SOCKERR	4
+#define LL_INTERR	0
+#define LL_INTWARN	8
+#define LL_INTINFO	9
+#define LL_SOCKINFO	10
+#define LL_ALL		10
+#define VNCLOG(s)	(__FILE__ " : " s)
+#define OutputDevMessage(...)
+
+#endif // _PORTABLE_STDHDRS
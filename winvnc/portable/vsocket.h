@@ -0,0 +1,67 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// vsocket.h: the VSocket of the portable build, see stdhdrs.h. It has
+// no socket: what the encoders send goes to the output sink, as with
+// winvnc's VSocket::SetOutputSink().
+
+#if !defined(_PORTABLE_VSOCKET)
+#define _PORTABLE_VSOCKET
+#pragma once
+
+#include "../winvnc/vtypes.h"
+#include <rdr/OutStream.h>
+
+class IIntegratedPlugin;
+
+class VSocket
+{
+public:
+	VSocket() : m_pIntegratedPluginInterface(NULL), m_pOutputSink(NULL) {}
+
+	// SendExact() and SendExactQueue() append to pSink, and fail
+	// while there is none
+	void SetOutputSink(rdr::OutStream* pSink) { m_pOutputSink = pSink; }
+
+	VBool SendExact(const char *buff, const VCard bufflen) { return SendToOutputSink(buff, bufflen); }
+	VBool SendExactQueue(const char *buff, const VCard bufflen) { return SendToOutputSink(buff, bufflen); }
+	VBool Close() { return VTrue; }
+	bool IsUsePluginEnabled() { return false; }
+
+	IIntegratedPlugin* m_pIntegratedPluginInterface;
+
+private:
+	VBool SendToOutputSink(const char *buff, const VCard bufflen)
+	{
+		if (m_pOutputSink == NULL)
+			return VFalse;
+		if (bufflen > 0)
+			m_pOutputSink->writeBytes(buff, bufflen);
+		return VTrue;
+	}
+
+	rdr::OutStream* m_pOutputSink;
+};
+
+#endif // _PORTABLE_VSOCKET
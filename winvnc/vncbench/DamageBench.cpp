@@ -0,0 +1,127 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// DamageBench.cpp: a synthetic damage source for the server's capture loop.
+
+#include "vncbench.h"
+
+// Not a timing of its own: a window that repaints a moving bar at -fps
+// for -seconds, for watching winvnc's CPU usage and update rate while it
+// runs. With -fps 0 the window paints once and then stays still, which
+// is the idle case the capture thread should back off from.
+namespace {
+	const int DAMAGE_WIDTH = 320;
+	const int DAMAGE_HEIGHT = 240;
+	const int DAMAGE_BAR = 16;
+
+	int g_damageFrame = 0;
+
+	LRESULT CALLBACK DamageWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+	{
+		switch (msg) {
+		case WM_PAINT: {
+			PAINTSTRUCT ps;
+			HDC hdc = BeginPaint(hwnd, &ps);
+			RECT rc;
+			GetClientRect(hwnd, &rc);
+			FillRect(hdc, &rc, (HBRUSH)GetStockObject(WHITE_BRUSH));
+			int x = (g_damageFrame * 4) % (rc.right - DAMAGE_BAR > 0 ? rc.right - DAMAGE_BAR : 1);
+			RECT bar = { x, 0, x + DAMAGE_BAR, rc.bottom };
+			FillRect(hdc, &bar, (HBRUSH)GetStockObject(BLACK_BRUSH));
+			EndPaint(hwnd, &ps);
+			return 0;
+		}
+		case WM_DESTROY:
+			PostQuitMessage(0);
+			return 0;
+		}
+		return DefWindowProc(hwnd, msg, wParam, lParam);
+	}
+}
+
+bool DamageBench()
+{
+	HINSTANCE hInstance = GetModuleHandle(NULL);
+	WNDCLASS wc;
+	memset(&wc, 0, sizeof(wc));
+	wc.lpfnWndProc = DamageWndProc;
+	wc.hInstance = hInstance;
+	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+	wc.lpszClassName = "vncbenchDamage";
+	if (!RegisterClass(&wc))
+		return false;
+	HWND hwnd = CreateWindowEx(WS_EX_TOPMOST, wc.lpszClassName, "vncbench damage",
+		WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU, 0, 0, DAMAGE_WIDTH, DAMAGE_HEIGHT,
+		NULL, NULL, hInstance, NULL);
+	if (hwnd == NULL) {
+		UnregisterClass(wc.lpszClassName, hInstance);
+		return false;
+	}
+	ShowWindow(hwnd, SW_SHOWNOACTIVATE);
+	UpdateWindow(hwnd);
+
+	int fps = g_benchOptions.fps;
+	double interval = fps > 0 ? 1000.0 / fps : 0.0;
+	double duration = g_benchOptions.seconds * 1000.0;
+	BenchPrint("  %i fps for %i s, close the window to stop early\n", fps, g_benchOptions.seconds);
+
+	BenchTimer timer;
+	double next = interval;
+	bool running = true;
+	while (running) {
+		double now = timer.Elapsed();
+		if (now >= duration)
+			break;
+		double until = duration;
+		if (fps > 0) {
+			if (now >= next) {
+				g_damageFrame++;
+				InvalidateRect(hwnd, NULL, FALSE);
+				UpdateWindow(hwnd);
+				// Skip frames we are late for rather than bursting
+				while (next <= now)
+					next += interval;
+			}
+			until = min(next, duration);
+		}
+		DWORD wait = (DWORD)(until > now ? until - now : 0);
+		MsgWaitForMultipleObjects(0, NULL, FALSE, wait, QS_ALLINPUT);
+		MSG msg;
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			if (msg.message == WM_QUIT) {
+				running = false;
+				break;
+			}
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	}
+	double elapsed = timer.Elapsed();
+	BenchPrint("  %i frames painted in %.0f ms, %.1f fps\n", g_damageFrame, elapsed,
+		elapsed > 0 ? g_damageFrame * 1000.0 / elapsed : 0.0);
+	if (IsWindow(hwnd))
+		DestroyWindow(hwnd);
+	UnregisterClass(wc.lpszClassName, hInstance);
+	return true;
+}
@@ -0,0 +1,329 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// EncoderBench.cpp: every encoding over the bench frames, the way
+// vncClient sends a full screen update. What the encoders send
+// themselves goes to an in-memory VSocket sink instead of a socket.
+// Reports ms per frame, raw MB/s and the compression ratio.
+//
+// PoolBench runs the encoders that keep their scratch space in the
+// BufferPool and counts what the pool takes from the heap once warm.
+
+#include "vncbench.h"
+#include "EncoderThreadPool.h"
+#include "vncencoder.h"
+#include "vncencoderre.h"
+#include "vncencodecorre.h"
+#include "vncencodehext.h"
+#include "vncEncodeZlib.h"
+#include "vncEncodeZlibHex.h"
+#include "vncEncodeTight.h"
+#include "vncEncodeUltra.h"
+#include "vncEncodeUltra2.h"
+#include "vncencodezrle.h"
+#ifdef _XZ
+#include "vncEncodeXZ.h"
+#endif
+#include <rdr/MemOutStream.h>
+
+namespace {
+	enum {
+		// Encodings the bench adds on top of the rfbEncoding values
+		ENC_BENCH_TIGHT_JPEG = -1
+	};
+
+	struct EncoderBenchCase {
+		const char *name;
+		int encoding;
+		bool pooled;		// runs on the EncoderThreadPool
+	};
+
+	const EncoderBenchCase g_encoderBenchCases[] = {
+		{ "Raw", rfbEncodingRaw, false },
+		{ "RRE", rfbEncodingRRE, false },
+		{ "CoRRE", rfbEncodingCoRRE, false },
+		{ "Hextile", rfbEncodingHextile, false },
+		{ "Zlib", rfbEncodingZlib, false },
+		{ "Zstd", rfbEncodingZstd, false },
+		{ "ZlibHex", rfbEncodingZlibHex, true },
+		{ "ZstdHex", rfbEncodingZstdHex, true },
+		{ "Tight", rfbEncodingTight, false },
+		{ "TightZstd", rfbEncodingTightZstd, false },
+		{ "Tight JPEG", ENC_BENCH_TIGHT_JPEG, true },
+		{ "Ultra", rfbEncodingUltra, false },
+		{ "Ultra2", rfbEncodingUltra2, true },
+		{ "ZRLE", rfbEncodingZRLE, false },
+		{ "ZSTDRLE", rfbEncodingZSTDRLE, false },
+		{ "ZYWRLE", rfbEncodingZYWRLE, false },
+#ifdef _XZ
+		{ "XZ", rfbEncodingXZ, false },
+#endif
+	};
+
+	// As vncEncodeMgr::SetEncoding() sets them up
+	vncEncoder *EncoderBenchCreate(int encoding)
+	{
+		switch (encoding) {
+		case rfbEncodingRaw: return new vncEncoder;
+		case rfbEncodingRRE: return new vncEncodeRRE;
+		case rfbEncodingCoRRE: return new vncEncodeCoRRE;
+		case rfbEncodingHextile: return new vncEncodeHexT;
+		case rfbEncodingUltra: {
+			vncEncodeUltra *ultra = new vncEncodeUltra;
+			ultra->EnableQueuing(false);
+			return ultra;
+		}
+		case rfbEncodingUltra2: return new vncEncodeUltra2;
+		case rfbEncodingZlib:
+		case rfbEncodingZstd: {
+			vncEncodeZlib *zlib = new vncEncodeZlib;
+			zlib->set_use_zstd(encoding == rfbEncodingZstd);
+			return zlib;
+		}
+		case rfbEncodingZlibHex:
+		case rfbEncodingZstdHex: {
+			vncEncodeZlibHex *zlibhex = new vncEncodeZlibHex;
+			zlibhex->set_use_zstd(encoding == rfbEncodingZstdHex);
+			return zlibhex;
+		}
+		case rfbEncodingTight:
+		case rfbEncodingTightZstd:
+		case ENC_BENCH_TIGHT_JPEG: {
+			vncEncodeTight *tight = new vncEncodeTight;
+			tight->set_use_zstd(encoding == rfbEncodingTightZstd);
+			return tight;
+		}
+		case rfbEncodingZRLE:
+		case rfbEncodingZSTDRLE:
+		case rfbEncodingZYWRLE: {
+			vncEncodeZRLE *zrle = new vncEncodeZRLE;
+			zrle->m_use_zywrle = encoding == rfbEncodingZYWRLE;
+			zrle->set_use_zstd(encoding == rfbEncodingZSTDRLE);
+			return zrle;
+		}
+#ifdef _XZ
+		case rfbEncodingXZ: {
+			vncEncodeXZ *xz = new vncEncodeXZ;
+			xz->m_use_xzyw = FALSE;
+			return xz;
+		}
+#endif
+		}
+		return NULL;
+	}
+
+	// As vncEncodeMgr::EncodeRect() calls them, returns the bytes left in dest
+	UINT EncoderBenchRect(vncEncoder *encoder, int encoding, BYTE *frame, VSocket *sink,
+						  BYTE *dest, const rfb::Rect &rect)
+	{
+		switch (encoding) {
+		case rfbEncodingZlib:
+		case rfbEncodingZstd:
+			return encoder->EncodeRect(frame, sink, dest, rect, false);
+		case rfbEncodingTight:
+		case rfbEncodingTightZstd:
+		case ENC_BENCH_TIGHT_JPEG:
+		case rfbEncodingZlibHex:
+		case rfbEncodingZstdHex: {
+			RECT r;
+			r.left = rect.tl.x; r.top = rect.tl.y;
+			r.right = rect.br.x; r.bottom = rect.br.y;
+			return encoder->EncodeRect(frame, sink, dest, r);
+		}
+#ifdef _XZ
+		case rfbEncodingXZ: {
+			rfb::RectVector rects;
+			rects.push_back(rect);
+			// Sends everything itself and returns a flag
+			encoder->EncodeBulkRects(rects, frame, dest, sink);
+			return 0;
+		}
+#endif
+		}
+		return encoder->EncodeRect(frame, sink, dest, rect);
+	}
+
+	void EncoderBenchFormat(rfbPixelFormat &format)
+	{
+		memset(&format, 0, sizeof(format));
+		format.bitsPerPixel = 32;
+		format.depth = 24;
+		format.trueColour = 1;
+		format.redMax = format.greenMax = format.blueMax = 255;
+		format.redShift = 16;
+		format.greenShift = 8;
+		format.blueShift = 0;
+	}
+
+	void EncoderBenchSetup(vncEncoder *encoder, int encoding, const BenchFrame &frame)
+	{
+		rfbPixelFormat format;
+		EncoderBenchFormat(format);
+		encoder->Init();
+		encoder->SetLocalFormat(format, frame.width, frame.height);
+		encoder->SetRemoteFormat(format);
+		encoder->SetBufferOffset(0, 0);
+		encoder->SetCompressLevel(6);
+		encoder->SetQualityLevel(encoding == rfbEncodingUltra2 ? 8 : -1);
+		encoder->SetFineQualityLevel(encoding == ENC_BENCH_TIGHT_JPEG ? 80 : -1);
+		encoder->SetSubsampling(SUBSAMP_4X);
+	}
+
+	void EncoderBenchRun(const BenchFrame &frame, const char *suffix, bool pooledOnly)
+	{
+		rfb::Rect rect(0, 0, frame.width, frame.height);
+		double raw = (double)frame.Size();
+		int passes = g_benchOptions.passes;
+
+		rdr::MemOutStream mos(1 << 20);
+		VSocket sink;
+		sink.SetOutputSink(&mos);
+
+		for (int i = 0; i < (int)(sizeof(g_encoderBenchCases) / sizeof(g_encoderBenchCases[0])); i++) {
+			const EncoderBenchCase &c = g_encoderBenchCases[i];
+			if (pooledOnly && !c.pooled)
+				continue;
+			vncEncoder *encoder = EncoderBenchCreate(c.encoding);
+			if (encoder == NULL)
+				continue;
+			EncoderBenchSetup(encoder, c.encoding, frame);
+			std::vector<BYTE> dest(encoder->RequiredBuffSize(frame.width, frame.height));
+
+			double bytes = 0;
+			BenchTimer timer;
+			for (int pass = 0; pass < passes; pass++) {
+				mos.clear();
+				UINT left = EncoderBenchRect(encoder, c.encoding, frame.data, &sink, &dest[0], rect);
+				encoder->LastRect(&sink);
+				bytes += left + mos.length();
+			}
+			double elapsed = timer.Elapsed();
+
+			BenchPrint("%-8s%-3s %ix%i %-10s %6.1f ms/frame %7.1f MB/s  ratio %6.1f\n",
+				frame.name, suffix, frame.width, frame.height, c.name, elapsed / passes,
+				BenchRate(raw * passes, elapsed), bytes > 0 ? raw * passes / bytes : 0.0);
+
+			delete encoder;
+		}
+		sink.SetOutputSink(NULL);
+	}
+}
+
+bool EncoderBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+	// The encoders that cut large rects in bands once more on one
+	// thread, for their speedup
+	bool threads = EncoderThreadPool::Workers() > 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		EncoderBenchRun(frames[i], "", false);
+		if (threads) {
+			EncoderThreadPool::LimitWorkers(0);
+			EncoderBenchRun(frames[i], "/1t", true);
+			EncoderThreadPool::LimitWorkers(EncoderThreadPool::MAX_WORKERS);
+		}
+	}
+	return true;
+}
+
+// The encoders whose scratch buffers come from the BufferPool
+namespace {
+	const EncoderBenchCase g_poolBenchCases[] = {
+		{ "ZlibHex", rfbEncodingZlibHex, true },
+		{ "Tight", rfbEncodingTight, false },
+		{ "Tight JPEG", ENC_BENCH_TIGHT_JPEG, true },
+		{ "Ultra", rfbEncodingUltra, false },
+		{ "Ultra2", rfbEncodingUltra2, true },
+	};
+
+	// One client session: a new encoder sends rects that grow from a
+	// small damage area to the full screen, the way the buffers grow a
+	// little at a time on a real desktop
+	double PoolBenchSession(const EncoderBenchCase &c, BenchFrames &frames, rdr::MemOutStream &mos, VSocket &sink)
+	{
+		double raw = 0;
+		for (size_t f = 0; f < frames.size(); f++) {
+			BenchFrame &frame = frames[f];
+			vncEncoder *encoder = EncoderBenchCreate(c.encoding);
+			EncoderBenchSetup(encoder, c.encoding, frame);
+			std::vector<BYTE> dest(encoder->RequiredBuffSize(frame.width, frame.height));
+			for (int step = 1; step <= 8; step++) {
+				rfb::Rect rect(0, 0, frame.width * step / 8, frame.height * step / 8);
+				mos.clear();
+				EncoderBenchRect(encoder, c.encoding, frame.data, &sink, &dest[0], rect);
+				encoder->LastRect(&sink);
+				raw += (double)rect.area() * 4;
+			}
+			delete encoder;
+		}
+		return raw;
+	}
+}
+
+bool PoolBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+
+	rdr::MemOutStream mos(1 << 20);
+	VSocket sink;
+	sink.SetOutputSink(&mos);
+
+	bool ok = true;
+	int passes = g_benchOptions.passes;
+	for (int i = 0; i < (int)(sizeof(g_poolBenchCases) / sizeof(g_poolBenchCases[0])); i++) {
+		const EncoderBenchCase &c = g_poolBenchCases[i];
+		BufferPool::Trim();
+		// The first session fills the pool
+		PoolBenchSession(c, frames, mos, sink);
+
+		BufferPool::Stats before, after;
+		BufferPool::GetStats(before);
+		double rects = 0;
+		for (int pass = 0; pass < passes; pass++) {
+			PoolBenchSession(c, frames, mos, sink);
+			rects += (double)frames.size() * 8;
+		}
+		BufferPool::GetStats(after);
+
+		unsigned __int64 heapAllocs = after.heapAllocs - before.heapAllocs;
+		unsigned __int64 requests = after.requests - before.requests;
+		unsigned __int64 hits = after.hits - before.hits;
+		// Once warm the pool should not go to the heap, and what it holds
+		// should not grow past the first session
+		bool steady = heapAllocs == 0 && after.peakBytes == before.peakBytes;
+		BenchPrint("%-10s %5.2f heap allocs/rect  %4.1f%% hits  peak %6.1f MB  in use %6.1f MB  cached %5.1f MB  %s\n",
+			c.name, rects > 0 ? (double)heapAllocs / rects : 0.0,
+			requests > 0 ? (double)hits * 100.0 / (double)requests : 100.0,
+			after.peakBytes / 1048576.0, after.bytesInUse / 1048576.0,
+			after.bytesCached / 1048576.0, BenchCheck(steady));
+		ok = ok && steady;
+	}
+	sink.SetOutputSink(NULL);
+	BufferPool::Trim();
+	return ok;
+}
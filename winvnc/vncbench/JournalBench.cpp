@@ -0,0 +1,228 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// JournalBench.cpp: the shared change journal with several viewers.
+
+#include "vncbench.h"
+#include "vncChangeJournal.h"
+
+// The capture side adds damage, scroll copies and cache hits to one
+// vncChangeJournal. Each viewer reads it into its own tracker at its own
+// pace, and one stalls until the end, so it falls past the entries the
+// journal keeps and reads their merged region instead. A viewer that
+// keeps up must end each read with the tracker the server built before
+// the journal, when every change went to every client directly; the
+// stalled one must at least cover everything.
+namespace {
+	const int JOURNAL_BENCH_CHANGES = 3000;
+	const int JOURNAL_BENCH_VIEWERS = 8;
+	const int JOURNAL_BENCH_WIDTH = 1920;
+	const int JOURNAL_BENCH_HEIGHT = 1080;
+
+	struct JournalBenchChange {
+		enum { CHANGED, CACHED, COPIED } kind;
+		rfb::Region2D region;
+		rfb::Point delta;
+	};
+
+	void JournalBenchChanges(std::vector<JournalBenchChange> &changes)
+	{
+		unsigned int seed = 12345;
+		changes.resize(JOURNAL_BENCH_CHANGES);
+		for (int i = 0; i < JOURNAL_BENCH_CHANGES; i++) {
+			JournalBenchChange &c = changes[i];
+			if (i % 5 == 4) {
+				// Scroll a window up by a few lines
+				seed = seed * 1103515245 + 12345;
+				int lines = 8 + (seed >> 16) % 40;
+				c.kind = JournalBenchChange::COPIED;
+				c.region = rfb::Region2D(rfb::Rect(200, 100, 1400, 900 - lines));
+				c.delta = rfb::Point(0, -lines);
+				continue;
+			}
+			c.kind = i % 7 == 6 ? JournalBenchChange::CACHED : JournalBenchChange::CHANGED;
+			for (int n = 0; n < 3; n++) {
+				seed = seed * 1103515245 + 12345;
+				int x = (seed >> 8) % (JOURNAL_BENCH_WIDTH - 200);
+				int y = (seed >> 4) % (JOURNAL_BENCH_HEIGHT - 200);
+				int size = 16 + (seed >> 20) % 184;
+				c.region.assign_union(rfb::Region2D(rfb::Rect(x, y, x + size, y + size)));
+			}
+		}
+	}
+
+	void JournalBenchAdd(const JournalBenchChange &c, vncChangeJournal &journal)
+	{
+		switch (c.kind) {
+		case JournalBenchChange::CHANGED: journal.AddChanged(c.region); break;
+		case JournalBenchChange::CACHED: journal.AddCached(c.region); break;
+		case JournalBenchChange::COPIED: journal.AddCopied(c.region, c.delta); break;
+		}
+	}
+
+	void JournalBenchAdd(const JournalBenchChange &c, rfb::SimpleUpdateTracker &tracker)
+	{
+		switch (c.kind) {
+		case JournalBenchChange::CHANGED: tracker.add_changed(c.region); break;
+		case JournalBenchChange::CACHED: tracker.add_cached(c.region); break;
+		case JournalBenchChange::COPIED: tracker.add_copied(c.region, c.delta); break;
+		}
+	}
+
+	rfb::Region2D JournalBenchAll(const rfb::SimpleUpdateTracker &tracker)
+	{
+		rfb::Region2D all = tracker.get_changed_region();
+		all.assign_union(tracker.get_copied_region());
+		all.assign_union(tracker.get_cached_region());
+		return all;
+	}
+
+	bool JournalBenchSame(const rfb::SimpleUpdateTracker &a, const rfb::SimpleUpdateTracker &b)
+	{
+		return a.get_changed_region().equals(b.get_changed_region()) &&
+			a.get_copied_region().equals(b.get_copied_region()) &&
+			a.get_cached_region().equals(b.get_cached_region());
+	}
+
+	// On one thread, so every read can be compared. Viewer v > 0 reads
+	// after every v-th change, viewer 0 only at the end.
+	bool JournalBenchOrder(const std::vector<JournalBenchChange> &changes)
+	{
+		vncChangeJournal journal;
+		vncChangeJournal::Reader readers[JOURNAL_BENCH_VIEWERS];
+		std::vector<rfb::SimpleUpdateTracker> trackers(JOURNAL_BENCH_VIEWERS, rfb::SimpleUpdateTracker(true));
+		std::vector<rfb::SimpleUpdateTracker> direct(JOURNAL_BENCH_VIEWERS, rfb::SimpleUpdateTracker(true));
+		for (int v = 0; v < JOURNAL_BENCH_VIEWERS; v++)
+			journal.Attach(readers[v]);
+
+		bool ok = true;
+		for (size_t i = 0; i < changes.size(); i++) {
+			JournalBenchAdd(changes[i], journal);
+			for (int v = 0; v < JOURNAL_BENCH_VIEWERS; v++)
+				JournalBenchAdd(changes[i], direct[v]);
+			for (int v = 1; v < JOURNAL_BENCH_VIEWERS; v++) {
+				bool last = i + 1 == changes.size();
+				if ((i + 1) % v != 0 && !last)
+					continue;
+				// The update goes out, both trackers are empty again
+				journal.Read(readers[v], trackers[v]);
+				ok = ok && JournalBenchSame(trackers[v], direct[v]) && !journal.Unread(readers[v]);
+				trackers[v].clear();
+				direct[v].clear();
+			}
+		}
+
+		bool stalled = journal.Unread(readers[0]);
+		journal.Read(readers[0], trackers[0]);
+		ok = ok && stalled && JournalBenchAll(direct[0]).subtract(JournalBenchAll(trackers[0])).is_empty();
+		for (int v = 0; v < JOURNAL_BENCH_VIEWERS; v++)
+			journal.Detach(readers[v]);
+		return ok;
+	}
+
+	struct JournalBenchViewer {
+		vncChangeJournal *journal;
+		vncChangeJournal::Reader reader;
+		int pause;				// ms between reads, -1 = none until the end
+		volatile LONG *done;	// set once every change is added
+		rfb::Region2D seen;
+	};
+
+	DWORD WINAPI JournalBenchRead(LPVOID lpParam)
+	{
+		JournalBenchViewer *viewer = (JournalBenchViewer *)lpParam;
+		rfb::SimpleUpdateTracker tracker(true);
+		for (;;) {
+			// Taken before the read, so the last read has everything
+			bool last = InterlockedCompareExchange(viewer->done, 0, 0) != 0;
+			if (viewer->pause >= 0 || last) {
+				viewer->journal->Read(viewer->reader, tracker);
+				viewer->seen.assign_union(JournalBenchAll(tracker));
+				tracker.clear();
+			}
+			if (last)
+				return 0;
+			Sleep(viewer->pause > 0 ? viewer->pause : 1);
+		}
+	}
+
+	// The changes added while <viewers> threads read them, viewer 0 stalled
+	// when there is more than one. Milliseconds the adds took, negative
+	// when a viewer missed part of the damage.
+	double JournalBenchThreads(const std::vector<JournalBenchChange> &changes, int viewers)
+	{
+		vncChangeJournal journal;
+		volatile LONG done = 0;
+		std::vector<JournalBenchViewer> v(viewers);
+		std::vector<HANDLE> threads;
+		for (int i = 0; i < viewers; i++) {
+			v[i].journal = &journal;
+			v[i].pause = viewers > 1 && i == 0 ? -1 : i;
+			v[i].done = &done;
+			journal.Attach(v[i].reader);
+		}
+		for (int i = 0; i < viewers; i++) {
+			HANDLE thread = CreateThread(NULL, 0, JournalBenchRead, &v[i], 0, NULL);
+			if (thread != NULL)
+				threads.push_back(thread);
+		}
+
+		rfb::Region2D all;
+		BenchTimer timer;
+		for (size_t i = 0; i < changes.size(); i++)
+			JournalBenchAdd(changes[i], journal);
+		double elapsed = timer.Elapsed();
+		InterlockedExchange(&done, 1);
+		for (size_t i = 0; i < changes.size(); i++)
+			all.assign_union(changes[i].region);
+
+		bool ok = (int)threads.size() == viewers;
+		if (!threads.empty())
+			WaitForMultipleObjects((DWORD)threads.size(), &threads[0], TRUE, INFINITE);
+		for (size_t i = 0; i < threads.size(); i++)
+			CloseHandle(threads[i]);
+		for (int i = 0; i < viewers; i++) {
+			ok = ok && v[i].seen.equals(all);
+			journal.Detach(v[i].reader);
+		}
+		return ok ? elapsed : -1;
+	}
+}
+
+bool JournalBench()
+{
+	std::vector<JournalBenchChange> changes;
+	JournalBenchChanges(changes);
+
+	bool ordered = JournalBenchOrder(changes);
+	BenchPrint("%i changes, %i viewers, one stalled  every read as direct  %s\n",
+		JOURNAL_BENCH_CHANGES, JOURNAL_BENCH_VIEWERS, BenchCheck(ordered));
+
+	double onetime = JournalBenchThreads(changes, 1);
+	double alltime = JournalBenchThreads(changes, JOURNAL_BENCH_VIEWERS);
+	bool threaded = onetime >= 0 && alltime >= 0;
+	BenchPrint("adds with reader threads  1 viewer %.1f ms  %i viewers, one stalled %.1f ms  %s\n",
+		onetime, JOURNAL_BENCH_VIEWERS, alltime, BenchCheck(threaded));
+	return ordered && threaded;
+}
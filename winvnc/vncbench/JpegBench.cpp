@@ -0,0 +1,316 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// JpegBench.cpp: Tight JPEG rects, decoded the way the viewer does and
+// compressed the way the Tight and Ultra2 encoders do.
+
+#include "vncbench.h"
+#include "common/JpegDecoder.h"
+#include "JpegCompressor.h"
+
+namespace {
+	enum {
+		JPEG_TILE_W = 256, JPEG_TILE_H = 128,
+		JPEG_ENC_TILE_W = 256, JPEG_ENC_TILE_H = 256,
+		JPEG_PASSES = 10
+	};
+
+	struct JpegBenchRect {
+		int x, y, w, h;
+		unsigned char *data;
+		unsigned long len;
+	};
+
+	// Tight sized JPEG rects covering the frame
+	bool JpegBenchRecord(const BenchFrame &frame, std::vector<JpegBenchRect> &rects)
+	{
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&cinfo);
+		BYTE *row = new BYTE[JPEG_TILE_W * 3];
+		for (int y = 0; y < frame.height; y += JPEG_TILE_H) {
+			for (int x = 0; x < frame.width; x += JPEG_TILE_W) {
+				JpegBenchRect r;
+				r.x = x;
+				r.y = y;
+				r.w = min(frame.width - x, (int)JPEG_TILE_W);
+				r.h = min(frame.height - y, (int)JPEG_TILE_H);
+				r.data = NULL;
+				r.len = 0;
+				jpeg_mem_dest(&cinfo, &r.data, &r.len);
+				cinfo.image_width = r.w;
+				cinfo.image_height = r.h;
+				cinfo.input_components = 3;
+				cinfo.in_color_space = JCS_RGB;
+				jpeg_set_defaults(&cinfo);
+				jpeg_set_quality(&cinfo, 75, TRUE);
+				jpeg_start_compress(&cinfo, TRUE);
+				while (cinfo.next_scanline < cinfo.image_height) {
+					const BYTE *src = frame.data + (r.y + cinfo.next_scanline) * frame.Stride() + r.x * 4;
+					for (int i = 0; i < r.w; i++) {
+						row[i * 3] = src[i * 4 + 2];
+						row[i * 3 + 1] = src[i * 4 + 1];
+						row[i * 3 + 2] = src[i * 4];
+					}
+					JSAMPROW rowPointer = row;
+					jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+				}
+				jpeg_finish_compress(&cinfo);
+				rects.push_back(r);
+			}
+		}
+		delete [] row;
+		jpeg_destroy_compress(&cinfo);
+		return !rects.empty();
+	}
+
+	// What the viewer did before JpegDecoder, for 32 bit BGRX
+	void JpegBenchOldDecode(const JpegBenchRect &r, BYTE *dst, int stride, BYTE *row)
+	{
+		jpeg_decompress_struct cinfo;
+		jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&cinfo);
+		jpeg_mem_src(&cinfo, r.data, r.len);
+		jpeg_read_header(&cinfo, TRUE);
+		cinfo.out_color_space = JCS_RGB;
+		jpeg_start_decompress(&cinfo);
+		JSAMPROW rowPointer = row;
+		for (int dy = 0; cinfo.output_scanline < cinfo.output_height; dy++) {
+			jpeg_read_scanlines(&cinfo, &rowPointer, 1);
+			CARD32 *p = (CARD32 *)(dst + (r.y + dy) * stride + r.x * 4);
+			for (int dx = 0; dx < r.w; dx++)
+				p[dx] = ((CARD32)row[dx * 3] << 16) | ((CARD32)row[dx * 3 + 1] << 8) | row[dx * 3 + 2];
+		}
+		jpeg_finish_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+	}
+
+	// Pixels in the colour bits, the padding byte is not compared
+	bool JpegBenchSame(const BYTE *a, const BYTE *b, int size)
+	{
+		const CARD32 *pa = (const CARD32 *)a;
+		const CARD32 *pb = (const CARD32 *)b;
+		for (int i = 0; i < size / 4; i++) {
+			if ((pa[i] ^ pb[i]) & 0x00FFFFFF)
+				return false;
+		}
+		return true;
+	}
+
+	// The old viewer path (decompressor created per rect, per pixel
+	// conversion) against one persistent JpegDecoder and against the
+	// JpegDecodePool. The decoder outputs must match byte for byte.
+	bool JpegDecodeFrame(const BenchFrame &frame, JpegDecoder &decoder, JpegDecodePool *pool)
+	{
+		std::vector<JpegBenchRect> rects;
+		if (!JpegBenchRecord(frame, rects))
+			return false;
+		size_t total = 0;
+		for (size_t i = 0; i < rects.size(); i++)
+			total += rects[i].len;
+
+		int stride = frame.Stride();
+		int size = frame.Size();
+		std::vector<BYTE> oldOut(size), decOut(size), poolOut(size);
+		std::vector<BYTE> row(JPEG_TILE_W * 3);
+		JpegPixelFormat fmt;
+		fmt.Set(32, 255, 255, 255, 16, 8, 0);
+
+		double oldTime = 0, decTime = 0, poolTime = 0;
+		int failed = 0;
+		for (int pass = 0; pass < JPEG_PASSES; pass++) {
+			BenchTimer timer;
+			for (size_t i = 0; i < rects.size(); i++)
+				JpegBenchOldDecode(rects[i], &oldOut[0], stride, &row[0]);
+			oldTime += timer.Elapsed();
+
+			timer.Restart();
+			for (size_t i = 0; i < rects.size(); i++) {
+				const JpegBenchRect &r = rects[i];
+				if (!decoder.Decode(r.data, r.len, r.w, r.h, fmt, &decOut[0] + r.y * stride + r.x * 4, stride))
+					failed++;
+			}
+			decTime += timer.Elapsed();
+
+			if (pool) {
+				// The copy stands in for the socket read of each rect
+				timer.Restart();
+				for (size_t i = 0; i < rects.size(); i++) {
+					const JpegBenchRect &r = rects[i];
+					if (pool->Full()) {
+						failed += pool->Wait();
+						pool->Draw();
+					}
+					BYTE *buf = pool->Reserve(r.len);
+					memcpy(buf, r.data, r.len);
+					pool->Submit(r.len, r.w, r.h, &poolOut[0] + r.y * stride + r.x * 4, stride, r.x, r.y);
+				}
+				failed += pool->Wait();
+				pool->Draw();
+				poolTime += timer.Elapsed();
+			}
+		}
+
+		bool ok = failed == 0 && JpegBenchSame(&oldOut[0], &decOut[0], size) &&
+				  (pool == NULL || memcmp(&decOut[0], &poolOut[0], size) == 0);
+		BenchPrint("%-8s %ix%i %i rects %i bytes x%i  per rect %.0f ms  persistent %.0f ms  pool %.0f ms  %s\n",
+			frame.name, frame.width, frame.height, (int)rects.size(), (int)total, JPEG_PASSES,
+			oldTime, decTime, poolTime, BenchCheck(ok));
+
+		for (size_t i = 0; i < rects.size(); i++)
+			free(rects[i].data);
+		return ok;
+	}
+
+	int JpegEncodeOld(const JpegSource &src, BYTE *dst, unsigned long dstSize)
+	{
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&cinfo);
+		unsigned char *out = dst;
+		unsigned long len = dstSize;
+		jpeg_mem_dest(&cinfo, &out, &len);
+		cinfo.image_width = src.width;
+		cinfo.image_height = src.height;
+		cinfo.input_components = 4;
+		cinfo.in_color_space = JCS_EXT_BGRX;
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, 75, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+		while (cinfo.next_scanline < cinfo.image_height) {
+			JSAMPROW rowPointer = (JSAMPROW)(src.data + cinfo.next_scanline * src.stride);
+			jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+		}
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+		if (out != dst) {
+			free(out);
+			return 0;
+		}
+		return (int)len;
+	}
+
+	// The old encoder path (compressor created per rect), one persistent
+	// JpegCompressor, and the JpegCompressorPool slicing each rect over the
+	// worker threads. Sliced output with a fixed restart interval must
+	// equal the single pass.
+	bool JpegEncodeFrame(BenchFrame &frame, JpegCompressor &compressor)
+	{
+		rfbPixelFormat format = {};
+		format.bitsPerPixel = 32;
+		format.depth = 24;
+		format.trueColour = 1;
+		format.redMax = format.greenMax = format.blueMax = 255;
+		format.redShift = 16;
+		format.greenShift = 8;
+		format.blueShift = 0;
+
+		std::vector<JpegSource> rects;
+		for (int y = 0; y < frame.height; y += JPEG_ENC_TILE_H) {
+			for (int x = 0; x < frame.width; x += JPEG_ENC_TILE_W) {
+				JpegSource src;
+				src.data = frame.data + y * frame.Stride() + x * 4;
+				src.stride = frame.Stride();
+				src.width = min(frame.width - x, (int)JPEG_ENC_TILE_W);
+				src.height = min(frame.height - y, (int)JPEG_ENC_TILE_H);
+				src.format = format;
+				rects.push_back(src);
+			}
+		}
+
+		int dstSize = JPEG_ENC_TILE_W * JPEG_ENC_TILE_H * 4;
+		std::vector<BYTE> single(dstSize), sliced(dstSize);
+		JpegSettings settings;
+
+		double oldTime = 0, singleTime = 0, poolTime = 0;
+		size_t oldTotal = 0, singleTotal = 0, poolTotal = 0;
+		for (int pass = 0; pass < JPEG_PASSES; pass++) {
+			BenchTimer timer;
+			for (size_t i = 0; i < rects.size(); i++)
+				oldTotal += JpegEncodeOld(rects[i], &single[0], dstSize);
+			oldTime += timer.Elapsed();
+
+			timer.Restart();
+			for (size_t i = 0; i < rects.size(); i++)
+				singleTotal += compressor.Compress(rects[i], 0, rects[i].height, settings, &single[0], dstSize);
+			singleTime += timer.Elapsed();
+
+			timer.Restart();
+			for (size_t i = 0; i < rects.size(); i++)
+				poolTotal += JpegCompressorPool::Compress(rects[i], settings, &sliced[0], dstSize);
+			poolTime += timer.Elapsed();
+		}
+
+		// With the same restart interval the slices join into the same bytes
+		bool ok = oldTotal != 0 && singleTotal != 0 && poolTotal != 0;
+		JpegSettings restart = settings;
+		restart.restartRows = 1;
+		for (size_t i = 0; i < rects.size() && ok; i++) {
+			int a = compressor.Compress(rects[i], 0, rects[i].height, restart, &single[0], dstSize);
+			int b = JpegCompressorPool::Compress(rects[i], restart, &sliced[0], dstSize);
+			ok = a != 0 && a == b && memcmp(&single[0], &sliced[0], a) == 0;
+		}
+
+		BenchPrint("%-8s %ix%i %i rects x%i  per rect %.0f ms %i bytes  persistent %.0f ms %i bytes  pool %.0f ms %i bytes  %s\n",
+			frame.name, frame.width, frame.height, (int)rects.size(), JPEG_PASSES,
+			oldTime, (int)oldTotal, singleTime, (int)singleTotal, poolTime, (int)poolTotal, BenchCheck(ok));
+		return ok;
+	}
+}
+
+bool JpegDecodeBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+	JpegDecoder decoder;
+	JpegDecodePool *pool = JpegDecodePool::Create();
+	if (pool == NULL)
+		BenchPrint("one CPU, no decode pool\n");
+	else {
+		JpegPixelFormat fmt;
+		fmt.Set(32, 255, 255, 255, 16, 8, 0);
+		pool->SetFormat(fmt);
+	}
+	bool ok = true;
+	for (size_t i = 0; i < frames.size(); i++)
+		ok = JpegDecodeFrame(frames[i], decoder, pool) && ok;
+	delete pool;
+	return ok;
+}
+
+bool JpegEncodeBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+	JpegCompressor compressor;
+	bool ok = true;
+	for (size_t i = 0; i < frames.size(); i++)
+		ok = JpegEncodeFrame(frames[i], compressor) && ok;
+	return ok;
+}
@@ -0,0 +1,170 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// RecordBench.cpp: the cost of sealing DSM records with CRecordCipher.
+
+#include "vncbench.h"
+#include <DSMPlugin/RecordCipher.h>
+
+// Pushes the same data through a loopback TCP connection twice: plain,
+// and sealed/opened as DSM records with the reference cipher, the way
+// VSocket and the viewer do it. The ratio is the cost of encryption.
+namespace {
+	const int RECORD_BENCH_BYTES = 32 * 1024 * 1024;
+
+	struct RecordBenchSender {
+		SOCKET sock;
+		CRecordCipher *cipher;
+	};
+
+	bool RecordBenchSendAll(SOCKET sock, const char *buf, int len)
+	{
+		while (len > 0) {
+			int n = send(sock, buf, len, 0);
+			if (n <= 0)
+				return false;
+			buf += n;
+			len -= n;
+		}
+		return true;
+	}
+
+	bool RecordBenchRecvAll(SOCKET sock, char *buf, int len)
+	{
+		while (len > 0) {
+			int n = recv(sock, buf, len, 0);
+			if (n <= 0)
+				return false;
+			buf += n;
+			len -= n;
+		}
+		return true;
+	}
+
+	DWORD WINAPI RecordBenchSend(LPVOID lpParam)
+	{
+		RecordBenchSender *sender = (RecordBenchSender *)lpParam;
+		int payload = CRecordCipher::DEFAULT_MAX_PAYLOAD;
+		char *buf = new char[CRecordCipher::HEADER_SIZE + payload + CRecordCipher::TAG_SIZE];
+		memset(buf, 0x5a, CRecordCipher::HEADER_SIZE + payload + CRecordCipher::TAG_SIZE);
+		for (int sent = 0; sent < RECORD_BENCH_BYTES; sent += payload) {
+			if (sender->cipher) {
+				int len = sender->cipher->SealRecord((BYTE *)buf, payload);
+				if (!RecordBenchSendAll(sender->sock, buf, len))
+					break;
+			}
+			else if (!RecordBenchSendAll(sender->sock, buf, payload))
+				break;
+		}
+		delete [] buf;
+		return 0;
+	}
+
+	// Milliseconds for RECORD_BENCH_BYTES, negative when the data did not
+	// all arrive or a record failed to open
+	double RecordBenchRun(bool encrypted)
+	{
+		SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == INVALID_SOCKET)
+			return -1;
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		int addrlen = sizeof(addr);
+		if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0
+			|| getsockname(listener, (sockaddr *)&addr, &addrlen) != 0) {
+			closesocket(listener);
+			return -1;
+		}
+		SOCKET out = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (connect(out, (sockaddr *)&addr, sizeof(addr)) != 0) {
+			closesocket(out);
+			closesocket(listener);
+			return -1;
+		}
+		SOCKET in = accept(listener, NULL, NULL);
+		closesocket(listener);
+
+		BYTE key[CRecordCipher::KEY_SIZE];
+		for (int i = 0; i < CRecordCipher::KEY_SIZE; i++)
+			key[i] = (BYTE)(i * 7 + 1);
+		CRecordCipher server, viewer;
+		server.SetKey(key, true);
+		viewer.SetKey(key, false);
+
+		RecordBenchSender sender;
+		sender.sock = out;
+		sender.cipher = encrypted ? &server : NULL;
+
+		BenchTimer timer;
+		HANDLE thread = CreateThread(NULL, 0, RecordBenchSend, &sender, 0, NULL);
+
+		int recsize = CRecordCipher::HEADER_SIZE + CRecordCipher::DEFAULT_MAX_PAYLOAD + CRecordCipher::TAG_SIZE;
+		char *buf = new char[recsize];
+		int received = 0;
+		while (received < RECORD_BENCH_BYTES) {
+			if (encrypted) {
+				if (!RecordBenchRecvAll(in, buf, CRecordCipher::HEADER_SIZE))
+					break;
+				int len = viewer.GetRecordLength((BYTE *)buf);
+				if (len == 0 || !RecordBenchRecvAll(in, buf + CRecordCipher::HEADER_SIZE, len - CRecordCipher::HEADER_SIZE))
+					break;
+				int data = viewer.OpenRecord((BYTE *)buf, len);
+				if (data < 0)
+					break;
+				received += data;
+			}
+			else {
+				int n = recv(in, buf, CRecordCipher::DEFAULT_MAX_PAYLOAD, 0);
+				if (n <= 0)
+					break;
+				received += n;
+			}
+		}
+		double elapsed = timer.Elapsed();
+
+		// Unblocks the sender when the receiver gave up early
+		closesocket(in);
+		if (thread != NULL) {
+			WaitForSingleObject(thread, INFINITE);
+			CloseHandle(thread);
+		}
+		delete [] buf;
+		closesocket(out);
+		return received == RECORD_BENCH_BYTES ? elapsed : -1;
+	}
+}
+
+bool RecordBench()
+{
+	double plaintime = RecordBenchRun(false);
+	double recordtime = RecordBenchRun(true);
+	double bytes = RECORD_BENCH_BYTES;
+	BenchPrint("%i MB loopback  plain %.0f ms (%.0f MB/s)  records %.0f ms (%.0f MB/s)  %s\n",
+		RECORD_BENCH_BYTES / (1024 * 1024), plaintime, BenchRate(bytes, plaintime),
+		recordtime, BenchRate(bytes, recordtime), BenchCheck(plaintime >= 0 && recordtime >= 0));
+	return plaintime >= 0 && recordtime >= 0;
+}
@@ -0,0 +1,515 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// RectDecodeBench.cpp: the viewer's Hextile, RRE and CoRRE decoders on
+// what the server's encoders send for the bench frames, in 64x64 rects
+// the way damage arrives.
+//
+// The decoders are hextileDecode.h, rreDecode.h and correDecode.h of
+// vncviewer, included below inside a namespace with a ClientConnection
+// that has what they use. Its ReadRectBytes() reads as the viewer's does:
+// in place from the rdr::InStream window, or from the opened DSM record,
+// here sealed by CRecordCipher. The "ReadExact" times copy every field
+// through ReadExact() instead, as the decoders read before. Each decode
+// is checked against Raw rects decoded into the same framebuffer.
+
+#include "vncbench.h"
+#include "omnithread.h"
+#include "vncencoder.h"
+#include "vncencoderre.h"
+#include "vncencodecorre.h"
+#include "vncencodehext.h"
+#include <DSMPlugin/RecordCipher.h>
+#include <rdr/MemInStream.h>
+#include <rdr/Exception.h>
+#include <algorithm>
+
+namespace RectDecode {
+	// What the decoders use of the viewer besides ClientConnection
+	static char sz_L70[64] = "Too many RRE subrects";
+
+	class ErrorException
+	{
+	public:
+		ErrorException(const char *info) : m_info(info) {};
+		const char *m_info;
+	};
+
+	// Largest read ReadRectBytes() serves from the rdr window, as the viewer's
+	enum { RECT_INPLACE_MAX = 4096 };
+
+	class ClientConnection
+	{
+	public:
+		ClientConnection(const rfbPixelFormat &format, int width, int height);
+		~ClientConnection();
+
+		// One update of rects from in, records opened with records when
+		// it is not NULL. inPlace false reads every field with ReadExact().
+		void Decode(rdr::InStream &in, IRecordPlugin *records, bool inPlace);
+
+		BYTE *m_DIBbits;
+		int m_DIBsize;
+
+	private:
+		const CARD8 *ReadRectBytes(int bytes);
+		void ReadExact(char *buf, int bytes);
+		void ReadRecordData(char *buf, int bytes);
+		void CheckBufferSize(UINT bufsize);
+
+		void ReadRawRect(rfbFramebufferUpdateRectHeader *pfburh);
+		void ReadRRERect(rfbFramebufferUpdateRectHeader *pfburh);
+		void ReadCoRRERect(rfbFramebufferUpdateRectHeader *pfburh);
+		void ReadHextileRect(rfbFramebufferUpdateRectHeader *pfburh);
+		void HandleHextileEncoding8(int x, int y, int w, int h);
+		void HandleHextileEncoding16(int x, int y, int w, int h);
+		void HandleHextileEncoding32(int x, int y, int w, int h);
+
+		// As the viewer's, into m_DIBbits, but a rect outside it throws
+		void ConvertAll(int width, int height, int xx, int yy,int bytes_per_pixel,BYTE* source,BYTE* dest,int framebufferWidth, int framebufferHeight);
+		void SolidColor(int width, int height, int xx, int yy,int bytes_per_pixel,BYTE* source,BYTE* dest,int framebufferWidth);
+		inline void FillSolidRect_ultra(int x, int y, int w, int h, int bpp,BYTE *color) {
+			if (m_DIBbits) SolidColor(w, h, x, y,bpp/8,(BYTE*) color,(BYTE*)m_DIBbits,m_si.framebufferWidth);
+		};
+
+		enum { RRE_SUBRECT_CHUNK = 256 };
+
+		rfbPixelFormat m_myFormat;
+		unsigned int m_minPixelBytes;
+		rfbServerInitMsg m_si;
+		omni_mutex m_bitmapdcMutex;
+		rdr::InStream *fis;
+		bool m_fInPlace;
+
+		char *m_netbuf;
+		UINT m_netbufsize;
+
+		IRecordPlugin *m_pRecordPlugin;
+		bool m_fRecordsIn;
+		BYTE *m_pRecordInBuf;
+		int m_nRecordInBufSize;
+		int m_nRecordInPos;
+		int m_nRecordInEnd;
+	};
+
+#define SETPIXELS(buffer, bpp, x, y, w, h)										\
+	{																			\
+			if (m_DIBbits) ConvertAll(w,h,x,y,bpp/8,(BYTE*)buffer,(BYTE*)m_DIBbits,m_si.framebufferWidth,m_si.framebufferHeight);\
+	}
+
+#include <vncviewer/hextileDecode.h>
+#include <vncviewer/rreDecode.h>
+#include <vncviewer/correDecode.h>
+
+#undef SETPIXELS
+
+	ClientConnection::ClientConnection(const rfbPixelFormat &format, int width, int height)
+	{
+		m_myFormat = format;
+		m_minPixelBytes = format.bitsPerPixel / 8;
+		memset(&m_si, 0, sizeof(m_si));
+		m_si.framebufferWidth = (CARD16)width;
+		m_si.framebufferHeight = (CARD16)height;
+		// The viewer's DIB section rows are 4 byte aligned
+		int row = (width * m_minPixelBytes + 3) & ~3;
+		m_DIBsize = row * height;
+		m_DIBbits = new BYTE[m_DIBsize];
+		memset(m_DIBbits, 0, m_DIBsize);
+		fis = NULL;
+		m_fInPlace = true;
+		m_netbufsize = 4096;
+		m_netbuf = new char[m_netbufsize];
+		m_pRecordPlugin = NULL;
+		m_fRecordsIn = false;
+		m_nRecordInBufSize = CRecordCipher::HEADER_SIZE + CRecordCipher::DEFAULT_MAX_PAYLOAD + CRecordCipher::TAG_SIZE;
+		m_pRecordInBuf = new BYTE[m_nRecordInBufSize];
+		m_nRecordInPos = 0;
+		m_nRecordInEnd = 0;
+	}
+
+	ClientConnection::~ClientConnection()
+	{
+		delete [] m_DIBbits;
+		delete [] m_netbuf;
+		delete [] m_pRecordInBuf;
+	}
+
+	void ClientConnection::Decode(rdr::InStream &in, IRecordPlugin *records, bool inPlace)
+	{
+		fis = &in;
+		m_fInPlace = inPlace;
+		m_pRecordPlugin = records;
+		m_fRecordsIn = records != NULL;
+		m_nRecordInPos = 0;
+		m_nRecordInEnd = 0;
+		// Until the stream and the last record run out
+		while (m_nRecordInPos < m_nRecordInEnd || in.getptr() < in.getend()) {
+			rfbFramebufferUpdateRectHeader surh;
+			ReadExact((char *)&surh, sz_rfbFramebufferUpdateRectHeader);
+			surh.encoding = Swap32IfLE(surh.encoding);
+			surh.r.x = Swap16IfLE(surh.r.x);
+			surh.r.y = Swap16IfLE(surh.r.y);
+			surh.r.w = Swap16IfLE(surh.r.w);
+			surh.r.h = Swap16IfLE(surh.r.h);
+			switch (surh.encoding) {
+			case rfbEncodingRaw:
+				ReadRawRect(&surh);
+				break;
+			case rfbEncodingRRE:
+				ReadRRERect(&surh);
+				break;
+			case rfbEncodingCoRRE:
+				ReadCoRRERect(&surh);
+				break;
+			case rfbEncodingHextile:
+				ReadHextileRect(&surh);
+				break;
+			default:
+				throw rdr::Exception("unexpected encoding");
+			}
+		}
+		fis = NULL;
+	}
+
+	// As ClientConnection::ReadRectBytes(), with the restored rect buffer
+	// of the non record plugins left out
+	const CARD8 *ClientConnection::ReadRectBytes(int bytes)
+	{
+		if (bytes <= 0)
+			return (CARD8 *)m_netbuf;
+
+		if (m_fInPlace && m_fRecordsIn)
+		{
+			if (m_nRecordInEnd - m_nRecordInPos >= bytes)
+			{
+				// Within the current record
+				const CARD8 *p = m_pRecordInBuf + m_nRecordInPos;
+				m_nRecordInPos += bytes;
+				return p;
+			}
+		}
+		else if (m_fInPlace && bytes <= RECT_INPLACE_MAX)
+		{
+			fis->check(bytes);
+			const CARD8 *p = fis->getptr();
+			fis->setptr(p + bytes);
+			return p;
+		}
+
+		CheckBufferSize(bytes);
+		ReadExact(m_netbuf, bytes);
+		return (const CARD8 *)m_netbuf;
+	}
+
+	void ClientConnection::ReadExact(char *buf, int bytes)
+	{
+		if (m_fRecordsIn)
+			ReadRecordData(buf, bytes);
+		else
+			fis->readBytes(buf, bytes);
+	}
+
+	// As ClientConnection::ReadRecordData()
+	void ClientConnection::ReadRecordData(char *buf, int bytes)
+	{
+		while (bytes > 0)
+		{
+			if (m_nRecordInPos == m_nRecordInEnd)
+			{
+				// Next record: the header tells how much follows
+				int nHeader = m_pRecordPlugin->GetRecordHeaderSize();
+				fis->readBytes(m_pRecordInBuf, nHeader);
+				int nRecordLen = m_pRecordPlugin->GetRecordLength(m_pRecordInBuf);
+				if (nRecordLen < nHeader || nRecordLen > m_nRecordInBufSize)
+					throw rdr::Exception("invalid record length");
+				fis->readBytes(m_pRecordInBuf + nHeader, nRecordLen - nHeader);
+				int nDataLen = m_pRecordPlugin->OpenRecord(m_pRecordInBuf, nRecordLen);
+				if (nDataLen < 0)
+					throw rdr::Exception("OpenRecord failed");
+				m_nRecordInPos = nHeader;
+				m_nRecordInEnd = nHeader + nDataLen;
+				continue;
+			}
+			int n = m_nRecordInEnd - m_nRecordInPos;
+			if (n > bytes) n = bytes;
+			memcpy(buf, m_pRecordInBuf + m_nRecordInPos, n);
+			m_nRecordInPos += n;
+			buf += n;
+			bytes -= n;
+		}
+	}
+
+	void ClientConnection::CheckBufferSize(UINT bufsize)
+	{
+		if (m_netbufsize >= bufsize)
+			return;
+		delete [] m_netbuf;
+		m_netbuf = new char[bufsize + 256];
+		m_netbufsize = bufsize + 256;
+	}
+
+	void ClientConnection::ReadRawRect(rfbFramebufferUpdateRectHeader *pfburh)
+	{
+		UINT numpixels = pfburh->r.w * pfburh->r.h;
+		UINT numbytes = numpixels * m_minPixelBytes;
+		CheckBufferSize(numbytes);
+		ReadExact(m_netbuf, numbytes);
+		omni_mutex_lock l(m_bitmapdcMutex);
+		ConvertAll(pfburh->r.w, pfburh->r.h, pfburh->r.x, pfburh->r.y, m_minPixelBytes, (BYTE *)m_netbuf,
+			m_DIBbits, m_si.framebufferWidth, m_si.framebufferHeight);
+	}
+
+	void ClientConnection::ConvertAll(int width, int height, int xx, int yy,int bytes_per_pixel,BYTE* source,BYTE* dest,int framebufferWidth, int framebufferHeight)
+	{
+		int bytesPerInputRow = width * bytes_per_pixel;
+		int bytesPerOutputRow = framebufferWidth * bytes_per_pixel;
+		if (bytesPerOutputRow % 4)
+			bytesPerOutputRow += 4 - bytesPerOutputRow % 4;
+		if ((xx + width) > framebufferWidth || (yy + height) > framebufferHeight)
+			throw rdr::Exception("rect outside the framebuffer");
+
+		BYTE *destpos = dest + (bytesPerOutputRow * yy) + (xx * bytes_per_pixel);
+		for (int y = 0; y < height; y++) {
+			memcpy(destpos, source, width * bytes_per_pixel);
+			source += bytesPerInputRow;
+			destpos += bytesPerOutputRow;
+		}
+	}
+
+	void ClientConnection::SolidColor(int width, int height, int xx, int yy,int bytes_per_pixel,BYTE* source,BYTE* dest,int framebufferWidth)
+	{
+		int bytesPerOutputRow = framebufferWidth * bytes_per_pixel;
+		if (bytesPerOutputRow % 4)
+			bytesPerOutputRow += 4 - bytesPerOutputRow % 4;
+		if ((xx + width) > framebufferWidth || (yy + height) > m_si.framebufferHeight)
+			throw rdr::Exception("rect outside the framebuffer");
+
+		BYTE *destpos = dest + (bytesPerOutputRow * yy) + (xx * bytes_per_pixel);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++)
+				memcpy(destpos + x * bytes_per_pixel, source, bytes_per_pixel);
+			destpos += bytesPerOutputRow;
+		}
+	}
+}
+
+namespace {
+	const int RECT_BENCH_SIZE = 64;
+
+	struct RectBenchCase {
+		const char *name;
+		int encoding;
+	};
+
+	const RectBenchCase g_rectBenchCases[] = {
+		{ "Hextile", rfbEncodingHextile },
+		{ "RRE", rfbEncodingRRE },
+		{ "CoRRE", rfbEncodingCoRRE },
+	};
+
+	// The viewer's usual formats: BGR233, RGB565 and 32 bit
+	const int g_rectBenchBpp[] = { 8, 16, 32 };
+
+	void RectBenchFormat(int bpp, rfbPixelFormat &format)
+	{
+		memset(&format, 0, sizeof(format));
+		format.bitsPerPixel = (CARD8)bpp;
+		format.trueColour = 1;
+		switch (bpp) {
+		case 8:
+			format.depth = 8;
+			format.redMax = 7; format.greenMax = 7; format.blueMax = 3;
+			format.redShift = 0; format.greenShift = 3; format.blueShift = 6;
+			break;
+		case 16:
+			format.depth = 16;
+			format.redMax = 31; format.greenMax = 63; format.blueMax = 31;
+			format.redShift = 11; format.greenShift = 5; format.blueShift = 0;
+			break;
+		default:
+			format.depth = 24;
+			format.redMax = format.greenMax = format.blueMax = 255;
+			format.redShift = 16; format.greenShift = 8; format.blueShift = 0;
+		}
+	}
+
+	vncEncoder *RectBenchCreate(int encoding)
+	{
+		switch (encoding) {
+		case rfbEncodingRRE: return new vncEncodeRRE;
+		case rfbEncodingCoRRE: return new vncEncodeCoRRE;
+		case rfbEncodingHextile: return new vncEncodeHexT;
+		}
+		return new vncEncoder;
+	}
+
+	// What the server sends for the frame in <bpp>, the rects one after the
+	// other. The encoders send Raw for a rect that would come out larger.
+	void RectBenchEncode(const BenchFrame &frame, int encoding, int bpp, std::vector<BYTE> &stream)
+	{
+		rfbPixelFormat local, remote;
+		RectBenchFormat(32, local);
+		RectBenchFormat(bpp, remote);
+		vncEncoder *encoder = RectBenchCreate(encoding);
+		encoder->Init();
+		encoder->SetLocalFormat(local, frame.width, frame.height);
+		encoder->SetRemoteFormat(remote);
+		encoder->SetBufferOffset(0, 0);
+		std::vector<BYTE> dest(encoder->RequiredBuffSize(RECT_BENCH_SIZE, RECT_BENCH_SIZE));
+
+		stream.clear();
+		for (int y = 0; y < frame.height; y += RECT_BENCH_SIZE) {
+			for (int x = 0; x < frame.width; x += RECT_BENCH_SIZE) {
+				rfb::Rect rect(x, y, std::min(x + RECT_BENCH_SIZE, frame.width),
+					std::min(y + RECT_BENCH_SIZE, frame.height));
+				UINT size = encoder->EncodeRect(frame.data, &dest[0], rect);
+				stream.insert(stream.end(), dest.begin(), dest.begin() + size);
+			}
+		}
+		delete encoder;
+	}
+
+	void RectBenchKey(BYTE *key)
+	{
+		for (int i = 0; i < CRecordCipher::KEY_SIZE; i++)
+			key[i] = (BYTE)(i * 7 + 1);
+	}
+
+	// The stream in CRecordCipher records, as a record framed server sends it
+	void RectBenchSeal(const std::vector<BYTE> &stream, std::vector<BYTE> &sealed)
+	{
+		BYTE key[CRecordCipher::KEY_SIZE];
+		RectBenchKey(key);
+		CRecordCipher server;
+		server.SetKey(key, true);
+
+		int payload = server.GetMaxRecordPayload();
+		std::vector<BYTE> record(CRecordCipher::HEADER_SIZE + payload + CRecordCipher::TAG_SIZE);
+		sealed.clear();
+		for (size_t pos = 0; pos < stream.size(); pos += payload) {
+			int n = (int)std::min<size_t>(payload, stream.size() - pos);
+			memcpy(&record[CRecordCipher::HEADER_SIZE], &stream[pos], n);
+			int len = server.SealRecord(&record[0], n);
+			if (len <= 0)
+				throw rdr::Exception("SealRecord failed");
+			sealed.insert(sealed.end(), record.begin(), record.begin() + len);
+		}
+	}
+
+	void RectBenchDecode(RectDecode::ClientConnection &cc, const std::vector<BYTE> &stream, bool sealed, bool inPlace)
+	{
+		rdr::MemInStream in(&stream[0], (int)stream.size());
+		if (!sealed) {
+			cc.Decode(in, NULL, inPlace);
+			return;
+		}
+		BYTE key[CRecordCipher::KEY_SIZE];
+		RectBenchKey(key);
+		CRecordCipher viewer;
+		viewer.SetKey(key, false);
+		cc.Decode(in, &viewer, inPlace);
+	}
+
+	// Best of the passes, in ms
+	double RectBenchTime(RectDecode::ClientConnection &cc, const std::vector<BYTE> &stream, bool sealed, bool inPlace)
+	{
+		double best = 0;
+		for (int pass = 0; pass < g_benchOptions.passes; pass++) {
+			BenchTimer timer;
+			RectBenchDecode(cc, stream, sealed, inPlace);
+			double elapsed = timer.Elapsed();
+			if (pass == 0 || elapsed < best)
+				best = elapsed;
+		}
+		return best;
+	}
+
+	// Every way of reading, in every format, against Raw
+	bool RectBenchCheck(const BenchFrame &frame, int encoding)
+	{
+		bool same = true;
+		std::vector<BYTE> raw, stream, sealed;
+		for (int i = 0; i < (int)(sizeof(g_rectBenchBpp) / sizeof(g_rectBenchBpp[0])); i++) {
+			rfbPixelFormat format;
+			RectBenchFormat(g_rectBenchBpp[i], format);
+			RectDecode::ClientConnection reference(format, frame.width, frame.height);
+			RectBenchEncode(frame, rfbEncodingRaw, g_rectBenchBpp[i], raw);
+			RectBenchDecode(reference, raw, false, true);
+
+			RectBenchEncode(frame, encoding, g_rectBenchBpp[i], stream);
+			RectBenchSeal(stream, sealed);
+			for (int way = 0; way < 4; way++) {
+				RectDecode::ClientConnection cc(format, frame.width, frame.height);
+				RectBenchDecode(cc, (way & 2) ? sealed : stream, (way & 2) != 0, (way & 1) != 0);
+				same = same && memcmp(cc.m_DIBbits, reference.m_DIBbits, cc.m_DIBsize) == 0;
+			}
+		}
+		return same;
+	}
+}
+
+bool RectDecodeBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+
+	bool ok = true;
+	for (size_t i = 0; i < frames.size(); i++) {
+		const BenchFrame &frame = frames[i];
+		for (int c = 0; c < (int)(sizeof(g_rectBenchCases) / sizeof(g_rectBenchCases[0])); c++) {
+			const RectBenchCase &bc = g_rectBenchCases[c];
+			try {
+				bool same = RectBenchCheck(frame, bc.encoding);
+
+				// Timed in 32 bit
+				rfbPixelFormat format;
+				RectBenchFormat(32, format);
+				std::vector<BYTE> stream, sealed;
+				RectBenchEncode(frame, bc.encoding, 32, stream);
+				RectBenchSeal(stream, sealed);
+				RectDecode::ClientConnection cc(format, frame.width, frame.height);
+				double plainCopy = RectBenchTime(cc, stream, false, false);
+				double plainInPlace = RectBenchTime(cc, stream, false, true);
+				double sealedCopy = RectBenchTime(cc, sealed, true, false);
+				double sealedInPlace = RectBenchTime(cc, sealed, true, true);
+
+				BenchPrint("%-8s %ix%i %-8s %5.1f MB  ReadExact %6.2f ms  in place %6.2f ms (%.1fx)  "
+					"DSM ReadExact %6.2f ms  in place %6.2f ms (%.1fx)  all formats %s\n",
+					frame.name, frame.width, frame.height, bc.name, stream.size() / 1048576.0,
+					plainCopy, plainInPlace, plainInPlace > 0 ? plainCopy / plainInPlace : 0.0,
+					sealedCopy, sealedInPlace, sealedInPlace > 0 ? sealedCopy / sealedInPlace : 0.0,
+					BenchCheck(same));
+				ok = ok && same;
+			} catch (rdr::Exception &e) {
+				BenchPrint("%-8s %-8s failed: %s\n", frame.name, bc.name, e.str());
+				ok = false;
+			} catch (RectDecode::ErrorException &e) {
+				BenchPrint("%-8s %-8s failed: %s\n", frame.name, bc.name, e.m_info);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
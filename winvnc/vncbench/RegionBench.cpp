@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// RegionBench.cpp: the banded Region2D against the GDI one.
+
+#include "vncbench.h"
+#include "rfbRegion_win32.h"
+#include "rfbRegion_banded.h"
+#include "ScreenCapture.h"
+
+namespace {
+	// Replays what vncBuffer::CheckRect and the update trackers do with a
+	// region on a fragmented desktop: scan order unions of 32x32 blocks,
+	// a clip, a subtract and a get_rects per frame.
+	__int64 RegionBenchArea(const std::vector<rfb::Rect> &rects)
+	{
+		__int64 area = 0;
+		for (size_t i = 0; i < rects.size(); i++)
+			area += (__int64)rects[i].width() * rects[i].height();
+		return area;
+	}
+
+	template <class REGION>
+	double RegionBenchRun(int width, int height, int frames, int &nrects, __int64 &area)
+	{
+		BenchTimer timer;
+		std::vector<rfb::Rect> rects;
+		REGION changed, cache;
+		unsigned int seed = 12345;
+		nrects = 0;
+		area = 0;
+		for (int f = 0; f < frames; f++) {
+			changed.clear();
+			for (int y = 0; y < height; y += 32) {
+				for (int x = 0; x < width; x += 32) {
+					seed = seed * 1103515245 + 12345;
+					if (((seed >> 16) & 7) < 3)
+						changed.assign_union(REGION(rfb::Rect(x, y, x + 32, y + 32)));
+				}
+			}
+			cache.assign_union(changed);
+			changed.assign_intersect(REGION(rfb::Rect(0, 0, width, height - 64)));
+			changed.assign_subtract(REGION(rfb::Rect(width / 4, height / 4, width / 2, height / 2)));
+			changed.get_rects(rects, true, true);
+			nrects += (int)rects.size();
+			area += RegionBenchArea(rects);
+			cache.assign_subtract(changed);
+		}
+		return timer.Elapsed();
+	}
+
+	// A driver cycle of MAXCHANGES_BUF glyph sized records along text lines,
+	// added one by one or swept at once with setRects()
+	double RegionDriverBenchRun(int width, int height, int frames, bool batch, int &nrects, __int64 &area)
+	{
+		BenchTimer timer;
+		std::vector<rfb::Rect> records, rects;
+		rfb::BandedRegion rgn;
+		unsigned int seed = 12345;
+		nrects = 0;
+		area = 0;
+		for (int f = 0; f < frames; f++) {
+			records.clear();
+			while ((int)records.size() < MAXCHANGES_BUF - 1) {
+				seed = seed * 1103515245 + 12345;
+				int x = (seed >> 8) % (width - 400);
+				int y = (seed >> 4) % (height - 16) / 16 * 16;
+				for (int g = 0; g < 40 && (int)records.size() < MAXCHANGES_BUF - 1; g++)
+					records.push_back(rfb::Rect(x + g * 8, y, x + g * 8 + 9, y + 16));
+			}
+			rgn.clear();
+			if (batch)
+				rgn.setRects(records);
+			else {
+				for (size_t i = 0; i < records.size(); i++)
+					rgn.assign_union(rfb::BandedRegion(records[i]));
+			}
+			rgn.get_rects(rects, true, true);
+			nrects += (int)rects.size();
+			area += RegionBenchArea(rects);
+		}
+		return timer.Elapsed();
+	}
+}
+
+bool RegionBench()
+{
+	int width = GetSystemMetrics(SM_CXSCREEN);
+	int height = GetSystemMetrics(SM_CYSCREEN);
+	int gdirects, bandedrects;
+	__int64 gdiarea, bandedarea;
+	double gditime = RegionBenchRun<rfb::Region>(width, height, 100, gdirects, gdiarea);
+	double bandedtime = RegionBenchRun<rfb::BandedRegion>(width, height, 100, bandedrects, bandedarea);
+	// The rects may be cut differently, the area they cover may not
+	bool ok = gdiarea == bandedarea;
+	BenchPrint("%ix%i x100  GDI %.0f ms (%i rects)  banded %.0f ms (%i rects)  %s\n",
+		width, height, gditime, gdirects, bandedtime, bandedrects, BenchCheck(ok));
+	int unionrects, sweeprects;
+	__int64 unionarea, sweeparea;
+	double uniontime = RegionDriverBenchRun(width, height, 50, false, unionrects, unionarea);
+	double sweeptime = RegionDriverBenchRun(width, height, 50, true, sweeprects, sweeparea);
+	BenchPrint("driver records x50  per record %.0f ms (%i rects)  setRects %.0f ms (%i rects)  %s\n",
+		uniontime, unionrects, sweeptime, sweeprects, BenchCheck(unionarea == sweeparea));
+	return ok && unionarea == sweeparea;
+}
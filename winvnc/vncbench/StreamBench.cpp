@@ -0,0 +1,285 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// StreamBench.cpp: the viewer's rdr::FdInStream reading updates from a
+// loopback TCP connection.
+
+#include "vncbench.h"
+#include "rdr/FdInStream.h"
+#include "rdr/Exception.h"
+
+#ifdef _VNC_PORTABLE
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int SOCKET;
+typedef socklen_t StreamBenchAddrLen;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+// A closed receiver fails send() instead of raising SIGPIPE
+#define STREAM_BENCH_SEND_FLAGS MSG_NOSIGNAL
+#else
+typedef int StreamBenchAddrLen;
+#define STREAM_BENCH_SEND_FLAGS 0
+#endif
+
+// A sender thread writes the same FramebufferUpdate over and over: Raw
+// rectangles of 16x16, 64x64 and 256x256 pixels, so the reader takes
+// small headers with readU16()/readU32() and pixel data with
+// readBytes(). The stream is read four ways: recv() into a 4 MB buffer,
+// the bound for the rest; FdInStream held at its first 8 KB buffer;
+// FdInStream without reading ahead of a large block, as in DSM mode;
+// and FdInStream as the viewer uses it.
+namespace {
+	const int STREAM_BENCH_BYTES = 512 * 1024 * 1024;
+	const int STREAM_BENCH_RECV = 4 * 1024 * 1024;
+
+	enum StreamBenchMode { RECV, FIXED, EXACT, ADAPTIVE, STREAM_BENCH_MODES };
+	const char *g_streamModes[STREAM_BENCH_MODES] = { "recv", "8 KB", "no ahead", "adaptive" };
+
+	struct StreamBenchRect {
+		int size;
+		int count;
+	};
+	const StreamBenchRect g_streamRects[] = { { 16, 64 }, { 64, 16 }, { 256, 8 } };
+
+	void StreamBenchPut16(std::vector<BYTE> &v, int value)
+	{
+		v.push_back((BYTE)(value >> 8));
+		v.push_back((BYTE)value);
+	}
+
+	void StreamBenchPut32(std::vector<BYTE> &v, int value)
+	{
+		StreamBenchPut16(v, value >> 16);
+		StreamBenchPut16(v, value);
+	}
+
+	// The value every byte of the pixels of rectangle <index> has
+	BYTE StreamBenchFill(int index)
+	{
+		return (BYTE)(index * 37 + 1);
+	}
+
+	// rfbFramebufferUpdate and its Raw rectangles, in a row of tiles
+	void StreamBenchUpdate(std::vector<BYTE> &update, int &rects)
+	{
+		rects = 0;
+		for (size_t i = 0; i < sizeof(g_streamRects) / sizeof(g_streamRects[0]); i++)
+			rects += g_streamRects[i].count;
+		update.push_back(rfbFramebufferUpdate);
+		update.push_back(0);
+		StreamBenchPut16(update, rects);
+		int index = 0;
+		for (size_t i = 0; i < sizeof(g_streamRects) / sizeof(g_streamRects[0]); i++) {
+			int size = g_streamRects[i].size;
+			for (int r = 0; r < g_streamRects[i].count; r++, index++) {
+				StreamBenchPut16(update, index);
+				StreamBenchPut16(update, size * (int)i);
+				StreamBenchPut16(update, size);
+				StreamBenchPut16(update, size);
+				StreamBenchPut32(update, rfbEncodingRaw);
+				update.insert(update.end(), size * size * 4, StreamBenchFill(index));
+			}
+		}
+	}
+
+	struct StreamBenchSender {
+		SOCKET sock;
+		const std::vector<BYTE> *update;
+		int updates;
+	};
+
+	DWORD WINAPI StreamBenchSend(LPVOID lpParam)
+	{
+		StreamBenchSender *sender = (StreamBenchSender *)lpParam;
+		const char *data = (const char *)&(*sender->update)[0];
+		int size = (int)sender->update->size();
+		for (int u = 0; u < sender->updates; u++) {
+			for (int sent = 0; sent < size; ) {
+				int n = send(sender->sock, data + sent, size - sent, STREAM_BENCH_SEND_FLAGS);
+				if (n <= 0)
+					return 0;
+				sent += n;
+			}
+		}
+		return 0;
+	}
+
+	bool StreamBenchConnect(SOCKET &in, SOCKET &out)
+	{
+		SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == INVALID_SOCKET)
+			return false;
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		StreamBenchAddrLen addrlen = sizeof(addr);
+		if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0
+			|| getsockname(listener, (sockaddr *)&addr, &addrlen) != 0) {
+			closesocket(listener);
+			return false;
+		}
+		out = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (connect(out, (sockaddr *)&addr, sizeof(addr)) != 0) {
+			closesocket(out);
+			closesocket(listener);
+			return false;
+		}
+		in = accept(listener, NULL, NULL);
+		closesocket(listener);
+		return in != INVALID_SOCKET;
+	}
+
+	// Reads <updates> updates the way the viewer does, false when the
+	// stream does not hold what was sent
+	bool StreamBenchParse(rdr::FdInStream &is, int updates, int rects, std::vector<BYTE> &pixels)
+	{
+		for (int u = 0; u < updates; u++) {
+			if (is.readU8() != rfbFramebufferUpdate)
+				return false;
+			is.skip(1);
+			if (is.readU16() != rects)
+				return false;
+			for (int r = 0; r < rects; r++) {
+				int x = is.readU16();
+				is.readU16();
+				int w = is.readU16();
+				int h = is.readU16();
+				if (x != r || (int)is.readU32() != rfbEncodingRaw)
+					return false;
+				int bytes = w * h * 4;
+				is.readBytes(&pixels[0], bytes);
+				if (pixels[0] != StreamBenchFill(r) || pixels[bytes - 1] != StreamBenchFill(r))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	struct StreamBenchResult {
+		double ms;
+		rdr::FdInStream::Stats stats;
+		int bufSize;
+	};
+
+	// Times one read of the whole stream, false when it did not arrive
+	// as it was sent
+	bool StreamBenchRun(StreamBenchMode mode, const std::vector<BYTE> &update, int rects,
+		int updates, StreamBenchResult &result)
+	{
+		SOCKET in, out;
+		if (!StreamBenchConnect(in, out))
+			return false;
+
+		StreamBenchSender sender;
+		sender.sock = out;
+		sender.update = &update;
+		sender.updates = updates;
+
+		std::vector<BYTE> pixels(STREAM_BENCH_RECV);
+		bool ok = true;
+		memset(&result.stats, 0, sizeof(result.stats));
+		result.bufSize = 0;
+		BenchTimer timer;
+		HANDLE thread = CreateThread(NULL, 0, StreamBenchSend, &sender, 0, NULL);
+		if (mode == RECV) {
+			LONGLONG left = (LONGLONG)update.size() * updates;
+			while (left > 0) {
+				int n = recv(in, (char *)&pixels[0], STREAM_BENCH_RECV, 0);
+				if (n <= 0)
+					break;
+				left -= n;
+				result.stats.reads++;
+				result.stats.bytes += n;
+			}
+			ok = left == 0;
+		}
+		else {
+			try {
+				rdr::FdInStream is((int)in);
+				if (mode == FIXED)
+					is.setMaxBufSize(0);
+				else if (mode == EXACT)
+					is.SetDSMMode(true);
+				ok = StreamBenchParse(is, updates, rects, pixels);
+				result.stats = is.getStats();
+				result.bufSize = is.getBufSize();
+			}
+			catch (rdr::Exception &e) {
+				BenchPrint("%s: %s\n", g_streamModes[mode], e.str());
+				ok = false;
+			}
+		}
+		result.ms = timer.Elapsed();
+
+		// Unblocks the sender when the reader gave up early
+		closesocket(in);
+		if (thread != NULL) {
+			WaitForSingleObject(thread, INFINITE);
+			CloseHandle(thread);
+		}
+		closesocket(out);
+		return ok;
+	}
+}
+
+bool StreamBench()
+{
+	std::vector<BYTE> update;
+	int rects;
+	StreamBenchUpdate(update, rects);
+	int updates = (int)(STREAM_BENCH_BYTES / update.size());
+	double bytes = (double)update.size() * updates;
+
+	bool ok = true;
+	for (int mode = 0; mode < STREAM_BENCH_MODES; mode++) {
+		// The best of the passes, the loopback's own jitter is large
+		StreamBenchResult best;
+		best.ms = -1;
+		for (int pass = 0; pass < g_benchOptions.passes; pass++) {
+			StreamBenchResult result;
+			if (!StreamBenchRun((StreamBenchMode)mode, update, rects, updates, result)) {
+				ok = false;
+				best.ms = -1;
+				break;
+			}
+			if (best.ms < 0 || result.ms < best.ms)
+				best = result;
+		}
+		if (best.ms < 0) {
+			BenchPrint("%-9s %i MB loopback  %s\n", g_streamModes[mode], (int)(bytes / 1048576), BenchCheck(false));
+			continue;
+		}
+		const rdr::FdInStream::Stats &s = best.stats;
+		BenchPrint("%-9s %i MB loopback %6.0f ms %6.2f Gbit/s  reads %7u  %7u bytes/read  vectored %6u  buffer %5i KB  %s\n",
+			g_streamModes[mode], (int)(bytes / 1048576), best.ms, bytes * 8 / 1e6 / best.ms,
+			(unsigned)s.reads, s.reads ? (unsigned)(s.bytes / s.reads) : 0, (unsigned)s.vectored,
+			mode == RECV ? STREAM_BENCH_RECV / 1024 : best.bufSize / 1024, BenchCheck(true));
+	}
+	return ok;
+}
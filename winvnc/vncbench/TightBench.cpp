@@ -0,0 +1,123 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// TightBench.cpp: the Tight analysis run scans, plain loops against
+// PixelScan.
+
+#include "vncbench.h"
+#include "PixelScan.h"
+
+namespace {
+	int ScalarRun(const CARD32 *p, int n, CARD32 c)
+	{
+		int i = 0;
+		while (i < n && p[i] == c)
+			i++;
+		return i;
+	}
+
+	int ScalarRun2(const CARD32 *p, int n, CARD32 c0, CARD32 c1)
+	{
+		int i = 0;
+		while (i < n && (p[i] == c0 || p[i] == c1))
+			i++;
+		return i;
+	}
+
+	// Solid 16x16 tiles, as CheckSolidTile scans them
+	double TightBenchTiles(const BenchFrame &frame, bool simd, int &solid)
+	{
+		const CARD32 *pixels = (const CARD32 *)frame.data;
+		int width = frame.width;
+		solid = 0;
+		BenchTimer timer;
+		for (int pass = 0; pass < 20; pass++) {
+			for (int y = 0; y + 16 <= frame.height; y += 16) {
+				for (int x = 0; x + 16 <= width; x += 16) {
+					const CARD32 *p = pixels + y * width + x;
+					CARD32 c = *p;
+					int dy;
+					for (dy = 0; dy < 16; dy++, p += width) {
+						if (simd ? !PixelScan::Equal(p, 16, c) : ScalarRun(p, 16, c) != 16)
+							break;
+					}
+					solid += dy == 16;
+				}
+			}
+		}
+		return timer.Elapsed();
+	}
+
+	// One and two colour runs along the rows, as the palette fill and the
+	// solid area extension walk them
+	double TightBenchRows(const BenchFrame &frame, bool simd, int &runs)
+	{
+		const CARD32 *pixels = (const CARD32 *)frame.data;
+		int width = frame.width;
+		runs = 0;
+		BenchTimer timer;
+		for (int pass = 0; pass < 20; pass++) {
+			for (int y = 0; y < frame.height; y++) {
+				const CARD32 *row = pixels + y * width;
+				for (int x = 0; x < width; runs++) {
+					int m, n0;
+					if (x + 1 < width && row[x + 1] != row[x])
+						m = 1 + (simd ? PixelScan::Run2(row + x + 1, width - x - 1, row[x], row[x + 1], n0)
+									  : ScalarRun2(row + x + 1, width - x - 1, row[x], row[x + 1]));
+					else
+						m = simd ? PixelScan::Run(row + x, width - x, row[x])
+								 : ScalarRun(row + x, width - x, row[x]);
+					x += m;
+				}
+			}
+		}
+		return timer.Elapsed();
+	}
+}
+
+bool TightBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1280, 720))
+		return false;
+#ifdef PIXELSCAN_SSE2
+	const char *mode = PixelScan::g_sse2 ? "SSE2" : "scalar";
+#else
+	const char *mode = "scalar";
+#endif
+	bool ok = true;
+	for (size_t i = 0; i < frames.size(); i++) {
+		const BenchFrame &frame = frames[i];
+		int solid, solidSimd, runs, runsSimd;
+		double tiles = TightBenchTiles(frame, false, solid);
+		double tilesSimd = TightBenchTiles(frame, true, solidSimd);
+		double rows = TightBenchRows(frame, false, runs);
+		double rowsSimd = TightBenchRows(frame, true, runsSimd);
+		bool same = solid == solidSimd && runs == runsSimd;
+		ok = ok && same;
+		BenchPrint("%-8s %ix%i x20 %s  solid tiles %.0f -> %.0f ms  row runs %.0f -> %.0f ms  %s\n",
+			frame.name, frame.width, frame.height, mode, tiles, tilesSimd, rows, rowsSimd, BenchCheck(same));
+	}
+	return ok;
+}
@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// XZBench.cpp: the XZ stream on the bench frames.
+
+#include "vncbench.h"
+#ifdef _XZ
+#include "EncoderThreadPool.h"
+#include <rdr/MemOutStream.h>
+#include <rdr/MemInStream.h>
+#include <rdr/xzOutStream.h>
+#include <rdr/xzInStream.h>
+
+// Sends the frames one after the other as full screen updates through one
+// stream, as vncEncodeXZ does for a session: everything in the shared
+// Block, parallel Blocks on the encoder pool, and those with the delta
+// filter. The stream is decoded again and compared frame by frame. With
+// -rec this is a recorded session, which is what the modes should be
+// judged on; level 6 has a 4 MB dictionary, smaller frames never go
+// parallel.
+namespace {
+	enum { SHARED_BLOCK, PARALLEL, PARALLEL_DELTA, MODES };
+
+	const char *g_modeNames[MODES] = { "shared Block", "parallel", "parallel+delta" };
+
+	bool XZBenchRun(BenchFrames &frames, int mode, double &elapsed, int &compressed)
+	{
+		rdr::MemOutStream mos;
+		rdr::xzOutStream xzos;
+		xzos.SetCompressLevel(6);
+		if (mode != SHARED_BLOCK)
+			xzos.SetJobRunner(EncoderThreadPool::Run, EncoderThreadPool::Workers() + 1);
+		xzos.SetDeltaDistance(mode == PARALLEL_DELTA ? 4 : 0);
+		xzos.setUnderlying(&mos);
+
+		BenchTimer timer;
+		for (size_t i = 0; i < frames.size(); i++) {
+			xzos.writeBytes(frames[i].data, frames[i].Size());
+			xzos.flush();
+		}
+		elapsed = timer.Elapsed();
+		compressed = mos.length();
+
+		rdr::MemInStream mis(mos.data(), mos.length());
+		rdr::xzInStream xzis;
+		xzis.setUnderlying(&mis, mos.length());
+		bool ok = true;
+		std::vector<BYTE> check;
+		for (size_t i = 0; i < frames.size(); i++) {
+			check.resize(frames[i].Size());
+			xzis.readBytes(&check[0], frames[i].Size());
+			ok = ok && memcmp(&check[0], frames[i].data, frames[i].Size()) == 0;
+		}
+		return ok;
+	}
+}
+
+bool XZBench()
+{
+	BenchFrames frames;
+	if (!frames.Load(1920, 1080))
+		return false;
+
+	double raw = 0;
+	for (size_t i = 0; i < frames.size(); i++)
+		raw += frames[i].Size();
+
+	bool ok = true;
+	for (int mode = 0; mode < MODES; mode++) {
+		try {
+			double elapsed;
+			int compressed;
+			bool modeok = XZBenchRun(frames, mode, elapsed, compressed);
+			BenchPrint("%-16s %i frames  %.0f ms  %.1f MB/s  ratio %.2f  %s\n",
+				g_modeNames[mode], (int)frames.size(), elapsed, BenchRate(raw, elapsed),
+				compressed > 0 ? raw / compressed : 0.0, BenchCheck(modeok));
+			ok = ok && modeok;
+		} catch (rdr::Exception &e) {
+			BenchPrint("%-16s failed: %s\n", g_modeNames[mode], e.str());
+			ok = false;
+		}
+	}
+	return ok;
+}
+#endif
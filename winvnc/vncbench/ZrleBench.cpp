@@ -0,0 +1,330 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// ZrleBench.cpp: the ZRLE encoder and decoder of the tree against the ones
+// they replaced. Both have to write the same bytes, for random rects in
+// every format and ZYWRLE level and for the bench frames; the frames are
+// timed as well. Decoding also has to give back the pixels that were
+// encoded, where ZYWRLE is off.
+
+#include "ZrleBench.h"
+#include <rdr/MemInStream.h>
+
+namespace {
+	const char *g_formatNames[ZRLE_BENCH_FORMATS] = { "8", "15", "16", "24A", "24B", "32" };
+
+	// The bytes of the zlib stream the viewer reads, chunks of 1 and 7
+	// bytes make the decoders refill in the middle of every item
+	const int g_chunks[3] = { 1, 7, 16384 };
+	enum { BENCH_CHUNK = 16384 };
+
+	unsigned int g_seed = 12345;
+
+	unsigned int ZrleBenchRandom()
+	{
+		g_seed = g_seed * 1103515245 + 12345;
+		return g_seed >> 8;
+	}
+
+	// The rect and tile length fields of the update, then the tiles
+	void ZrleBenchMessage(ZrleBenchStream &tiles, std::vector<BYTE> &message)
+	{
+		int length = tiles.length();
+		message.resize(4 + length);
+		message[0] = (BYTE)(length >> 24);
+		message[1] = (BYTE)(length >> 16);
+		message[2] = (BYTE)(length >> 8);
+		message[3] = (BYTE)length;
+		memcpy(&message[4], tiles.data(), length);
+	}
+
+	void ZrleBenchDecode(bool tree, const std::vector<BYTE> &message, ZrleBenchImage &image,
+		int level, int x, int y, int w, int h, int chunk, bool direct)
+	{
+		rdr::MemInStream in(&message[0], (int)message.size());
+		if (tree)
+			ZrleTree::Decode(image, level, x, y, w, h, in, chunk, direct);
+		else
+			ZrleRef::Decode(image, level, x, y, w, h, in, chunk, direct);
+	}
+
+	bool ZrleBenchSame(const ZrleBenchImage &image, int level, int x, int y, int w, int h)
+	{
+		ZrleBenchStream ref, tree;
+		ZrleRef::Encode(image, level, x, y, w, h, ref);
+		ZrleTree::Encode(image, level, x, y, w, h, tree);
+		return ref.length() == tree.length() &&
+			memcmp(ref.data(), tree.data(), ref.length()) == 0;
+	}
+
+	enum { RANDOM_WIDTH = 301, RANDOM_HEIGHT = 203, RANDOM_CASES = 480 };
+
+	// Case i of the random rects: runs of a few colours up to hundreds,
+	// one pixel to the whole image long, so every tile kind and the
+	// palette limit come up. The 24 bit formats keep their unused byte
+	// zero, as the pixels of a real framebuffer do.
+	void ZrleBenchRandomImage(int i, std::vector<BYTE> &pixels, ZrleBenchImage &image, int &level,
+		int &x, int &y, int &w, int &h)
+	{
+		int format = i % ZRLE_BENCH_FORMATS;
+		int bytes = ZrleBenchPixelBytes(format);
+		level = format == ZRLE_BENCH_8 ? 0 : (i / ZRLE_BENCH_FORMATS) % 4;
+		int colors = 1 + ZrleBenchRandom() % (i % 3 == 0 ? 3 : i % 3 == 1 ? 20 : 300);
+		std::vector<CARD32> palette(colors);
+		for (int c = 0; c < colors; c++) {
+			palette[c] = (ZrleBenchRandom() * 2654435761u) ^ ZrleBenchRandom();
+			if (format == ZRLE_BENCH_24A)
+				palette[c] &= 0x00FFFFFF;
+			else if (format == ZRLE_BENCH_24B)
+				palette[c] &= 0xFFFFFF00;
+		}
+		int mode = i % 4;
+		pixels.resize(RANDOM_WIDTH * RANDOM_HEIGHT * 4);
+		for (int p = 0; p < RANDOM_WIDTH * RANDOM_HEIGHT;) {
+			CARD32 c = palette[ZrleBenchRandom() % colors];
+			int len = mode == 0 ? 1 : mode == 1 ? 1 + ZrleBenchRandom() % 4 : 1 + ZrleBenchRandom() % 300;
+			if (mode == 3 && ZrleBenchRandom() % 8 == 0)
+				len = RANDOM_WIDTH * RANDOM_HEIGHT;
+			for (int k = 0; k < len && p < RANDOM_WIDTH * RANDOM_HEIGHT; k++, p++)
+				memcpy(&pixels[p * bytes], &c, bytes);
+		}
+		image.data = &pixels[0];
+		image.stride = RANDOM_WIDTH * bytes;
+		image.format = format;
+		x = ZrleBenchRandom() % 50;
+		y = ZrleBenchRandom() % 50;
+		w = 1 + ZrleBenchRandom() % (RANDOM_WIDTH - x - 1);
+		h = 1 + ZrleBenchRandom() % (RANDOM_HEIGHT - y - 1);
+	}
+
+	bool ZrleBenchRandomRects()
+	{
+		std::vector<BYTE> pixels;
+		int cases = 0, mismatches = 0;
+		for (int i = 0; i < RANDOM_CASES; i++) {
+			ZrleBenchImage image;
+			int level, x, y, w, h;
+			ZrleBenchRandomImage(i, pixels, image, level, x, y, w, h);
+			cases++;
+			if (!ZrleBenchSame(image, level, x, y, w, h)) {
+				if (mismatches++ < 5)
+					BenchPrint("mismatch: format %s level %i rect %i,%i %ix%i\n",
+						g_formatNames[image.format], level, x, y, w, h);
+			}
+		}
+		BenchPrint("random rects  %i cases  %s\n", cases, BenchCheck(mismatches == 0));
+		return mismatches == 0;
+	}
+
+	// Best of the passes, in ms
+	double ZrleBenchTime(bool tree, const ZrleBenchImage &image, int width, int height, int &length)
+	{
+		double best = 0;
+		for (int pass = 0; pass < g_benchOptions.passes; pass++) {
+			ZrleBenchStream out;
+			BenchTimer timer;
+			if (tree)
+				ZrleTree::Encode(image, 0, 0, 0, width, height, out);
+			else
+				ZrleRef::Encode(image, 0, 0, 0, width, height, out);
+			double elapsed = timer.Elapsed();
+			if (pass == 0 || elapsed < best)
+				best = elapsed;
+			length = out.length();
+		}
+		return best;
+	}
+	// A bench frame in one of the formats: the low bytes of the 32 bit
+	// pixels, with the byte 24A and 24B leave out cleared
+	void ZrleBenchFrameImage(const BenchFrame &frame, int format, std::vector<BYTE> &copy, ZrleBenchImage &image)
+	{
+		int pixels = frame.width * frame.height;
+		int bytes = ZrleBenchPixelBytes(format);
+		image.format = format;
+		image.stride = frame.width * bytes;
+		if (format == ZRLE_BENCH_32) {
+			image.data = frame.data;
+			return;
+		}
+		copy.resize(pixels * bytes);
+		for (int p = 0; p < pixels; p++) {
+			CARD32 pix = ((const CARD32 *)frame.data)[p];
+			if (format == ZRLE_BENCH_24A)
+				pix &= 0x00FFFFFF;
+			else if (format == ZRLE_BENCH_24B)
+				pix &= 0xFFFFFF00;
+			memcpy(&copy[p * bytes], &pix, bytes);
+		}
+		image.data = &copy[0];
+	}
+
+	// Decodes case i with the previous decoder and with both paths of the
+	// tree's, into copies of the same noise. They have to agree, and at
+	// level 0 give back the rect that was encoded.
+	bool ZrleBenchRandomDecode()
+	{
+		std::vector<BYTE> pixels, message, noise, ref, direct, buffered;
+		int cases = 0, mismatches = 0;
+		for (int i = 0; i < RANDOM_CASES; i++) {
+			ZrleBenchImage image;
+			int level, x, y, w, h;
+			ZrleBenchRandomImage(i, pixels, image, level, x, y, w, h);
+			ZrleBenchStream tiles;
+			ZrleTree::Encode(image, level, x, y, w, h, tiles);
+			ZrleBenchMessage(tiles, message);
+
+			noise.resize(pixels.size());
+			for (size_t b = 0; b < noise.size(); b++)
+				noise[b] = (BYTE)ZrleBenchRandom();
+			ref = direct = buffered = noise;
+			int chunk = g_chunks[i % 3];
+			ZrleBenchImage target = image;
+			target.data = &ref[0];
+			ZrleBenchDecode(false, message, target, level, x, y, w, h, chunk, false);
+			target.data = &direct[0];
+			ZrleBenchDecode(true, message, target, level, x, y, w, h, chunk, true);
+			target.data = &buffered[0];
+			ZrleBenchDecode(true, message, target, level, x, y, w, h, chunk, false);
+
+			bool same = ref == direct && ref == buffered;
+			if (level == 0) {
+				int bytes = ZrleBenchPixelBytes(image.format);
+				for (int row = 0; row < h && same; row++) {
+					int offset = (y + row) * image.stride + x * bytes;
+					same = memcmp(&ref[offset], &pixels[offset], w * bytes) == 0;
+				}
+			}
+			cases++;
+			if (!same) {
+				if (mismatches++ < 5)
+					BenchPrint("mismatch: format %s level %i rect %i,%i %ix%i chunk %i\n",
+						g_formatNames[image.format], level, x, y, w, h, chunk);
+			}
+		}
+		BenchPrint("random rects  %i cases  %s\n", cases, BenchCheck(mismatches == 0));
+		return mismatches == 0;
+	}
+
+	// Best of the passes, in ms
+	double ZrleBenchDecodeTime(bool tree, bool direct, const std::vector<BYTE> &message,
+		ZrleBenchImage &target, int width, int height)
+	{
+		double best = 0;
+		for (int pass = 0; pass < g_benchOptions.passes; pass++) {
+			BenchTimer timer;
+			ZrleBenchDecode(tree, message, target, 0, 0, 0, width, height, BENCH_CHUNK, direct);
+			double elapsed = timer.Elapsed();
+			if (pass == 0 || elapsed < best)
+				best = elapsed;
+		}
+		return best;
+	}
+}
+
+bool ZrleBench()
+{
+	bool ok = ZrleBenchRandomRects();
+
+	BenchFrames frames;
+	if (!frames.Load(1920, 1080))
+		return false;
+	for (size_t i = 0; i < frames.size(); i++) {
+		const BenchFrame &frame = frames[i];
+
+		bool same = true;
+		std::vector<BYTE> copy;
+		for (int format = 0; format < ZRLE_BENCH_FORMATS; format++) {
+			ZrleBenchImage image;
+			ZrleBenchFrameImage(frame, format, copy, image);
+			for (int level = 0; level < (format == ZRLE_BENCH_8 ? 1 : 4); level++)
+				same = same && ZrleBenchSame(image, level, 0, 0, frame.width, frame.height);
+		}
+
+		ZrleBenchImage image = { frame.data, frame.Stride(), ZRLE_BENCH_32 };
+		int refLength, treeLength;
+		double refTime = ZrleBenchTime(false, image, frame.width, frame.height, refLength);
+		double treeTime = ZrleBenchTime(true, image, frame.width, frame.height, treeLength);
+		BenchPrint("%-8s %ix%i  previous %.2f ms  tree %.2f ms (%i bytes)  all formats %s\n",
+			frame.name, frame.width, frame.height, refTime, treeTime, treeLength, BenchCheck(same));
+		ok = ok && same;
+	}
+	return ok;
+}
+
+bool ZrleDecodeBench()
+{
+	bool ok;
+	try {
+		ok = ZrleBenchRandomDecode();
+	} catch (rdr::Exception &e) {
+		BenchPrint("random rects failed: %s\n", e.str());
+		ok = false;
+	}
+
+	BenchFrames frames;
+	if (!frames.Load(1920, 1080))
+		return false;
+	for (size_t i = 0; i < frames.size(); i++) {
+		const BenchFrame &frame = frames[i];
+		try {
+			// Every format through both paths, pixel for pixel
+			bool same = true;
+			std::vector<BYTE> copy, message, out;
+			for (int format = 0; format < ZRLE_BENCH_FORMATS; format++) {
+				ZrleBenchImage image;
+				ZrleBenchFrameImage(frame, format, copy, image);
+				ZrleBenchStream tiles;
+				ZrleTree::Encode(image, 0, 0, 0, frame.width, frame.height, tiles);
+				ZrleBenchMessage(tiles, message);
+				int size = image.stride * frame.height;
+				ZrleBenchImage target = image;
+				for (int direct = 0; direct < 2; direct++) {
+					out.assign(size, 0);
+					target.data = &out[0];
+					ZrleBenchDecode(true, message, target, 0, 0, 0, frame.width, frame.height,
+						BENCH_CHUNK, direct != 0);
+					same = same && memcmp(&out[0], image.data, size) == 0;
+				}
+			}
+
+			ZrleBenchImage image = { frame.data, frame.Stride(), ZRLE_BENCH_32 };
+			ZrleBenchStream tiles;
+			ZrleTree::Encode(image, 0, 0, 0, frame.width, frame.height, tiles);
+			ZrleBenchMessage(tiles, message);
+			out.assign(frame.Size(), 0);
+			ZrleBenchImage target = image;
+			target.data = &out[0];
+			double refTime = ZrleBenchDecodeTime(false, false, message, target, frame.width, frame.height);
+			double bufferedTime = ZrleBenchDecodeTime(true, false, message, target, frame.width, frame.height);
+			double directTime = ZrleBenchDecodeTime(true, true, message, target, frame.width, frame.height);
+			BenchPrint("%-8s %ix%i  previous %.2f ms  tree %.2f ms, in place %.2f ms  all formats %s\n",
+				frame.name, frame.width, frame.height, refTime, bufferedTime, directTime, BenchCheck(same));
+			ok = ok && same;
+		} catch (rdr::Exception &e) {
+			BenchPrint("%-8s failed: %s\n", frame.name, e.str());
+			ok = false;
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// ZrleBench.h: the ZRLE encoders and decoders ZrleBench compares. The
+// ones of rfb/ and the ones they replaced (zrleEncodeRef.h and
+// zrleDecodeRef.h) are built in files and namespaces of their own, from
+// ZrleBenchEncode.h and ZrleBenchDecode.h.
+
+#pragma once
+
+#include "vncbench.h"
+#include <rdr/MemOutStream.h>
+#include <rdr/InStream.h>
+#include <rdr/Exception.h>
+
+enum {
+	ZRLE_BENCH_8,
+	ZRLE_BENCH_15,
+	ZRLE_BENCH_16,
+	ZRLE_BENCH_24A,
+	ZRLE_BENCH_24B,
+	ZRLE_BENCH_32,
+	ZRLE_BENCH_FORMATS
+};
+
+// Little endian pixels in one of the formats above, 24A and 24B take
+// 4 bytes per pixel like 32
+struct ZrleBenchImage
+{
+	BYTE *data;
+	int stride;
+	int format;
+};
+
+inline int ZrleBenchPixelBytes(int format)
+{
+	return format == ZRLE_BENCH_8 ? 1 : format <= ZRLE_BENCH_16 ? 2 : 4;
+}
+
+// Takes the tiles uncompressed, the zlib stream is the same for both
+class ZrleBenchStream : public rdr::MemOutStream
+{
+public:
+	void setUnderlying(rdr::OutStream *) {};
+};
+
+// Stands in for the zlib stream of the viewer: serves the tile data
+// that follows in the underlying stream, chunk bytes at a time like the
+// inflate buffer, without copying it
+class ZrleBenchInStream : public rdr::InStream
+{
+public:
+	ZrleBenchInStream(int chunk_) : chunk(chunk_), last(NULL) { ptr = end = NULL; };
+	void setUnderlying(rdr::InStream *is, int length)
+	{
+		is->check(length);
+		ptr = end = is->getptr();
+		last = ptr + length;
+		is->setptr(last);
+	};
+	void reset()
+	{
+		if (ptr != last)
+			throw rdr::Exception("ZrleBenchInStream: tile data left over");
+	};
+	int pos() { return 0; };
+private:
+	int overrun(int itemSize, int nItems)
+	{
+		if (ptr + itemSize > last)
+			throw rdr::Exception("ZrleBenchInStream: past the tile data");
+		end = ptr + itemSize > end + chunk ? ptr + itemSize : end + chunk;
+		if (end > last)
+			end = last;
+		if (itemSize * nItems > end - ptr)
+			nItems = (int)((end - ptr) / itemSize);
+		return nItems;
+	};
+	int chunk;
+	const rdr::U8 *last;
+};
+
+// Encode() appends the ZRLE tiles of the rect to out, ZYWRLE from level 1
+// on. Decode() reads the length and the tiles from in and draws them into
+// the rect of image, in place when direct (only the decoder of the tree
+// can), through IMAGE_RECT otherwise.
+namespace ZrleTree {
+	void Encode(const ZrleBenchImage &image, int level, int x, int y, int w, int h, ZrleBenchStream &out);
+	void Decode(ZrleBenchImage &image, int level, int x, int y, int w, int h, rdr::InStream &in, int chunk, bool direct);
+}
+namespace ZrleRef {
+	void Encode(const ZrleBenchImage &image, int level, int x, int y, int w, int h, ZrleBenchStream &out);
+	void Decode(ZrleBenchImage &image, int level, int x, int y, int w, int h, rdr::InStream &in, int chunk, bool direct);
+}
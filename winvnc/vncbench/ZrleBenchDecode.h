@@ -0,0 +1,108 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// ZrleBenchDecode.h: ZrleBench.h's Decode() on the zrleDecode.h named by
+// ZRLE_BENCH_HEADER. Included inside a namespace by ZrleBenchTreeDecode.cpp
+// and ZrleBenchRefDecode.cpp; ZRLE_BENCH_DIRECT for the decoder that can
+// draw into the framebuffer itself.
+
+// What the decoders use of ClientConnection
+static omni_mutex m_bitmapdcMutex;
+static long zywrle_level;
+static int zywrleBuf[rfbZRLETileWidth * rfbZRLETileHeight];
+static int initialupdate_counter = 4;
+static bool directx_used = true;
+static HWND m_hwndcn = NULL;
+static ZrleBenchImage *g_target;
+
+// IMAGE_RECT: the tile into the rows of the image being decoded
+static void ZrleBenchImageRect(int x, int y, int w, int h, const void *data)
+{
+	int bytes = ZrleBenchPixelBytes(g_target->format);
+	for (int row = 0; row < h; row++)
+		memcpy(g_target->data + (y + row) * g_target->stride + x * bytes, (const BYTE *)data + row * w * bytes, w * bytes);
+}
+
+#define IMAGE_RECT(x,y,w,h,data)				\
+	ZrleBenchImageRect(x, y, w, h, data)
+
+#define ENDIAN_LITTLE 0
+#define ENDIAN_BIG 1
+#define ENDIAN_NO 2
+#define BPP 8
+#define ZYWRLE_ENDIAN ENDIAN_NO
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#undef ZYWRLE_ENDIAN
+#define BPP 15
+#define ZYWRLE_ENDIAN ENDIAN_LITTLE
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#define BPP 16
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#define BPP 32
+#include ZRLE_BENCH_HEADER
+#define CPIXEL 24A
+#include ZRLE_BENCH_HEADER
+#undef CPIXEL
+#define CPIXEL 24B
+#include ZRLE_BENCH_HEADER
+#undef CPIXEL
+#undef BPP
+#undef ZYWRLE_ENDIAN
+
+static rdr::U32 g_tileBuf[rfbZRLETileWidth * rfbZRLETileHeight + 1];
+#ifdef ZRLE_BENCH_DIRECT
+#define ZRLE_BENCH_ARGS(T) (T *)g_tileBuf, direct ? (T *)image.data : NULL, \
+	image.stride / ZrleBenchPixelBytes(image.format)
+#else
+#define ZRLE_BENCH_ARGS(T) (T *)g_tileBuf
+#endif
+
+void Decode(ZrleBenchImage &image, int level, int x, int y, int w, int h, rdr::InStream &in, int chunk, bool direct)
+{
+	ZrleBenchInStream zis(chunk);
+	g_target = &image;
+	zywrle_level = level;
+	switch (image.format) {
+	case ZRLE_BENCH_8:
+		zrleDecode8NE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U8));
+		break;
+	case ZRLE_BENCH_15:
+		zrleDecode15LE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U16));
+		break;
+	case ZRLE_BENCH_16:
+		zrleDecode16LE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U16));
+		break;
+	case ZRLE_BENCH_24A:
+		zrleDecode24ALE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U32));
+		break;
+	case ZRLE_BENCH_24B:
+		zrleDecode24BLE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U32));
+		break;
+	default:
+		zrleDecode32LE(x, y, w, h, &in, &zis, ZRLE_BENCH_ARGS(rdr::U32));
+	}
+}
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// ZrleBenchEncode.h: ZrleBench.h's Encode() on the zrleEncode.h named by
+// ZRLE_BENCH_HEADER. Included inside a namespace by ZrleBenchTree.cpp and
+// ZrleBenchRef.cpp; ZRLE_BENCH_STATE for the encoder that takes a
+// ZrleTileState.
+
+static void ZrleBenchCopy(const ZrleBenchImage &image, int tx, int ty, int tw, int th, void *buf)
+{
+	int bytes = ZrleBenchPixelBytes(image.format);
+	for (int row = 0; row < th; row++)
+		memcpy((BYTE *)buf + row * tw * bytes, image.data + (ty + row) * image.stride + tx * bytes, tw * bytes);
+}
+
+#define GET_IMAGE_INTO_BUF(tx,ty,tw,th,buf)		\
+	ZrleBenchCopy(image, tx, ty, tw, th, buf);
+
+#define EXTRA_ARGS , const ZrleBenchImage &image
+
+#define ENDIAN_LITTLE 0
+#define ENDIAN_BIG 1
+#define ENDIAN_NO 2
+#define BPP 8
+#define ZYWRLE_ENDIAN ENDIAN_NO
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#define BPP 15
+#undef ZYWRLE_ENDIAN
+#define ZYWRLE_ENDIAN ENDIAN_LITTLE
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#define BPP 16
+#include ZRLE_BENCH_HEADER
+#undef BPP
+#define BPP 32
+#include ZRLE_BENCH_HEADER
+#define CPIXEL 24A
+#include ZRLE_BENCH_HEADER
+#undef CPIXEL
+#define CPIXEL 24B
+#include ZRLE_BENCH_HEADER
+#undef CPIXEL
+#undef BPP
+
+static rdr::U32 g_tileBuf[rfbZRLETileWidth * rfbZRLETileHeight + 1];
+#ifdef ZRLE_BENCH_STATE
+static ZrleTileState g_tileState;
+#define ZRLE_BENCH_ARGS g_tileBuf, &g_tileState, image
+#else
+#define ZRLE_BENCH_ARGS g_tileBuf, image
+#endif
+
+void Encode(const ZrleBenchImage &image, int level, int x, int y, int w, int h, ZrleBenchStream &out)
+{
+	zywrle_level = level;
+	switch (image.format) {
+	case ZRLE_BENCH_8:
+		zrleEncode8NE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+		break;
+	case ZRLE_BENCH_15:
+		zrleEncode15LE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+		break;
+	case ZRLE_BENCH_16:
+		zrleEncode16LE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+		break;
+	case ZRLE_BENCH_24A:
+		zrleEncode24ALE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+		break;
+	case ZRLE_BENCH_24B:
+		zrleEncode24BLE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+		break;
+	default:
+		zrleEncode32LE(x, y, w, h, &out, &out, ZRLE_BENCH_ARGS);
+	}
+}
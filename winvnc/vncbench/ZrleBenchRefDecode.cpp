@@ -0,0 +1,37 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// ZrleBenchRefDecode.cpp: the ZRLE decoder before the in place decoding
+// and the bulk runs, for ZrleBench.
+
+#include "ZrleBench.h"
+#include "omnithread.h"
+#include <rdr/ZlibInStream.h>
+#include <rdr/ZstdInStream.h>
+
+namespace ZrleRef {
+// Keeps the decoder's repaint during the first updates off
+#define ZRLE_BENCH_HEADER "zrleDecodeRef.h"
+#include "ZrleBenchDecode.h"
+}
@@ -0,0 +1,362 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// vncbench.cpp: command line, frames and timing of the benches.
+//
+//   vncbench [-rec file.vncrec] [-frames n] [-passes n]
+//            [-fps n] [-seconds n] [bench ...]
+//   vncbench -rec file.vncrec -avi file.avi
+//
+// Runs the named benches, without a name all of them except the ones
+// that have to be asked for. The exit code is the number of benches
+// whose checks failed. With -avi the recording is converted instead,
+// the codec is asked for once and kept in codec.cfg next to the AVI.
+
+#include "vncbench.h"
+#include "avilog/avilog/SessionPlayer.h"
+#include <stdarg.h>
+
+// What the server sources linked in here expect from winvnc.cpp and
+// vncproperties.cpp
+bool fShutdownOrdered = false;
+unsigned int G_SENDBUFFER_EX = 1452;
+
+BenchOptions g_benchOptions = { NULL, 16, 3, 25, 30 };
+
+namespace {
+	struct BenchEntry {
+		const char *name;
+		const char *description;
+		bool (*run)();
+		bool onRequest;		// not part of a run without names
+	};
+
+	// The portable build has the benches of the codecs only, see
+	// winvnc/portable
+	const BenchEntry g_benches[] = {
+#ifndef _VNC_PORTABLE
+		{ "region", "Region2D backends on a fragmented desktop", RegionBench, false },
+		{ "journal", "shared change journal, several viewers and a stalled one", JournalBench, false },
+		{ "record", "DSM records over loopback, plain against ChaCha20-Poly1305", RecordBench, false },
+#endif
+		{ "stream", "viewer FdInStream over loopback, fixed 8 KB buffer against adaptive", StreamBench, false },
+		{ "tight", "Tight solid tile and palette run scans", TightBench, false },
+		{ "jpegdecode", "viewer Tight JPEG decoding", JpegDecodeBench, false },
+		{ "jpegencode", "Tight and Ultra2 JPEG compression", JpegEncodeBench, false },
+		{ "encoder", "every encoding, MB/s and ratio", EncoderBench, false },
+		{ "pool", "BufferPool heap traffic of the encoders once warm", PoolBench, false },
+		{ "zrle", "ZRLE encoder against the one it replaced, byte for byte", ZrleBench, false },
+		{ "zrledecode", "viewer ZRLE decoding against the previous decoder, byte for byte", ZrleDecodeBench, false },
+		{ "rectdecode", "viewer Hextile, RRE and CoRRE decoding, plain and DSM records", RectDecodeBench, false },
+#ifdef _XZ
+		{ "xz", "XZ stream over the frame sequence, parallel Blocks and delta", XZBench, false },
+#endif
+#ifndef _VNC_PORTABLE
+		{ "damage", "window repainting at -fps, for the server's capture loop", DamageBench, true },
+#endif
+	};
+	const int g_benchCount = sizeof(g_benches) / sizeof(g_benches[0]);
+
+	void Usage()
+	{
+		printf("vncbench [-rec file.vncrec] [-frames n] [-passes n]\n"
+			"         [-fps n] [-seconds n] [bench ...]\n"
+			"vncbench -rec file.vncrec -avi file.avi\n\n");
+		for (int i = 0; i < g_benchCount; i++)
+			printf("  %-12s %s\n", g_benches[i].name, g_benches[i].description);
+	}
+
+	// Writes the -rec recording out as avi, 0 on success
+	int ConvertRecording(const char *avi)
+	{
+#ifdef _VNC_PORTABLE
+		BenchPrint("Cannot convert %s to %s: no Video for Windows\n", g_benchOptions.recording, avi);
+		return 1;
+#else
+		char path[MAX_PATH];
+		strcpy_s(path, avi);
+		char *slash = strrchr(path, '\\');
+		if (strrchr(path, '/') > slash)
+			slash = strrchr(path, '/');
+		const char *name = path;
+		if (slash != NULL) {
+			*slash = '\0';
+			name = slash + 1;
+		}
+		HRESULT hr = ConvertSessionToAvi(g_benchOptions.recording, name, slash != NULL ? path : ".");
+		if (FAILED(hr)) {
+			BenchPrint("Cannot convert %s to %s: 0x%08lx\n", g_benchOptions.recording, avi, (unsigned long)hr);
+			return 1;
+		}
+		BenchPrint("Converted %s to %s\n", g_benchOptions.recording, avi);
+		return 0;
+#endif
+	}
+}
+
+BenchFrame::BenchFrame()
+: data(NULL), width(0), height(0)
+{
+	name[0] = '\0';
+}
+
+BenchFrame::~BenchFrame()
+{
+	delete [] data;
+}
+
+void BenchFrame::Allocate(int w, int h)
+{
+	delete [] data;
+	width = w;
+	height = h;
+	data = new BYTE[w * h * 4];
+}
+
+void BenchFrame::Synthetic(int kind, int w, int h)
+{
+	static const char *names[SYNTHETIC_KINDS] = { "ui", "photo", "noise" };
+	strcpy_s(name, sizeof(name), names[kind]);
+	Allocate(w, h);
+	CARD32 *p = (CARD32 *)data;
+	unsigned int seed = 12345;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++, p++) {
+			seed = seed * 1103515245 + 12345;
+			switch (kind) {
+			case UI: {
+				// Window, title bar, and rows of glyph like strokes
+				CARD32 c = y < 24 ? 0x003060A0 : (x < 200 ? 0x00E8E8E8 : 0x00FFFFFF);
+				int row = y % 18, col = x % 8;
+				if (y >= 24 && row >= 4 && row < 14 && col < 6 && (x / 8 + y / 18) % 7 != 0 &&
+					(((x / 8) * 31 + (y / 18) * 17 + row * 3 + col) % 5) < 2)
+					c = 0x00101010;
+				*p = c;
+				break;
+			}
+			case PHOTO: {
+				int n = (seed >> 24) & 7;
+				int r = (x * 255 / width + n) & 255;
+				int g = (y * 255 / height + n) & 255;
+				int b = ((x + y) * 127 / (width + height) + 64 + n) & 255;
+				*p = (CARD32)(r << 16 | g << 8 | b);
+				break;
+			}
+			default:
+				*p = (seed >> 8) & 0x00FFFFFF;
+			}
+		}
+	}
+}
+
+bool BenchFrame::Capture()
+{
+#ifdef _VNC_PORTABLE
+	// No desktop to copy
+	return false;
+#else
+	int w = GetSystemMetrics(SM_CXSCREEN);
+	int h = GetSystemMetrics(SM_CYSCREEN);
+	HDC hScreen = GetDC(NULL);
+	if (hScreen == NULL)
+		return false;
+	BITMAPINFO bmi;
+	memset(&bmi, 0, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = w;
+	bmi.bmiHeader.biHeight = -h;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	void *bits = NULL;
+	bool ok = false;
+	HBITMAP hbm = CreateDIBSection(hScreen, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+	HDC hMem = CreateCompatibleDC(hScreen);
+	if (hbm != NULL && hMem != NULL) {
+		HGDIOBJ old = SelectObject(hMem, hbm);
+		if (BitBlt(hMem, 0, 0, w, h, hScreen, 0, 0, SRCCOPY)) {
+			Allocate(w, h);
+			memcpy(data, bits, w * h * 4);
+			strcpy_s(name, sizeof(name), "desktop");
+			ok = true;
+		}
+		SelectObject(hMem, old);
+	}
+	if (hMem) DeleteDC(hMem);
+	if (hbm) DeleteObject(hbm);
+	ReleaseDC(NULL, hScreen);
+	return ok;
+#endif
+}
+
+void BenchFrame::Recorded(int number, const BYTE *bits, int w, int h, int stride)
+{
+	_snprintf_s(name, sizeof(name), _TRUNCATE, "rec %i", number);
+	Allocate(w, h);
+	for (int y = 0; y < h; y++)
+		memcpy(data + y * Stride(), bits + y * stride, Stride());
+}
+
+BenchFrames::~BenchFrames()
+{
+	for (size_t i = 0; i < m_frames.size(); i++)
+		delete m_frames[i];
+}
+
+bool BenchFrames::Load(int width, int height)
+{
+	if (g_benchOptions.recording == NULL) {
+		for (int kind = 0; kind < BenchFrame::SYNTHETIC_KINDS; kind++) {
+			m_frames.push_back(new BenchFrame);
+			m_frames.back()->Synthetic(kind, width, height);
+		}
+		BenchFrame *desktop = new BenchFrame;
+		if (desktop->Capture())
+			m_frames.push_back(desktop);
+		else
+			delete desktop;
+		return true;
+	}
+
+	CSessionPlayer player;
+	if (!player.Open(g_benchOptions.recording)) {
+		BenchPrint("Cannot open recording %s\n", g_benchOptions.recording);
+		return false;
+	}
+	const SessionFileHeader &header = player.GetHeader();
+	if (header.bitsPerPixel != 32) {
+		BenchPrint("Recording %s is %i bpp, the benches take 32 bpp\n",
+			g_benchOptions.recording, (int)header.bitsPerPixel);
+		return false;
+	}
+	while ((int)m_frames.size() < g_benchOptions.recordingFrames && player.ReadFrame()) {
+		m_frames.push_back(new BenchFrame);
+		m_frames.back()->Recorded(player.GetFrameNumber(), player.GetFrame(),
+			header.width, header.height, header.stride);
+	}
+	return !m_frames.empty();
+}
+
+BenchTimer::BenchTimer()
+{
+	QueryPerformanceFrequency(&m_frequency);
+	Restart();
+}
+
+void BenchTimer::Restart()
+{
+	QueryPerformanceCounter(&m_start);
+}
+
+double BenchTimer::Elapsed() const
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)(now.QuadPart - m_start.QuadPart) * 1000.0 / (double)m_frequency.QuadPart;
+}
+
+void BenchPrint(const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	vprintf(format, ap);
+	va_end(ap);
+	fflush(stdout);
+}
+
+double BenchRate(double bytes, double ms)
+{
+	return ms > 0 ? bytes / 1048576.0 * 1000.0 / ms : 0.0;
+}
+
+const char *BenchCheck(bool ok)
+{
+	return ok ? "verified" : "MISMATCH";
+}
+
+#ifdef _VNC_PORTABLE
+#define WSACleanup()
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifndef _VNC_PORTABLE
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return 1;
+#endif
+
+	std::vector<const BenchEntry *> selected;
+	const char *avi = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (_stricmp(argv[i], "-rec") == 0 && i + 1 < argc)
+			g_benchOptions.recording = argv[++i];
+		else if (_stricmp(argv[i], "-avi") == 0 && i + 1 < argc)
+			avi = argv[++i];
+		else if (_stricmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			g_benchOptions.recordingFrames = max(1, atoi(argv[++i]));
+		else if (_stricmp(argv[i], "-passes") == 0 && i + 1 < argc)
+			g_benchOptions.passes = max(1, atoi(argv[++i]));
+		else if (_stricmp(argv[i], "-fps") == 0 && i + 1 < argc)
+			g_benchOptions.fps = max(0, atoi(argv[++i]));
+		else if (_stricmp(argv[i], "-seconds") == 0 && i + 1 < argc)
+			g_benchOptions.seconds = max(1, atoi(argv[++i]));
+		else {
+			int b;
+			for (b = 0; b < g_benchCount; b++) {
+				if (_stricmp(argv[i], g_benches[b].name) == 0)
+					break;
+			}
+			if (b == g_benchCount) {
+				Usage();
+				return 1;
+			}
+			selected.push_back(&g_benches[b]);
+		}
+	}
+	if (avi != NULL) {
+		if (g_benchOptions.recording == NULL || !selected.empty()) {
+			Usage();
+			return 1;
+		}
+		int result = ConvertRecording(avi);
+		WSACleanup();
+		return result;
+	}
+	if (selected.empty()) {
+		for (int b = 0; b < g_benchCount; b++) {
+			if (!g_benches[b].onRequest)
+				selected.push_back(&g_benches[b]);
+		}
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < selected.size(); i++) {
+		BenchPrint("== %s: %s\n", selected[i]->name, selected[i]->description);
+		if (!selected[i]->run())
+			failed++;
+	}
+	WSACleanup();
+	return failed;
+}
@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// vncbench.h: shared pieces of the vncbench benchmarks.
+//
+// vncbench times the codecs and the region engine outside the server,
+// and checks that the fast paths produce the same bytes as the plain
+// ones. Each bench is one function in its own file, listed in the table
+// in vncbench.cpp. A bench returns false when a check fails.
+//
+// vncbench is a Windows console program. winvnc/portable builds the
+// encoders and the codec benches elsewhere too (_VNC_PORTABLE), on
+// synthetic frames or -rec recordings; without a desktop to capture,
+// Win32 sockets or Video for Windows.
+
+#pragma once
+
+#include "stdhdrs.h"
+#include "rfb.h"
+#include <vector>
+
+////////////////////////////////////////
+// class BenchFrame;
+//
+// A 32 bit BGRX top-down framebuffer
+// the benches encode: synthetic
+// content, a capture of the desktop or
+// a frame of a session recording.
+//
+class BenchFrame
+{
+public:
+	enum { UI, PHOTO, NOISE, SYNTHETIC_KINDS };
+
+	BenchFrame();
+	~BenchFrame();
+
+	// Window with text, smooth gradients with sensor noise, or noise
+	void Synthetic(int kind, int width, int height);
+	// A copy of the primary screen
+	bool Capture();
+	// A copy of frame <number> of a 32 bit session recording
+	void Recorded(int number, const BYTE *bits, int width, int height, int stride);
+
+	int Stride() const { return width * 4; };
+	int Size() const { return width * height * 4; };
+
+	char name[32];
+	BYTE *data;
+	int width;
+	int height;
+
+private:
+	BenchFrame(const BenchFrame &);
+	BenchFrame &operator=(const BenchFrame &);
+	void Allocate(int w, int h);
+};
+
+// The frames a bench runs on: the synthetic kinds and the desktop, or
+// the frames of the recording given with -rec
+class BenchFrames
+{
+public:
+	~BenchFrames();
+	bool Load(int width, int height);
+	size_t size() const { return m_frames.size(); };
+	BenchFrame &operator[](size_t i) { return *m_frames[i]; };
+private:
+	std::vector<BenchFrame *> m_frames;
+};
+
+////////////////////////////////////////
+// class BenchTimer;
+//
+// Milliseconds since construction or the
+// last Restart(), performance counter
+// based.
+//
+class BenchTimer
+{
+public:
+	BenchTimer();
+	void Restart();
+	double Elapsed() const;
+private:
+	LARGE_INTEGER m_start;
+	LARGE_INTEGER m_frequency;
+};
+
+// Command line settings shared by the benches
+struct BenchOptions
+{
+	const char *recording;		// -rec <file>, NULL for synthetic frames
+	int recordingFrames;		// -frames <n>, most frames taken from it
+	int passes;					// -passes <n>
+	int fps;					// -fps <n>, damage rate
+	int seconds;				// -seconds <n>, damage duration
+};
+extern BenchOptions g_benchOptions;
+
+// One result line, printf style
+void BenchPrint(const char *format, ...);
+// MB/s of <bytes> in <ms>
+double BenchRate(double bytes, double ms);
+// "verified" or "MISMATCH"
+const char *BenchCheck(bool ok);
+
+// The benches, see vncbench.cpp
+bool RegionBench();
+bool JournalBench();
+bool RecordBench();
+bool StreamBench();
+bool TightBench();
+bool JpegDecodeBench();
+bool JpegEncodeBench();
+bool EncoderBench();
+bool PoolBench();
+bool DamageBench();
+bool ZrleBench();
+bool ZrleDecodeBench();
+bool RectDecodeBench();
+#ifdef _XZ
+bool XZBench();
+#endif
@@ -0,0 +1,503 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "CursorShapeCache.h"
+#include "vncdesktop.h"
+#include "translate.h"
+#include <string.h>
+
+namespace {
+
+	// A cursor's bitmaps as Windows returns them
+	struct CursorBits
+	{
+		CursorBits() : mask(NULL), maskSize(0), colorBits(NULL), colorSize(0) {};
+		~CursorBits() { delete[] mask; delete[] colorBits; };
+
+		int width, height;
+		int xhot, yhot;
+		bool color;
+		BYTE *mask;				// AND mask, and XOR mask for monochrome cursors
+		int maskSize;
+		int maskStride;			// bmWidthBytes
+		int maskHeight;
+		BYTE *colorBits;		// NULL for monochrome cursors, or if unreadable
+		int colorSize;
+	};
+
+	bool ReadCursorBits(HCURSOR hcursor, CursorBits &bits)
+	{
+		ICONINFO IconInfo;
+		if (!GetIconInfo(hcursor, &IconInfo)) {
+			vnclog.Print(LL_INTINFO, VNCLOG("GetIconInfo() failed.\n"));
+			return false;
+		}
+		bits.xhot = IconInfo.xHotspot;
+		bits.yhot = IconInfo.yHotspot;
+		bits.color = (IconInfo.hbmColor != NULL);
+		if (bits.color) {
+			// Only for the hash, the image is drawn by GetRichCursorData()
+			BITMAP bmColor;
+			if (GetObject(IconInfo.hbmColor, sizeof(BITMAP), (LPVOID)&bmColor)) {
+				bits.colorSize = bmColor.bmWidthBytes * bmColor.bmHeight;
+				bits.colorBits = new BYTE[bits.colorSize];
+				if (!GetBitmapBits(IconInfo.hbmColor, bits.colorSize, bits.colorBits)) {
+					delete[] bits.colorBits;
+					bits.colorBits = NULL;
+				}
+			}
+			DeleteObject(IconInfo.hbmColor);
+		}
+		if (IconInfo.hbmMask == NULL) {
+			vnclog.Print(LL_INTINFO, VNCLOG("cursor bitmap handle is NULL.\n"));
+			return false;
+		}
+
+		BITMAP bmMask;
+		if (!GetObject(IconInfo.hbmMask, sizeof(BITMAP), (LPVOID)&bmMask)) {
+			vnclog.Print(LL_INTINFO, VNCLOG("GetObject() for bitmap failed.\n"));
+			DeleteObject(IconInfo.hbmMask);
+			return false;
+		}
+		if (bmMask.bmPlanes != 1 || bmMask.bmBitsPixel != 1) {
+			vnclog.Print(LL_INTINFO, VNCLOG("incorrect data in cursor bitmap.\n"));
+			DeleteObject(IconInfo.hbmMask);
+			return false;
+		}
+
+		// NOTE: they say we should use GetDIBits() instead of GetBitmapBits().
+		bits.maskStride = bmMask.bmWidthBytes;
+		bits.maskHeight = bmMask.bmHeight;
+		bits.maskSize = bmMask.bmWidthBytes * bmMask.bmHeight;
+		bits.mask = new BYTE[bits.maskSize];
+		BOOL success = GetBitmapBits(IconInfo.hbmMask, bits.maskSize, bits.mask);
+		DeleteObject(IconInfo.hbmMask);
+		if (!success) {
+			vnclog.Print(LL_INTINFO, VNCLOG("GetBitmapBits() failed.\n"));
+			return false;
+		}
+
+		bits.width = bmMask.bmWidth;
+		bits.height = bits.color ? bmMask.bmHeight : bmMask.bmHeight / 2;
+		return true;
+	}
+
+	// FNV-1a
+	inline void HashBytes(DWORD64 &h, const BYTE *p, int n)
+	{
+		for (int i = 0; i < n; i++) {
+			h ^= p[i];
+			h *= 1099511628211ULL;
+		}
+	}
+
+	// What the hash is taken of: the local pixel size, the size and
+	// hotspot, then the mask and colour bits. NULL if the colour bits
+	// could not be read, such a cursor is not cached.
+	BYTE *MakeKey(const CursorBits &bits, int localBpp, int &size)
+	{
+		if (bits.color && bits.colorBits == NULL)
+			return NULL;
+		int header[6] = { localBpp, bits.width, bits.height, bits.xhot, bits.yhot, bits.color };
+		size = (int)sizeof(header) + bits.maskSize + (bits.color ? bits.colorSize : 0);
+		BYTE *key = new BYTE[size];
+		memcpy(key, header, sizeof(header));
+		memcpy(key + sizeof(header), bits.mask, bits.maskSize);
+		if (bits.color)
+			memcpy(key + sizeof(header) + bits.maskSize, bits.colorBits, bits.colorSize);
+		return key;
+	}
+
+	DWORD64 HashKey(const BYTE *key, int size)
+	{
+		DWORD64 h = 14695981039346656037ULL;
+		HashBytes(h, key, size);
+		return h != 0 ? h : 1;
+	}
+
+	// Packs and inverts the mask, and makes the pixels the viewer
+	// cannot show (inverted background) black
+	void FixCursorMask(BYTE *mbits, BYTE *cbits, int width, int height,
+					   int width_bytes, int bytes_pixel)
+	{
+		int packed_width_bytes = (width + 7) / 8;
+
+		// Pack and invert bitmap data (mbits)
+		int x, y;
+		for (y = 0; y < height; y++)
+			for (x = 0; x < packed_width_bytes; x++)
+				mbits[y * packed_width_bytes + x] = ~mbits[y * width_bytes + x];
+
+		// Replace "inverted background" bits with black color to ensure
+		// cross-platform interoperability. Not beautiful but necessary code.
+		if (cbits == NULL) {
+			BYTE m, c;
+			height /= 2;
+			for (y = 0; y < height; y++) {
+				for (x = 0; x < packed_width_bytes; x++) {
+					m = mbits[y * packed_width_bytes + x];
+					c = mbits[(height + y) * packed_width_bytes + x];
+					mbits[y * packed_width_bytes + x] |= ~(m | c);
+					mbits[(height + y) * packed_width_bytes + x] |= ~(m | c);
+				}
+			}
+		} else {
+			int bytes_row = width * bytes_pixel;
+			while (bytes_row % sizeof(DWORD))
+				bytes_row++;	// Actually, this should never happen
+
+			BYTE bitmask;
+			int b1, b2;
+			for (y = 0; y < height; y++) {
+				bitmask = 0x80;
+				for (x = 0; x < width; x++) {
+					if ((mbits[y * packed_width_bytes + x / 8] & bitmask) == 0) {
+						for (b1 = 0; b1 < bytes_pixel; b1++) {
+							if (cbits[y * bytes_row + x * bytes_pixel + b1] != 0) {
+								mbits[y * packed_width_bytes + x / 8] ^= bitmask;
+								for (b2 = b1; b2 < bytes_pixel; b2++)
+									cbits[y * bytes_row + x * bytes_pixel + b2] = 0x00;
+								break;
+							}
+						}
+					}
+					if ((bitmask >>= 1) == 0)
+						bitmask = 0x80;
+				}
+			}
+		}
+	}
+
+	CursorShape *PrepareShape(vncDesktop *desktop, HCURSOR hcursor, const CursorBits &bits,
+							  int localBpp, bool rich)
+	{
+		CursorShape *shape = new CursorShape;
+		shape->width = bits.width;
+		shape->height = bits.height;
+		shape->xhot = bits.xhot;
+		shape->yhot = bits.yhot;
+		shape->color = bits.color;
+		shape->maskRowBytes = (bits.width + 7) / 8;
+
+		if (!bits.color) {
+			shape->xbits = new BYTE[bits.maskSize];
+			memcpy(shape->xbits, bits.mask, bits.maskSize);
+			FixCursorMask(shape->xbits, NULL, bits.width, bits.maskHeight, bits.maskStride, localBpp / 8);
+		}
+
+		if (rich) {
+			shape->rowBytes = bits.width * (localBpp / 8);
+			while (shape->rowBytes % sizeof(DWORD))
+				shape->rowBytes++;	// Actually, this should never happen
+			shape->rbits = new BYTE[bits.width * bits.height * 4];
+			if (!desktop->GetRichCursorData(shape->rbits, hcursor, bits.width, bits.height)) {
+				vnclog.Print(LL_INTINFO, VNCLOG("vncDesktop::GetRichCursorData() failed.\n"));
+				shape->Release();
+				return NULL;
+			}
+			shape->rmask = new BYTE[bits.maskSize];
+			memcpy(shape->rmask, bits.mask, bits.maskSize);
+			FixCursorMask(shape->rmask, shape->rbits, bits.width, bits.height, bits.maskStride, localBpp / 8);
+		}
+		return shape;
+	}
+}
+
+CursorShape::CursorShape()
+	: hash(0), width(0), height(0), xhot(0), yhot(0), color(false), maskRowBytes(0),
+	  xbits(NULL), rbits(NULL), rowBytes(0), rmask(NULL),
+	  m_rectCount(0), m_key(NULL), m_keySize(0), m_refs(1), m_used(0)
+{
+}
+
+CursorShape::~CursorShape()
+{
+	delete[] xbits;
+	delete[] rbits;
+	delete[] rmask;
+	delete[] m_key;
+	for (int i = 0; i < m_rectCount; i++)
+		delete[] m_rects[i].data;
+}
+
+CursorShapeCache::CursorShapeCache()
+	: m_count(0), m_clock(0), m_nextHandle(0), m_sharedCount(0)
+{
+	InitializeCriticalSection(&m_lock);
+	memset(m_shapes, 0, sizeof(m_shapes));
+	memset(m_handles, 0, sizeof(m_handles));
+
+	static const LPCTSTR ids[] = {
+		IDC_ARROW, IDC_IBEAM, IDC_WAIT, IDC_CROSS, IDC_UPARROW,
+		IDC_SIZENWSE, IDC_SIZENESW, IDC_SIZEWE, IDC_SIZENS, IDC_SIZEALL,
+		IDC_NO, IDC_HAND, IDC_APPSTARTING, IDC_HELP
+	};
+	for (int i = 0; i < (int)(sizeof(ids) / sizeof(ids[0])) && m_sharedCount < MAX_SHARED; i++) {
+		HCURSOR hcursor = LoadCursor(NULL, ids[i]);
+		if (hcursor != NULL)
+			m_shared[m_sharedCount++] = hcursor;
+	}
+}
+
+CursorShapeCache::~CursorShapeCache()
+{
+	Clear();
+	DeleteCriticalSection(&m_lock);
+}
+
+void
+CursorShapeCache::Clear()
+{
+	EnterCriticalSection(&m_lock);
+	for (int i = 0; i < m_count; i++) {
+		m_shapes[i]->Release();
+		m_shapes[i] = NULL;
+	}
+	m_count = 0;
+	memset(m_handles, 0, sizeof(m_handles));
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+CursorShapeCache::ForgetHandles()
+{
+	EnterCriticalSection(&m_lock);
+	memset(m_handles, 0, sizeof(m_handles));
+	LeaveCriticalSection(&m_lock);
+}
+
+bool
+CursorShapeCache::IsShared(HCURSOR hcursor) const
+{
+	for (int i = 0; i < m_sharedCount; i++) {
+		if (m_shared[i] == hcursor)
+			return true;
+	}
+	return false;
+}
+
+int
+CursorShapeCache::FindShape(DWORD64 hash, const BYTE *key, int keySize)
+{
+	for (int i = 0; i < m_count; i++) {
+		const CursorShape *shape = m_shapes[i];
+		if (shape->hash == hash && shape->m_keySize == keySize &&
+			memcmp(shape->m_key, key, keySize) == 0)
+			return i;
+	}
+	return -1;
+}
+
+CursorShape *
+CursorShapeCache::FindHandle(HCURSOR hcursor, int localBpp)
+{
+	for (int i = 0; i < MAX_HANDLES; i++) {
+		if (m_handles[i].shape != NULL && m_handles[i].hcursor == hcursor &&
+			m_handles[i].localBpp == localBpp)
+			return m_handles[i].shape;
+	}
+	return NULL;
+}
+
+void
+CursorShapeCache::AddHandle(HCURSOR hcursor, int localBpp, CursorShape *shape)
+{
+	if (!IsShared(hcursor))
+		return;
+	for (int i = 0; i < MAX_HANDLES; i++) {
+		if (m_handles[i].shape != NULL && m_handles[i].hcursor == hcursor &&
+			m_handles[i].localBpp == localBpp) {
+			m_handles[i].shape = shape;
+			return;
+		}
+	}
+	Handle &h = m_handles[m_nextHandle];
+	m_nextHandle = (m_nextHandle + 1) % MAX_HANDLES;
+	h.hcursor = hcursor;
+	h.localBpp = localBpp;
+	h.shape = shape;
+}
+
+void
+CursorShapeCache::DropHandles(CursorShape *shape)
+{
+	for (int i = 0; i < MAX_HANDLES; i++) {
+		if (m_handles[i].shape == shape)
+			m_handles[i].shape = NULL;
+	}
+}
+
+DWORD64
+CursorShapeCache::Hash(HCURSOR hcursor, int localBpp)
+{
+	if (hcursor == NULL)
+		return 0;
+	EnterCriticalSection(&m_lock);
+	CursorShape *known = FindHandle(hcursor, localBpp);
+	DWORD64 hash = known != NULL ? known->hash : 0;
+	LeaveCriticalSection(&m_lock);
+	if (known != NULL)
+		return hash;
+
+	CursorBits bits;
+	if (!ReadCursorBits(hcursor, bits))
+		return 0;
+	int keySize = 0;
+	BYTE *key = MakeKey(bits, localBpp, keySize);
+	if (key == NULL)
+		return 0;
+	hash = HashKey(key, keySize);
+
+	EnterCriticalSection(&m_lock);
+	int i = FindShape(hash, key, keySize);
+	if (i >= 0)
+		AddHandle(hcursor, localBpp, m_shapes[i]);
+	LeaveCriticalSection(&m_lock);
+	delete[] key;
+	return hash;
+}
+
+CursorShape *
+CursorShapeCache::Acquire(vncDesktop *desktop, HCURSOR hcursor, int localBpp, bool xcursor)
+{
+	EnterCriticalSection(&m_lock);
+	// A monochrome shape prepared for XCursor only has no RichCursor image
+	CursorShape *known = FindHandle(hcursor, localBpp);
+	if (known != NULL && (known->rbits != NULL || (!known->color && xcursor))) {
+		known->m_used = ++m_clock;
+		known->AddRef();
+		LeaveCriticalSection(&m_lock);
+		return known;
+	}
+	LeaveCriticalSection(&m_lock);
+
+	CursorBits bits;
+	if (!ReadCursorBits(hcursor, bits))
+		return NULL;
+	int keySize = 0;
+	BYTE *key = MakeKey(bits, localBpp, keySize);
+	DWORD64 hash = key != NULL ? HashKey(key, keySize) : 0;
+	bool rich = bits.color || !xcursor;
+
+	if (key != NULL) {
+		EnterCriticalSection(&m_lock);
+		int i = FindShape(hash, key, keySize);
+		if (i >= 0 && (!rich || m_shapes[i]->rbits != NULL)) {
+			CursorShape *shape = m_shapes[i];
+			AddHandle(hcursor, localBpp, shape);
+			shape->m_used = ++m_clock;
+			shape->AddRef();
+			LeaveCriticalSection(&m_lock);
+			delete[] key;
+			return shape;
+		}
+		LeaveCriticalSection(&m_lock);
+	}
+
+	// Prepared outside the lock, GetRichCursorData() waits for the
+	// desktop's update lock
+	CursorShape *shape = PrepareShape(desktop, hcursor, bits, localBpp, rich);
+	if (shape == NULL || key == NULL) {
+		delete[] key;
+		return shape;
+	}
+	shape->hash = hash;
+	shape->m_key = key;
+	shape->m_keySize = keySize;
+
+	EnterCriticalSection(&m_lock);
+	// Replaces the same cursor without the RichCursor image, else
+	// the one used least recently when the cache is full
+	int slot = FindShape(hash, key, keySize);
+	if (slot < 0) {
+		if (m_count < MAX_SHAPES) {
+			slot = m_count++;
+		} else {
+			slot = 0;
+			for (int i = 1; i < m_count; i++) {
+				if ((LONG)(m_shapes[i]->m_used - m_shapes[slot]->m_used) < 0)
+					slot = i;
+			}
+		}
+	}
+	if (m_shapes[slot] != NULL) {
+		DropHandles(m_shapes[slot]);
+		m_shapes[slot]->Release();
+	}
+	shape->m_used = ++m_clock;
+	shape->AddRef();
+	m_shapes[slot] = shape;
+	AddHandle(hcursor, localBpp, shape);
+	LeaveCriticalSection(&m_lock);
+	return shape;
+}
+
+bool
+CursorShapeCache::FindRect(CursorShape *shape, CARD32 encoding, const rfbPixelFormat &format,
+						   const BYTE *&data, int &size)
+{
+	bool found = false;
+	EnterCriticalSection(&m_lock);
+	for (int i = 0; i < shape->m_rectCount; i++) {
+		const CursorShape::Rect &r = shape->m_rects[i];
+		if (r.encoding == encoding &&
+			(encoding == rfbEncodingXCursor || PF_EQ(r.format, format))) {
+			data = r.data;
+			size = r.size;
+			found = true;
+			break;
+		}
+	}
+	LeaveCriticalSection(&m_lock);
+	return found;
+}
+
+void
+CursorShapeCache::AddRect(CursorShape *shape, CARD32 encoding, const rfbPixelFormat &format,
+						  const BYTE *data, int size)
+{
+	// Not for uncached shapes, nobody else will look
+	if (shape->hash == 0)
+		return;
+	const BYTE *existing;
+	int existingSize;
+	if (FindRect(shape, encoding, format, existing, existingSize))
+		return;
+
+	BYTE *copy = new BYTE[size];
+	memcpy(copy, data, size);
+	EnterCriticalSection(&m_lock);
+	if (shape->m_rectCount < CursorShape::MAX_RECTS) {
+		CursorShape::Rect &r = shape->m_rects[shape->m_rectCount];
+		r.encoding = encoding;
+		r.format = format;
+		r.data = copy;
+		r.size = size;
+		shape->m_rectCount++;
+		copy = NULL;
+	}
+	LeaveCriticalSection(&m_lock);
+	delete[] copy;
+}
@@ -0,0 +1,172 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WINVNC_CURSORSHAPECACHE)
+#define _WINVNC_CURSORSHAPECACHE
+#pragma once
+
+#include "rfb.h"
+
+////////////////////////////////////////
+// class CursorShape;
+//
+// A cursor read from Windows once and
+// prepared for the XCursor and
+// RichCursor encodings. Shared by the
+// clients by reference count, and not
+// changed once it is in the cache.
+//
+class CursorShape
+{
+public:
+	CursorShape();
+
+	void AddRef() { InterlockedIncrement(&m_refs); };
+	void Release() { if (InterlockedDecrement(&m_refs) == 0) delete this; };
+
+	DWORD64 hash;			// of the mask and colour bits, never 0 in the cache
+	int width, height;
+	int xhot, yhot;
+	bool color;
+	int maskRowBytes;		// (width + 7) / 8
+	// XCursor bitmap then mask, maskRowBytes * height each. NULL for
+	// colour cursors.
+	BYTE *xbits;
+	// RichCursor image in the local format, rowBytes per row, and its
+	// mask. NULL unless a client asked for RichCursor.
+	BYTE *rbits;
+	int rowBytes;
+	BYTE *rmask;
+
+private:
+	friend class CursorShapeCache;
+	enum { MAX_RECTS = 8 };
+
+	~CursorShape();
+	CursorShape(const CursorShape &);
+	CursorShape &operator=(const CursorShape &);
+
+	// Cursor rects as sent, header included, under the cache lock
+	struct Rect {
+		CARD32 encoding;
+		rfbPixelFormat format;	// not compared for XCursor
+		BYTE *data;
+		int size;
+	};
+	Rect m_rects[MAX_RECTS];
+	int m_rectCount;
+	// What the hash was taken of, to tell shapes with the same hash
+	// apart
+	BYTE *m_key;
+	int m_keySize;
+	volatile LONG m_refs;
+	DWORD m_used;
+};
+
+class vncDesktop;
+
+////////////////////////////////////////
+// class CursorShapeCache;
+//
+// The cursors a server has seen, by a
+// hash of their bits. A change between
+// a few cursors (arrow, I-beam, busy)
+// finds the prepared shape and the rect
+// another client already encoded, and
+// skips GetRichCursorData() and the
+// mask fixups.
+//
+// The shared system cursors seen last
+// are kept with their shape, so the
+// bits of such a handle are not read
+// and hashed again. Those are never
+// destroyed and only change with the
+// cursor scheme. Other handles are read
+// every time: an application's cursor
+// can be destroyed and its handle given
+// to another.
+//
+// Thread-safe.
+//
+class CursorShapeCache
+{
+public:
+	enum { MAX_SHAPES = 32 };
+
+	CursorShapeCache();
+	~CursorShapeCache();
+
+	// Hash of the cursor's bits and the local pixel size, 0 if the
+	// cursor cannot be read. The bits of a system cursor seen before
+	// are not read again.
+	DWORD64 Hash(HCURSOR hcursor, int localBpp);
+
+	// The shape of hcursor, NULL if it cannot be read. The RichCursor
+	// image is prepared for colour cursors, and for monochrome ones
+	// unless xcursor is set. Release() it when done.
+	CursorShape *Acquire(vncDesktop *desktop, HCURSOR hcursor, int localBpp, bool xcursor);
+
+	// A rect built from shape for encoding and the client format
+	bool FindRect(CursorShape *shape, CARD32 encoding, const rfbPixelFormat &format,
+				  const BYTE *&data, int &size);
+	// Keeps a copy for the other clients, if there is room
+	void AddRect(CursorShape *shape, CARD32 encoding, const rfbPixelFormat &format,
+				 const BYTE *data, int size);
+
+	void Clear();
+	// The cursor scheme changed, the system cursors show other bits
+	void ForgetHandles();
+
+private:
+	CursorShapeCache(const CursorShapeCache &);
+	CursorShapeCache &operator=(const CursorShapeCache &);
+
+	enum { MAX_HANDLES = 16, MAX_SHARED = 16 };
+
+	// Under m_lock
+	int FindShape(DWORD64 hash, const BYTE *key, int keySize);
+	CursorShape *FindHandle(HCURSOR hcursor, int localBpp);
+	void AddHandle(HCURSOR hcursor, int localBpp, CursorShape *shape);
+	void DropHandles(CursorShape *shape);
+	bool IsShared(HCURSOR hcursor) const;
+
+	CRITICAL_SECTION m_lock;
+	CursorShape *m_shapes[MAX_SHAPES];
+	int m_count;
+	DWORD m_clock;
+
+	// A handle seen before and its shape, which is in m_shapes
+	struct Handle {
+		HCURSOR hcursor;
+		int localBpp;
+		CursorShape *shape;
+	};
+	Handle m_handles[MAX_HANDLES];
+	int m_nextHandle;		// replaced next, round robin
+	// The shared system cursors, only these are memoized
+	HCURSOR m_shared[MAX_SHARED];
+	int m_sharedCount;
+};
+
+#endif // _WINVNC_CURSORSHAPECACHE
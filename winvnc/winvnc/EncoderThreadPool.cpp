@@ -0,0 +1,170 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "EncoderThreadPool.h"
+#include <deque>
+#include <algorithm>
+
+namespace {
+
+	struct Batch {
+		EncoderThreadPool::JobFn fn;
+		void *param;
+		int count;
+		int next;				// next job to take, under the lock
+		volatile LONG outstanding;
+		HANDLE done;
+	};
+
+	struct Service {
+		CRITICAL_SECTION lock;
+		std::deque<Batch *> queue;	// batches with jobs left to take
+		HANDLE work;			// semaphore, one count per job for the workers
+		int workers;
+		int limit;
+		bool started;
+
+		Service() : work(NULL), workers(0), limit(EncoderThreadPool::MAX_WORKERS), started(false) {
+			InitializeCriticalSection(&lock);
+		}
+	};
+
+	// Never destroyed, the workers live as long as the process
+	Service g_service;
+
+	// Takes a job of batch, or of the oldest batch if batch is NULL.
+	// Returns the batch, NULL if there was nothing to take.
+	Batch *TakeJob(Batch *batch, int &index)
+	{
+		EnterCriticalSection(&g_service.lock);
+		if (batch == NULL && !g_service.queue.empty())
+			batch = g_service.queue.front();
+		if (batch != NULL && batch->next < batch->count) {
+			index = batch->next++;
+			if (batch->next == batch->count) {
+				std::deque<Batch *>::iterator i =
+					std::find(g_service.queue.begin(), g_service.queue.end(), batch);
+				if (i != g_service.queue.end())
+					g_service.queue.erase(i);
+			}
+		} else {
+			batch = NULL;
+		}
+		LeaveCriticalSection(&g_service.lock);
+		return batch;
+	}
+
+	void RunJob(Batch *batch, int index)
+	{
+		batch->fn(batch->param, index);
+		// The batch is gone once the caller sees the event
+		if (InterlockedDecrement(&batch->outstanding) == 0)
+			SetEvent(batch->done);
+	}
+
+	DWORD WINAPI WorkerThread(LPVOID)
+	{
+		for (;;) {
+			WaitForSingleObject(g_service.work, INFINITE);
+			// The job may already have been taken by its caller
+			int index;
+			Batch *batch = TakeJob(NULL, index);
+			if (batch != NULL)
+				RunJob(batch, index);
+		}
+		return 0;
+	}
+}
+
+int
+EncoderThreadPool::Workers()
+{
+	EnterCriticalSection(&g_service.lock);
+	if (!g_service.started) {
+		g_service.started = true;
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		// The caller runs jobs too
+		int workers = (int)si.dwNumberOfProcessors - 1;
+		if (workers > MAX_WORKERS)
+			workers = MAX_WORKERS;
+		if (workers > 0)
+			g_service.work = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+		for (int i = 0; i < workers && g_service.work != NULL; i++) {
+			HANDLE thread = CreateThread(NULL, 0, WorkerThread, NULL, 0, NULL);
+			if (thread == NULL)
+				break;
+			CloseHandle(thread);
+			g_service.workers++;
+		}
+	}
+	int workers = g_service.workers < g_service.limit ? g_service.workers : g_service.limit;
+	LeaveCriticalSection(&g_service.lock);
+	return workers;
+}
+
+void
+EncoderThreadPool::LimitWorkers(int workers)
+{
+	EnterCriticalSection(&g_service.lock);
+	g_service.limit = workers;
+	LeaveCriticalSection(&g_service.lock);
+}
+
+void
+EncoderThreadPool::Run(JobFn fn, void *param, int count)
+{
+	if (count <= 0)
+		return;
+	int workers = count > 1 ? Workers() : 0;
+	HANDLE done = workers > 0 ? CreateEvent(NULL, FALSE, FALSE, NULL) : NULL;
+	if (done == NULL) {
+		for (int i = 0; i < count; i++)
+			fn(param, i);
+		return;
+	}
+
+	Batch batch;
+	batch.fn = fn;
+	batch.param = param;
+	batch.count = count;
+	batch.next = 0;
+	batch.outstanding = count;
+	batch.done = done;
+
+	EnterCriticalSection(&g_service.lock);
+	g_service.queue.push_back(&batch);
+	LeaveCriticalSection(&g_service.lock);
+	ReleaseSemaphore(g_service.work, count - 1 < workers ? count - 1 : workers, NULL);
+
+	int index;
+	while (TakeJob(&batch, index) != NULL)
+		RunJob(&batch, index);
+	// Whoever finishes the last job sets the event exactly once, wait
+	// for it even if that was this thread so no worker touches the
+	// batch after we return
+	WaitForSingleObject(done, INFINITE);
+	CloseHandle(done);
+}
@@ -0,0 +1,60 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WINVNC_ENCODERTHREADPOOL)
+#define _WINVNC_ENCODERTHREADPOOL
+#pragma once
+
+////////////////////////////////////////
+// class EncoderThreadPool;
+//
+// Process wide worker threads for the
+// encoders that cut a large rect into
+// bands or slices. Run() queues the
+// jobs of one rect, runs them on the
+// workers and the calling thread, and
+// returns when all of them are done.
+//
+// Thread-safe, the clients' update
+// threads share the workers.
+//
+class EncoderThreadPool
+{
+public:
+	enum { MAX_WORKERS = 4 };
+
+	typedef void (*JobFn)(void *param, int index);
+
+	// Threads that help the caller, 0 on a single CPU. Starts them on
+	// the first call.
+	static int Workers();
+	// At most this many workers help from now on, 0 runs every job
+	// on the caller. For the benchmarks.
+	static void LimitWorkers(int workers);
+
+	// Calls fn(param, i) for every i in [0, count), on any thread
+	static void Run(JobFn fn, void *param, int count);
+};
+
+#endif // _WINVNC_ENCODERTHREADPOOL
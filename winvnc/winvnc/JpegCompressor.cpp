@@ -0,0 +1,540 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "JpegCompressor.h"
+#include "EncoderThreadPool.h"
+#include <string.h>
+#include <vector>
+
+namespace {
+
+	// Rows converted per jpeg_write_scanlines() call
+	enum { ROW_BATCH = 16 };
+
+	// The layouts libjpeg reads as they are, JCS_UNKNOWN for the others
+	J_COLOR_SPACE DirectColorSpace(const rfbPixelFormat &f, int &components)
+	{
+#ifdef JCS_EXTENSIONS
+		int bytes = f.bitsPerPixel / 8;
+		if (!f.trueColour || (bytes != 3 && bytes != 4) ||
+			f.redMax != 255 || f.greenMax != 255 || f.blueMax != 255 ||
+			(f.redShift | f.greenShift | f.blueShift) & 7)
+			return JCS_UNKNOWN;
+
+		// Byte offsets of the channels
+		int r = f.redShift / 8;
+		int g = f.greenShift / 8;
+		int b = f.blueShift / 8;
+		if (f.bigEndian) {
+			r = bytes - 1 - r;
+			g = bytes - 1 - g;
+			b = bytes - 1 - b;
+		}
+		components = bytes;
+		if (g != 1 && g != 2)
+			return JCS_UNKNOWN;
+		if (bytes == 3) {
+			if (r == 0 && g == 1 && b == 2) return JCS_EXT_RGB;
+			if (b == 0 && g == 1 && r == 2) return JCS_EXT_BGR;
+		} else {
+			if (r == 0 && g == 1 && b == 2) return JCS_EXT_RGBX;
+			if (b == 0 && g == 1 && r == 2) return JCS_EXT_BGRX;
+			if (r == 1 && g == 2 && b == 3) return JCS_EXT_XRGB;
+			if (b == 1 && g == 2 && r == 3) return JCS_EXT_XBGR;
+		}
+#endif
+		return JCS_UNKNOWN;
+	}
+
+	// True colour formats ConvertRow() can read
+	bool Convertible(const rfbPixelFormat &f)
+	{
+		int bytes = f.bitsPerPixel / 8;
+		return f.trueColour && (bytes == 2 || bytes == 3 || bytes == 4) &&
+			   f.redMax != 0 && f.greenMax != 0 && f.blueMax != 0;
+	}
+
+	inline CARD32 ReadPixel(const BYTE *p, int bytes, bool bigEndian)
+	{
+		switch (bytes) {
+		case 2:
+			return bigEndian ? (CARD32)p[0] << 8 | p[1] : (CARD32)p[1] << 8 | p[0];
+		case 3:
+			return bigEndian ? (CARD32)p[0] << 16 | (CARD32)p[1] << 8 | p[2]
+							 : (CARD32)p[2] << 16 | (CARD32)p[1] << 8 | p[0];
+		default:
+			return bigEndian ? (CARD32)p[0] << 24 | (CARD32)p[1] << 16 | (CARD32)p[2] << 8 | p[3]
+							 : *(const CARD32 *)p;
+		}
+	}
+
+	// The end of the headers of a JPEG image, past the SOS segment,
+	// 0 if it is not one. A height >= 0 is written to the frame header.
+	int HeaderLength(BYTE *p, int size, int height)
+	{
+		if (size < 4 || p[0] != 0xFF || p[1] != 0xD8)
+			return 0;
+		int pos = 2;
+		while (pos + 4 <= size) {
+			if (p[pos] != 0xFF)
+				return 0;
+			int marker = p[pos + 1];
+			if (marker == 0xFF) {
+				pos++;
+				continue;
+			}
+			int len = p[pos + 2] << 8 | p[pos + 3];
+			if (marker >= 0xC0 && marker <= 0xC2 && height >= 0 && pos + 7 <= size) {
+				p[pos + 5] = (BYTE)(height >> 8);
+				p[pos + 6] = (BYTE)height;
+			}
+			if (marker == 0xDA)
+				return pos + 2 + len <= size ? pos + 2 + len : 0;
+			pos += 2 + len;
+		}
+		return 0;
+	}
+
+	inline bool IsRestart(const BYTE *p)
+	{
+		return p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7;
+	}
+
+	// Copies entropy coded data, numbering its restart markers on from
+	// restarts. Stuffed 0xFF bytes are followed by 0, so any 0xFF D0-D7
+	// is a marker.
+	int CopyEntropy(BYTE *dst, const BYTE *src, int len, int &restarts)
+	{
+		BYTE *out = dst;
+		const BYTE *end = src + len;
+		while (src < end) {
+			const BYTE *ff = (const BYTE *)memchr(src, 0xFF, end - src);
+			if (ff == NULL || ff + 1 >= end) {
+				memcpy(out, src, end - src);
+				out += end - src;
+				break;
+			}
+			memcpy(out, src, ff + 2 - src);
+			out += ff + 2 - src;
+			if (IsRestart(ff))
+				out[-1] = (BYTE)(0xD0 + (restarts++ & 7));
+			src = ff + 2;
+		}
+		return (int)(out - dst);
+	}
+
+	int CountRestarts(const BYTE *p, int len)
+	{
+		int n = 0;
+		for (int i = 0; i + 1 < len; i++) {
+			if (p[i] == 0xFF) {
+				n += IsRestart(p + i);
+				i++;
+			}
+		}
+		return n;
+	}
+
+	struct SliceJob {
+		PooledBuffer out;
+		int size;
+	};
+
+	struct SliceBatch {
+		const JpegSource *src;
+		const JpegSettings *settings;
+		BYTE *dst;
+		int dstSize;
+		int sliceRows;
+		SliceJob *jobs;
+	};
+
+	// Idle contexts, never destroyed
+	struct Service {
+		CRITICAL_SECTION lock;
+		std::vector<JpegCompressor *> idle;
+
+		Service() {
+			InitializeCriticalSection(&lock);
+		}
+	};
+
+	Service g_service;
+
+	void CompressSlice(void *param, int index)
+	{
+		SliceBatch *batch = (SliceBatch *)param;
+		SliceJob &job = batch->jobs[index];
+		int firstRow = index * batch->sliceRows;
+		int rows = batch->src->height - firstRow;
+		if (rows > batch->sliceRows)
+			rows = batch->sliceRows;
+		// The first slice goes straight into dst
+		BYTE *out = index == 0 ? batch->dst : job.out.Data();
+		JpegCompressor *compressor = JpegCompressorPool::Acquire();
+		job.size = compressor->Compress(*batch->src, firstRow, rows, *batch->settings, out, batch->dstSize);
+		JpegCompressorPool::Release(compressor);
+	}
+
+	// Appends the slices to the image of the first one in dst
+	int JoinSlices(BYTE *dst, int dstSize, int size0, int height, SliceJob *jobs, int slices)
+	{
+		int header = HeaderLength(dst, size0, height);
+		if (header == 0 || size0 < header + 2 || dst[size0 - 2] != 0xFF || dst[size0 - 1] != 0xD9)
+			return 0;
+		int pos = size0 - 2;
+		int restarts = CountRestarts(dst + header, pos - header);
+
+		for (int i = 1; i < slices; i++) {
+			BYTE *p = jobs[i].out.Data();
+			int size = jobs[i].size;
+			int sliceHeader = HeaderLength(p, size, -1);
+			if (sliceHeader == 0 || size < sliceHeader + 2)
+				return 0;
+			int len = size - 2 - sliceHeader;
+			if (pos + 2 + len + 2 > dstSize)
+				return 0;
+			dst[pos++] = 0xFF;
+			dst[pos++] = (BYTE)(0xD0 + (restarts++ & 7));
+			pos += CopyEntropy(dst + pos, p + sliceHeader, len, restarts);
+		}
+		dst[pos++] = 0xFF;
+		dst[pos++] = 0xD9;
+		return pos;
+	}
+
+}
+
+JpegCompressor::JpegCompressor()
+	: m_setup(false), m_inColorSpace(JCS_UNKNOWN)
+{
+	m_cinfo.err = jpeg_std_error(&m_err.pub);
+	m_err.pub.error_exit = ErrorExit;
+	m_err.pub.output_message = OutputMessage;
+	jpeg_create_compress(&m_cinfo);
+
+	m_dest.pub.init_destination = InitDestination;
+	m_dest.pub.empty_output_buffer = EmptyOutputBuffer;
+	m_dest.pub.term_destination = TermDestination;
+	m_dest.buffer = NULL;
+	m_dest.size = 0;
+	m_dest.overflow = false;
+	m_cinfo.dest = &m_dest.pub;
+
+	memset(&m_scaleFormat, 0, sizeof(m_scaleFormat));
+}
+
+JpegCompressor::~JpegCompressor()
+{
+	jpeg_destroy_compress(&m_cinfo);
+}
+
+void
+JpegCompressor::InitDestination(j_compress_ptr cinfo)
+{
+	DestinationManager *dest = (DestinationManager *)cinfo->dest;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->size;
+	dest->overflow = false;
+}
+
+// The image does not fit: flag it and let libjpeg write over the
+// start of the buffer until the caller stops
+boolean
+JpegCompressor::EmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	DestinationManager *dest = (DestinationManager *)cinfo->dest;
+	dest->overflow = true;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->size;
+	return TRUE;
+}
+
+void
+JpegCompressor::TermDestination(j_compress_ptr cinfo)
+{
+}
+
+void
+JpegCompressor::ErrorExit(j_common_ptr cinfo)
+{
+	ErrorManager *err = (ErrorManager *)cinfo->err;
+	longjmp(err->jump, 1);
+}
+
+// The default writes warnings to stderr
+void
+JpegCompressor::OutputMessage(j_common_ptr cinfo)
+{
+}
+
+// Tables and sampling only change with the settings or the input layout
+void
+JpegCompressor::Setup(J_COLOR_SPACE inColorSpace, int components, const JpegSettings &settings)
+{
+	if (m_setup && inColorSpace == m_inColorSpace && settings == m_settings)
+		return;
+
+	m_cinfo.in_color_space = inColorSpace;
+	m_cinfo.input_components = components;
+	jpeg_set_defaults(&m_cinfo);
+	jpeg_set_quality(&m_cinfo, settings.quality, TRUE);
+	m_cinfo.dct_method = settings.dctMethod;
+	if (settings.gray) {
+		jpeg_set_colorspace(&m_cinfo, JCS_GRAYSCALE);
+	} else {
+		// jpeg_set_colorspace() resets the sampling factors
+		jpeg_set_colorspace(&m_cinfo, JCS_YCbCr);
+		m_cinfo.comp_info[0].h_samp_factor = settings.hSamp;
+		m_cinfo.comp_info[0].v_samp_factor = settings.vSamp;
+		m_cinfo.comp_info[1].h_samp_factor = m_cinfo.comp_info[1].v_samp_factor = 1;
+		m_cinfo.comp_info[2].h_samp_factor = m_cinfo.comp_info[2].v_samp_factor = 1;
+	}
+
+	m_inColorSpace = inColorSpace;
+	m_settings = settings;
+	m_setup = true;
+}
+
+int
+JpegCompressor::Compress(const JpegSource &src, int firstRow, int rows,
+						 const JpegSettings &settings, BYTE *dst, int dstSize)
+{
+	if (src.width <= 0 || rows <= 0 || dstSize <= 0)
+		return 0;
+
+	int components = 3;
+	J_COLOR_SPACE inColorSpace = DirectColorSpace(src.format, components);
+	if (inColorSpace == JCS_UNKNOWN) {
+		if (!Convertible(src.format))
+			return 0;
+		inColorSpace = JCS_RGB;
+		components = 3;
+	}
+
+	m_dest.buffer = dst;
+	m_dest.size = dstSize;
+
+	// Only members are used after the jump
+	if (setjmp(m_err.jump)) {
+		jpeg_abort_compress(&m_cinfo);
+		m_setup = false;
+		return 0;
+	}
+
+	Setup(inColorSpace, components, settings);
+	m_cinfo.image_width = src.width;
+	m_cinfo.image_height = rows;
+	m_cinfo.restart_interval = 0;
+	m_cinfo.restart_in_rows = settings.restartRows;
+
+	jpeg_start_compress(&m_cinfo, TRUE);
+	if (!WriteRows(src, firstRow, rows, inColorSpace)) {
+		jpeg_abort_compress(&m_cinfo);
+		return 0;
+	}
+	jpeg_finish_compress(&m_cinfo);
+
+	if (m_dest.overflow)
+		return 0;
+	return dstSize - (int)m_dest.pub.free_in_buffer;
+}
+
+bool
+JpegCompressor::WriteRows(const JpegSource &src, int firstRow, int rows, J_COLOR_SPACE inColorSpace)
+{
+	const BYTE *base = src.data + (size_t)firstRow * src.stride;
+
+	// libjpeg reads the framebuffer rows
+	if (inColorSpace != JCS_RGB) {
+		JSAMPROW *rowPointer = (JSAMPROW *)m_rowPointers.Reserve(rows * sizeof(JSAMPROW));
+		if (rowPointer == NULL)
+			return false;
+		for (int dy = 0; dy < rows; dy++)
+			rowPointer[dy] = (JSAMPROW)(base + (size_t)dy * src.stride);
+		while (m_cinfo.next_scanline < m_cinfo.image_height) {
+			jpeg_write_scanlines(&m_cinfo, &rowPointer[m_cinfo.next_scanline],
+								 m_cinfo.image_height - m_cinfo.next_scanline);
+			if (m_dest.overflow)
+				return false;
+		}
+		return true;
+	}
+
+	// Other formats go through RGB rows
+	int w = src.width;
+	BYTE *buf = m_rows.Reserve((size_t)w * 3 * ROW_BATCH);
+	if (buf == NULL)
+		return false;
+	JSAMPROW rowPointer[ROW_BATCH];
+	while (m_cinfo.next_scanline < m_cinfo.image_height) {
+		int dy = m_cinfo.next_scanline;
+		int n = rows - dy < ROW_BATCH ? rows - dy : ROW_BATCH;
+		for (int i = 0; i < n; i++) {
+			rowPointer[i] = (JSAMPROW)(buf + (size_t)i * w * 3);
+			ConvertRow(base + (size_t)(dy + i) * src.stride, src.format, w, rowPointer[i]);
+		}
+		jpeg_write_scanlines(&m_cinfo, rowPointer, n);
+		if (m_dest.overflow)
+			return false;
+	}
+	return true;
+}
+
+void
+JpegCompressor::ConvertRow(const BYTE *src, const rfbPixelFormat &fmt, int w, BYTE *dst)
+{
+	int bytes = fmt.bitsPerPixel / 8;
+	bool bigEndian = fmt.bigEndian != 0;
+	int rs = fmt.redShift, gs = fmt.greenShift, bs = fmt.blueShift;
+	int rm = fmt.redMax, gm = fmt.greenMax, bm = fmt.blueMax;
+
+	// Channels of up to 8 bits are scaled through tables
+	if (rm <= 255 && gm <= 255 && bm <= 255) {
+		if (memcmp(&m_scaleFormat, &fmt, sizeof(fmt)) != 0) {
+			for (int i = 0; i < 256; i++) {
+				m_scale[0][i] = (BYTE)((i & rm) * 255 / rm);
+				m_scale[1][i] = (BYTE)((i & gm) * 255 / gm);
+				m_scale[2][i] = (BYTE)((i & bm) * 255 / bm);
+			}
+			m_scaleFormat = fmt;
+		}
+		for (int x = 0; x < w; x++, src += bytes) {
+			CARD32 pix = ReadPixel(src, bytes, bigEndian);
+			*dst++ = m_scale[0][pix >> rs & rm];
+			*dst++ = m_scale[1][pix >> gs & gm];
+			*dst++ = m_scale[2][pix >> bs & bm];
+		}
+		return;
+	}
+
+	for (int x = 0; x < w; x++, src += bytes) {
+		CARD32 pix = ReadPixel(src, bytes, bigEndian);
+		*dst++ = (BYTE)((pix >> rs & rm) * 255 / rm);
+		*dst++ = (BYTE)((pix >> gs & gm) * 255 / gm);
+		*dst++ = (BYTE)((pix >> bs & bm) * 255 / bm);
+	}
+}
+
+JpegCompressor *
+JpegCompressorPool::Acquire()
+{
+	JpegCompressor *compressor = NULL;
+	EnterCriticalSection(&g_service.lock);
+	if (!g_service.idle.empty()) {
+		compressor = g_service.idle.back();
+		g_service.idle.pop_back();
+	}
+	LeaveCriticalSection(&g_service.lock);
+	if (compressor == NULL)
+		compressor = new JpegCompressor;
+	return compressor;
+}
+
+void
+JpegCompressorPool::Release(JpegCompressor *compressor)
+{
+	if (compressor == NULL)
+		return;
+	EnterCriticalSection(&g_service.lock);
+	if ((int)g_service.idle.size() < MAX_IDLE_CONTEXTS) {
+		g_service.idle.push_back(compressor);
+		compressor = NULL;
+	}
+	LeaveCriticalSection(&g_service.lock);
+	delete compressor;
+}
+
+int
+JpegCompressorPool::Compress(const JpegSource &src, const JpegSettings &settings,
+							 BYTE *dst, int dstSize)
+{
+	// Slices are whole MCU rows, and whole restart intervals
+	int slices = 1;
+	int sliceRows = 0;
+	int workers = src.width * src.height >= 2 * MIN_SLICE_PIXELS ? EncoderThreadPool::Workers() : 0;
+	if (workers > 0) {
+		int mcuHeight = settings.gray ? 8 : 8 * settings.vSamp;
+		int mcuWidth = settings.gray ? 8 : 8 * settings.hSamp;
+		int mcuRows = (src.height + mcuHeight - 1) / mcuHeight;
+		int mcusPerRow = (src.width + mcuWidth - 1) / mcuWidth;
+		int want = workers + 1;
+		if (want > src.width * src.height / MIN_SLICE_PIXELS)
+			want = src.width * src.height / MIN_SLICE_PIXELS;
+		if (want > mcuRows)
+			want = mcuRows;
+		if (want >= 2) {
+			int per = (mcuRows + want - 1) / want;
+			if (settings.restartRows > 0)
+				per = (per + settings.restartRows - 1) / settings.restartRows * settings.restartRows;
+			int interval = settings.restartRows > 0 ? settings.restartRows : per;
+			// libjpeg caps the interval, the slices would not line up
+			if ((long)interval * mcusPerRow <= 65535L) {
+				slices = (mcuRows + per - 1) / per;
+				sliceRows = per * mcuHeight;
+			}
+		}
+	}
+
+	if (slices < 2) {
+		JpegCompressor *compressor = Acquire();
+		int size = compressor->Compress(src, 0, src.height, settings, dst, dstSize);
+		Release(compressor);
+		return size;
+	}
+
+	JpegSettings sliced = settings;
+	if (sliced.restartRows == 0)
+		sliced.restartRows = sliceRows / (settings.gray ? 8 : 8 * settings.vSamp);
+
+	SliceJob jobs[EncoderThreadPool::MAX_WORKERS + 1];
+	bool ok = true;
+	for (int i = 1; i < slices && ok; i++)
+		ok = jobs[i].out.Reserve(dstSize) != NULL;
+	if (!ok) {
+		JpegCompressor *compressor = Acquire();
+		int size = compressor->Compress(src, 0, src.height, settings, dst, dstSize);
+		Release(compressor);
+		return size;
+	}
+
+	SliceBatch batch;
+	batch.src = &src;
+	batch.settings = &sliced;
+	batch.dst = dst;
+	batch.dstSize = dstSize;
+	batch.sliceRows = sliceRows;
+	batch.jobs = jobs;
+	EncoderThreadPool::Run(CompressSlice, &batch, slices);
+
+	int size0 = jobs[0].size;
+	for (int i = 1; i < slices; i++) {
+		if (jobs[i].size == 0)
+			return 0;
+	}
+	if (size0 == 0)
+		return 0;
+	return JoinSlices(dst, dstSize, size0, src.height, jobs, slices);
+}
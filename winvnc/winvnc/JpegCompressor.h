@@ -0,0 +1,176 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WINVNC_JPEGCOMPRESSOR)
+#define _WINVNC_JPEGCOMPRESSOR
+#pragma once
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "rfb.h"
+#include "../../common/BufferPool.h"
+
+extern "C"
+{
+#ifdef _INTERNALLIB
+#include <jpeglib.h>
+#else
+#include "libjpeg-turbo-win/jpeglib.h"
+#endif
+}
+
+////////////////////////////////////////
+// struct JpegSettings;
+//
+// How a rect is compressed. Contexts
+// keep the tables of the last settings,
+// so encoders that do not change them
+// pay for the setup once.
+//
+struct JpegSettings
+{
+	JpegSettings() : quality(75), hSamp(2), vSamp(2), gray(false),
+					 dctMethod(JDCT_ISLOW), restartRows(0) {};
+
+	bool operator==(const JpegSettings &s) const {
+		return quality == s.quality && hSamp == s.hSamp && vSamp == s.vSamp &&
+			   gray == s.gray && dctMethod == s.dctMethod;
+	};
+
+	int quality;			// 1..100
+	int hSamp, vSamp;		// luminance sampling, chroma is 1x1
+	bool gray;
+	J_DCT_METHOD dctMethod;
+	// MCU rows per restart interval, 0 for none. Large rects are
+	// sliced on these boundaries, with 0 the slices pick their own.
+	int restartRows;
+};
+
+////////////////////////////////////////
+// struct JpegSource;
+//
+// A rect of the framebuffer, read in
+// place. 32 and 24 bit layouts with 8
+// bit channels go to libjpeg as they
+// are, other formats are converted a
+// few rows at a time.
+//
+struct JpegSource
+{
+	const BYTE *data;		// first pixel of the rect
+	int stride;				// bytes per framebuffer row
+	int width, height;
+	rfbPixelFormat format;
+};
+
+////////////////////////////////////////
+// class JpegCompressor;
+//
+// A compression context: one libjpeg
+// compressor with its own destination
+// and error managers, reused for every
+// rect. One thread at a time.
+//
+class JpegCompressor
+{
+public:
+	JpegCompressor();
+	~JpegCompressor();
+
+	// Compresses rows [firstRow, firstRow + rows) of src into dst as a
+	// standalone JPEG image. Returns its size, or 0 if it does not fit
+	// in dstSize or libjpeg fails.
+	int Compress(const JpegSource &src, int firstRow, int rows,
+				 const JpegSettings &settings, BYTE *dst, int dstSize);
+
+private:
+	JpegCompressor(const JpegCompressor &);
+	JpegCompressor &operator=(const JpegCompressor &);
+
+	struct DestinationManager {
+		jpeg_destination_mgr pub;
+		JOCTET *buffer;
+		size_t size;
+		bool overflow;
+	};
+	struct ErrorManager {
+		jpeg_error_mgr pub;
+		jmp_buf jump;
+	};
+
+	static void InitDestination(j_compress_ptr cinfo);
+	static boolean EmptyOutputBuffer(j_compress_ptr cinfo);
+	static void TermDestination(j_compress_ptr cinfo);
+	static void ErrorExit(j_common_ptr cinfo);
+	static void OutputMessage(j_common_ptr cinfo);
+
+	void Setup(J_COLOR_SPACE inColorSpace, int components, const JpegSettings &settings);
+	bool WriteRows(const JpegSource &src, int firstRow, int rows, J_COLOR_SPACE inColorSpace);
+	void ConvertRow(const BYTE *src, const rfbPixelFormat &fmt, int w, BYTE *dst);
+
+	jpeg_compress_struct m_cinfo;
+	DestinationManager m_dest;
+	ErrorManager m_err;
+	bool m_setup;
+	J_COLOR_SPACE m_inColorSpace;
+	JpegSettings m_settings;
+	PooledBuffer m_rows;
+	PooledBuffer m_rowPointers;
+	// Channel scales of the converted formats
+	rfbPixelFormat m_scaleFormat;
+	BYTE m_scale[3][256];
+};
+
+////////////////////////////////////////
+// class JpegCompressorPool;
+//
+// Process wide compression service for
+// the Tight and Ultra2 encoders. Keeps
+// idle contexts for reuse, and cuts a
+// large rect into slices on restart
+// interval boundaries. The slices are
+// compressed on the EncoderThreadPool
+// and the calling thread, joined into one
+// image that any decoder reads.
+//
+// Thread-safe.
+//
+class JpegCompressorPool
+{
+public:
+	enum {
+		MAX_IDLE_CONTEXTS = 8,
+		MIN_SLICE_PIXELS = 16384
+	};
+
+	// Returns the size of the image in dst, 0 on failure
+	static int Compress(const JpegSource &src, const JpegSettings &settings,
+						BYTE *dst, int dstSize);
+
+	// A context for the caller's own use, give it back with Release()
+	static JpegCompressor *Acquire();
+	static void Release(JpegCompressor *compressor);
+};
+
+#endif // _WINVNC_JPEGCOMPRESSOR
@@ -0,0 +1,354 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "stdhdrs.h"
+#include "MonitorWorkers.h"
+#include "vncdesktop.h"
+
+MonitorWorkers::MonitorWorkers()
+: m_count(0), m_canCapture(false), m_quit(false), m_bits(NULL), m_section(NULL),
+  m_bytesPerRow(0), m_screenOffsetx(0), m_screenOffsety(0), m_rop(SRCCOPY),
+  m_buffer(NULL), m_full(false), m_dest(NULL), m_cacheRgn(NULL)
+{
+	for (int i = 0; i < MAX_WORKERS; i++) {
+		Worker &w = m_workers[i];
+		w.owner = this;
+		w.thread = NULL;
+		w.start = NULL;
+		w.done = NULL;
+		w.screen = NULL;
+		w.memdc = NULL;
+		w.view = NULL;
+		w.oldbitmap = NULL;
+		w.rowIndex = 0;
+		w.job = JOB_NONE;
+		w.late = false;
+	}
+}
+
+MonitorWorkers::~MonitorWorkers()
+{
+	Stop();
+}
+
+void MonitorWorkers::Configure(const std::vector<rfb::Rect> &slices, void *bits, HANDLE section,
+							   const BITMAPINFO *bmi, size_t bmiSize, int bytesPerRow, int bytesPerPixel,
+							   int screenOffsetx, int screenOffsety)
+{
+	if (slices.size() == m_slices.size() && bits == m_bits && section == m_section &&
+		bytesPerRow == m_bytesPerRow && screenOffsetx == m_screenOffsetx && screenOffsety == m_screenOffsety) {
+		bool same = true;
+		for (size_t i = 0; i < slices.size() && same; i++)
+			same = slices[i].equals(m_slices[i]);
+		if (same)
+			return;
+	}
+
+	// Remembered even when the workers cannot start, so a failure is
+	// not retried every frame
+	Stop();
+	m_slices = slices;
+	m_bits = bits;
+	m_section = section;
+	m_bytesPerRow = bytesPerRow;
+	m_screenOffsetx = screenOffsetx;
+	m_screenOffsety = screenOffsety;
+
+	if (slices.size() < 2 || slices.size() > MAX_WORKERS)
+		return;
+	// The slices must not share a pixel. CheckRect() rounds the left
+	// edge of a rect down to a DWORD, that has to stay in the slice too.
+	for (size_t i = 0; i < slices.size(); i++) {
+		if (slices[i].is_empty() || (slices[i].tl.x * bytesPerPixel) % 4 != 0)
+			return;
+		for (size_t j = 0; j < i; j++) {
+			if (!slices[i].intersect(slices[j]).is_empty())
+				return;
+		}
+	}
+
+	m_quit = false;
+	m_canCapture = section != NULL && bits != NULL && bytesPerPixel >= 2;
+	for (int i = 0; i < (int)slices.size(); i++) {
+		Worker &w = m_workers[i];
+		w.slice = slices[i];
+		w.rowIndex = 0;
+		w.job = JOB_NONE;
+		m_count = i + 1;
+		if (m_canCapture && !CreateView(w, bmi, bmiSize)) {
+			vnclog.Print(LL_INTINFO, VNCLOG("monitor %d: no DIB section view, capturing serially\n"), i);
+			m_canCapture = false;
+		}
+		w.start = CreateEvent(NULL, FALSE, FALSE, NULL);
+		w.done = CreateEvent(NULL, TRUE, TRUE, NULL);
+		if (w.start != NULL && w.done != NULL)
+			w.thread = CreateThread(NULL, 0, WorkerThread, &w, 0, NULL);
+		if (w.thread == NULL) {
+			vnclog.Print(LL_INTERR, VNCLOG("failed to start monitor worker %d\n"), i);
+			Stop();
+			return;
+		}
+	}
+	vnclog.Print(LL_INTINFO, VNCLOG("%d monitor workers, capture %s\n"), m_count,
+				 m_canCapture ? "per monitor" : "serial");
+}
+
+void MonitorWorkers::Stop()
+{
+	m_quit = true;
+	for (int i = 0; i < m_count; i++) {
+		if (m_workers[i].thread != NULL)
+			SetEvent(m_workers[i].start);
+	}
+	for (int i = 0; i < m_count; i++) {
+		Worker &w = m_workers[i];
+		if (w.thread != NULL) {
+			WaitForSingleObject(w.thread, INFINITE);
+			CloseHandle(w.thread);
+			w.thread = NULL;
+		}
+		if (w.start != NULL) {
+			CloseHandle(w.start);
+			w.start = NULL;
+		}
+		if (w.done != NULL) {
+			CloseHandle(w.done);
+			w.done = NULL;
+		}
+		if (w.memdc != NULL) {
+			if (w.oldbitmap != NULL)
+				SelectObject(w.memdc, w.oldbitmap);
+			DeleteDC(w.memdc);
+			w.memdc = NULL;
+			w.oldbitmap = NULL;
+		}
+		if (w.view != NULL) {
+			DeleteObject(w.view);
+			w.view = NULL;
+		}
+		if (w.screen != NULL) {
+			ReleaseDC(NULL, w.screen);
+			w.screen = NULL;
+		}
+		w.src.clear();
+		w.changed.clear();
+		w.cached.clear();
+		w.late = false;
+		w.grabLater.clear();
+		w.checkLater.clear();
+	}
+	m_count = 0;
+	m_canCapture = false;
+}
+
+bool MonitorWorkers::CreateView(Worker &w, const BITMAPINFO *bmi, size_t bmiSize)
+{
+	// A view starts at the slice's first row of the main DIB section,
+	// which only works with the rows packed as vncBuffer sees them and
+	// a DWORD aligned offset
+	const BITMAPINFOHEADER &main = bmi->bmiHeader;
+	if (((main.biWidth * main.biBitCount + 31) / 32) * 4 != m_bytesPerRow)
+		return false;
+	DWORD offset = (DWORD)w.slice.tl.y * m_bytesPerRow;
+	if (offset % sizeof(DWORD) != 0)
+		return false;
+
+	std::vector<BYTE> info((const BYTE *)bmi, (const BYTE *)bmi + bmiSize);
+	BITMAPINFOHEADER &header = ((BITMAPINFO *)&info[0])->bmiHeader;
+	header.biHeight = -w.slice.height();
+	header.biSizeImage = 0;
+
+	if ((w.screen = GetDC(NULL)) == NULL)
+		return false;
+	if ((w.memdc = CreateCompatibleDC(w.screen)) == NULL)
+		return false;
+	void *bits = NULL;
+	w.view = CreateDIBSection(w.memdc, (BITMAPINFO *)&info[0], DIB_RGB_COLORS, &bits, m_section, offset);
+	if (w.view == NULL)
+		return false;
+	w.oldbitmap = (HBITMAP)SelectObject(w.memdc, w.view);
+	return w.oldbitmap != NULL;
+}
+
+DWORD WINAPI MonitorWorkers::WorkerThread(LPVOID param)
+{
+	Worker &w = *(Worker *)param;
+	for (;;) {
+		WaitForSingleObject(w.start, INFINITE);
+		if (w.owner->m_quit)
+			break;
+		w.owner->RunJob(w);
+		SetEvent(w.done);
+	}
+	return 0;
+}
+
+void MonitorWorkers::RunJob(Worker &w)
+{
+	if (w.job == JOB_GRAB)
+		GrabSlice(w);
+	else if (w.job == JOB_CHECK) {
+		rfb::RectVector rects;
+		w.src.get_rects(rects, 1, 1);
+		for (rfb::RectVector::const_iterator i = rects.begin(); i != rects.end(); ++i)
+			m_buffer->ScanRect(w.changed, w.cached, *i, m_full, w.rowIndex);
+	}
+}
+
+void MonitorWorkers::GrabSlice(Worker &w)
+{
+	// The rects of a band go in one blit, as in vncBuffer::GrabRegion()
+	rfb::RectVector rects;
+	w.src.get_rects(rects, 1, 1);
+	rfb::Rect band;
+	band.clear();
+	for (rfb::RectVector::const_iterator i = rects.begin(); i != rects.end(); ++i) {
+		if (i->tl.y > band.br.y) {
+			if (!band.is_empty())
+				Blit(w, band);
+			band = *i;
+		}
+		else
+			band = i->union_boundary(band);
+	}
+	if (!band.is_empty())
+		Blit(w, band);
+	// GDI batches per thread, the desktop thread reads the bits next
+	GdiFlush();
+}
+
+void MonitorWorkers::Blit(Worker &w, const rfb::Rect &rect)
+{
+	BitBlt(w.memdc, rect.tl.x, rect.tl.y - w.slice.tl.y, rect.width(), rect.height(),
+		   w.screen, rect.tl.x + m_screenOffsetx, rect.tl.y + m_screenOffsety, m_rop);
+}
+
+rfb::Region2D MonitorWorkers::Run(Job job, const rfb::Region2D &src)
+{
+	HANDLE waits[MAX_WORKERS];
+	Worker *running[MAX_WORKERS];
+	int nwaits = 0;
+	rfb::Region2D rest = src;
+	for (int i = 0; i < m_count; i++) {
+		Worker &w = m_workers[i];
+		rfb::Region2D part = src.intersect(w.slice);
+		rest.assign_subtract(w.slice);
+		rfb::Region2D &later = job == JOB_GRAB ? w.grabLater : w.checkLater;
+		// Still capturing from an earlier pass. A capture that came in
+		// is checked before the next one starts, so a monitor that is
+		// always slow is still checked every other pass.
+		if ((w.late && WaitForSingleObject(w.done, 0) != WAIT_OBJECT_0) ||
+			(job == JOB_GRAB && !w.checkLater.is_empty())) {
+			later.assign_union(part);
+			continue;
+		}
+		w.late = false;
+		part.assign_union(later);
+		later.clear();
+		w.src = part;
+		w.changed.clear();
+		w.cached.clear();
+		w.job = w.src.is_empty() ? JOB_NONE : job;
+		if (w.job == JOB_NONE)
+			continue;
+		ResetEvent(w.done);
+		SetEvent(w.start);
+		running[nwaits] = &w;
+		waits[nwaits++] = w.done;
+	}
+
+	DWORD start = GetTickCount();
+	DWORD limit = INFINITE;
+	while (nwaits > 0) {
+		DWORD timeout = INFINITE;
+		if (limit != INFINITE) {
+			DWORD elapsed = GetTickCount() - start;
+			timeout = elapsed < limit ? limit - elapsed : 0;
+		}
+		DWORD result = WaitForMultipleObjects(nwaits, waits, FALSE, timeout);
+		if (result == WAIT_TIMEOUT) {
+			// Only captures get here. Their rows are not read before
+			// Finish() or a pass that finds them done.
+			for (int i = 0; i < nwaits; i++)
+				running[i]->late = true;
+			break;
+		}
+		if (result >= WAIT_OBJECT_0 + (DWORD)nwaits) {
+			// Cannot tell which one is done, take them all
+			WaitForMultipleObjects(nwaits, waits, TRUE, INFINITE);
+			for (int i = 0; i < nwaits; i++)
+				Merge(*running[i]);
+			break;
+		}
+		int k = (int)(result - WAIT_OBJECT_0);
+		Merge(*running[k]);
+		// done stays set, the slice leaves the wait
+		nwaits--;
+		waits[k] = waits[nwaits];
+		running[k] = running[nwaits];
+		// A check is memory bound and always waited for
+		if (job == JOB_GRAB && limit == INFINITE)
+			limit = max((DWORD)LATE_MIN, 2 * (GetTickCount() - start));
+	}
+	return rest;
+}
+
+void MonitorWorkers::Merge(Worker &w)
+{
+	if (w.job != JOB_CHECK)
+		return;
+	m_dest->assign_union(w.changed);
+	m_cacheRgn->assign_union(w.cached);
+}
+
+rfb::Region2D MonitorWorkers::Grab(const rfb::Region2D &src, DWORD rop)
+{
+	m_rop = rop;
+	return Run(JOB_GRAB, src);
+}
+
+rfb::Region2D MonitorWorkers::Check(vncBuffer *buffer, rfb::Region2D &dest, rfb::Region2D &cacheRgn,
+									const rfb::Region2D &src, bool full)
+{
+	m_buffer = buffer;
+	m_full = full;
+	m_dest = &dest;
+	m_cacheRgn = &cacheRgn;
+	rfb::Region2D rest = Run(JOB_CHECK, src);
+	m_dest = NULL;
+	m_cacheRgn = NULL;
+	return rest;
+}
+
+void MonitorWorkers::Finish(const rfb::Rect &rect)
+{
+	for (int i = 0; i < m_count; i++) {
+		Worker &w = m_workers[i];
+		if (w.late && !w.slice.intersect(rect).is_empty()) {
+			WaitForSingleObject(w.done, INFINITE);
+			// checkLater stays, the next pass scans it
+			w.late = false;
+		}
+	}
+}
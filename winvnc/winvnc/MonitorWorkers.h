@@ -0,0 +1,155 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WINVNC_MONITORWORKERS)
+#define _WINVNC_MONITORWORKERS
+#pragma once
+
+#include "stdhdrs.h"
+#include "rfbRegion.h"
+#include "rfbRect.h"
+#include <vector>
+
+class vncBuffer;
+
+////////////////////////////////////////
+// class MonitorWorkers;
+//
+// Capture and change detection for a
+// desktop that spans several monitors,
+// with one worker per monitor. Each
+// worker owns its monitor's slice of
+// the framebuffer: its own screen and
+// memory DCs, a DIB section view of its
+// rows of the main DIB section, and its
+// own changed region. The desktop thread
+// hands each worker the part of a region
+// on its monitor and merges the results
+// of each slice as it finishes. A monitor
+// without changes does not wake its
+// worker.
+//
+// A busy monitor, a video playing on it,
+// does not hold up the others. A capture
+// still running at twice the time the
+// first one took is left to finish on its
+// own, the pass goes on without it. What
+// that monitor needs checked, and grabbed
+// meanwhile, is done in a later pass once
+// the capture is in.
+//
+// Driven by the desktop thread only.
+//
+class MonitorWorkers
+{
+public:
+	enum { MAX_WORKERS = 8 };
+
+	MonitorWorkers();
+	~MonitorWorkers();
+
+	// Slices are the monitors in framebuffer coordinates; nothing is
+	// done while they and the framebuffer stay the same. Fewer than two
+	// usable slices stop the workers. bits/section are the main DIB
+	// section and its file mapping; without a mapping, capture stays
+	// on the desktop thread.
+	void Configure(const std::vector<rfb::Rect> &slices, void *bits, HANDLE section,
+				   const BITMAPINFO *bmi, size_t bmiSize, int bytesPerRow, int bytesPerPixel,
+				   int screenOffsetx, int screenOffsety);
+	void Stop();
+
+	bool Active() const { return m_count > 1; };
+	bool CanCapture() const { return m_count > 1 && m_canCapture; };
+
+	// BitBlts src from the screen into the main DIB section with rop.
+	// Returns the part of src outside the monitors for the caller.
+	rfb::Region2D Grab(const rfb::Region2D &src, DWORD rop);
+	// vncBuffer::CheckRegion() per monitor. The caller holds the
+	// buffer's cache lock. Returns the part of src outside the monitors.
+	rfb::Region2D Check(vncBuffer *buffer, rfb::Region2D &dest, rfb::Region2D &cacheRgn,
+						const rfb::Region2D &src, bool full);
+	// Waits for the captures still running on the monitors rect
+	// touches, before the desktop thread draws into or reads its rows
+	void Finish(const rfb::Rect &rect);
+
+private:
+	MonitorWorkers(const MonitorWorkers &);
+	MonitorWorkers &operator=(const MonitorWorkers &);
+
+	enum Job { JOB_NONE, JOB_GRAB, JOB_CHECK };
+	enum {
+		LATE_MIN = 4	// ms a capture is always waited for
+	};
+
+	struct Worker {
+		MonitorWorkers *owner;
+		rfb::Rect slice;
+		HANDLE thread;
+		HANDLE start;			// auto reset, a job is set
+		HANDLE done;			// manual reset
+		HDC screen;
+		HDC memdc;
+		HBITMAP view;			// DIB section over the slice's rows
+		HBITMAP oldbitmap;
+		int rowIndex;			// vncBuffer::nRowIndex of this slice
+		Job job;
+		rfb::Region2D src;
+		rfb::Region2D changed;
+		rfb::Region2D cached;
+		bool late;				// a capture outlived its pass
+		rfb::Region2D grabLater;	// asked for while it ran
+		rfb::Region2D checkLater;
+	};
+
+	static DWORD WINAPI WorkerThread(LPVOID param);
+	void RunJob(Worker &w);
+	void GrabSlice(Worker &w);
+	void Blit(Worker &w, const rfb::Rect &rect);
+	// Hands each worker its part of src and merges every slice as it
+	// finishes, slow captures are left running
+	rfb::Region2D Run(Job job, const rfb::Region2D &src);
+	void Merge(Worker &w);
+	bool CreateView(Worker &w, const BITMAPINFO *bmi, size_t bmiSize);
+
+	Worker m_workers[MAX_WORKERS];
+	int m_count;
+	bool m_canCapture;
+	volatile bool m_quit;
+
+	// Configuration, to tell when it changes
+	std::vector<rfb::Rect> m_slices;
+	void *m_bits;
+	HANDLE m_section;
+	int m_bytesPerRow;
+
+	// Parameters of the current job
+	int m_screenOffsetx, m_screenOffsety;
+	DWORD m_rop;
+	vncBuffer *m_buffer;
+	bool m_full;
+	rfb::Region2D *m_dest;
+	rfb::Region2D *m_cacheRgn;
+};
+
+#endif // _WINVNC_MONITORWORKERS
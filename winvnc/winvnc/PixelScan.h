@@ -0,0 +1,503 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WINVNC_PIXELSCAN)
+#define _WINVNC_PIXELSCAN
+#pragma once
+
+#include "rfb.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELSCAN_SSE2
+#endif
+
+////////////////////////////////////////
+// PixelScan
+//
+// Run scanning over rows of pixels, for
+// the encoder analysis passes (solid
+// areas, colour counts). SSE2 compares
+// 32 bytes at a time, the scalar code
+// takes short runs and finds the exact
+// end of the long ones.
+//
+// Only the bits in mask are compared, so
+// the pixel format's unused bits can be
+// ignored.
+//
+// Inline, the callers are the per pixel
+// loops of the encoders.
+//
+namespace PixelScan
+{
+#ifdef PIXELSCAN_SSE2
+	// Set once at startup, always true on x64
+	extern const bool g_sse2;
+
+	// differ() has a bit per pixel that did not compare equal
+	struct Ops8 {
+		enum { PER_VECTOR = 16, SHIFT = 0 };
+		static __m128i set1(CARD8 c) { return _mm_set1_epi8((char)c); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+		static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi8(a, b); }
+		static unsigned differ(__m128i eq) { return ~_mm_movemask_epi8(eq) & 0xFFFF; }
+	};
+	struct Ops16 {
+		enum { PER_VECTOR = 8, SHIFT = 1 };
+		static __m128i set1(CARD16 c) { return _mm_set1_epi16((short)c); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+		static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+		static unsigned differ(__m128i eq) {
+			return ~_mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128())) & 0xFF;
+		}
+	};
+	struct Ops32 {
+		enum { PER_VECTOR = 4, SHIFT = 2 };
+		static __m128i set1(CARD32 c) { return _mm_set1_epi32((int)c); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+		static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+		static unsigned differ(__m128i eq) { return ~_mm_movemask_ps(_mm_castsi128_ps(eq)) & 0xF; }
+	};
+	// By size, so rdr::U32 pixels work as well as CARD32
+	template <int SIZE> struct OpsBySize;
+	template <> struct OpsBySize<1> { typedef Ops8 Ops; };
+	template <> struct OpsBySize<2> { typedef Ops16 Ops; };
+	template <> struct OpsBySize<4> { typedef Ops32 Ops; };
+	template <class T> struct OpsFor : OpsBySize<sizeof(T)> {};
+
+	inline int PopCount16(int m)
+	{
+		m = m - ((m >> 1) & 0x5555);
+		m = (m & 0x3333) + ((m >> 2) & 0x3333);
+		m = (m + (m >> 4)) & 0x0F0F;
+		return (m + (m >> 8)) & 0x1F;
+	}
+#endif
+
+	// Index of the lowest set bit, m != 0
+	inline int LowestBit(unsigned m)
+	{
+#ifdef _MSC_VER
+		unsigned long b;
+		_BitScanForward(&b, m);
+		return (int)b;
+#else
+		return __builtin_ctz(m);
+#endif
+	}
+
+	// Scalar pixels checked before the vector loop, most runs in
+	// text and UI are shorter
+	enum { SCALAR_LEAD = 8 };
+
+	// Leading pixels of p[0..n) equal to c
+	template <class T>
+	inline int Run(const T *p, int n, T c, T mask = (T)~0)
+	{
+		c &= mask;
+		int i = 0;
+		int lead = n < SCALAR_LEAD ? n : SCALAR_LEAD;
+		while (i < lead && (T)(p[i] & mask) == c)
+			i++;
+		if (i < lead || i == n)
+			return i;
+#ifdef PIXELSCAN_SSE2
+		if (g_sse2) {
+			typedef typename OpsFor<T>::Ops OPS;
+			const int step = 2 * OPS::PER_VECTOR;
+			const __m128i vc = OPS::set1(c);
+			const __m128i vm = OPS::set1(mask);
+			for (; i + step <= n; i += step) {
+				__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), vm);
+				__m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i + OPS::PER_VECTOR)), vm);
+				__m128i eq = _mm_and_si128(OPS::cmpeq(a, vc), OPS::cmpeq(b, vc));
+				if (_mm_movemask_epi8(eq) != 0xFFFF)
+					break;
+			}
+		}
+#endif
+		while (i < n && (T)(p[i] & mask) == c)
+			i++;
+		return i;
+	}
+
+	// True if all of p[0..n) equal c. No scalar lead, for rows
+	// that are expected to be solid.
+	template <class T>
+	inline bool Equal(const T *p, int n, T c)
+	{
+		int i = 0;
+#ifdef PIXELSCAN_SSE2
+		if (g_sse2) {
+			typedef typename OpsFor<T>::Ops OPS;
+			const __m128i vc = OPS::set1(c);
+			for (; i + 2 * OPS::PER_VECTOR <= n; i += 2 * OPS::PER_VECTOR) {
+				__m128i a = OPS::cmpeq(_mm_loadu_si128((const __m128i *)(p + i)), vc);
+				__m128i b = OPS::cmpeq(_mm_loadu_si128((const __m128i *)(p + i + OPS::PER_VECTOR)), vc);
+				if (_mm_movemask_epi8(_mm_and_si128(a, b)) != 0xFFFF)
+					return false;
+			}
+			if (i + OPS::PER_VECTOR <= n) {
+				if (_mm_movemask_epi8(OPS::cmpeq(_mm_loadu_si128((const __m128i *)(p + i)), vc)) != 0xFFFF)
+					return false;
+				i += OPS::PER_VECTOR;
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			if (p[i] != c)
+				return false;
+		}
+		return true;
+	}
+
+	// Trailing pixels of p[0..n) equal to c
+	template <class T>
+	inline int RunBack(const T *p, int n, T c, T mask = (T)~0)
+	{
+		c &= mask;
+		int i = n;
+#ifdef PIXELSCAN_SSE2
+		if (g_sse2) {
+			typedef typename OpsFor<T>::Ops OPS;
+			const int step = 2 * OPS::PER_VECTOR;
+			const __m128i vc = OPS::set1(c);
+			const __m128i vm = OPS::set1(mask);
+			for (; i >= step; i -= step) {
+				__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i - step)), vm);
+				__m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i - OPS::PER_VECTOR)), vm);
+				__m128i eq = _mm_and_si128(OPS::cmpeq(a, vc), OPS::cmpeq(b, vc));
+				if (_mm_movemask_epi8(eq) != 0xFFFF)
+					break;
+			}
+		}
+#endif
+		while (i > 0 && (T)(p[i - 1] & mask) == c)
+			i--;
+		return n - i;
+	}
+
+	// Pixels of p[1..n) that differ from the one before them, the
+	// number of runs in p[0..n) less one
+	template <class T>
+	inline int Changes(const T *p, int n)
+	{
+		int changes = 0;
+		int i = 1;
+#ifdef PIXELSCAN_SSE2
+		if (g_sse2) {
+			typedef typename OpsFor<T>::Ops OPS;
+			for (; i + OPS::PER_VECTOR <= n; i += OPS::PER_VECTOR) {
+				__m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+				__m128i b = _mm_loadu_si128((const __m128i *)(p + i - 1));
+				changes += PopCount16(~_mm_movemask_epi8(OPS::cmpeq(a, b)) & 0xFFFF) >> OPS::SHIFT;
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			if (p[i] != p[i - 1])
+				changes++;
+		}
+		return changes;
+	}
+
+	// The runs of p[0..n) one after the other, for the palette
+	// builders. With SSE2 a vector of pixels is compared with the
+	// pixels before them at once: a run ending in it then costs a bit
+	// scan, a long run a compare per vector.
+	template <class T>
+	class RunWalker
+	{
+	public:
+		RunWalker(const T *p, int n, T mask = (T)~0)
+			: m_p(p), m_n(n), m_mask(mask), m_pos(0), m_next(1), m_base(0), m_ends(0) {}
+
+		// Where the next run starts, n after the last
+		int Pos() const { return m_pos; }
+
+		// Length of the run at Pos(), which moves past it
+		int Next()
+		{
+			int start = m_pos;
+			for (;;) {
+				if (m_ends != 0) {
+					m_pos = m_base + LowestBit(m_ends);
+					m_ends &= m_ends - 1;
+					return m_pos - start;
+				}
+#ifdef PIXELSCAN_SSE2
+				typedef typename OpsFor<T>::Ops OPS;
+				if (g_sse2 && m_next + OPS::PER_VECTOR <= m_n) {
+					const __m128i vm = OPS::set1(m_mask);
+					__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(m_p + m_next)), vm);
+					__m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(m_p + m_next - 1)), vm);
+					m_ends = OPS::differ(OPS::cmpeq(a, b));
+					m_base = m_next;
+					m_next += OPS::PER_VECTOR;
+					continue;
+				}
+#endif
+				while (m_next < m_n && (T)((m_p[m_next] ^ m_p[m_next - 1]) & m_mask) == 0)
+					m_next++;
+				m_pos = m_next < m_n ? m_next++ : m_n;
+				return m_pos - start;
+			}
+		}
+
+	private:
+		const T *m_p;
+		int m_n;
+		T m_mask;
+		int m_pos;
+		int m_next;			// first pixel not compared yet
+		int m_base;			// pixel of bit 0 of m_ends
+		unsigned m_ends;	// runs starting in the vector at m_base
+	};
+
+	// Pixels and last position of each of the first colours of a rect.
+	// Up to MAX colours every vector is compared with all of them and the
+	// compares are summed, with no branch per run; the last positions
+	// are looked up once at the end. Without SSE2 nothing is counted.
+	template <class T>
+	class ColourCounter
+	{
+	public:
+		enum { MAX = 4 };
+
+		ColourCounter(int limit, T mask = (T)~0)
+			: count(0), m_limit(limit < MAX ? limit : MAX), m_mask(mask) {}
+
+		// A colour counted already, last seen at pos
+		void Seed(T c, int n, int pos)
+		{
+			colour[count] = (T)(c & m_mask);
+			pixels[count] = n;
+			last[count] = pos;
+			m_lastBlock[count] = 0;
+			count++;
+		}
+
+		// Counts p[0..n), p[0] being at position pos, up to the pixel
+		// before the one more colour than the limit. Returns the pixels
+		// counted. p must stay valid until SortByLast().
+		int Add(const T *p, int n, int pos)
+		{
+			int i = 0;
+#ifdef PIXELSCAN_SSE2
+			if (!g_sse2)
+				return 0;
+			typedef typename OpsFor<T>::Ops OPS;
+			int sums[MAX];
+			while (i + OPS::PER_VECTOR <= n) {
+				int vectors = (n - i) / OPS::PER_VECTOR;
+				if (vectors > BLOCK)
+					vectors = BLOCK;
+				bool known;
+				switch (count) {
+				case 1: known = Block<1>(p + i, vectors, sums); break;
+				case 2: known = Block<2>(p + i, vectors, sums); break;
+				case 3: known = Block<3>(p + i, vectors, sums); break;
+				case 4: known = Block<4>(p + i, vectors, sums); break;
+				default: known = false;
+				}
+				int end = i + vectors * OPS::PER_VECTOR;
+				if (known) {
+					for (int k = 0; k < count; k++) {
+						if (sums[k] != 0) {
+							pixels[k] += sums[k];
+							last[k] = pos + i;
+							m_lastBlock[k] = p + i;
+							m_lastLength[k] = end - i;
+						}
+					}
+					i = end;
+					continue;
+				}
+				// A new colour in the block, which is counted pixel by pixel
+				for (; i < end; i++) {
+					if (!AddPixel(p, i, pos))
+						return i;
+				}
+			}
+			for (; i < n; i++) {
+				if (!AddPixel(p, i, pos))
+					break;
+			}
+#endif
+			return i;
+		}
+
+		// Puts the colours in the order they were last seen
+		void SortByLast()
+		{
+			int k, j;
+			for (k = 0; k < count; k++) {
+				if (m_lastBlock[k] != 0) {
+					for (j = m_lastLength[k] - 1; (T)(m_lastBlock[k][j] & m_mask) != colour[k]; j--)
+						;
+					last[k] += j;
+				}
+			}
+			for (k = 1; k < count; k++) {
+				T c = colour[k];
+				int n = pixels[k], pos = last[k];
+				for (j = k; j > 0 && last[j - 1] > pos; j--) {
+					colour[j] = colour[j - 1];
+					pixels[j] = pixels[j - 1];
+					last[j] = last[j - 1];
+				}
+				colour[j] = c;
+				pixels[j] = n;
+				last[j] = pos;
+			}
+		}
+
+		int count;
+		T colour[MAX];
+		int pixels[MAX];
+		int last[MAX];
+
+	private:
+		// Vectors per block, few enough for the 8-bit sums
+		enum { BLOCK = 16 };
+
+#ifdef PIXELSCAN_SSE2
+		// Sums of the K colours in p[0..vectors), false if the block
+		// holds another colour
+		template <int K>
+		bool Block(const T *p, int vectors, int *sums) const
+		{
+			// Written out, as not all compilers keep arrays of them in registers
+			typedef typename OpsFor<T>::Ops OPS;
+			const __m128i vm = OPS::set1(m_mask);
+			const __m128i c0 = OPS::set1(colour[0]);
+			const __m128i c1 = OPS::set1(colour[K > 1 ? 1 : 0]);
+			const __m128i c2 = OPS::set1(colour[K > 2 ? 2 : 0]);
+			const __m128i c3 = OPS::set1(colour[K > 3 ? 3 : 0]);
+			__m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+			__m128i all = _mm_set1_epi32(-1);
+			for (int v = 0; v < vectors; v++) {
+				__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + v * OPS::PER_VECTOR)), vm);
+				__m128i eq = OPS::cmpeq(a, c0), any = eq;
+				s0 = OPS::sub(s0, eq);
+				if (K > 1) {
+					eq = OPS::cmpeq(a, c1);
+					s1 = OPS::sub(s1, eq);
+					any = _mm_or_si128(any, eq);
+				}
+				if (K > 2) {
+					eq = OPS::cmpeq(a, c2);
+					s2 = OPS::sub(s2, eq);
+					any = _mm_or_si128(any, eq);
+				}
+				if (K > 3) {
+					eq = OPS::cmpeq(a, c3);
+					s3 = OPS::sub(s3, eq);
+					any = _mm_or_si128(any, eq);
+				}
+				all = _mm_and_si128(all, any);
+			}
+			if (_mm_movemask_epi8(all) != 0xFFFF)
+				return false;
+			sums[0] = Sum(s0);
+			if (K > 1) sums[1] = Sum(s1);
+			if (K > 2) sums[2] = Sum(s2);
+			if (K > 3) sums[3] = Sum(s3);
+			return true;
+		}
+
+		static int Sum(__m128i s)
+		{
+			typedef typename OpsFor<T>::Ops OPS;
+			T lanes[OPS::PER_VECTOR];
+			_mm_storeu_si128((__m128i *)lanes, s);
+			int sum = 0;
+			for (int l = 0; l < OPS::PER_VECTOR; l++)
+				sum += lanes[l];
+			return sum;
+		}
+#endif
+
+		bool AddPixel(const T *p, int i, int pos)
+		{
+			T c = (T)(p[i] & m_mask);
+			int k;
+			for (k = 0; k < count && colour[k] != c; k++)
+				;
+			if (k == count) {
+				if (count == m_limit)
+					return false;
+				Seed(c, 0, 0);
+			}
+			pixels[k]++;
+			last[k] = pos + i;
+			m_lastBlock[k] = 0;
+			return true;
+		}
+
+		int m_limit;
+		T m_mask;
+		const T *m_lastBlock[MAX];	// block last seen in if not at last
+		int m_lastLength[MAX];
+	};
+
+	// Leading pixels of p[0..n) that are c0 or c1,
+	// n0 is increased by how many of them are c0
+	template <class T>
+	inline int Run2(const T *p, int n, T c0, T c1, int &n0, T mask = (T)~0)
+	{
+		c0 &= mask;
+		c1 &= mask;
+		int i = 0;
+#ifdef PIXELSCAN_SSE2
+		if (g_sse2) {
+			typedef typename OpsFor<T>::Ops OPS;
+			const __m128i v0 = OPS::set1(c0);
+			const __m128i v1 = OPS::set1(c1);
+			const __m128i vm = OPS::set1(mask);
+			for (; i + OPS::PER_VECTOR <= n; i += OPS::PER_VECTOR) {
+				__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), vm);
+				__m128i eq0 = OPS::cmpeq(a, v0);
+				__m128i eq1 = OPS::cmpeq(a, v1);
+				if (_mm_movemask_epi8(_mm_or_si128(eq0, eq1)) != 0xFFFF)
+					break;
+				n0 += PopCount16(_mm_movemask_epi8(eq0)) >> OPS::SHIFT;
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			T ci = (T)(p[i] & mask);
+			if (ci == c0)
+				n0++;
+			else if (ci != c1)
+				break;
+		}
+		return i;
+	}
+};
+
+#endif // _WINVNC_PIXELSCAN
@@ -33,7 +33,12 @@
 
 // Define the CARD* types as used in X11/Xmd.h
 
+#ifdef _VNC_PORTABLE
+// long is 64 bits on LP64 platforms
+typedef unsigned int CARD32;
+#else
 typedef unsigned long CARD32;
+#endif
 typedef unsigned short CARD16;
 typedef short INT16;
 typedef unsigned char  CARD8;
@@ -24,7 +24,7 @@
 #ifndef __RFB_RECT_INCLUDED__
 #define __RFB_RECT_INCLUDED__
 
-#ifdef WIN32
+#if defined(WIN32) || defined(_VNC_PORTABLE)
 #include <windows.h>
 #endif
 
@@ -45,7 +45,7 @@ namespace rfb {
 	struct Point {
 		Point() : x(0), y(0) {}
 		Point(int x_, int y_) : x(x_), y(y_) {}
-#ifdef WIN32
+#if defined(WIN32) || defined(_VNC_PORTABLE)
 		Point(const POINT &p) : x(p.x), y(p.y) {}
 #endif
 		Point negate() const {return Point(-x, -y);}
@@ -69,7 +69,7 @@ namespace rfb {
 		Rect() {}
 		Rect(Point tl_, Point br_) : tl(tl_), br(br_) {}
 		Rect(int x1, int y1, int x2, int y2) : tl(x1, y1), br(x2, y2) {}
-#ifdef WIN32
+#if defined(WIN32) || defined(_VNC_PORTABLE)
 		Rect(const RECT &r) : tl(r.left, r.top), br(r.right, r.bottom) {}
 #endif
 		Rect intersect(const Rect &r) const {
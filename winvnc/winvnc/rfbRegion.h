@@ -20,12 +20,19 @@
 // the authors on info@realvnc.com for information on obtaining it.
 
 //#define USE_X11_REGIONS
+// GDI HRGN based regions, the default before the banded rect lists
+//#define USE_WIN32_REGIONS
 
 #ifdef USE_X11_REGIONS
 #include "rfbRegion_X11.h"
-#else
+#elif defined(USE_WIN32_REGIONS)
 
 #include "rfbRegion_win32.h"
+namespace rfb { typedef Region Region2D; };
+
+#else
 
+#include "rfbRegion_banded.h"
+namespace rfb { typedef BandedRegion Region2D; };
 
 #endif // X11
@@ -113,6 +113,10 @@ void Region::setOrderedRects(const std::vector<Rect>& rects) {
   }
 }
 
+void Region::setRects(std::vector<Rect>& rects) {
+  clear();
+  setOrderedRects(rects);
+}
 
 void Region::assign_intersect(const Region& r) {
   XIntersectRegion(r.Xrgn, Xrgn, Xrgn);
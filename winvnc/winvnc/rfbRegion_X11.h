@@ -52,6 +52,7 @@ namespace rfb {
     void reset(const Rect& r);
     void translate(const rfb::Point& delta);
     void setOrderedRects(const std::vector<Rect>& rects);
+    void setRects(std::vector<Rect>& rects);
 
     void assign_intersect(const Region& r);
     void assign_union(const Region& r);
@@ -0,0 +1,562 @@
+//  Copyright (C) 2002-2003 RealVNC Ltd. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check http://www.realvnc.com/ or contact
+// the authors on info@realvnc.com for information on obtaining it.
+
+// Portable rfb::Region based on banded rectangle lists
+
+#include "stdhdrs.h"
+#include "rfbRegion_banded.h"
+#include <limits.h>
+#include <algorithm>
+
+using namespace rfb;
+
+namespace {
+
+	// Index just past the band starting at rects[i]
+	inline size_t band_end(const std::vector<Rect>& rects, size_t i)
+	{
+		const int top = rects[i].tl.y;
+		const size_t n = rects.size();
+		while (i < n && rects[i].tl.y == top)
+			i++;
+		return i;
+	}
+
+	// Writes the bands produced by a sweep, merging touching spans and
+	// vertically adjacent bands with identical spans on the fly.
+	class BandWriter {
+	public:
+		BandWriter(std::vector<Rect>& out) : m_out(out), m_prev((size_t)-1), m_cur(0), m_y1(0), m_y2(0) {}
+
+		void begin(int y1, int y2) {
+			m_cur = m_out.size();
+			m_y1 = y1;
+			m_y2 = y2;
+		}
+
+		// Spans must arrive sorted by x1
+		void span(int x1, int x2) {
+			if (x1 >= x2)
+				return;
+			if (m_out.size() > m_cur && m_out.back().br.x >= x1) {
+				if (x2 > m_out.back().br.x)
+					m_out.back().br.x = x2;
+				return;
+			}
+			m_out.push_back(Rect(x1, m_y1, x2, m_y2));
+		}
+
+		void end() {
+			const size_t n = m_out.size() - m_cur;
+			if (n == 0)
+				return;
+			if (m_prev != (size_t)-1 && m_cur - m_prev == n && m_out[m_prev].br.y == m_y1) {
+				size_t i;
+				for (i = 0; i < n; i++) {
+					if (m_out[m_prev + i].tl.x != m_out[m_cur + i].tl.x ||
+						m_out[m_prev + i].br.x != m_out[m_cur + i].br.x)
+						break;
+				}
+				if (i == n) {
+					for (i = 0; i < n; i++)
+						m_out[m_prev + i].br.y = m_y2;
+					m_out.resize(m_cur);
+					return;
+				}
+			}
+			m_prev = m_cur;
+		}
+
+	private:
+		std::vector<Rect>& m_out;
+		size_t m_prev;
+		size_t m_cur;
+		int m_y1, m_y2;
+	};
+
+	inline bool by_top(const Rect& a, const Rect& b)
+	{
+		return a.tl.y < b.tl.y;
+	}
+
+	inline bool by_left(const Rect& a, const Rect& b)
+	{
+		return a.tl.x < b.tl.x;
+	}
+
+	void spans_union(BandWriter& w, const Rect* a, const Rect* ae, const Rect* b, const Rect* be)
+	{
+		while (a < ae || b < be) {
+			if (b >= be || (a < ae && a->tl.x <= b->tl.x)) {
+				w.span(a->tl.x, a->br.x);
+				a++;
+			}
+			else {
+				w.span(b->tl.x, b->br.x);
+				b++;
+			}
+		}
+	}
+
+	void spans_intersect(BandWriter& w, const Rect* a, const Rect* ae, const Rect* b, const Rect* be)
+	{
+		while (a < ae && b < be) {
+			const int x1 = std::max(a->tl.x, b->tl.x);
+			const int x2 = std::min(a->br.x, b->br.x);
+			w.span(x1, x2);
+			if (a->br.x < b->br.x)
+				a++;
+			else
+				b++;
+		}
+	}
+
+	void spans_subtract(BandWriter& w, const Rect* a, const Rect* ae, const Rect* b, const Rect* be)
+	{
+		for (; a < ae; a++) {
+			int x1 = a->tl.x;
+			const int x2 = a->br.x;
+			while (b < be && b->br.x <= x1)
+				b++;
+			const Rect* bb = b;
+			while (bb < be && bb->tl.x < x2) {
+				w.span(x1, bb->tl.x);
+				if (bb->br.x >= x2) {
+					x1 = x2;
+					break;
+				}
+				x1 = bb->br.x;
+				bb++;
+			}
+			w.span(x1, x2);
+		}
+	}
+
+}
+
+BandedRegion::BandedRegion() : m_tail_dirty(false), m_extents(0, 0, 0, 0) {
+}
+
+BandedRegion::BandedRegion(int x1, int y1, int x2, int y2) : m_tail_dirty(false), m_extents(0, 0, 0, 0) {
+  reset(Rect(x1, y1, x2, y2));
+}
+
+BandedRegion::BandedRegion(const Rect& r) : m_tail_dirty(false), m_extents(0, 0, 0, 0) {
+  reset(r);
+}
+
+BandedRegion::BandedRegion(const BandedRegion& r) : m_tail_dirty(false), m_extents(0, 0, 0, 0) {
+  *this = r;
+}
+
+BandedRegion::~BandedRegion() {
+}
+
+rfb::BandedRegion& BandedRegion::operator=(const BandedRegion& r) {
+  if (this == &r)
+	  return *this;
+  r.normalize();
+  m_rects.assign(r.m_rects.begin(), r.m_rects.end());
+  m_tail_dirty = false;
+  m_extents = r.m_extents;
+  return *this;
+}
+
+bool BandedRegion::IsPtInRegion(int x, int y)
+{
+	if (x < m_extents.tl.x || x >= m_extents.br.x || y < m_extents.tl.y || y >= m_extents.br.y)
+		return false;
+	for (size_t i = 0; i < m_rects.size(); i++) {
+		const Rect& r = m_rects[i];
+		if (r.tl.y > y)
+			break;
+		if (y < r.br.y && x >= r.tl.x && x < r.br.x)
+			return true;
+	}
+	return false;
+}
+
+void BandedRegion::clear() {
+  m_rects.clear();
+  m_tail_dirty = false;
+  m_extents = Rect(0, 0, 0, 0);
+}
+
+void BandedRegion::reset(const Rect& r) {
+  clear();
+  if (!r.is_empty()) {
+	  m_rects.push_back(r);
+	  m_extents = r;
+  }
+}
+
+void BandedRegion::translate(const Point& delta) {
+  for (size_t i = 0; i < m_rects.size(); i++)
+	  m_rects[i] = m_rects[i].translate(delta);
+  if (!m_rects.empty())
+	  m_extents = m_extents.translate(delta);
+}
+
+void BandedRegion::setOrderedRects(const std::vector<Rect>& rects) {
+  clear();
+  for (size_t i = 0; i < rects.size(); i++)
+	  assign_union(BandedRegion(rects[i]));
+}
+
+// The slabs between consecutive rect edges, each written from the rects
+// that span it. The active rects are kept sorted by x, so a slab is one
+// pass over them, and the work follows the rects alive in each slab rather
+// than their total.
+void BandedRegion::setRects(std::vector<Rect>& rects) {
+  clear();
+  size_t n = 0;
+  for (size_t i = 0; i < rects.size(); i++) {
+	  if (!rects[i].is_empty())
+		  rects[n++] = rects[i];
+  }
+  rects.resize(n);
+  if (n == 0)
+	  return;
+  std::sort(rects.begin(), rects.end(), by_top);
+
+  m_edges.clear();
+  for (size_t i = 0; i < n; i++) {
+	  m_edges.push_back(rects[i].tl.y);
+	  m_edges.push_back(rects[i].br.y);
+  }
+  std::sort(m_edges.begin(), m_edges.end());
+  m_edges.erase(std::unique(m_edges.begin(), m_edges.end()), m_edges.end());
+
+  std::vector<Rect>& active = m_scratch;
+  active.clear();
+  BandWriter w(m_rects);
+  size_t next = 0;
+  for (size_t e = 0; e + 1 < m_edges.size(); e++) {
+	  const int y1 = m_edges[e], y2 = m_edges[e + 1];
+	  size_t live = 0;
+	  for (size_t i = 0; i < active.size(); i++) {
+		  if (active[i].br.y > y1)
+			  active[live++] = active[i];
+	  }
+	  active.resize(live);
+	  if (next < n && rects[next].tl.y == y1) {
+		  while (next < n && rects[next].tl.y == y1)
+			  active.push_back(rects[next++]);
+		  std::sort(active.begin(), active.end(), by_left);
+	  }
+	  if (active.empty())
+		  continue;
+	  w.begin(y1, y2);
+	  for (size_t i = 0; i < active.size(); i++)
+		  w.span(active[i].tl.x, active[i].br.x);
+	  w.end();
+  }
+  active.clear();
+  update_extents();
+}
+
+// Merges the last band into the one above it when they touch and have the
+// same spans. Only the last band can be left uncoalesced by append_rect().
+void BandedRegion::normalize() const {
+  if (!m_tail_dirty)
+	  return;
+  m_tail_dirty = false;
+  const size_t n = m_rects.size();
+  if (n < 2)
+	  return;
+  size_t last = n - 1;
+  while (last > 0 && m_rects[last - 1].tl.y == m_rects[n - 1].tl.y)
+	  last--;
+  if (last == 0 || m_rects[last - 1].br.y != m_rects[last].tl.y)
+	  return;
+  size_t prev = last - 1;
+  while (prev > 0 && m_rects[prev - 1].tl.y == m_rects[last - 1].tl.y)
+	  prev--;
+  const size_t count = n - last;
+  if (last - prev != count)
+	  return;
+  for (size_t i = 0; i < count; i++) {
+	  if (m_rects[prev + i].tl.x != m_rects[last + i].tl.x ||
+		  m_rects[prev + i].br.x != m_rects[last + i].br.x)
+		  return;
+  }
+  const int bottom = m_rects[last].br.y;
+  for (size_t i = prev; i < last; i++)
+	  m_rects[i].br.y = bottom;
+  m_rects.resize(last);
+}
+
+// Fast path for rects arriving in scan order: below the region, or to the
+// right of the last rect in the last band. Returns false if a sweep is needed.
+bool BandedRegion::append_rect(const Rect& r) {
+  if (m_rects.empty()) {
+	  m_rects.push_back(r);
+	  m_extents = r;
+	  return true;
+  }
+  Rect& last = m_rects.back();
+  if (r.enclosed_by(last))
+	  return true;
+  if (r.tl.y >= last.br.y) {
+	  normalize();
+	  m_rects.push_back(r);
+  }
+  else if (r.tl.y == last.tl.y && r.br.y == last.br.y && r.tl.x >= last.br.x) {
+	  if (r.tl.x == last.br.x)
+		  last.br.x = r.br.x;
+	  else
+		  m_rects.push_back(r);
+  }
+  else
+	  return false;
+  m_tail_dirty = true;
+  m_extents = m_extents.union_boundary(r);
+  return true;
+}
+
+void BandedRegion::update_extents() {
+  if (m_rects.empty()) {
+	  m_extents = Rect(0, 0, 0, 0);
+	  return;
+  }
+  int x1 = INT_MAX, x2 = INT_MIN;
+  for (size_t i = 0; i < m_rects.size(); i++) {
+	  if (m_rects[i].tl.x < x1) x1 = m_rects[i].tl.x;
+	  if (m_rects[i].br.x > x2) x2 = m_rects[i].br.x;
+  }
+  m_extents = Rect(x1, m_rects.front().tl.y, x2, m_rects.back().br.y);
+}
+
+// Sweeps both band lists top to bottom. Each slab between two band edges
+// is combined span-wise and written to the scratch vector, which then
+// becomes the region. The scratch keeps its capacity for the next call.
+void BandedRegion::combine(const BandedRegion& other, int op) {
+  normalize();
+  other.normalize();
+  const std::vector<Rect>& a = m_rects;
+  const std::vector<Rect>& b = other.m_rects;
+  const size_t na = a.size(), nb = b.size();
+
+  m_scratch.clear();
+  if (m_scratch.capacity() < na + nb)
+	  m_scratch.reserve(na + nb);
+  BandWriter w(m_scratch);
+
+  size_t ia = 0, ib = 0;
+  int y = INT_MIN;
+  while (ia < na || ib < nb) {
+	  if (op == OP_INTERSECT && (ia >= na || ib >= nb))
+		  break;
+	  if (op == OP_SUBTRACT && ia >= na)
+		  break;
+
+	  int aTop = INT_MAX, aBot = INT_MAX, bTop = INT_MAX, bBot = INT_MAX;
+	  size_t ja = ia, jb = ib;
+	  if (ia < na) {
+		  aTop = a[ia].tl.y;
+		  aBot = a[ia].br.y;
+		  ja = band_end(a, ia);
+	  }
+	  if (ib < nb) {
+		  bTop = b[ib].tl.y;
+		  bBot = b[ib].br.y;
+		  jb = band_end(b, ib);
+	  }
+	  const int top = std::min(aTop, bTop);
+	  if (y < top)
+		  y = top;
+	  const bool inA = aTop <= y;
+	  const bool inB = bTop <= y;
+	  const int bottom = std::min(inA ? aBot : aTop, inB ? bBot : bTop);
+
+	  const Rect* as = inA ? &a[ia] : 0;
+	  const Rect* ae = inA ? as + (ja - ia) : 0;
+	  const Rect* bs = inB ? &b[ib] : 0;
+	  const Rect* be = inB ? bs + (jb - ib) : 0;
+
+	  w.begin(y, bottom);
+	  switch (op) {
+	  case OP_UNION:
+		  spans_union(w, as, ae, bs, be);
+		  break;
+	  case OP_INTERSECT:
+		  if (inA && inB)
+			  spans_intersect(w, as, ae, bs, be);
+		  break;
+	  case OP_SUBTRACT:
+		  if (inA)
+			  spans_subtract(w, as, ae, bs, be);
+		  break;
+	  }
+	  w.end();
+
+	  y = bottom;
+	  if (ia < na && aBot <= y)
+		  ia = ja;
+	  if (ib < nb && bBot <= y)
+		  ib = jb;
+  }
+
+  m_rects.swap(m_scratch);
+  m_tail_dirty = false;
+  update_extents();
+}
+
+void BandedRegion::assign_intersect(const BandedRegion& r) {
+  if (this == &r)
+	  return;
+  if (m_rects.empty())
+	  return;
+  if (r.m_rects.empty() || m_extents.intersect(r.m_extents).is_empty()) {
+	  clear();
+	  return;
+  }
+  if (r.m_rects.size() == 1 && m_extents.enclosed_by(r.m_extents))
+	  return;
+  if (m_rects.size() == 1 && r.m_rects.size() == 1) {
+	  reset(m_rects[0].intersect(r.m_rects[0]));
+	  return;
+  }
+  combine(r, OP_INTERSECT);
+}
+
+void BandedRegion::assign_union(const BandedRegion& r) {
+  if (this == &r || r.m_rects.empty())
+	  return;
+  if (m_rects.empty()) {
+	  *this = r;
+	  return;
+  }
+  if (r.m_rects.size() == 1) {
+	  if (m_extents.enclosed_by(r.m_extents)) {
+		  reset(r.m_rects[0]);
+		  return;
+	  }
+	  if (append_rect(r.m_rects[0]))
+		  return;
+  }
+  combine(r, OP_UNION);
+}
+
+void BandedRegion::assign_subtract(const BandedRegion& r) {
+  if (this == &r) {
+	  clear();
+	  return;
+  }
+  if (m_rects.empty() || r.m_rects.empty() || m_extents.intersect(r.m_extents).is_empty())
+	  return;
+  if (r.m_rects.size() == 1 && m_extents.enclosed_by(r.m_extents)) {
+	  clear();
+	  return;
+  }
+  combine(r, OP_SUBTRACT);
+}
+
+
+rfb::BandedRegion BandedRegion::intersect(const BandedRegion& r) const {
+  BandedRegion t = *this;
+  t.assign_intersect(r);
+  return t;
+}
+
+rfb::BandedRegion BandedRegion::union_(const BandedRegion& r) const {
+  BandedRegion t = *this;
+  t.assign_union(r);
+  return t;
+}
+
+rfb::BandedRegion BandedRegion::subtract(const BandedRegion& r) const {
+  BandedRegion t = *this;
+  t.assign_subtract(r);
+  return t;
+}
+
+
+bool BandedRegion::equals(const BandedRegion& b) const {
+  normalize();
+  b.normalize();
+  if (m_rects.size() != b.m_rects.size())
+	  return false;
+  for (size_t i = 0; i < m_rects.size(); i++) {
+	  if (!m_rects[i].equals(b.m_rects[i]))
+		  return false;
+  }
+  return true;
+}
+
+bool BandedRegion::is_empty() const {
+  return m_rects.empty();
+}
+
+bool BandedRegion::get_rects(std::vector<Rect>& rects,
+					   bool left2right,
+					   bool topdown) const {
+   normalize();
+   rects.clear();
+   size_t nRects = m_rects.size();
+   if (nRects == 0)
+	   return false;
+   rects.reserve(nRects);
+
+   if (left2right && topdown) {
+	   rects.assign(m_rects.begin(), m_rects.end());
+	   return true;
+   }
+
+   // Same band walk as the GDI version: bands in y order, rects within a
+   // band in x order, either of them reversed as requested.
+   int xInc = left2right ? 1 : -1;
+   int yInc = topdown ? 1 : -1;
+   int i = topdown ? 0 : (int)nRects-1;
+
+   while (nRects > 0) {
+	   int firstInNextBand = i;
+	   int nRectsInBand = 0;
+
+	   while (nRects > 0 && m_rects[firstInNextBand].tl.y == m_rects[i].tl.y) {
+		   firstInNextBand += yInc;
+		   nRects--;
+		   nRectsInBand++;
+	   }
+
+	   if (xInc != yInc)
+		   i = firstInNextBand - yInc;
+
+	   while (nRectsInBand > 0) {
+		   rects.push_back(m_rects[i]);
+		   i += xInc;
+		   nRectsInBand--;
+	   }
+
+	   i = firstInNextBand;
+   }
+   return true;
+}
+
+rfb::Rect BandedRegion::get_bounding_rect() const {
+  return m_extents;
+}
+
+int BandedRegion::Numrects()
+{
+	normalize();
+	return (int)m_rects.size();
+}
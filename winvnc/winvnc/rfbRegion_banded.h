@@ -0,0 +1,109 @@
+//  Copyright (C) 2002-2003 RealVNC Ltd. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check http://www.realvnc.com/ or contact
+// the authors on info@realvnc.com for information on obtaining it.
+
+// Portable rfb::Region based on banded rectangle lists
+
+#ifndef __RFB_REGION_BANDED_INCLUDED__
+#define __RFB_REGION_BANDED_INCLUDED__
+
+#include "rfbRect.h"
+#include <vector>
+
+namespace rfb {
+
+	// rfb::BandedRegion
+	//
+	// Same interface as the GDI based region, without any kernel objects.
+	//
+	// The rectangles are kept in y-x banded order: every band is a run of
+	// rects sharing the same top and bottom, sorted by x, neither
+	// overlapping nor touching. Bands never overlap, and vertically
+	// adjacent bands with identical x spans are merged, so equal regions
+	// have identical rect lists.
+	//
+	// Set operations sweep both band lists once into a scratch vector that
+	// is owned by the region and swapped in, so a long-lived region such as
+	// the desktop thread's rgncache stops allocating once warm.
+	// Adding rects in scan order (what CheckRect and the driver ingestion
+	// do) is appended in place without a sweep.
+
+  class BandedRegion {
+  public:
+    // Create an empty region
+    BandedRegion();
+    // Create a rectangular region
+    BandedRegion(int x1, int y1, int x2, int y2);
+    BandedRegion(const Rect& r);
+
+    BandedRegion(const BandedRegion& r);
+    BandedRegion &operator=(const BandedRegion& src);
+	bool IsPtInRegion(int x, int y);
+
+    ~BandedRegion();
+
+    // the following methods alter the region in place:
+
+    void clear();
+    void reset(const Rect& r);
+    void translate(const rfb::Point& delta);
+    void setOrderedRects(const std::vector<Rect>& rects);
+    // Replaces the region with the union of rects, in any order and
+    // overlapping, in one sweep. Sorts rects in place.
+    void setRects(std::vector<Rect>& rects);
+
+	void name(const char *) {}
+
+    void assign_intersect(const BandedRegion& r);
+    void assign_union(const BandedRegion& r);
+    void assign_subtract(const BandedRegion& r);
+
+    // the following three operations return a new region:
+
+    BandedRegion intersect(const BandedRegion& r) const;
+    BandedRegion union_(const BandedRegion& r) const;
+    BandedRegion subtract(const BandedRegion& r) const;
+
+    bool equals(const BandedRegion& b) const;
+    bool is_empty() const;
+
+    bool get_rects(std::vector<Rect>& rects, bool left2right=true,
+                   bool topdown=true) const;
+    Rect get_bounding_rect() const;
+	int Numrects();
+
+  protected:
+	  enum { OP_UNION, OP_INTERSECT, OP_SUBTRACT };
+
+	  void combine(const BandedRegion& r, int op);
+	  bool append_rect(const Rect& r);
+	  void normalize() const;
+	  void update_extents();
+
+	  mutable std::vector<Rect> m_rects;
+	  mutable bool m_tail_dirty;
+	  std::vector<Rect> m_scratch;
+	  std::vector<int> m_edges;		// setRects() band edges
+	  Rect m_extents;
+  };
+
+};
+
+#endif /* __RFB_REGION_BANDED_INCLUDED__ */
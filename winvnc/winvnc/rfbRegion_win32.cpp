@@ -128,6 +128,12 @@ void Region::translate(const Point& delta) {
   OffsetRgn(rgn, delta.x, delta.y);
 }
 
+void Region::setRects(std::vector<Rect>& rects) {
+  clear();
+  for (size_t i = 0; i < rects.size(); i++)
+    assign_union(Region(rects[i]));
+}
+
 
 void Region::assign_intersect(const Region& r) {
   CombineRgn(rgn, rgn, r.rgn, RGN_AND);
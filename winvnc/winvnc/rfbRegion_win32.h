@@ -53,6 +53,7 @@ namespace rfb {
     void reset(const Rect& r);
     void translate(const rfb::Point& delta);
     void setOrderedRects(const std::vector<Rect>& rects);
+    void setRects(std::vector<Rect>& rects);
 
 	void name(const char *n)
 	{
@@ -84,7 +85,6 @@ namespace rfb {
 	  HRGN rgn;
 	  char *m_name;
   };
-  typedef Region Region2D;
 
 };
 
@@ -21,6 +21,10 @@
 // If the source code for the VNC system is not available from the place 
 // whence you received this file, check http://www.uk.research.att.com/vnc or contact
 // the authors on vnc@uk.research.att.com for information on obtaining it.
+#ifdef _VNC_PORTABLE
+// The encoders built outside Windows, see winvnc/portable
+#include "../portable/stdhdrs.h"
+#else
 //need to be added for VS 2005
 #define _Gii
 #ifdef _Gii
@@ -128,3 +132,4 @@ extern void WriteLog(char* sender, char *format, ...);
 #else
 #define GetTimeFunction GetTickCount
 #endif
+#endif // _VNC_PORTABLE
@@ -46,6 +46,11 @@ rfbInitColourMapSingleTableOUTVNC (char **table,
 	}
 
 	// Obtain the system palette
+#ifdef _VNC_PORTABLE
+	// No display to ask outside Windows
+	struct { BYTE peRed, peGreen, peBlue, peFlags; } palette[256];
+	UINT entries = 0;
+#else
 	bool create_dc = false;
 	HDC hDC = GetDcMirror();
 	if (hDC == NULL)
@@ -64,6 +69,7 @@ rfbInitColourMapSingleTableOUTVNC (char **table,
 	vnclog.Print(LL_INTINFO, VNCLOG("got %u palette entries\n"), GetLastError());
 	if (create_dc) DeleteDC(hDC);
 	else ReleaseDC(NULL, hDC);
+#endif
 
   // - Set the rest of the palette to something nasty but usable
   unsigned int i;
@@ -138,6 +138,7 @@ rfbTranslateNone(char *table, rfbPixelFormat *in, rfbPixelFormat *out,
 
 
 
+#ifndef _VNC_PORTABLE
 HDC GetDcMirror()
 {
 typedef BOOL (WINAPI* pEnumDisplayDevices)(PVOID,DWORD,PVOID,DWORD);
@@ -181,4 +182,5 @@ typedef BOOL (WINAPI* pEnumDisplayDevices)(PVOID,DWORD,PVOID,DWORD);
 		if (hUser32) FreeLibrary(hUser32);
 
 		return m_hrootdc;
-}
\ No newline at end of file
+}
+#endif
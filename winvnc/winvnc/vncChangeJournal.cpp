@@ -0,0 +1,182 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include "vncChangeJournal.h"
+
+vncChangeJournal::vncChangeJournal()
+{
+	InitializeCriticalSection(&m_lock);
+	m_first = 0;
+}
+
+vncChangeJournal::~vncChangeJournal()
+{
+	DeleteCriticalSection(&m_lock);
+}
+
+void
+vncChangeJournal::AddChanged(const rfb::Region2D &region)
+{
+	Append(CHANGED, region, rfb::Point());
+}
+
+void
+vncChangeJournal::AddCached(const rfb::Region2D &region)
+{
+	Append(CACHED, region, rfb::Point());
+}
+
+void
+vncChangeJournal::AddCopied(const rfb::Region2D &dest, const rfb::Point &delta)
+{
+	Append(COPIED, dest, delta);
+}
+
+void
+vncChangeJournal::Append(Kind kind, const rfb::Region2D &region, const rfb::Point &delta)
+{
+	if (region.is_empty())
+		return;
+	EnterCriticalSection(&m_lock);
+	m_entries.push_back(Entry());
+	Entry &e = m_entries.back();
+	e.kind = kind;
+	e.region = region;
+	e.delta = delta;
+	Trim();
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+vncChangeJournal::Clear()
+{
+	EnterCriticalSection(&m_lock);
+	m_first = End();
+	m_entries.clear();
+	m_overflow.clear();
+	for (size_t i = 0; i < m_readers.size(); i++)
+		m_readers[i]->next = m_first;
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+vncChangeJournal::Attach(Reader &reader)
+{
+	EnterCriticalSection(&m_lock);
+	if (!reader.attached) {
+		reader.next = End();
+		reader.attached = true;
+		m_readers.push_back(&reader);
+	}
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+vncChangeJournal::Detach(Reader &reader)
+{
+	EnterCriticalSection(&m_lock);
+	if (reader.attached) {
+		m_readers.erase(std::remove(m_readers.begin(), m_readers.end(), &reader), m_readers.end());
+		reader.attached = false;
+		Trim();
+	}
+	LeaveCriticalSection(&m_lock);
+}
+
+bool
+vncChangeJournal::Unread(const Reader &reader)
+{
+	EnterCriticalSection(&m_lock);
+	bool unread = reader.attached && reader.next != End();
+	LeaveCriticalSection(&m_lock);
+	return unread;
+}
+
+void
+vncChangeJournal::Read(Reader &reader, rfb::SimpleUpdateTracker &to)
+{
+	rfb::Region2D overflow;
+	std::vector<Entry> unread;
+
+	// Copy the entries out, the capture thread does not wait while they
+	// are merged into the tracker
+	EnterCriticalSection(&m_lock);
+	if (!reader.attached || reader.next == End()) {
+		LeaveCriticalSection(&m_lock);
+		return;
+	}
+	if (Before(reader.next, m_first)) {
+		overflow = m_overflow;
+		reader.next = m_first;
+	}
+	unread.assign(m_entries.begin() + (reader.next - m_first), m_entries.end());
+	reader.next = End();
+	Trim();
+	LeaveCriticalSection(&m_lock);
+
+	if (!overflow.is_empty())
+		to.rfb::SimpleUpdateTracker::add_changed(overflow);
+	for (size_t i = 0; i < unread.size(); i++) {
+		const Entry &e = unread[i];
+		switch (e.kind) {
+		case CHANGED:
+			to.rfb::SimpleUpdateTracker::add_changed(e.region);
+			break;
+		case CACHED:
+			to.rfb::SimpleUpdateTracker::add_cached(e.region);
+			break;
+		case COPIED:
+			to.rfb::SimpleUpdateTracker::add_copied(e.region, e.delta);
+			break;
+		}
+	}
+}
+
+void
+vncChangeJournal::Trim()
+{
+	// Drop what every reader has had
+	DWORD oldest = End();
+	for (size_t i = 0; i < m_readers.size(); i++)
+		if (Before(m_readers[i]->next, oldest))
+			oldest = m_readers[i]->next;
+	while (!m_entries.empty() && Before(m_first, oldest)) {
+		m_entries.pop_front();
+		m_first++;
+	}
+
+	// Someone lags, merge the oldest entries. A copy becomes a change
+	// of its destination, which is always safe to send again.
+	while (m_entries.size() > MAX_ENTRIES) {
+		m_overflow.assign_union(m_entries.front().region);
+		m_entries.pop_front();
+		m_first++;
+	}
+
+	if (!Before(oldest, m_first))
+		m_overflow.clear();
+}
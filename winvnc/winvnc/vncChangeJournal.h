@@ -0,0 +1,117 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "rfbRegion.h"
+#include "rfbUpdateTracker.h"
+
+////////////////////////////////////////
+// class vncChangeJournal;
+//
+// The changes the capture thread finds,
+// kept once for all clients as a list of
+// sequence numbered entries.
+//
+// Adding an entry costs the same with one
+// viewer or twenty, and never waits for a
+// client. Each client has a Reader, its
+// position in the list, and reads what
+// is new into its own update tracker when
+// it builds an update.
+//
+// Entries every reader has had are dropped.
+// A reader that falls far behind, because
+// its viewer is slow or does not ask for
+// updates, does not hold the list up: the
+// oldest entries are merged into one
+// changed region, which it reads instead.
+//
+// Thread-safe.
+//
+class vncChangeJournal
+{
+public:
+	// A client's position in the journal
+	struct Reader {
+		Reader() : next(0), attached(false) {};
+		DWORD next;			// sequence number of the first unread entry
+		bool attached;
+	};
+
+	vncChangeJournal();
+	~vncChangeJournal();
+
+	void AddChanged(const rfb::Region2D &region);
+	void AddCached(const rfb::Region2D &region);
+	void AddCopied(const rfb::Region2D &dest, const rfb::Point &delta);
+	// Forgets everything, after a display change the old coordinates
+	// are meaningless
+	void Clear();
+
+	// A reader starts at the end, it sees what is added after
+	void Attach(Reader &reader);
+	void Detach(Reader &reader);
+
+	bool Unread(const Reader &reader);
+	// Adds what <reader> has not read yet to <to>, oldest first. Uses
+	// the SimpleUpdateTracker methods, not their overrides, so a tracker
+	// may read the journal from its own add_ methods.
+	void Read(Reader &reader, rfb::SimpleUpdateTracker &to);
+
+private:
+	vncChangeJournal(const vncChangeJournal &);
+	vncChangeJournal &operator=(const vncChangeJournal &);
+
+	enum {
+		MAX_ENTRIES = 64
+	};
+
+	enum Kind {
+		CHANGED,
+		CACHED,
+		COPIED
+	};
+
+	struct Entry {
+		Kind kind;
+		rfb::Region2D region;
+		rfb::Point delta;
+	};
+
+	void Append(Kind kind, const rfb::Region2D &region, const rfb::Point &delta);
+	void Trim();
+	DWORD End() { return m_first + (DWORD)m_entries.size(); };
+	// Sequence numbers wrap
+	static bool Before(DWORD a, DWORD b) { return (LONG)(a - b) < 0; };
+
+	CRITICAL_SECTION m_lock;
+	std::deque<Entry> m_entries;
+	DWORD m_first;				// sequence number of the first entry
+	// Entries merged away before every reader had them
+	rfb::Region2D m_overflow;
+	std::vector<Reader *> m_readers;
+};
@@ -42,6 +42,7 @@
 // while the server CPU performs the compression algorithms.
 #include "stdhdrs.h"
 #include "vncEncodeTight.h"
+#include "PixelScan.h"
 
 // Compression level stuff. The following array contains various
 // encoder parameters for each of 10 compression levels (0..9).
@@ -67,10 +68,8 @@ vncEncodeTight::vncEncodeTight()
 
 vncEncodeTight::~vncEncodeTight()
 {
-	if (m_buffer != NULL) {
-		delete[] m_buffer;
-		m_buffer = NULL;
-	}
+	BufferPool::Free(m_buffer);
+	m_buffer = NULL;
 	delete[] m_hdrBuffer;
 }
 
@@ -153,14 +152,15 @@ vncEncodeTight::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest,
 	const int rawDataSize = maxRectSize * (m_remoteformat.bitsPerPixel / 8);
 
 	if (m_bufflen < rawDataSize) {
-		if (m_buffer != NULL)
-			delete [] m_buffer;
-
-		m_buffer = new BYTE [rawDataSize+1];
-		if (m_buffer == NULL)
+		size_t capacity;
+		BufferPool::Free(m_buffer);
+		m_buffer = BufferPool::Alloc(rawDataSize+1, &capacity);
+		if (m_buffer == NULL) {
+			m_bufflen = 0;
 			return vncEncoder::EncodeRect(source, dest, rect);
+		}
 
-		m_bufflen = rawDataSize;
+		m_bufflen = (int)capacity-1;
 	}
 
 	if ( m_remoteformat.depth == 24 && m_remoteformat.redMax == 0xFF &&
@@ -346,22 +346,63 @@ void vncEncodeTight::ExtendSolidArea(BYTE *source, int x, int y, int w, int h,
 		  cy++ );
 	*h_ptr += cy - (*y_ptr + *h_ptr);
 
-	// ... to the left.
-	for ( cx = *x_ptr - 1;
-		  cx >= x && CheckSolidTile(source, cx, *y_ptr, 1, *h_ptr,
-									&colorValue, TRUE);
-		  cx-- );
-	*w_ptr += *x_ptr - (cx + 1);
-	*x_ptr = cx + 1;
+	// ... to the left. Scanned by rows, the extension is the shortest
+	// run of the color among the rows.
+	cx = SolidColumns(source, x, *y_ptr, *x_ptr - x, *h_ptr, colorValue, true);
+	*w_ptr += cx;
+	*x_ptr -= cx;
 
 	// ... to the right.
-	for ( cx = *x_ptr + *w_ptr;
-		  cx < x + w && CheckSolidTile(source, cx, *y_ptr, 1, *h_ptr,
-									   &colorValue, TRUE);
-		  cx++ );
-	*w_ptr += cx - (*x_ptr + *w_ptr);
+	cx = SolidColumns(source, *x_ptr + *w_ptr, *y_ptr, x + w - (*x_ptr + *w_ptr),
+					  *h_ptr, colorValue, false);
+	*w_ptr += cx;
 }
 
+// Number of columns of colorValue, common to rows y..y+h-1, at the start
+// (or the end, fromEnd) of the span x..x+n-1
+int vncEncodeTight::SolidColumns(BYTE *source, int x, int y, int n, int h,
+								 CARD32 colorValue, bool fromEnd)
+{
+	switch(m_localformat.bitsPerPixel) {
+	case 32:
+		return SolidColumns32(source, x, y, n, h, colorValue, fromEnd);
+	case 16:
+		return SolidColumns16(source, x, y, n, h, colorValue, fromEnd);
+	default:
+		return SolidColumns8(source, x, y, n, h, colorValue, fromEnd);
+	}
+}
+
+#define DEFINE_SOLID_COLUMNS_FUNCTION(bpp)									  \
+																			  \
+int 																		  \
+vncEncodeTight::SolidColumns##bpp(BYTE *source, int x, int y, int n, int h,   \
+								  CARD32 colorValue, bool fromEnd)			  \
+{																			  \
+	CARD##bpp *fbptr;														  \
+	int dy; 																  \
+																			  \
+	if ((CARD32)(CARD##bpp)colorValue != colorValue)						  \
+		return 0;															  \
+	fbptr = (CARD##bpp *)													  \
+		&source[y * m_bytesPerRow + x * (bpp/8)];							  \
+	if (fromEnd)															  \
+		fbptr += n; /* the runs end at x+n */								  \
+																			  \
+	for (dy = 0; dy < h && n > 0; dy++) {									  \
+		if (fromEnd)														  \
+			n = PixelScan::RunBack(fbptr - n, n, (CARD##bpp)colorValue);	  \
+		else																  \
+			n = PixelScan::Run(fbptr, n, (CARD##bpp)colorValue);			  \
+		fbptr = (CARD##bpp *)((BYTE *)fbptr + m_bytesPerRow);				  \
+	}																		  \
+	return n;																  \
+}
+
+DEFINE_SOLID_COLUMNS_FUNCTION(8)
+DEFINE_SOLID_COLUMNS_FUNCTION(16)
+DEFINE_SOLID_COLUMNS_FUNCTION(32)
+
 bool
 vncEncodeTight::CheckSolidTile(BYTE *source, int x, int y, int w, int h,
 							   CARD32 *colorPtr, bool needSameColor)
@@ -384,7 +425,7 @@ vncEncodeTight::CheckSolidTile##bpp(BYTE *source, int x, int y, int w, int h, \
 {																			  \
 	CARD##bpp *fbptr;														  \
 	CARD##bpp colorValue;													  \
-	int dx, dy; 															  \
+	int dy; 																  \
 																			  \
 	fbptr = (CARD##bpp *)													  \
 		&source[y * m_bytesPerRow + x * (bpp/8)];							  \
@@ -394,10 +435,8 @@ vncEncodeTight::CheckSolidTile##bpp(BYTE *source, int x, int y, int w, int h, \
 		return false;														  \
 																			  \
 	for (dy = 0; dy < h; dy++) {											  \
-		for (dx = 0; dx < w; dx++) {										  \
-			if (colorValue != fbptr[dx])									  \
-				return false;												  \
-		}																	  \
+		if (!PixelScan::Equal(fbptr, w, colorValue))						  \
+			return false;													  \
 		fbptr = (CARD##bpp *)((BYTE *)fbptr + m_bytesPerRow);				  \
 	}																		  \
 																			  \
@@ -760,7 +799,7 @@ vncEncodeTight::FillPalette8(int count)
 	m_paletteNumColors = 0;
 
 	c0 = data[0];
-	for (i = 1; i < count && data[i] == c0; i++);
+	i = 1 + PixelScan::Run(data + 1, count - 1, c0);
 	if (i == count) {
 		m_paletteNumColors = 1;
 		return; 				// Solid rectangle
@@ -772,14 +811,12 @@ vncEncodeTight::FillPalette8(int count)
 	n0 = i;
 	c1 = data[i];
 	n1 = 0;
-	for (i++; i < count; i++) {
-		if (data[i] == c0) {
-			n0++;
-		} else if (data[i] == c1) {
-			n1++;
-		} else
-			break;
-	}
+	i++;
+	int m0 = 0;
+	int m = PixelScan::Run2(data + i, count - i, c0, c1, m0);
+	n0 += m0;
+	n1 = m - m0;
+	i += m;
 	if (i == count) {
 		if (n0 > n1) {
 			m_monoBackground = (CARD32)c0;
@@ -801,6 +838,15 @@ void vncEncodeTight::set_use_zstd(bool enabled)
 }
 
 
+// The palettes are counted a vector at a time while they have few			  \
+// colours, then a run at a time while the runs average PALETTE_SHORT_RUN
+// pixels or more, judged once PALETTE_RUN_SAMPLE runs are in. Shorter
+// ones (photos, dithering) go faster pixel by pixel.
+// Inserting the counted colours in the order they were last seen leaves
+// the palette as inserting their runs one by one would.
+static const int PALETTE_SHORT_RUN = 4;
+static const int PALETTE_RUN_SAMPLE = 16;
+
 #define DEFINE_FILL_PALETTE_FUNCTION(bpp)									  \
 																			  \
 void																		  \
@@ -808,10 +854,10 @@ vncEncodeTight::FillPalette##bpp(int count) 								  \
 {																			  \
 	CARD##bpp *data = (CARD##bpp *)m_buffer;								  \
 	CARD##bpp c0, c1, ci;													  \
-	int i, n0, n1, ni;														  \
+	int i, k, n0, n1, ni, m, m0 = 0, runs;									  \
 																			  \
 	c0 = data[0];															  \
-	for (i = 1; i < count && data[i] == c0; i++);							  \
+	i = 1 + PixelScan::Run(data + 1, count - 1, c0);						  \
 	if (i >= count) {														  \
 		m_paletteNumColors = 1; /* Solid rectangle */						  \
 		return; 															  \
@@ -824,16 +870,11 @@ vncEncodeTight::FillPalette##bpp(int count) 								  \
 																			  \
 	n0 = i; 																  \
 	c1 = data[i];															  \
-	n1 = 0; 																  \
-	for (i++; i < count; i++) { 											  \
-		ci = data[i];														  \
-		if (ci == c0) { 													  \
-			n0++;															  \
-		} else if (ci == c1) {												  \
-			n1++;															  \
-		} else																  \
-			break;															  \
-	}																		  \
+	i++;																	  \
+	m = PixelScan::Run2(data + i, count - i, c0, c1, m0);					  \
+	n0 += m0;																  \
+	n1 = m - m0;															  \
+	i += m; 																  \
 	if (i >= count) {														  \
 		if (n0 > n1) {														  \
 			m_monoBackground = (CARD32)c0;									  \
@@ -846,19 +887,48 @@ vncEncodeTight::FillPalette##bpp(int count) 								  \
 		return; 															  \
 	}																		  \
 																			  \
+	/* A compare per colour for each vector of pixels while they are few */	  \
+	PixelScan::ColourCounter<CARD##bpp>										  \
+		counter(m_paletteMaxColors);										  \
+	counter.Seed(c0, n0, 0);												  \
+	counter.Seed(c1, n1, 1);												  \
+	i += counter.Add(data + i, count - i, i + 2);							  \
+	counter.SortByLast();													  \
 	PaletteReset(); 														  \
-	PaletteInsert (c0, (CARD32)n0, bpp);									  \
-	PaletteInsert (c1, (CARD32)n1, bpp);									  \
+	for (k = 0; k < counter.count; k++) {									  \
+		ci = counter.colour[k];												  \
+		if (!PaletteInsert (ci, (CARD32)counter.pixels[k], bpp))			  \
+			return;															  \
+	}																		  \
+	if (i >= count)															  \
+		return;																  \
+																			  \
+	/* Whole runs per palette lookup while they are long enough */			  \
+	PixelScan::RunWalker<CARD##bpp> walker(data + i, count - i);			  \
+	for (runs = 0; walker.Pos() < count - i; runs++) {						  \
+		if (runs >= PALETTE_RUN_SAMPLE &&									  \
+			walker.Pos() < PALETTE_SHORT_RUN * runs)						  \
+			break;															  \
+		ci = data[i + walker.Pos()];										  \
+		ni = walker.Next();													  \
+		if (!PaletteInsert (ci, (CARD32)ni, bpp))							  \
+			return;															  \
+	}																		  \
+	i += walker.Pos();														  \
+	if (i >= count)															  \
+		return;																  \
 																			  \
+	/* Pixel by pixel once they are short */								  \
+	ci = data[i];															  \
 	ni = 1; 																  \
 	for (i++; i < count; i++) { 											  \
 		if (data[i] == ci) {												  \
 			ni++;															  \
 		} else {															  \
 			if (!PaletteInsert (ci, (CARD32)ni, bpp))						  \
-				return; 													  \
+				return;														  \
 			ci = data[i];													  \
-			ni = 1; 														  \
+			ni = 1;															  \
 		}																	  \
 	}																		  \
 	PaletteInsert (ci, (CARD32)ni, bpp);									  \
@@ -874,8 +944,9 @@ void																		  \
 vncEncodeTight::FastFillPalette##bpp										  \
   (CARD##bpp *data, int w, int pitch, int h)								  \
 {																			  \
-	CARD##bpp c0, c1, ci, mask, c0t, c1t, cit;								  \
-	int i, j, i2 = 0, j2, n0, n1, ni;										  \
+	CARD##bpp c0, c1, ci, ct, mask, c0t, c1t, cit;							  \
+	CARD##bpp *row;															  \
+	int i, j, k, n0, n1, ni, m, m0, runs, pixels;							  \
 																			  \
 	if (m_transfunc != rfbTranslateNone) {									  \
 		mask = m_localformat.redMax << m_localformat.redShift;				  \
@@ -883,14 +954,15 @@ vncEncodeTight::FastFillPalette##bpp										  \
 		mask |= m_localformat.blueMax << m_localformat.blueShift;			  \
 	} else mask = ~0;														  \
 																			  \
+	/* The runs are scanned row by row, i and j track the pixel after */	  \
+	/* the last run. */														  \
 	c0 = data[0] & mask;													  \
+	i = 0;																	  \
 	for (j = 0; j < h; j++) {												  \
-		for (i = 0; i < w; i++) {											  \
-			if ((data[j * pitch + i] & mask) != c0)							  \
-				goto done;													  \
-		}																	  \
+		i = PixelScan::Run(data + j * pitch, w, c0, mask);					  \
+		if (i < w)															  \
+			break;															  \
 	}																		  \
-	done:																	  \
 	if (j >= h) {															  \
 		m_paletteNumColors = 1;	  /* Solid rectangle */						  \
 		return;																  \
@@ -904,23 +976,21 @@ vncEncodeTight::FastFillPalette##bpp										  \
 	c1 = data[j * pitch + i] & mask;										  \
 	n1 = 0;																	  \
 	i++;  if (i >= w) { i = 0;  j++; }										  \
-	for (j2 = j; j2 < h; j2++) {											  \
-		for (i2 = i; i2 < w; i2++) {										  \
-			ci = data[j2 * pitch + i2] & mask;								  \
-			if (ci == c0) {													  \
-				n0++;														  \
-			} else if (ci == c1) {											  \
-				n1++;														  \
-			} else															  \
-				goto done2;													  \
-		}																	  \
+	for (; j < h; j++) {													  \
+		row = data + j * pitch;												  \
+		m0 = 0;																  \
+		m = PixelScan::Run2(row + i, w - i, c0, c1, m0, mask);				  \
+		n0 += m0;															  \
+		n1 += m - m0;														  \
+		i += m;																  \
+		if (i < w)															  \
+			break;															  \
 		i = 0;																  \
 	}																		  \
-	done2:																	  \
 	RECT rect1 = { 0, 0, 1, 1 };											  \
 	Translate((BYTE *)&c0, (BYTE *)&c0t, rect1);							  \
 	Translate((BYTE *)&c1, (BYTE *)&c1t, rect1);							  \
-	if (j2 >= h) {															  \
+	if (j >= h) {															  \
 		if (n0 > n1) {														  \
 			m_monoBackground = (CARD32)c0t;									  \
 			m_monoForeground = (CARD32)c1t;									  \
@@ -932,14 +1002,64 @@ vncEncodeTight::FastFillPalette##bpp										  \
 		return;																  \
 	}																		  \
 																			  \
+	/* A compare per colour for each vector of pixels while they are few */	  \
+	PixelScan::ColourCounter<CARD##bpp>										  \
+		counter(m_paletteMaxColors, mask);									  \
+	counter.Seed(c0, n0, 0);												  \
+	counter.Seed(c1, n1, 1);												  \
+	for (; j < h; j++) {													  \
+		m = counter.Add(data + j * pitch + i, w - i, j * w + i + 2);		  \
+		i += m;																  \
+		if (i < w)															  \
+			break;															  \
+		i = 0;																  \
+	}																		  \
+	counter.SortByLast();													  \
 	PaletteReset();															  \
-	PaletteInsert(c0t, (CARD32)n0, bpp);									  \
-	PaletteInsert(c1t, (CARD32)n1, bpp);									  \
+	for (k = 0; k < counter.count; k++) {									  \
+		Translate((BYTE *)&counter.colour[k], (BYTE *)&cit, rect1);			  \
+		if (!PaletteInsert(cit, (CARD32)counter.pixels[k], bpp))			  \
+			return;															  \
+	}																		  \
+	if (j >= h)																  \
+		return;																  \
+																			  \
+	/* Whole runs per palette lookup while they are long enough, a */		  \
+	/* run can go on in the next row */										  \
+	ci = data[j * pitch + i] & mask;										  \
+	ni = 0;																	  \
+	runs = 0;																  \
+	pixels = 0;																  \
+	for (; j < h; j++) {													  \
+		row = data + j * pitch;												  \
+		PixelScan::RunWalker<CARD##bpp> walker(row + i, w - i, mask);		  \
+		while (walker.Pos() < w - i) {										  \
+			if (runs >= PALETTE_RUN_SAMPLE &&								  \
+				pixels < PALETTE_SHORT_RUN * runs)							  \
+				break;														  \
+			ct = row[i + walker.Pos()] & mask;								  \
+			m = walker.Next();												  \
+			pixels += m;													  \
+			if (ct == ci) {													  \
+				ni += m;													  \
+				continue;													  \
+			}																  \
+			Translate((BYTE *)&ci, (BYTE *)&cit, rect1);					  \
+			if (!PaletteInsert (cit, (CARD32)ni, bpp))						  \
+				return;														  \
+			runs++;															  \
+			ci = ct;														  \
+			ni = m;															  \
+		}																	  \
+		i += walker.Pos();													  \
+		if (i < w)															  \
+			break;															  \
+		i = 0;																  \
+	}																		  \
 																			  \
-	ni = 1;																	  \
-	i2++;  if (i2 >= w) { i2 = 0;  j2++; }									  \
-	for (j = j2; j < h; j++) {												  \
-		for (i = i2; i < w; i++) {											  \
+	/* Pixel by pixel once they are short */								  \
+	for (; j < h; j++) {													  \
+		for (; i < w; i++) {												  \
 			if ((data[j * pitch + i] & mask) == ci) {						  \
 				ni++;														  \
 			} else {														  \
@@ -950,7 +1070,7 @@ vncEncodeTight::FastFillPalette##bpp										  \
 				ni = 1;														  \
 			}																  \
 		}																	  \
-		i2 = 0;																  \
+		i = 0;																  \
 	}																		  \
 																			  \
 	Translate((BYTE *)&ci, (BYTE *)&cit, rect1);							  \
@@ -1174,11 +1294,6 @@ DEFINE_MONO_ENCODE_FUNCTION(32)
 // JPEG compression stuff.
 //
 
-static bool jpegError;
-static int jpegDstDataLen;
-
-static void JpegSetDstManager(j_compress_ptr cinfo, JOCTET *buf, size_t buflen);
-
 int
 vncEncodeTight::SendJpegRect(BYTE *source, BYTE *dst, int x, int y, int w,
 							 int h)
@@ -1186,208 +1301,35 @@ vncEncodeTight::SendJpegRect(BYTE *source, BYTE *dst, int x, int y, int w,
 	const int h_samp_factor[NUM_SUBSAMPOPT] = { 1, 2, 2, 1, 4, 4 };
 	const int v_samp_factor[NUM_SUBSAMPOPT] = { 1, 2, 1, 1, 2, 4 };
 
-	struct jpeg_compress_struct cinfo;
-	struct jpeg_error_mgr jerr;
-
 	if (m_localformat.bitsPerPixel == 8)
 		return SendFullColorRect(dst, w, h);
 
-	cinfo.err = jpeg_std_error(&jerr);
-	int size=sizeof(cinfo);
-	jpeg_create_compress(&cinfo);
-
-	cinfo.image_width = w;
-	cinfo.image_height = h;
-	cinfo.input_components = 3;
-	cinfo.in_color_space = JCS_RGB;
-#ifdef JCS_EXTENSIONS
-	if (m_localformat.bitsPerPixel > 16) {
-		cinfo.input_components = m_localformat.bitsPerPixel / 8;
-		if (m_localformat.bitsPerPixel == 24) {
-			if (m_localformat.redShift > m_localformat.blueShift)
-				cinfo.in_color_space = JCS_EXT_BGR;
-			else
-				cinfo.in_color_space = JCS_EXT_RGB;
-		} else if (m_localformat.bitsPerPixel == 32) {
-			if (m_localformat.redShift > m_localformat.blueShift)
-				cinfo.in_color_space = JCS_EXT_BGRA;
-			else
-				cinfo.in_color_space = JCS_EXT_RGBA;
-		}
-	}
-#endif
-
-	jpeg_set_defaults(&cinfo);
-	jpeg_set_quality(&cinfo, m_finequalitylevel, TRUE);
-	cinfo.comp_info[0].h_samp_factor = h_samp_factor[m_subsampling];
-	cinfo.comp_info[0].v_samp_factor = v_samp_factor[m_subsampling];
-	if (m_subsampling == SUBSAMP_GRAY) {
-		jpeg_set_colorspace(&cinfo, JCS_GRAYSCALE);
-	} else {
-		jpeg_set_colorspace(&cinfo, JCS_YCbCr);
-		cinfo.comp_info[1].h_samp_factor = cinfo.comp_info[1].v_samp_factor = 1;
-		cinfo.comp_info[2].h_samp_factor = cinfo.comp_info[2].v_samp_factor = 1;
-	}
-
-	JpegSetDstManager (&cinfo, (JOCTET*)dst, w * h * (m_localformat.bitsPerPixel / 8));
-
-	jpeg_start_compress(&cinfo, TRUE);
-
-	BYTE *srcBuf = NULL;
-	if (cinfo.in_color_space == JCS_RGB) {
-		srcBuf = new BYTE[w * 3];
-		JSAMPROW rowPointer[1];
-		rowPointer[0] = (JSAMPROW)srcBuf;
-
-		for (int dy = 0; dy < h; dy++) {
-			PrepareRowForJpeg(srcBuf, dy, w);
-			jpeg_write_scanlines(&cinfo, rowPointer, 1);
-			if (jpegError)
-				break;
-		}
-	} else {
-		JSAMPROW *rowPointer;
-		rowPointer = new JSAMPROW[h];
-		for (int dy = 0; dy < h; dy++)
-			rowPointer[dy] = &source[(y + dy) * m_bytesPerRow +
-									 x * (m_localformat.bitsPerPixel / 8)];
-		while (cinfo.next_scanline < cinfo.image_height) {
-			jpeg_write_scanlines(&cinfo, &rowPointer[cinfo.next_scanline],
-								 cinfo.image_height - cinfo.next_scanline);
-			if (jpegError)
-				break;
-		}
-		delete [] rowPointer;
-	}
-
-	if (!jpegError)
-		jpeg_finish_compress(&cinfo);
-
-	jpeg_destroy_compress(&cinfo);
-	if (srcBuf) delete[] srcBuf;
-
-	if (jpegError)
+	// The pixels are read in place, m_buffer is not needed
+	JpegSource src;
+	src.data = source + m_bytesPerRow * y + x * (m_localformat.bitsPerPixel / 8);
+	src.stride = m_bytesPerRow;
+	src.width = w;
+	src.height = h;
+	src.format = m_localformat;
+
+	JpegSettings settings;
+	settings.quality = m_finequalitylevel;
+	settings.hSamp = h_samp_factor[m_subsampling];
+	settings.vSamp = v_samp_factor[m_subsampling];
+	settings.gray = m_subsampling == SUBSAMP_GRAY;
+
+	int size = JpegCompressorPool::Compress(src, settings, dst,
+											w * h * (m_localformat.bitsPerPixel / 8));
+	if (size == 0) {
+		// The JPEG paths may have skipped the translation
+		RECT r;
+		r.left = x; r.top = y;
+		r.right = x + w; r.bottom = y + h;
+		Translate(source, m_buffer, r);
 		return SendFullColorRect(dst, w, h);
-
-	m_hdrBuffer[m_hdrBufferBytes++] = rfbTightJpeg << 4;
-
-	return SendCompressedData(jpegDstDataLen);
-}
-
-void
-vncEncodeTight::PrepareRowForJpeg(BYTE *dst, int y, int w)
-{
-	if (m_remoteformat.bitsPerPixel == 32) {
-		CARD32 *src = (CARD32 *)&m_buffer[y * w * sizeof(CARD32)];
-		if (m_usePixelFormat24) {
-			PrepareRowForJpeg24(dst, src, w);
-		} else {
-			PrepareRowForJpeg32(dst, src, w);
-		}
-	} else {
-		// 16 bpp assumed.
-		CARD16 *src = (CARD16 *)&m_buffer[y * w * sizeof(CARD16)];
-		PrepareRowForJpeg16(dst, src, w);
 	}
-}
 
-void
-vncEncodeTight::PrepareRowForJpeg24(BYTE *dst, CARD32 *src, int count)
-{
-	int r_shift, g_shift, b_shift;
-	if (!m_localformat.bigEndian == !m_remoteformat.bigEndian) {
-		r_shift = m_remoteformat.redShift;
-		g_shift = m_remoteformat.greenShift;
-		b_shift = m_remoteformat.blueShift;
-	} else {
-		r_shift = 24 - m_remoteformat.redShift;
-		g_shift = 24 - m_remoteformat.greenShift;
-		b_shift = 24 - m_remoteformat.blueShift;
-	}
-
-	CARD32 pix;
-	while (count--) {
-		pix = *src++;
-		*dst++ = (BYTE)(pix >> r_shift);
-		*dst++ = (BYTE)(pix >> g_shift);
-		*dst++ = (BYTE)(pix >> b_shift);
-	}
-}
-
-#define DEFINE_JPEG_GET_ROW_FUNCTION(bpp)									\
-																			\
-void																		\
-vncEncodeTight::PrepareRowForJpeg##bpp(BYTE *dst, CARD##bpp *src, int count)\
-{																			\
-	bool endianMismatch =													\
-		(!m_localformat.bigEndian != !m_remoteformat.bigEndian);			\
-																			\
-	int r_shift = m_remoteformat.redShift;									\
-	int g_shift = m_remoteformat.greenShift;								\
-	int b_shift = m_remoteformat.blueShift; 								\
-	int r_max = m_remoteformat.redMax;										\
-	int g_max = m_remoteformat.greenMax;									\
-	int b_max = m_remoteformat.blueMax; 									\
-																			\
-	CARD##bpp pix;															\
-	while (count--) {														\
-		pix = *src++;														\
-		if (endianMismatch) {												\
-			pix = Swap##bpp(pix);											\
-		}																	\
-		*dst++ = (BYTE)((pix >> r_shift & r_max) * 255 / r_max);			\
-		*dst++ = (BYTE)((pix >> g_shift & g_max) * 255 / g_max);			\
-		*dst++ = (BYTE)((pix >> b_shift & b_max) * 255 / b_max);			\
-	}																		\
-}
-
-DEFINE_JPEG_GET_ROW_FUNCTION(16)
-DEFINE_JPEG_GET_ROW_FUNCTION(32)
-
-/*
- * Destination manager implementation for JPEG library.
- */
-
-static struct jpeg_destination_mgr jpegDstManager;
-static JOCTET *jpegDstBuffer;
-static size_t jpegDstBufferLen;
-
-static void JpegInitDestination(j_compress_ptr cinfo);
-static boolean JpegEmptyOutputBuffer(j_compress_ptr cinfo);
-static void JpegTermDestination(j_compress_ptr cinfo);
-
-static void
-JpegInitDestination(j_compress_ptr cinfo)
-{
-	jpegError = false;
-	jpegDstManager.next_output_byte = jpegDstBuffer;
-	jpegDstManager.free_in_buffer = jpegDstBufferLen;
-}
-
-static boolean
-JpegEmptyOutputBuffer(j_compress_ptr cinfo)
-{
-	jpegError = true;
-	jpegDstManager.next_output_byte = jpegDstBuffer;
-	jpegDstManager.free_in_buffer = jpegDstBufferLen;
-
-	return TRUE;
-}
-
-static void
-JpegTermDestination(j_compress_ptr cinfo)
-{
-	jpegDstDataLen = jpegDstBufferLen - jpegDstManager.free_in_buffer;
-}
+	m_hdrBuffer[m_hdrBufferBytes++] = rfbTightJpeg << 4;
 
-static void
-JpegSetDstManager(j_compress_ptr cinfo, JOCTET *buf, size_t buflen)
-{
-	jpegDstBuffer = buf;
-	jpegDstBufferLen = buflen;
-	jpegDstManager.init_destination = JpegInitDestination;
-	jpegDstManager.empty_output_buffer = JpegEmptyOutputBuffer;
-	jpegDstManager.term_destination = JpegTermDestination;
-	cinfo->dest = &jpegDstManager;
+	return SendCompressedData(size);
 }
-
@@ -37,15 +37,7 @@ class vncEncodeTight;
 
 #include "vncencoder.h"
 #include "../../common/UltraVncZ.h"
-
-extern "C"
-{
-#ifdef _INTERNALLIB
-#include <jpeglib.h>
-#else
-#include "libjpeg-turbo-win/jpeglib.h"
-#endif
-}
+#include "JpegCompressor.h"
 #include <math.h>
 
 // Minimum amount of data to be compressed. This value should not be
@@ -132,6 +124,14 @@ protected:
 						   CARD32 *colorPtr, bool needSameColor);
 	bool CheckSolidTile32 (BYTE *source, int x, int y, int w, int h,
 						   CARD32 *colorPtr, bool needSameColor);
+	int SolidColumns      (BYTE *source, int x, int y, int n, int h,
+						   CARD32 colorValue, bool fromEnd);
+	int SolidColumns8     (BYTE *source, int x, int y, int n, int h,
+						   CARD32 colorValue, bool fromEnd);
+	int SolidColumns16    (BYTE *source, int x, int y, int n, int h,
+						   CARD32 colorValue, bool fromEnd);
+	int SolidColumns32    (BYTE *source, int x, int y, int n, int h,
+						   CARD32 colorValue, bool fromEnd);
 	UINT EncodeRectSimple (BYTE *source, VSocket *outConn, BYTE *dest,
 						   const RECT &rect);
 	UINT EncodeSubrect    (BYTE *source, VSocket *outConn, BYTE *dest,
@@ -158,10 +158,6 @@ protected:
 	void EncodeMonoRect16(BYTE *buf, int w, int h);
 	void EncodeMonoRect32(BYTE *buf, int w, int h);
 	int SendJpegRect(BYTE *source, BYTE *dst, int x, int y, int w, int h);
-	void PrepareRowForJpeg(BYTE *dst, int y, int w);
-	void PrepareRowForJpeg24(BYTE *dst, CARD32 *src, int count);
-	void PrepareRowForJpeg16(BYTE *dst, CARD16 *src, int count);
-	void PrepareRowForJpeg32(BYTE *dst, CARD32 *src, int count);
 };
 
 #endif // _WINVNC_ENCODETIGHT
@@ -55,11 +55,8 @@ vncEncodeUltra::vncEncodeUltra()
 
 vncEncodeUltra::~vncEncodeUltra()
 {
-	if (m_buffer != NULL)
-	{
-		delete [] m_buffer;
-		m_buffer = NULL;
-	}
+	BufferPool::Free(m_buffer);
+	m_buffer = NULL;
 
 	if (m_Queuebuffer != NULL)
 	{
@@ -212,15 +209,15 @@ vncEncodeUltra::EncodeOneRect(BYTE *source, BYTE *dest, const RECT &rect,VSocket
 	// create a space big enough for the Zlib encoded pixels
 	if (m_bufflen < rawDataSize)
 	{
-		if (m_buffer != NULL)
-		{
-			delete [] m_buffer;
-			m_buffer = NULL;
-		}
-		m_buffer = new BYTE [rawDataSize+1000];
+		size_t capacity;
+		BufferPool::Free(m_buffer);
+		m_buffer = BufferPool::Alloc(rawDataSize+1000, &capacity);
 		if (m_buffer == NULL)
+		{
+			m_bufflen = 0;
 			return vncEncoder::EncodeRect(source, dest, rect);
-		m_bufflen = rawDataSize+999;
+		}
+		m_bufflen = (int)capacity-1;
 	}
 	// Translate the data into our new buffer
 	Translate(source, m_buffer, rect);
@@ -23,23 +23,11 @@
 ////////////////////////////////////////////////////////////////////////////
 #include "stdhdrs.h"
 #include "vncEncodeUltra2.h"
+#include "EncoderThreadPool.h"
 #include <mmsystem.h>
 
-struct jpeg_destination_mgr jpegDstManager;
-static JOCTET *jpegDstBuffer;
-static size_t jpegDstBufferLen;
-static void JpegInitDestination(j_compress_ptr cinfo);
-static boolean JpegEmptyOutputBuffer(j_compress_ptr cinfo);
-static void JpegTermDestination(j_compress_ptr cinfo);
-static void JpegSetDstManager(j_compress_ptr cinfo, JOCTET *buf, size_t buflen);
-static bool jpegError;
-static int jpegDstDataLen;
-
 #define IN_LEN		(128*1024)
 #define OUT_LEN		(IN_LEN + IN_LEN / 64 + 16 + 3)
-#define HEAP_ALLOC(var,size) \
-	lzo_align_t __LZO_MMODEL var [ ((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
-static HEAP_ALLOC(wrkmem,LZO1X_1_MEM_COMPRESS);
 
 
 vncEncodeUltra2::vncEncodeUltra2()
@@ -47,11 +35,8 @@ vncEncodeUltra2::vncEncodeUltra2()
 	m_buffer = NULL;
 	m_bufflen = 0;
 	destbuffer=NULL;
-	m_quality = 0;
-	m_rowPointer = NULL;
-	m_rowPointerSize = 0;
-	cinfo.err = jpeg_std_error(&jerr);
-	jpeg_create_compress(&cinfo);
+	lzo=false;
+	m_jpeg = JpegCompressorPool::Acquire();
 }
 
 vncEncodeUltra2::~vncEncodeUltra2()
@@ -60,9 +45,7 @@ vncEncodeUltra2::~vncEncodeUltra2()
 		delete [] m_buffer;
 	if (destbuffer!=0) 
 		free (destbuffer);
-	if (m_rowPointer != NULL)
-		delete[] m_rowPointer;
-	jpeg_destroy_compress(&cinfo);
+	JpegCompressorPool::Release(m_jpeg);
 }
 
 void
@@ -85,6 +68,8 @@ vncEncodeUltra2::RequiredBuffSize(UINT width, UINT height)
 	// to cover the Ultra header space.
 	result = vncEncoder::RequiredBuffSize(width, height);
 	result += result/ 64 + 16 + 3 + sz_rfbZlibHeader+sz_rfbFramebufferUpdateRectHeader+ sz_rfbZlibHeader;
+	// The headers of the LZO bands
+	result += MAX_BANDS * (sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader);
 	return result;
 }
 
@@ -127,7 +112,36 @@ vncEncodeUltra2::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rf
 	surh->r.h = Swap16IfLE(surh->r.h);
 	surh->encoding = Swap32IfLE(rfbEncodingUltra2);
 
-	// create a space big enough for the Jpeg encoded pixels
+	rfbZlibHeader *zlibh=(rfbZlibHeader *)(dest+sz_rfbFramebufferUpdateRectHeader);
+	size=0;
+	// The JPEG is compressed straight from the framebuffer, into the
+	// space RequiredBuffSize() leaves for the data
+	if (rectW >= 8 && rectH >= 8) {
+		size=SendJpegRect(source,dest+sz_rfbFramebufferUpdateRectHeader+sz_rfbZlibHeader, rawDataSize + rawDataSize/64 + 16 + 3, rect, m_qualitylevel*10);
+		zlibh->nBytes = Swap32IfLE(size);
+	}
+	if (size != 0) {
+		transmittedSize += sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader + size;
+		return sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader + size;
+	}
+
+	// jpeg failed
+	if (rawDataSize < 64)
+		return vncEncoder::EncodeRect(source, dest, rect);
+
+	if (lzo==false && lzo_init() == LZO_E_OK)
+		lzo=true;
+
+	if (rectW * rectH >= 2 * MIN_BAND_PIXELS) {
+		int workers = EncoderThreadPool::Workers();
+		if (workers > 0) {
+			size = EncodeLzoBands(source, dest, rect, workers);
+			if (size != 0)
+				return size;
+		}
+	}
+
+	// create a space big enough for the translated pixels
 	if (m_bufflen < rawDataSize + 1000) {
 		if (m_buffer != NULL) {
 			delete [] m_buffer;
@@ -140,160 +154,113 @@ vncEncodeUltra2::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rf
 	}
 	// Translate the data into our new buffer
 	Translate(source, m_buffer, rect);
-	rfbZlibHeader *zlibh=(rfbZlibHeader *)(dest+sz_rfbFramebufferUpdateRectHeader);
-	size=0;
-	if (rectW >= 8 && rectH >= 8) {
-		size=SendJpegRect(m_buffer,dest+sz_rfbFramebufferUpdateRectHeader+sz_rfbZlibHeader, rawDataSize + 1000, rectW , rectH , m_qualitylevel*10,m_remoteformat);		
-		zlibh->nBytes = Swap32IfLE(size);
-	}
-	// jpeg failed
-	if (size == 0) {		
-		if (rawDataSize < 64)
-			return vncEncoder::EncodeRect(source, dest, rect);
-				
-		if (lzo==false && lzo_init() == LZO_E_OK)
-			lzo=true;
-		lzo1x_1_compress(m_buffer,rawDataSize,dest+sz_rfbFramebufferUpdateRectHeader+sz_rfbZlibHeader,&out_len,wrkmem);
-		if (out_len > (lzo_uint)rawDataSize)
-			return vncEncoder::EncodeRect(source, dest, rect);
-		surh->encoding = Swap32IfLE(rfbEncodingUltra);
-		zlibh->nBytes = Swap32IfLE(out_len);
-		size=out_len;
-	}
+
+	if (m_wrkmem.Reserve(LZO1X_1_MEM_COMPRESS) == NULL)
+		return vncEncoder::EncodeRect(source, dest, rect);
+	lzo1x_1_compress(m_buffer,rawDataSize,dest+sz_rfbFramebufferUpdateRectHeader+sz_rfbZlibHeader,&out_len,m_wrkmem.Data());
+	if (out_len > (lzo_uint)rawDataSize)
+		return vncEncoder::EncodeRect(source, dest, rect);
+	surh->encoding = Swap32IfLE(rfbEncodingUltra);
+	zlibh->nBytes = Swap32IfLE(out_len);
+	size=out_len;
 	transmittedSize += sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader + size;
 	return sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader + size;
 }
 
-void vncEncodeUltra2::checkRowPointer(int h)
-{
-	if (h > m_rowPointerSize) {
-		if (m_rowPointer != NULL)
-			delete[] m_rowPointer;
-		m_rowPointer = new JSAMPROW[h];
-		m_rowPointerSize = h;
-	}
-}
-
 int
-vncEncodeUltra2::SendJpegRect(BYTE *src,BYTE *dst, int dst_size, int w, int h, int quality,rfbPixelFormat m_remoteformat)
+vncEncodeUltra2::SendJpegRect(BYTE *source,BYTE *dst, int dst_size, const rfb::Rect &rect, int quality)
 {
-  BYTE *srcBuf=NULL;
-
-  cinfo.image_width = w;
-  cinfo.image_height = h;
-  cinfo.in_color_space = JCS_RGB;
-  cinfo.input_components = 3;
-
-  if(m_remoteformat.bitsPerPixel==32) {
-    int redShift, greenShift, blueShift;
-
-    if(m_remoteformat.bigEndian) {
-      redShift = 24 - m_remoteformat.redShift;
-      greenShift = 24 - m_remoteformat.greenShift;
-      blueShift = 24 - m_remoteformat.blueShift;
-    } else {
-      redShift = m_remoteformat.redShift;
-      greenShift = m_remoteformat.greenShift;
-      blueShift = m_remoteformat.blueShift;
-    }
-
-    if(redShift == 0 && greenShift == 8 && blueShift == 16)
-      cinfo.in_color_space = JCS_EXT_RGBX;
-    if(redShift == 16 && greenShift == 8 && blueShift == 0)
-      cinfo.in_color_space = JCS_EXT_BGRX;
-    if(redShift == 24 && greenShift == 16 && blueShift == 8)
-      cinfo.in_color_space = JCS_EXT_XBGR;
-    if(redShift == 8 && greenShift == 16 && blueShift == 24)
-      cinfo.in_color_space = JCS_EXT_XRGB;
-
-    if (cinfo.in_color_space != JCS_RGB) {
-      srcBuf = src;
-      cinfo.input_components = 4;
-    }
-  }
-
-  if (w *h < 2500)
-	quality = 90;
-
-  if (quality != m_quality)
-  {
-	jpeg_set_defaults(&cinfo);
-	jpeg_set_quality(&cinfo, quality, TRUE);
-	if(quality >= 90) 
-		cinfo.dct_method = JDCT_ISLOW;
-	else 
-		cinfo.dct_method = JDCT_FASTEST;
-	if(quality >= 60) {
-		cinfo.comp_info[0].h_samp_factor = 2;
-		cinfo.comp_info[0].v_samp_factor = 2;
-	}
-	if(quality >= 70) {
-		cinfo.comp_info[0].h_samp_factor = 1;
-		cinfo.comp_info[0].v_samp_factor = 1;
-	}
-	m_quality = quality;
-  }
-
-  JpegSetDstManager(&cinfo, dst, dst_size);
-
-  checkRowPointer(h);
-  for (int dy = 0; dy < h; dy++)
-    m_rowPointer[dy] = (JSAMPROW)(&srcBuf[dy * w * 4]);
-
-  jpeg_start_compress(&cinfo, TRUE);
-  while (cinfo.next_scanline < cinfo.image_height)
-  {
-    jpeg_write_scanlines(&cinfo, &m_rowPointer[cinfo.next_scanline],
-      cinfo.image_height - cinfo.next_scanline);
-	if (jpegError)
-			break;
-  }
-
-  if (!jpegError)
-		jpeg_finish_compress(&cinfo);
-
-  if (jpegError) {
-	jpeg_destroy_compress(&cinfo);
-	cinfo.err = jpeg_std_error(&jerr);
-	jpeg_create_compress(&cinfo);
-	m_quality = 0;
-	return 0;
-  }
-  return jpegDstDataLen;
+	const int w = rect.br.x - rect.tl.x;
+	const int h = rect.br.y - rect.tl.y;
+
+	JpegSource src;
+	src.data = source + m_bytesPerRow * rect.tl.y + rect.tl.x * (m_localformat.bitsPerPixel / 8);
+	src.stride = m_bytesPerRow;
+	src.width = w;
+	src.height = h;
+	src.format = m_localformat;
+
+	if (w * h < 2500)
+		quality = 90;
+
+	JpegSettings settings;
+	settings.quality = quality;
+	settings.dctMethod = quality >= 90 ? JDCT_ISLOW : JDCT_FASTEST;
+	if (quality >= 70)
+		settings.hSamp = settings.vSamp = 1;
+
+	// Large rects are sliced over the pool's threads
+	if (w * h >= 2 * JpegCompressorPool::MIN_SLICE_PIXELS)
+		return JpegCompressorPool::Compress(src, settings, dst, dst_size);
+	return m_jpeg->Compress(src, 0, h, settings, dst, dst_size);
 }
 
-
-void
-JpegInitDestination(j_compress_ptr cinfo)
+UINT
+vncEncodeUltra2::EncodeLzoBands(BYTE *source, BYTE *dest, const rfb::Rect &rect, int workers)
 {
-	jpegError = false;
-	jpegDstManager.next_output_byte = jpegDstBuffer;
-	jpegDstManager.free_in_buffer = jpegDstBufferLen;
-}
+	const int rectW = rect.br.x - rect.tl.x;
+	const int rectH = rect.br.y - rect.tl.y;
+	const int bytesPerPixel = m_remoteformat.bitsPerPixel / 8;
+
+	int bands = workers + 1;
+	if (bands > MAX_BANDS)
+		bands = MAX_BANDS;
+	if (bands > rectW * rectH / MIN_BAND_PIXELS)
+		bands = rectW * rectH / MIN_BAND_PIXELS;
+	if (bands < 2)
+		return 0;
+	int bandRows = (rectH + bands - 1) / bands;
+	bands = (rectH + bandRows - 1) / bandRows;
+
+	for (int i = 0; i < bands; i++) {
+		Band &band = m_bands[i];
+		int top = rect.tl.y + i * bandRows;
+		int bottom = top + bandRows < rect.br.y ? top + bandRows : rect.br.y;
+		band.rect = rfb::Rect(rect.tl.x, top, rect.br.x, bottom);
+		band.rawSize = rectW * (bottom - top) * bytesPerPixel;
+		band.size = 0;
+		// LZO's worst case expansion
+		if (band.raw.Reserve(band.rawSize) == NULL ||
+			band.out.Reserve(band.rawSize + band.rawSize / 16 + 64 + 3) == NULL ||
+			band.wrkmem.Reserve(LZO1X_1_MEM_COMPRESS) == NULL)
+			return 0;
+	}
 
-boolean
-JpegEmptyOutputBuffer(j_compress_ptr cinfo)
-{
-	jpegError = true;
-	jpegDstManager.next_output_byte = jpegDstBuffer;
-	jpegDstManager.free_in_buffer = jpegDstBufferLen;
+	BandBatch batch;
+	batch.encoder = this;
+	batch.source = source;
+	EncoderThreadPool::Run(CompressBand, &batch, bands);
 
-	return TRUE;
-}
+	// Incompressible bands go back to one raw rect
+	for (int i = 0; i < bands; i++) {
+		if (m_bands[i].size == 0 || m_bands[i].size > (lzo_uint)m_bands[i].rawSize)
+			return 0;
+	}
 
-void
-JpegTermDestination(j_compress_ptr cinfo)
-{
-	jpegDstDataLen = jpegDstBufferLen - jpegDstManager.free_in_buffer;
+	UINT total = 0;
+	for (int i = 0; i < bands; i++) {
+		Band &band = m_bands[i];
+		rfbFramebufferUpdateRectHeader *surh=(rfbFramebufferUpdateRectHeader *)(dest + total);
+		surh->r.x = Swap16IfLE((CARD16) (band.rect.tl.x-monitor_Offsetx));
+		surh->r.y = Swap16IfLE((CARD16) (band.rect.tl.y-monitor_Offsety));
+		surh->r.w = Swap16IfLE((CARD16) (band.rect.br.x-band.rect.tl.x));
+		surh->r.h = Swap16IfLE((CARD16) (band.rect.br.y-band.rect.tl.y));
+		surh->encoding = Swap32IfLE(rfbEncodingUltra);
+		rfbZlibHeader *zlibh=(rfbZlibHeader *)(dest + total + sz_rfbFramebufferUpdateRectHeader);
+		zlibh->nBytes = Swap32IfLE(band.size);
+		memcpy(dest + total + sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader, band.out.Data(), band.size);
+		total += sz_rfbFramebufferUpdateRectHeader + sz_rfbZlibHeader + band.size;
+	}
+	transmittedSize += total;
+	return total;
 }
 
 void
-JpegSetDstManager(j_compress_ptr cinfo, JOCTET *buf, size_t buflen)
+vncEncodeUltra2::CompressBand(void *param, int index)
 {
-	jpegDstBuffer = buf;
-	jpegDstBufferLen = buflen;
-	jpegDstManager.init_destination = JpegInitDestination;
-	jpegDstManager.empty_output_buffer = JpegEmptyOutputBuffer;
-	jpegDstManager.term_destination = JpegTermDestination;
-	cinfo->dest = &jpegDstManager;
+	BandBatch *batch = (BandBatch *)param;
+	Band &band = batch->encoder->m_bands[index];
+	batch->encoder->Translate(batch->source, band.raw.Data(), band.rect);
+	if (lzo1x_1_compress(band.raw.Data(), band.rawSize, band.out.Data(), &band.size, band.wrkmem.Data()) != LZO_E_OK)
+		band.size = 0;
 }
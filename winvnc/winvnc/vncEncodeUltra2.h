@@ -29,11 +29,7 @@ class vncEncodeUltra2;
 #pragma once
 #include "vncencoder.h"
 #include "lzo/minilzo.h"
-#ifdef _INTERNALLIB
-#include <jpeglib.h>
-#else
-#include "libjpeg-turbo-win/jpeglib.h"
-#endif
+#include "JpegCompressor.h"
 
 // Class definition
 
@@ -60,16 +56,32 @@ public:
 private:
 	BYTE		      *m_buffer;
 	int			       m_bufflen;
-	int SendJpegRect(BYTE *src,BYTE *dst, int dst_size, int w, int h, int quality,rfbPixelFormat m_remoteformat);
+	int SendJpegRect(BYTE *source,BYTE *dst, int dst_size, const rfb::Rect &rect, int quality);
 	bool				lzo;
 	lzo_uint out_len;
+	PooledBuffer		m_wrkmem;
+
+	// When JPEG fails on a large rect the LZO fallback is cut in bands,
+	// one Ultra rect each, compressed on the EncoderThreadPool
+	enum { MAX_BANDS = 5, MIN_BAND_PIXELS = 65536 };
+	struct Band {
+		rfb::Rect rect;
+		PooledBuffer raw;
+		PooledBuffer out;
+		PooledBuffer wrkmem;
+		lzo_uint size;
+		int rawSize;
+	};
+	struct BandBatch {
+		vncEncodeUltra2 *encoder;
+		BYTE *source;
+	};
+	Band m_bands[MAX_BANDS];
+	UINT EncodeLzoBands(BYTE *source, BYTE *dest, const rfb::Rect &rect, int workers);
+	static void CompressBand(void *param, int index);
 	unsigned char *destbuffer;
-	JSAMPROW *m_rowPointer;
-	int m_rowPointerSize;
-	void checkRowPointer(int h);
-	int m_quality;
-	struct jpeg_compress_struct cinfo;
-	struct jpeg_error_mgr jerr;
+	// Reused for every rect, keeps its tables while the quality holds
+	JpegCompressor *m_jpeg;
 };
 
 #endif // _WINVNC_EncodeUltra
@@ -28,6 +28,7 @@
 #include <time.h>
 #include <rdr/MemOutStream.h>
 #include <rdr/xzOutStream.h>
+#include "EncoderThreadPool.h"
 
 #define GET_IMAGE_INTO_BUF(tx,ty,tw,th,buf)     \
   rfb::Rect rect;                                    \
@@ -37,7 +38,9 @@
   rect.br.y = ty+th;                          \
   encoder->Translate(source, (BYTE*)buf, rect);
 
-#define EXTRA_ARGS , BYTE* source, vncEncoder* encoder
+#define EXTRA_ARGS , BYTE* source, vncEncodeXZ* encoder
+
+#define TILE_ENCODED(rawBytes,bytes) encoder->TileEncoded(rawBytes, bytes)
 
 #define ENDIAN_LITTLE 0
 #define ENDIAN_BIG 1
@@ -87,19 +90,27 @@
 #undef CPIXEL
 #undef BPP
 
+// Updates with less tile data than this don't move the delta filter decision
+#define DELTA_MIN_UPDATE 0x10000
+
 vncEncodeXZ::vncEncodeXZ()
 {
 	mos = new rdr::MemOutStream;
 	xzos = new rdr::xzOutStream;
+	// Large updates are split into Blocks compressed on the encoder pool
+	xzos->SetJobRunner(EncoderThreadPool::Run, EncoderThreadPool::Workers() + 1);
 	beforeBuf = new rdr::U32[rfbXZTileWidth * rfbXZTileHeight + 1];
 	m_use_xzyw = FALSE;
+	m_use_delta = FALSE;
+	m_tileBytes = 0;
+	m_rawTileBytes = 0;
 }
 
 vncEncodeXZ::~vncEncodeXZ()
 {
 	delete mos;
 	delete xzos;
-	delete [] beforeBuf;
+	delete [] (rdr::U32 *) beforeBuf;
 }
 
 void vncEncodeXZ::Init()
@@ -121,8 +132,11 @@ UINT vncEncodeXZ::EncodeBulkRects(const rfb::RectVector &allRects, BYTE *source,
 	}
 
 	xzos->SetCompressLevel(m_compresslevel);
+	xzos->SetDeltaDistance(m_use_delta ? PixelStride() : 0);
 	mos->clear();
 	xzos->setUnderlying(mos);
+	m_tileBytes = 0;
+	m_rawTileBytes = 0;
 	
 	int nAllRects = (int)allRects.size();
 
@@ -151,6 +165,7 @@ UINT vncEncodeXZ::EncodeBulkRects(const rfb::RectVector &allRects, BYTE *source,
 		EncodeRect_Internal(source, x, y, w, h);
 	}
 
+	UpdateDeltaFilter();
 	xzos->flush();
 
 	const void* pDataBytes = mos->data();
@@ -191,6 +206,29 @@ UINT vncEncodeXZ::EncodeBulkRects(const rfb::RectVector &allRects, BYTE *source,
 }
 
 UINT vncEncodeXZ::EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect)
+{
+	UINT hdrlen = EncodeToStream(source, dest, rect);
+	memcpy(dest + hdrlen, (rdr::U8*)mos->data(), mos->length());
+	return hdrlen + mos->length();
+}
+
+// Same as vncEncodeZRLE, the compressed data goes to the socket from mos
+UINT vncEncodeXZ::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rfb::Rect &rect)
+{
+	if (outConn == NULL || outConn->IsUsePluginEnabled())
+		return EncodeRect(source, dest, rect);
+
+	UINT hdrlen = EncodeToStream(source, dest, rect);
+	if (!outConn->SendExactQueue((char *)dest, hdrlen) ||
+		!outConn->SendExactQueue((char *)mos->data(), mos->length())) {
+		vnclog.Print(LL_CONNERR, VNCLOG("XZ rect send failed, closing\n"));
+		outConn->Close();
+	}
+	return 0;
+}
+
+// Encodes into mos and writes the rect and XZ headers into dest
+UINT vncEncodeXZ::EncodeToStream(BYTE *source, BYTE *dest, const rfb::Rect &rect)
 {
 	int x = rect.tl.x;
 	int y = rect.tl.y;
@@ -198,11 +236,15 @@ UINT vncEncodeXZ::EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect)
 	int h = rect.br.y - y;
 
 	xzos->SetCompressLevel(m_compresslevel);
+	xzos->SetDeltaDistance(m_use_delta ? PixelStride() : 0);
 	mos->clear();
 	xzos->setUnderlying(mos);
+	m_tileBytes = 0;
+	m_rawTileBytes = 0;
 
 	EncodeRect_Internal(source, x, y, w, h);
 
+	UpdateDeltaFilter();
 	xzos->flush();
 
 	rfbFramebufferUpdateRectHeader* surh = (rfbFramebufferUpdateRectHeader*)dest;
@@ -222,10 +264,53 @@ UINT vncEncodeXZ::EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect)
 	int length = mos->length();
 	hdr->length = Swap32IfLE(length);
 
-	memcpy(dest + sz_rfbFramebufferUpdateRectHeader + sz_rfbXZHeader,
-		(rdr::U8*)mos->data(), length);
+	return sz_rfbFramebufferUpdateRectHeader + sz_rfbXZHeader;
+}
+
+// Bytes per pixel in the tiles, 3 for the packed 24 bit formats
+int vncEncodeXZ::PixelStride()
+{
+	if (m_remoteformat.bitsPerPixel != 32)
+		return m_remoteformat.bitsPerPixel / 8;
+
+	bool fitsInLS3Bytes
+		= ((m_remoteformat.redMax   << m_remoteformat.redShift)   < (1<<24) &&
+		(m_remoteformat.greenMax << m_remoteformat.greenShift) < (1<<24) &&
+		(m_remoteformat.blueMax  << m_remoteformat.blueShift)  < (1<<24));
+
+	bool fitsInMS3Bytes = (m_remoteformat.redShift   > 7  &&
+		m_remoteformat.greenShift > 7  &&
+		m_remoteformat.blueShift  > 7);
+
+	return (fitsInLS3Bytes || fitsInMS3Bytes) ? 3 : 4;
+}
+
+void vncEncodeXZ::TileEncoded(int rawBytes, int bytes)
+{
+	m_tileBytes += bytes;
+	if (bytes == rawBytes)
+		m_rawTileBytes += bytes;
+}
+
+// The delta filter runs over the whole stream at the pixel stride, which is
+// a horizontal pixel delta only inside raw tiles; on the palette and RLE
+// tiles of text and flat UI it scrambles the bytes LZMA would match. So it
+// is on while raw tiles make up nearly all of the tile data, as on photos
+// and video. Every switch starts a new Block, hence the hysteresis. XZYW
+// tiles hold wavelet coefficients, no delta for them.
+void vncEncodeXZ::UpdateDeltaFilter()
+{
+	if (m_use_xzyw) {
+		m_use_delta = FALSE;
+		return;
+	}
+	if (m_tileBytes < DELTA_MIN_UPDATE)
+		return;
 
-	return sz_rfbFramebufferUpdateRectHeader + sz_rfbXZHeader + length;
+	if (!m_use_delta && m_rawTileBytes >= m_tileBytes / 10 * 9)
+		m_use_delta = TRUE;
+	else if (m_use_delta && m_rawTileBytes < m_tileBytes / 4 * 3)
+		m_use_delta = FALSE;
 }
 
 void vncEncodeXZ::EncodeRect_Internal(BYTE *source, int x, int y, int w, int h)
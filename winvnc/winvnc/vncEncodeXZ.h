@@ -22,7 +22,7 @@
 #ifndef _WINVNC_ENCODEXZ
 #define _WINVNC_ENCODEXZ
 
-#include "vncEncoder.h"
+#include "vncencoder.h"
 
 namespace rdr { class xzOutStream; class MemOutStream; }
 
@@ -37,17 +37,27 @@ public:
   virtual UINT RequiredBuffSize(UINT width, UINT height);
 
   virtual UINT EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect);
+  virtual UINT EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rfb::Rect &rect);
   
   virtual UINT EncodeBulkRects(const rfb::RectVector &rects, BYTE *source, BYTE *dest, VSocket *outConn);
 
   void EncodeRect_Internal(BYTE *source, int x, int y, int w, int h);
+  // Called by the tile encoder for every tile, see UpdateDeltaFilter
+  void TileEncoded(int rawBytes, int bytes);
 
   BOOL m_use_xzyw;
 
 private:
+  UINT EncodeToStream(BYTE *source, BYTE *dest, const rfb::Rect &rect);
+  int PixelStride();
+  void UpdateDeltaFilter();
+
   rdr::xzOutStream* xzos;
   rdr::MemOutStream* mos;
   void* beforeBuf;
+  BOOL m_use_delta;
+  int m_tileBytes;
+  int m_rawTileBytes;
 };
 
 #endif
@@ -36,6 +36,7 @@
 #include "stdhdrs.h"
 #include "vncEncodeZlibHex.h"
 #include "../../common/UltraVncZ.h"
+#include "EncoderThreadPool.h"
 #include "rfb.h"
 #include <stdlib.h>
 #include <time.h>
@@ -122,6 +123,13 @@ vncEncodeZlibHex::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const R
 	const int rectW = rect.right - rect.left;
 	const int rectH = rect.bottom - rect.top;
 
+	// Large rects are encoded in bands, in parallel
+	if (rectW * rectH >= 2 * VNC_ENCODE_ZLIBHEX_MIN_BAND_PIXELS && rectH > 16) {
+		int workers = EncoderThreadPool::Workers();
+		if (workers > 0 && EncodeBands(source, outConn, dest, rect, workers))
+			return 0;
+	}
+
 	// Create the rectangle header
 	rfbFramebufferUpdateRectHeader *surh=(rfbFramebufferUpdateRectHeader *)dest;
 	surh->r.x = (CARD16) (rect.left-monitor_Offsetx);
@@ -534,6 +542,237 @@ DEFINE_SEND_HEXTILES(8)
 DEFINE_SEND_HEXTILES(16)
 DEFINE_SEND_HEXTILES(32)
 
+/*
+ * Band versions of EncodeHextiles#(), for the worker threads. They
+ * leave the data to deflate in place and record it in band.deferred,
+ * SendBand() runs it through the zlib streams.
+ */
+
+#define DEFINE_PREPARE_HEXTILES(bpp)										\
+																			\
+void																		\
+vncEncodeZlibHex::PrepareHextiles##bpp(BYTE *source, Band &band)			\
+{																			\
+    int x, y, w, h;															\
+    int rectoffset, destoffset;												\
+    int encodedBytes;														\
+	CARD##bpp bg, fg, newBg, newFg;											\
+	bg=0;fg=0;newBg=0;newFg=0;												\
+	BOOL mono, solid;														\
+	BOOL validBg = FALSE;													\
+	BOOL validFg = FALSE;													\
+	CARD##bpp clientPixelData[(16*16+2)*(bpp/8)+8+14+2];					\
+	BYTE *dest = band.out.Data();											\
+	Band::Deferred deferred;												\
+																			\
+	destoffset = 0;															\
+	band.deferred.clear();													\
+																			\
+    for (y = band.y; y < band.y+band.h; y += 16)							\
+	{																		\
+		for (x = band.x; x < band.x+band.w; x += 16)						\
+		{																	\
+		    w = h = 16;														\
+		    if (band.x+band.w - x < 16)										\
+				w = band.x+band.w - x;										\
+		    if (band.y+band.h - y < 16)										\
+				h = band.y+band.h - y;										\
+																			\
+			RECT hexrect;													\
+			hexrect.left = x;												\
+			hexrect.top = y;												\
+			hexrect.right = x+w;											\
+			hexrect.bottom = y+h;											\
+			Translate(source, (BYTE *) clientPixelData, hexrect);			\
+																			\
+			rectoffset = destoffset;										\
+			dest[rectoffset] = 0;											\
+			destoffset++;													\
+																			\
+			testColours##bpp(clientPixelData, w * h,						\
+			     &mono, &solid, &newBg, &newFg);							\
+																			\
+			if (!validBg || (newBg != bg))									\
+			{																\
+				validBg = TRUE;												\
+				bg = newBg;													\
+				dest[rectoffset] |= rfbHextileBackgroundSpecified;			\
+				PUT_PIXEL##bpp(bg);											\
+			}																\
+																			\
+			if (solid)														\
+				continue;													\
+																			\
+			dest[rectoffset] |= rfbHextileAnySubrects;						\
+																			\
+			if (mono)														\
+			{																\
+				if (!validFg || (newFg != fg))								\
+				{															\
+					validFg = TRUE;											\
+					fg = newFg;												\
+					dest[rectoffset] |= rfbHextileForegroundSpecified;		\
+					PUT_PIXEL##bpp(fg);										\
+				}															\
+			}																\
+			else															\
+			{																\
+				validFg = FALSE;											\
+				dest[rectoffset] |= rfbHextileSubrectsColoured;			    \
+			}																\
+																			\
+			encodedBytes = subrectEncode##bpp(clientPixelData,				\
+											dest + destoffset,				\
+											w, h, bg, fg, mono);			\
+																			\
+			if (encodedBytes == 0)											\
+			{																\
+				/* hextile encoding was too large, use raw/zlib */			\
+				validBg = FALSE;											\
+				validFg = FALSE;											\
+				destoffset = rectoffset;									\
+				if ((w*h*(bpp/8)) > VNC_ENCODE_ZLIBHEX_MIN_COMP_SIZE)		\
+				{															\
+					dest[destoffset++] = rfbHextileZlibRaw;					\
+					deferred.offset = destoffset;							\
+					deferred.length = w*h*(bpp/8);							\
+					deferred.raw = true;									\
+					band.deferred.push_back(deferred);						\
+				}															\
+				else														\
+				{															\
+					dest[destoffset++] = rfbHextileRaw;						\
+				}															\
+				Translate(source, (dest + destoffset), hexrect);			\
+				destoffset += (w*h*(bpp/8));								\
+			}																\
+			else if (encodedBytes > (VNC_ENCODE_ZLIBHEX_MIN_COMP_SIZE * 2))	\
+			{																\
+				/* the colours and subrects are deflated together */		\
+				dest[rectoffset] |= rfbHextileZlibHex;						\
+				deferred.offset = rectoffset + 1;							\
+				deferred.length = encodedBytes + destoffset - rectoffset - 1;	\
+				deferred.raw = false;										\
+				band.deferred.push_back(deferred);							\
+				destoffset += encodedBytes;									\
+			}																\
+			else															\
+			{																\
+				destoffset += encodedBytes;									\
+			}																\
+		}																	\
+    }																		\
+	band.size = destoffset;													\
+}
+
+DEFINE_PREPARE_HEXTILES(8)
+DEFINE_PREPARE_HEXTILES(16)
+DEFINE_PREPARE_HEXTILES(32)
+
+BOOL
+vncEncodeZlibHex::EncodeBands(BYTE *source, VSocket *outConn, BYTE *dest, const RECT &rect, int workers)
+{
+	const int rectW = rect.right - rect.left;
+	const int rectH = rect.bottom - rect.top;
+	const int bytesPerPixel = m_remoteformat.bitsPerPixel / 8;
+	if (bytesPerPixel != 1 && bytesPerPixel != 2 && bytesPerPixel != 4)
+		return FALSE;
+
+	// Whole tile rows per band, the last one takes the rest
+	int tileRows = (rectH + 15) / 16;
+	int bands = workers + 1;
+	if (bands > VNC_ENCODE_ZLIBHEX_MAX_BANDS)
+		bands = VNC_ENCODE_ZLIBHEX_MAX_BANDS;
+	if (bands > rectW * rectH / VNC_ENCODE_ZLIBHEX_MIN_BAND_PIXELS)
+		bands = rectW * rectH / VNC_ENCODE_ZLIBHEX_MIN_BAND_PIXELS;
+	if (bands > tileRows)
+		bands = tileRows;
+	if (bands < 2)
+		return FALSE;
+	int bandRows = (tileRows + bands - 1) / bands * 16;
+	bands = (rectH + bandRows - 1) / bandRows;
+
+	for (int i = 0; i < bands; i++) {
+		Band &band = m_bands[i];
+		band.x = rect.left;
+		band.y = rect.top + i * bandRows;
+		band.w = rectW;
+		band.h = rect.bottom - band.y < bandRows ? rect.bottom - band.y : bandRows;
+		band.size = 0;
+		// Worst case per tile: subencoding, background and foreground,
+		// raw pixels
+		int tiles = ((band.w + 15) / 16) * ((band.h + 15) / 16);
+		if (band.out.Reserve(tiles * (1 + (16 * 16 + 2) * bytesPerPixel)) == NULL)
+			return FALSE;
+	}
+
+	BandBatch batch;
+	batch.encoder = this;
+	batch.source = source;
+	EncoderThreadPool::Run(PrepareBand, &batch, bands);
+
+	for (int i = 0; i < bands; i++)
+		SendBand(m_bands[i], dest, outConn);
+	SendZlibHexrects(outConn);
+	return TRUE;
+}
+
+void
+vncEncodeZlibHex::PrepareBand(void *param, int index)
+{
+	BandBatch *batch = (BandBatch *)param;
+	vncEncodeZlibHex *encoder = batch->encoder;
+	Band &band = encoder->m_bands[index];
+	switch (encoder->m_remoteformat.bitsPerPixel)
+	{
+	case 8:
+		encoder->PrepareHextiles8(batch->source, band);
+		break;
+	case 16:
+		encoder->PrepareHextiles16(batch->source, band);
+		break;
+	case 32:
+		encoder->PrepareHextiles32(batch->source, band);
+		break;
+	}
+}
+
+// Queues the band as a rect of its own, deflating as it goes. dest
+// is scratch space for the compressed tiles.
+void
+vncEncodeZlibHex::SendBand(Band &band, BYTE *dest, VSocket *outConn)
+{
+	rfbFramebufferUpdateRectHeader surh;
+	surh.r.x = Swap16IfLE((CARD16) (band.x-monitor_Offsetx));
+	surh.r.y = Swap16IfLE((CARD16) (band.y-monitor_Offsety));
+	surh.r.w = Swap16IfLE((CARD16) band.w);
+	surh.r.h = Swap16IfLE((CARD16) band.h);
+	surh.encoding = Swap32IfLE(m_use_zstd ? rfbEncodingZstdHex : rfbEncodingZlibHex);
+	AddToQueu((BYTE *)&surh, sz_rfbFramebufferUpdateRectHeader, outConn);
+
+	rectangleOverhead += sz_rfbFramebufferUpdateRectHeader;
+	transmittedSize += sz_rfbFramebufferUpdateRectHeader;
+	dataSize += (band.w * band.h * m_remoteformat.bitsPerPixel) / 8;
+
+	BYTE *data = band.out.Data();
+	int pos = 0;
+	for (size_t i = 0; i < band.deferred.size(); i++) {
+		const Band::Deferred &d = band.deferred[i];
+		AddToQueu(data + pos, d.offset - pos, outConn);
+		UINT compressedSize = zlibCompress(data + d.offset, dest + 2, d.length,
+										   d.raw ? ultraVncZRaw : ultraVncZEncoded);
+		CARD16 *card16ptr = (CARD16 *)dest;
+		*card16ptr = Swap16IfLE(compressedSize);
+		AddToQueu(dest, compressedSize + 2, outConn);
+		transmittedSize += (int)compressedSize + 2 - d.length;
+		encodedSize += (int)compressedSize + 2 - d.length;
+		pos = d.offset + d.length;
+	}
+	AddToQueu(data + pos, band.size - pos, outConn);
+	transmittedSize += band.size;
+	encodedSize += band.size;
+}
+
 
 void
 vncEncodeZlibHex::AddToQueu(BYTE *source,int sizerect,VSocket *outConn)
@@ -43,6 +43,7 @@ class vncEncodeZlibHex;
 
 #include "vncencoder.h"
 #include "lzo/minilzo.h"
+#include <vector>
 
 // Minimum zlib rectangle size in bytes.  Anything smaller will
 // not compress well due to overhead.
@@ -57,6 +58,11 @@ class vncEncodeZlibHex;
 // improve latency issues with performance.
 #define VNC_ENCODE_ZLIBHEX_MIN_DATAXFER (1400)
 
+// Rects of at least twice this many pixels are cut in bands of tile
+// rows, one rect each, when there are threads to encode them on.
+#define VNC_ENCODE_ZLIBHEX_MIN_BAND_PIXELS (65536)
+#define VNC_ENCODE_ZLIBHEX_MAX_BANDS (5)
+
 // Class definition
 class UltraVncZ;
 
@@ -90,6 +96,32 @@ protected:
 	virtual UINT EncodeHextiles32(BYTE *source, BYTE *dest,
 		VSocket *outConn, int x, int y, int w, int h);
 
+	// Bands: the tiles are analysed and subencoded on the
+	// EncoderThreadPool, leaving the data to deflate in place. The
+	// zlib streams then run over the bands in order on this thread,
+	// as the viewer inflates them.
+	struct Band {
+		int x, y, w, h;
+		PooledBuffer out;
+		int size;
+		struct Deferred {
+			int offset;			// in out, after the subencoding byte
+			int length;
+			bool raw;			// ultraVncZRaw, else ultraVncZEncoded
+		};
+		std::vector<Deferred> deferred;
+	};
+	struct BandBatch {
+		vncEncodeZlibHex *encoder;
+		BYTE *source;
+	};
+	BOOL EncodeBands(BYTE *source, VSocket *outConn, BYTE *dest, const RECT &rect, int workers);
+	static void PrepareBand(void *param, int index);
+	void PrepareHextiles8(BYTE *source, Band &band);
+	void PrepareHextiles16(BYTE *source, Band &band);
+	void PrepareHextiles32(BYTE *source, Band &band);
+	void SendBand(Band &band, BYTE *dest, VSocket *outConn);
+
 // Implementation
 protected:
 	BYTE		      *m_buffer;
@@ -100,6 +132,7 @@ protected:
 	int					MaxQueuebufflen;
 	UltraVncZ   *ultraVncZRaw;
 	UltraVncZ   *ultraVncZEncoded;
+	Band		m_bands[VNC_ENCODE_ZLIBHEX_MAX_BANDS];
 };
 
 #endif // _WINVNC_ENCODEHEXTILE
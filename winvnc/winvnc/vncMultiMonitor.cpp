@@ -85,4 +85,25 @@ vncDesktop::Checkmonitors()
 	mymonitor[MULTI_MON_ALL].Height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
 	mymonitor[MULTI_MON_ALL].Depth = mymonitor[MULTI_MON_PRIMARY].Depth;//depth primary monitor is used
 	devicenaamToPosMap.insert(std::pair< std::string, monitor >("MULTI_MON_ALL", mymonitor[MULTI_MON_ALL]));
-}
\ No newline at end of file
+}
+
+// Slices the framebuffer by monitor for the workers, when all of
+// them are shown. Called every frame, the workers only restart when
+// the monitors or the framebuffer change.
+void
+vncDesktop::UpdateMonitorWorkers()
+{
+	std::vector<rfb::Rect> slices;
+	if (show_all_monitors && nr_monitors > 1 && nr_monitors <= MonitorWorkers::MAX_WORKERS) {
+		for (int i = 0; i < nr_monitors; i++) {
+			rfb::Rect r(mymonitor[i].offsetx - m_ScreenOffsetx, mymonitor[i].offsety - m_ScreenOffsety,
+						mymonitor[i].offsetx - m_ScreenOffsetx + mymonitor[i].Width,
+						mymonitor[i].offsety - m_ScreenOffsety + mymonitor[i].Height);
+			slices.push_back(r.intersect(m_bmrect));
+		}
+	}
+	m_monitorWorkers.Configure(slices, m_DIBbits, m_DIBsection,
+							   &m_bminfo.bmi, sizeof(m_bminfo.bmi) + sizeof(m_bminfo.cmap),
+							   m_bytesPerRow, m_scrinfo.format.bitsPerPixel / 8,
+							   m_ScreenOffsetx, m_ScreenOffsety);
+}
@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <winsock2.h>
+#include <windows.h>
+#include "vncSendPacer.h"
+
+vncSendPacer::vncSendPacer()
+{
+	InitializeCriticalSection(&m_lock);
+	m_first = 0;
+	m_count = 0;
+	m_ticket = 0;
+	m_inFlight = 0;
+	m_delivered = 0;
+	m_minRtt = 0;
+	m_minRttTime = 0;
+	m_maxRate = 0;
+	m_maxRateTime = 0;
+	m_sampled = false;
+	m_depth = 1;
+	m_unsampled = 0;
+}
+
+vncSendPacer::~vncSendPacer()
+{
+	DeleteCriticalSection(&m_lock);
+}
+
+DWORD
+vncSendPacer::UpdateStarting(DWORD now)
+{
+	EnterCriticalSection(&m_lock);
+	if (m_count == MAX_OUTSTANDING)
+		Pop();
+	Sent &s = m_sent[(m_first + m_count) % MAX_OUTSTANDING];
+	s.ticket = ++m_ticket;
+	s.time = now;
+	s.bytes = 0;
+	s.delivered = m_delivered;
+	m_count++;
+	DWORD ticket = s.ticket;
+	LeaveCriticalSection(&m_lock);
+	return ticket;
+}
+
+void
+vncSendPacer::UpdateSent(DWORD ticket, DWORD now, DWORD bytes)
+{
+	EnterCriticalSection(&m_lock);
+	Sent *s = Find(ticket);
+	if (s) {
+		s->time = now;
+		s->bytes = bytes;
+		m_inFlight += bytes;
+	}
+	else {
+		// Acknowledged while it was still being sent
+		m_delivered += bytes;
+	}
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+vncSendPacer::UpdateDropped(DWORD ticket)
+{
+	EnterCriticalSection(&m_lock);
+	// Only the update thread queues, an entry still there is the newest
+	if (Find(ticket))
+		m_count--;
+	LeaveCriticalSection(&m_lock);
+}
+
+void
+vncSendPacer::RequestReceived(DWORD now, LONG queued)
+{
+	EnterCriticalSection(&m_lock);
+	// Short of the depth the viewer tops up its pipeline, this answers
+	// no update. Paired anyway, the next update would be acknowledged
+	// with a fraction of its RTT and every answer after it shifted.
+	LONG ahead = queued + m_count;
+	if (ahead < m_depth || m_count == 0) {
+		if (ahead + 1 > m_depth)
+			m_depth = ahead + 1;
+		LeaveCriticalSection(&m_lock);
+		return;
+	}
+	Sent s = m_sent[m_first];
+	Pop();
+	m_delivered += s.bytes;
+
+	DWORD rtt = now - s.time;
+	if (rtt == 0)
+		rtt = 1;
+	if (!m_sampled || rtt <= m_minRtt || now - m_minRttTime > RTT_WINDOW) {
+		m_minRtt = rtt;
+		m_minRttTime = now;
+	}
+	// Everything acknowledged since this update left, over the time it took
+	DWORD64 rate = (DWORD64)(m_delivered - s.delivered) * 1000 / rtt;
+	if (rate > MAXDWORD)
+		rate = MAXDWORD;
+	if (!m_sampled || rate >= m_maxRate || now - m_maxRateTime > BW_WINDOW) {
+		m_maxRate = (DWORD)rate;
+		m_maxRateTime = now;
+	}
+	m_sampled = true;
+	m_unsampled = 0;
+	LeaveCriticalSection(&m_lock);
+}
+
+DWORD
+vncSendPacer::TimeToSend(DWORD now)
+{
+	EnterCriticalSection(&m_lock);
+	Expire(now);
+	DWORD wait = 0;
+	if (m_count > 0 && m_inFlight >= CurrentWindow()) {
+		// An acknowledgement wakes the update thread, this only bounds
+		// the wait for one that never comes
+		wait = STALE_TIMEOUT - (now - m_sent[m_first].time);
+		if (wait == 0)
+			wait = 1;
+	}
+	LeaveCriticalSection(&m_lock);
+	return wait;
+}
+
+DWORD
+vncSendPacer::Rtt()
+{
+	EnterCriticalSection(&m_lock);
+	DWORD rtt = m_minRtt;
+	LeaveCriticalSection(&m_lock);
+	return rtt;
+}
+
+DWORD
+vncSendPacer::Bandwidth()
+{
+	EnterCriticalSection(&m_lock);
+	DWORD rate = m_maxRate;
+	LeaveCriticalSection(&m_lock);
+	return rate;
+}
+
+DWORD
+vncSendPacer::Window()
+{
+	EnterCriticalSection(&m_lock);
+	DWORD window = CurrentWindow();
+	LeaveCriticalSection(&m_lock);
+	return window;
+}
+
+DWORD
+vncSendPacer::BytesInFlight()
+{
+	EnterCriticalSection(&m_lock);
+	DWORD inflight = m_inFlight;
+	LeaveCriticalSection(&m_lock);
+	return inflight;
+}
+
+void
+vncSendPacer::Expire(DWORD now)
+{
+	while (m_count > 0 && now - m_sent[m_first].time >= STALE_TIMEOUT) {
+		// Never answered, the viewer keeps fewer requests ahead than
+		// was learnt. The window grows by what left it without a sample.
+		DWORD bytes = m_sent[m_first].bytes;
+		m_unsampled = m_unsampled > MAXDWORD - bytes ? MAXDWORD : m_unsampled + bytes;
+		Pop();
+		if (m_depth > 1)
+			m_depth--;
+	}
+}
+
+vncSendPacer::Sent *
+vncSendPacer::Find(DWORD ticket)
+{
+	if (m_count == 0)
+		return NULL;
+	Sent *s = &m_sent[(m_first + m_count - 1) % MAX_OUTSTANDING];
+	return s->ticket == ticket ? s : NULL;
+}
+
+void
+vncSendPacer::Pop()
+{
+	m_inFlight -= m_sent[m_first].bytes;
+	m_first = (m_first + 1) % MAX_OUTSTANDING;
+	m_count--;
+}
+
+DWORD
+vncSendPacer::CurrentWindow()
+{
+	// No estimate before the first acknowledgement
+	DWORD64 window = m_sampled ? (DWORD64)m_maxRate * m_minRtt / 1000 * 2 : 0;
+	if (window < MIN_WINDOW)
+		window = MIN_WINDOW;
+	// Gone since without a sample, grow as from a slow start
+	for (DWORD64 acked = m_unsampled; acked >= window && window < MAXDWORD; window *= 2)
+		acked -= window;
+	if (window > MAXDWORD)
+		window = MAXDWORD;
+	return (DWORD)window;
+}
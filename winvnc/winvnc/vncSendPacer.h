@@ -0,0 +1,140 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+////////////////////////////////////////
+// class vncSendPacer;
+//
+// Keeps the bytes a client has in flight
+// near what its path can carry, so a slow
+// link queues fresh frames rather than a
+// backlog of stale ones in the kernel.
+//
+// Every update request that comes in is
+// taken as the acknowledgement of the
+// oldest update not yet acknowledged. The
+// time from sending that update gives an
+// RTT sample, the bytes acknowledged over
+// that time a delivery rate sample. The
+// window is twice the bandwidth-delay
+// product of the lowest recent RTT and the
+// highest recent rate.
+//
+// A viewer that pipelines keeps a number
+// of requests ahead: it sends one for each
+// update it reads, and tops up once at the
+// start. Its requests still queued here
+// plus the updates it has not answered
+// add up to that depth, so a request that
+// arrives short of it is a top-up, which
+// answers nothing and gives no sample.
+// The depth is learnt from the requests,
+// and lowered again when an update is
+// never answered.
+//
+// Without a sample the window still grows,
+// doubling with each window of bytes that
+// expires unanswered, so a stale or missing
+// estimate never holds a fast link at the
+// minimum. The next sample replaces it.
+//
+// The update thread holds a frame back
+// while the window is full. One update is
+// always allowed when nothing is in flight,
+// and updates that are never acknowledged
+// expire, so a viewer that does not answer
+// the way this expects is only unpaced.
+//
+// Thread-safe, the client thread feeds the
+// acknowledgements, the update thread the
+// sends.
+//
+class vncSendPacer
+{
+public:
+	vncSendPacer();
+	~vncSendPacer();
+
+	// Brackets an update. It is queued before it is sent, a fast
+	// viewer may ask for the next one before the send returns.
+	DWORD UpdateStarting(DWORD now);
+	// <bytes> went out with it at <now>
+	void UpdateSent(DWORD ticket, DWORD now, DWORD bytes);
+	// Nothing was sent, or nothing the viewer acknowledges
+	void UpdateDropped(DWORD ticket);
+	// An update request came in at <now>, <queued> earlier ones are
+	// not answered by an update yet
+	void RequestReceived(DWORD now, LONG queued);
+
+	// Milliseconds until the next update may be sent, 0 = now
+	DWORD TimeToSend(DWORD now);
+
+	// Current estimates, 0 until the first acknowledgement
+	DWORD Rtt();
+	DWORD Bandwidth();		// bytes per second
+	DWORD Window();
+	DWORD BytesInFlight();
+
+private:
+	vncSendPacer(const vncSendPacer &);
+	vncSendPacer &operator=(const vncSendPacer &);
+
+	enum {
+		MAX_OUTSTANDING = 32,
+		MIN_WINDOW = 65536,
+		RTT_WINDOW = 10000,		// ms a minimum RTT sample is kept
+		BW_WINDOW = 2000,		// ms a maximum rate sample is kept
+		STALE_TIMEOUT = 3000	// ms before an update counts as lost
+	};
+
+	struct Sent {
+		DWORD ticket;
+		DWORD time;
+		DWORD bytes;
+		DWORD delivered;	// m_delivered when it was sent
+	};
+
+	void Expire(DWORD now);
+	void Pop();
+	// The entry of <ticket>, NULL once acknowledged or expired
+	Sent *Find(DWORD ticket);
+	DWORD CurrentWindow();
+
+	CRITICAL_SECTION m_lock;
+	Sent m_sent[MAX_OUTSTANDING];
+	int m_first;
+	int m_count;
+	DWORD m_ticket;
+	DWORD m_inFlight;
+	DWORD m_delivered;		// acknowledged bytes, wraps
+
+	DWORD m_minRtt;
+	DWORD m_minRttTime;
+	DWORD m_maxRate;		// bytes per second
+	DWORD m_maxRateTime;
+	bool m_sampled;
+	LONG m_depth;			// requests the viewer keeps ahead
+	DWORD m_unsampled;		// bytes expired since the last sample
+};
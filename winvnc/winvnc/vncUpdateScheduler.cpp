@@ -0,0 +1,149 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <winsock2.h>
+#include <windows.h>
+#include "vncUpdateScheduler.h"
+
+vncUpdateScheduler::vncUpdateScheduler()
+{
+	m_targetInterval = 1000 / DEFAULT_FPS;
+	m_latencyBudget = DEFAULT_LATENCY_BUDGET;
+	m_interval = m_targetInterval;
+	m_cpuPenalty = 0;
+	m_sendAvg = 0;
+	m_lastFrame = 0;
+	m_idleWait = 0;
+	m_nextPoll = 0;
+}
+
+void
+vncUpdateScheduler::SetTargetFps(LONG fps)
+{
+	if (fps <= 0)
+		fps = DEFAULT_FPS;
+	if (fps > 1000)
+		fps = 1000;
+	DWORD interval = 1000 / fps;
+	if (interval == m_targetInterval)
+		return;
+	m_targetInterval = interval;
+	Adapt();
+}
+
+void
+vncUpdateScheduler::SetLatencyBudget(DWORD ms)
+{
+	m_latencyBudget = ms;
+	Adapt();
+}
+
+DWORD
+vncUpdateScheduler::TimeToNextFrame(DWORD now)
+{
+	DWORD elapsed = now - m_lastFrame;
+	if (elapsed >= m_interval)
+		return 0;
+	return m_interval - elapsed;
+}
+
+void
+vncUpdateScheduler::FrameStart(DWORD now)
+{
+	m_lastFrame = now;
+}
+
+void
+vncUpdateScheduler::FrameSent(DWORD start, DWORD end)
+{
+	m_lastFrame = start;
+	// The socket layer blocks in send() once the kernel buffer is full,
+	// so the time spent pushing a frame is a direct backpressure signal.
+	DWORD sendtime = end - start;
+	m_sendAvg = (m_sendAvg * 3 + sendtime) / 4;
+	Adapt();
+}
+
+void
+vncUpdateScheduler::CpuUsage(short usage, LONG maxcpu)
+{
+	if (maxcpu >= 100) {
+		m_cpuPenalty = 0;
+	}
+	else if (usage > maxcpu) {
+		m_cpuPenalty += 10;
+	}
+	else if (m_cpuPenalty >= 10) {
+		m_cpuPenalty -= 10;
+	}
+	else {
+		m_cpuPenalty = 0;
+	}
+	Adapt();
+}
+
+void
+vncUpdateScheduler::Damage()
+{
+	m_idleWait = 0;
+}
+
+void
+vncUpdateScheduler::Idle(DWORD now)
+{
+	m_idleWait += IDLE_STEP;
+	if (m_idleWait > IDLE_MAX)
+		m_idleWait = IDLE_MAX;
+	m_nextPoll = now + m_idleWait;
+}
+
+bool
+vncUpdateScheduler::PollDue(DWORD now)
+{
+	// Wrap safe, the next poll is at most IDLE_MAX ahead
+	return m_idleWait == 0 || (LONG)(now - m_nextPoll) >= 0;
+}
+
+DWORD
+vncUpdateScheduler::PollWait(DWORD minwait, DWORD now)
+{
+	DWORD wait = m_interval > minwait ? m_interval : minwait;
+	if (PollDue(now))
+		return wait;
+	// An early wakeup only waits out the rest of the back-off
+	DWORD left = m_nextPoll - now;
+	return left > wait ? left : wait;
+}
+
+void
+vncUpdateScheduler::Adapt()
+{
+	DWORD interval = m_targetInterval + m_cpuPenalty;
+	if (m_sendAvg > interval)
+		interval = m_sendAvg;
+	DWORD budget = m_latencyBudget > m_targetInterval ? m_latencyBudget : m_targetInterval;
+	if (interval > budget)
+		interval = budget;
+	m_interval = interval;
+}
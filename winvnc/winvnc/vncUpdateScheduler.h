@@ -0,0 +1,108 @@
+/////////////////////////////////////////////////////////////////////////////
+//  Copyright (C) 2002-2013 UltraVNC Team Members. All Rights Reserved.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+//  USA.
+//
+// If the source code for the program is not available from the place from
+// which you received this file, check
+// http://www.uvnc.com/
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+////////////////////////////////////////
+// class vncUpdateScheduler;
+//
+// Paces framebuffer updates towards a
+// target frame rate.
+//
+// The scheduler only decides *when* the
+// next frame may go out. Damage that
+// arrives in between is coalesced by the
+// caller's update tracker, so one frame
+// carries everything that changed since
+// the previous one.
+//
+// The frame interval stretches when the
+// socket pushes back (a send that blocks
+// longer than one interval) and when the
+// host is above the MaxCpu limit, but it
+// never exceeds the latency budget.
+//
+// Idle screens are handled by PollDue and
+// PollWait: every pass without damage
+// pushes the next screen poll further out,
+// up to IDLE_MAX. The capture thread
+// blocks on its events until then instead
+// of sleeping, so a hook, driver or cursor
+// event still wakes it immediately, but a
+// wakeup that brings no damage does not
+// poll early or reset the back-off.
+//
+// Not thread-safe, each thread owns one.
+//
+class vncUpdateScheduler
+{
+public:
+	vncUpdateScheduler();
+
+	// Target frame rate, 0 or less means the default
+	void SetTargetFps(LONG fps);
+	// Upper bound for the adapted frame interval
+	void SetLatencyBudget(DWORD ms);
+
+	// Milliseconds until the next frame may be sent, 0 = now
+	DWORD TimeToNextFrame(DWORD now);
+	// A frame was taken at <now>
+	void FrameStart(DWORD now);
+	// A frame was pushed into the socket between <start> and <end>
+	void FrameSent(DWORD start, DWORD end);
+
+	// CPU feedback from the capture thread, ignored in PowerMode (100)
+	void CpuUsage(short usage, LONG maxcpu);
+
+	// Idle back-off, fed with every detection pass
+	void Damage();
+	void Idle(DWORD now);
+	// The screen may be polled again at <now>
+	bool PollDue(DWORD now);
+	// How long the capture thread may block waiting for events
+	DWORD PollWait(DWORD minwait, DWORD now);
+
+	DWORD FrameInterval() { return m_interval; };
+	DWORD KeepAliveInterval() { return UPDATE_KEEPALIVE; };
+
+private:
+	void Adapt();
+
+	enum {
+		DEFAULT_FPS = 25,
+		DEFAULT_LATENCY_BUDGET = 500,
+		UPDATE_KEEPALIVE = 4000,
+		IDLE_STEP = 5,
+		IDLE_MAX = 1000
+	};
+
+	DWORD m_targetInterval;
+	DWORD m_latencyBudget;
+	DWORD m_interval;
+	DWORD m_cpuPenalty;
+	DWORD m_sendAvg;
+	DWORD m_lastFrame;
+	DWORD m_idleWait;
+	DWORD m_nextPoll;
+};
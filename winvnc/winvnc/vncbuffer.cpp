@@ -300,6 +300,13 @@ void vncBuffer::CheckRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rf
 	if (!FastCheckMainbuffer())
 		return;
 	omni_mutex_lock l(m_cacheLock, 667);
+	ScanRect(dest, cacheRgn, srcrect, full, nRowIndex);
+}
+
+// CheckRect() without the cache lock, rowIndex in place of nRowIndex.
+// The monitor workers scan their slices with it at the same time.
+void vncBuffer::ScanRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rfb::Rect &srcrect, bool full, int &rowIndex)
+{
 	const UINT bytesPerPixel = m_scrinfo.format.bitsPerPixel >> 3; // divide by 8
 
 	rfb::Rect new_rect;
@@ -385,7 +392,7 @@ void vncBuffer::CheckRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rf
 			// Scan this block
 			for (ay = y; ay < blockbottom; ay++)
 			{
-					int nBlockOffset =  nRowIndex * nOffset;
+					int nBlockOffset =  rowIndex * nOffset;
 					if (memcmp(n_block_ptr + nBlockOffset, o_block_ptr + nBlockOffset, nOffset) != 0)
 				{
 					// A pixel has changed, so this block needs updating
@@ -437,7 +444,7 @@ void vncBuffer::CheckRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rf
 				o_block_ptr += m_bytesPerRow;
 				c_block_ptr += m_bytesPerRow;
 
-				nRowIndex = (nRowIndex + 1) % m_nAccuracyDiv; // sf@2002 - v1.1.0
+				rowIndex = (rowIndex + 1) % m_nAccuracyDiv; // sf@2002 - v1.1.0
 			}
 
 			o_row_ptr += bytesPerBlockRow;
@@ -481,7 +488,7 @@ void vncBuffer::CheckRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rf
 			// Scan this block
 			for (ay = y; ay < blockbottom; ay++)
 			{
-					int nBlockOffset =  nRowIndex * nOffset;
+					int nBlockOffset =  rowIndex * nOffset;
 					if (full || memcmp(n_block_ptr + nBlockOffset, o_block_ptr + nBlockOffset, nOffset) != 0)
 				{
 					// A pixel has changed, so this block needs updating
@@ -517,7 +524,7 @@ void vncBuffer::CheckRect(rfb::Region2D &dest, rfb::Region2D &cacheRgn, const rf
 				{
 					n_block_ptr += m_bytesPerRow;
 					o_block_ptr += m_bytesPerRow;
-					nRowIndex = (nRowIndex + 1) % m_nAccuracyDiv;
+					rowIndex = (rowIndex + 1) % m_nAccuracyDiv;
 				}
 			}
 			if (x != ScaledRect.br.x-1)
@@ -573,7 +580,21 @@ vncBuffer::GrabRegion(rfb::Region2D &src,BOOL driver,BOOL capture)
 				src=src.union_(rect);
 			}
 	}
-	src.get_rects(rects, 1, 1);
+
+	// Across several monitors each one is captured by its own worker
+	rfb::Region2D rest;
+	const rfb::Region2D *todo = &src;
+	if (!driver && capture && m_nScale == 1 && !m_fGreyPalette && !m_videodriverused &&
+		m_mainbuff == m_desktop->OptimisedBlitBuffer())
+	{
+		m_desktop->UpdateMonitorWorkers();
+		if (m_desktop->m_monitorWorkers.CanCapture())
+		{
+			rest = m_desktop->m_monitorWorkers.Grab(src, m_desktop->CaptureRop());
+			todo = &rest;
+		}
+	}
+	todo->get_rects(rects, 1, 1);
 	if (rects.empty())
 		{
 			return;
@@ -607,8 +628,20 @@ vncBuffer::CheckRegion(rfb::Region2D &dest,rfb::Region2D &cacheRgn ,const rfb::R
 	rfb::RectVector rects;
 	rfb::RectVector::iterator i;
 
+	// Across several monitors each one is scanned by its own worker,
+	// what lies outside them is left for the loop below
+	rfb::Region2D rest;
+	const rfb::Region2D *todo = &src;
+	m_desktop->UpdateMonitorWorkers();
+	if (m_nScale == 1 && m_desktop->m_monitorWorkers.Active())
+	{
+		omni_mutex_lock l(m_cacheLock, 668);
+		rest = m_desktop->m_monitorWorkers.Check(this, dest, cacheRgn, src, full);
+		todo = &rest;
+	}
+
 	// If there is nothing to do then do nothing...
-	src.get_rects(rects, 1, 1);
+	todo->get_rects(rects, 1, 1);
 	if (rects.empty()) return;
 
 	//
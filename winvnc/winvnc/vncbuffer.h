@@ -70,6 +70,8 @@ public:
 //	void Clear(const rfb::Rect &rect);
 	void CheckRegion(rfb::Region2D &dest,rfb::Region2D &cache, const rfb::Region2D &src, bool full);
 	void CheckRect(rfb::Region2D &dest,rfb::Region2D &cache, const rfb::Rect &src, bool full);
+	// CheckRect() for the monitor workers, the caller holds m_cacheLock
+	void ScanRect(rfb::Region2D &dest,rfb::Region2D &cache, const rfb::Rect &src, bool full, int &rowIndex);
 
 	// SCREEN CAPTURE
 	void CopyRect(const rfb::Rect &dest, const rfb::Point &delta);
@@ -40,6 +40,7 @@
 // vncServer to communicate with.
 
 // Includes
+#include <assert.h>
 #include "stdhdrs.h"
 #include <omnithread.h>
 #include <string>
@@ -79,6 +80,7 @@
 #include <shlobj.h>
 #include "vncOSVersion.h"
 #include "common/win32_helpers.h"
+#include "common/BufferPool.h"
 #include "uvncUiAccess.h"
 #include "VirtualDisplay.h"
 #include<map>
@@ -87,6 +89,8 @@ using namespace std;
 #pragma comment(lib, "mpr.lib") //for getting full mapped drive
 
 #define DWEXTRA_VNC_REMOTE  0x564e4300
+// Largest piece of a clipboard payload handed to the socket at once
+#define CLIPBOARD_SEND_CHUNK 65536
 
 bool isDirectoryTransfer(const char *szFileName);
 extern BOOL SPECIAL_SC_PROMPT;
@@ -333,11 +337,11 @@ vncClientUpdateThread::Init(vncClient *client)
 	vnclog.Print(LL_INTINFO, VNCLOG("init update thread\n"));
 	m_client = client;
 	omni_mutex_lock l(m_client->GetUpdateLock(),80);
-	m_signal = new omni_condition(&m_client->GetUpdateLock());
+	m_trigger = CreateEvent(NULL, FALSE, FALSE, NULL);
 	m_sync_sig = new omni_condition(&m_client->GetUpdateLock());
 	m_active = TRUE;
 	m_enable = m_client->m_disable_protocol == 0;
-	if (m_signal && m_sync_sig) {
+	if (m_trigger && m_sync_sig) {
 		start_undetached();
 		return TRUE;
 	}
@@ -346,7 +350,8 @@ vncClientUpdateThread::Init(vncClient *client)
 
 vncClientUpdateThread::~vncClientUpdateThread()
 {
-	if (m_signal) delete m_signal;
+	m_client->m_clipboard.m_hProvideReady = NULL;
+	if (m_trigger) CloseHandle(m_trigger);
 	if (m_sync_sig) delete m_sync_sig;
 	vnclog.Print(LL_INTINFO, VNCLOG("update thread gone\n"));
 	m_client->m_updatethread=NULL;
@@ -355,13 +360,26 @@ vncClientUpdateThread::~vncClientUpdateThread()
 void
 vncClientUpdateThread::Trigger()
 {
-	// ALWAYS lock client UpdateLock before calling this!
 	// Only trigger an update if protocol is enabled
 	if (m_client->m_disable_protocol == 0) {
-		m_signal->signal();
+		SetEvent(m_trigger);
 	}
 }
 
+bool
+vncClientUpdateThread::WaitForTrigger(DWORD timeout)
+{
+	// Only the update loop's own hold may be outstanding, a nested one
+	// left taken would keep out the client thread and, with it, the
+	// Trigger() this waits for.
+	omni_mutex &lock = m_client->GetUpdateLock();
+	assert(lock.held() == 1);
+	lock.unlock();
+	DWORD result = WaitForSingleObject(m_trigger, timeout);
+	lock.lock();
+	return result == WAIT_OBJECT_0;
+}
+
 void
 vncClientUpdateThread::Kill()
 {
@@ -369,7 +387,7 @@ vncClientUpdateThread::Kill()
 
 	omni_mutex_lock l(m_client->GetUpdateLock(),81);
 	m_active=FALSE;
-	m_signal->signal();
+	SetEvent(m_trigger);
 }
 
 
@@ -407,7 +425,7 @@ vncClientUpdateThread::EnableUpdates(BOOL enable)
 	}
 
 	m_enable = enable;
-	m_signal->signal();
+	SetEvent(m_trigger);
 	//unsigned long now_sec, now_nsec;
     //get_time_now(&now_sec, &now_nsec);
 
@@ -434,7 +452,6 @@ vncClientUpdateThread::run_undetached(void *arg)
 	//char *clipboard_text = 0;
 	update.enable_copyrect(true);
 	BOOL send_palette = FALSE;
-	const int UPDATE_INTERVAL=40;
 	first_run = true;
 
 	vnclog.Print(LL_INTINFO, VNCLOG("starting update thread\n"));
@@ -445,7 +462,11 @@ vncClientUpdateThread::run_undetached(void *arg)
 	{				
 		{
 			m_client->m_incr_rgn.assign_union(clipregion);
+			// Held once from here, and only once where WaitForTrigger() is
+			// called below: it releases it while it sleeps, so what they
+			// test is read again after
 			omni_mutex_lock l(m_client->GetUpdateLock(),82);
+			m_client->ReadJournal();
 			// We block as long as updates are disabled, or the client
 			// isn't interested in them, unless this thread is killed.
 
@@ -455,14 +476,15 @@ vncClientUpdateThread::run_undetached(void *arg)
 								m_client->m_update_tracker.get_copied_region().intersect(m_client->m_incr_rgn).is_empty() &&
 								m_client->m_update_tracker.get_cached_region().intersect(m_client->m_incr_rgn).is_empty() &&
 								// adzm - 2010-07 - Extended clipboard
-								!(m_client->m_clipboard.m_bNeedToProvide || m_client->m_clipboard.m_bNeedToNotify) &&
+								!(m_client->m_clipboard.IsProvideReady() || m_client->m_clipboard.m_bNeedToNotify) &&
 								!m_client->m_cursor_pos_changed // nyama/marscha - PointerPos
 								))) {
 					// Issue the synchronisation signal, to tell other threads
 					// where we have got to
 					m_sync_sig->broadcast();
 					// Wait to be kicked into action
-					m_signal->wait();
+					WaitForTrigger();
+					m_client->ReadJournal();
 					first_run = false;
 				}
 			} 
@@ -473,7 +495,7 @@ vncClientUpdateThread::run_undetached(void *arg)
 							m_client->m_update_tracker.get_cached_region().intersect(m_client->m_incr_rgn).is_empty() &&
 							!m_client->m_encodemgr.IsCursorUpdatePending() &&
 							// adzm - 2010-07 - Extended clipboard
-							!(m_client->m_clipboard.m_bNeedToProvide || m_client->m_clipboard.m_bNeedToNotify) &&
+							!(m_client->m_clipboard.IsProvideReady() || m_client->m_clipboard.m_bNeedToNotify) &&
 							!m_client->m_NewSWUpdateWaiting &&
 							!m_client->m_cursor_pos_changed // nyama/marscha - PointerPos
 							))) {
@@ -482,7 +504,7 @@ vncClientUpdateThread::run_undetached(void *arg)
 					m_sync_sig->broadcast();
 					do{
 						if (!m_client->cl_connected) return 0;
-						if(m_signal->wait(UPDATE_INTERVAL*100)==false) {
+						if(WaitForTrigger(m_scheduler.KeepAliveInterval())==false) {
 							//do forcefull update after 4 seconds
 							m_client->TriggerUpdate();
 							m_client->TriggerUpdateThread();						
@@ -490,13 +512,37 @@ vncClientUpdateThread::run_undetached(void *arg)
 						else 
 							break;
 					}while(g_DesktopThread_running);
+					m_client->ReadJournal();
 				}
 			}
 			// If the thread is being killed then quit
 			if (!m_active) 
 				break;
+
+			// Wait out the rest of the frame interval with the lock released,
+			// damage that arrives meanwhile is coalesced into this update
+			m_scheduler.SetTargetFps(m_client->m_server->MaxFPS());
+			DWORD framewait;
+			while (m_active && m_enable && (framewait = m_scheduler.TimeToNextFrame(GetTimeFunction())) != 0)
+				WaitForTrigger(framewait);
+			if (!m_active) 
+				break;
+			// Disabled while pacing, go back and sync with EnableUpdates()
+			if (!m_enable)
+				continue;
+
+			// Hold the frame back while the path is full, so it is taken
+			// fresh when it can actually leave
+			while (m_active && m_enable && (framewait = m_client->m_pacer.TimeToSend(GetTimeFunction())) != 0)
+				WaitForTrigger(framewait);
+			if (!m_active) 
+				break;
+			if (!m_enable)
+				continue;
+
 			clipregion = m_client->m_incr_rgn;
 			m_client->m_incr_rgn.clear();
+			InterlockedExchange(&m_client->m_fullUpdatePending, 0);
 
 			// sf@2002
 			// New scale requested, we do it before sending the next Update
@@ -578,12 +624,23 @@ vncClientUpdateThread::run_undetached(void *arg)
 				bool bShouldFlush = false;
 				omni_mutex_lock l(m_client->GetUpdateLock(), 82);
 				// adzm - 2010-07 - Extended clipboard
-				// send any clipboard data that should be sent automatically
-				if (m_client->m_clipboard.m_bNeedToProvide) {
+				// send any clipboard data that should be sent automatically,
+				// once its payload is compressed
+				ClipboardPayload* payload = m_client->m_clipboard.m_pPayload;
+				if (payload && payload->IsReady() && payload->Failed()) {
+					vnclog.Print(LL_INTERR, VNCLOG("clipboard compression failed\n"));
+					m_client->m_clipboard.m_bNeedToProvide = false;
+					m_client->m_clipboard.extendedClipboardDataMessage.Reset();
+					m_client->m_clipboard.ReleasePayload();
+					payload = NULL;
+				}
+				if (m_client->m_clipboard.IsProvideReady()) {
 					m_client->m_clipboard.m_bNeedToProvide = false;
 					if (m_client->m_clipboard.settings.m_bSupportsEx) {
 					
 						int actualLen = m_client->m_clipboard.extendedClipboardDataMessage.GetDataLength();
+						if (payload)
+							actualLen += payload->GetLength();
 
 						rfbServerCutTextMsg message;
 						memset(&message, 0, sizeof(rfbServerCutTextMsg));
@@ -600,6 +657,20 @@ vncClientUpdateThread::run_undetached(void *arg)
 						}
 						if (!m_client->m_socket->SendExactQueue((char*)(m_client->m_clipboard.extendedClipboardDataMessage.GetData()), m_client->m_clipboard.extendedClipboardDataMessage.GetDataLength()))
 							m_client->m_socket->Close();
+						// The payload goes out in bounded pieces, so neither the
+						// DSM plugin nor the send queue takes all of it at once.
+						// It is one RFB message, nothing can go in between.
+						const char* data = payload ? (const char*)payload->GetData() : NULL;
+						int left = payload ? payload->GetLength() : 0;
+						while (left > 0) {
+							int chunk = std::min(left, CLIPBOARD_SEND_CHUNK);
+							if (!m_client->m_socket->SendExactQueue(data, chunk)) {
+								m_client->m_socket->Close();
+								break;
+							}
+							data += chunk;
+							left -= chunk;
+						}
 					} 
 					else {
 						rfbServerCutTextMsg message;
@@ -633,6 +704,7 @@ vncClientUpdateThread::run_undetached(void *arg)
 						delete[] unixtext;
 					}
 					m_client->m_clipboard.extendedClipboardDataMessage.Reset();
+					m_client->m_clipboard.ReleasePayload();
 				}
 			
 				// adzm - 2010-07 - Extended clipboard
@@ -683,8 +755,24 @@ vncClientUpdateThread::run_undetached(void *arg)
 					m_client->initialCapture_done)) {
 				if (m_client->m_server->MaxCpu() == 100)
 					m_client->sendingUpdate = true;
+				DWORD framestart = GetTimeFunction();
+				DWORD sentbefore = m_client->m_socket->GetBytesSent();
+				DWORD ticket = m_client->m_pacer.UpdateStarting(framestart);
 				if (m_client->SendUpdate(update)) {
-					clipregion.clear();
+					DWORD frameend = GetTimeFunction();
+					m_scheduler.FrameSent(framestart, frameend);
+					// A viewer that pipelines its requests has more queued,
+					// the region stays armed for the next update
+					LONG queued;
+					bool answered = m_client->UpdateRequestAnswered(queued);
+					if (queued == 0)
+						clipregion.clear();
+					// Only requested updates get acknowledged, one sent
+					// unasked must not wait in flight until it expires
+					if (answered)
+						m_client->m_pacer.UpdateSent(ticket, frameend, m_client->m_socket->GetBytesSent() - sentbefore);
+					else
+						m_client->m_pacer.UpdateDropped(ticket);
 #ifdef _DEBUG
 					static DWORD sNotifyLastCopy1 = GetTickCount();
 					DWORD now = GetTickCount();;
@@ -692,6 +780,8 @@ vncClientUpdateThread::run_undetached(void *arg)
 					sNotifyLastCopy1 = now;
 #endif
 				}
+				else
+					m_client->m_pacer.UpdateDropped(ticket);
 				m_client->sendingUpdate = false;
 			}
 			//else
@@ -3215,6 +3305,8 @@ vncClientThread::run(void *arg)
 				break;
 			}
 
+			// Before NotifyUpdate counts this one in m_updateRequests
+			m_client->m_pacer.RequestReceived(GetTimeFunction(), m_client->m_updateRequests);
 			if (!m_client->NotifyUpdate(msg.fur)) 
 				m_client->cl_connected = FALSE;
 			break;
@@ -4426,6 +4518,17 @@ vncClientThread::run(void *arg)
 			    }
             }
 			m_socket->SetPluginStreamingIn();
+			{
+				CARD16 flags = Swap16IfLE(msg.nsd.flags);
+				if ((flags & rfbPluginStreamingRecordsFollow) && !m_socket->SetRecordsIn())
+				{
+					vnclog.Print(LL_INTERR, VNCLOG("viewer sends DSM records, plugin has no record layer\n"));
+					m_client->cl_connected = FALSE;
+					break;
+				}
+				if ((flags & rfbPluginStreamingRecordsSupported) && m_socket->SupportsRecords() && !m_socket->IsRecordsOut())
+					m_client->NotifyPluginRecords();
+			}
             break;
 		default:
 			// Unknown message, so fail!
@@ -4547,8 +4650,12 @@ vncClient::vncClient() : m_clipboard(ClipboardSettings::defaultServerCaps), Send
 {
 	vnclog.Print(LL_INTINFO, VNCLOG("vncClient() executing...\n"));
 
+	// The update thread sends the clipboard, keep the compression off it
+	m_clipboard.m_bCompressAsync = true;
+
     m_hPToken = 0;
 
+	m_server = NULL;
 	m_socket = NULL;
 	m_client_name = NULL;
 
@@ -4561,6 +4668,8 @@ vncClient::vncClient() : m_clipboard(ClipboardSettings::defaultServerCaps), Send
 	// Other misc flags
 	m_thread_ClientThread = NULL;
 	m_palettechanged = FALSE;
+	m_updateRequests = 0;
+	m_fullUpdatePending = 0;
 
 	// Initialise the two update stores
 	m_updatethread = NULL;
@@ -4708,16 +4817,10 @@ vncClient::~vncClient()
 		delete m_socket;
 		m_socket = NULL;
 	}
-	if (m_pRawCacheZipBuf != NULL)
-		{
-			delete [] m_pRawCacheZipBuf;
-			m_pRawCacheZipBuf = NULL;
-		}
-	if (m_pCacheZipBuf != NULL)
-		{
-			delete [] m_pCacheZipBuf;
-			m_pCacheZipBuf = NULL;
-		}
+	BufferPool::Free(m_pRawCacheZipBuf);
+	m_pRawCacheZipBuf = NULL;
+	BufferPool::Free(m_pCacheZipBuf);
+	m_pCacheZipBuf = NULL;
 	if (m_lpCSBuffer)
 		delete [] m_lpCSBuffer;
 	if (m_pBuff)
@@ -4862,8 +4965,11 @@ vncClient::NotifyUpdate(rfbFramebufferUpdateRequestMsg fur)
 			update_rgn = update;
 			if (update_rgn.is_empty())
 				return false;
-			m_update_tracker.add_changed(update_rgn);
-			m_encodemgr.m_buffer->m_desktop->UpdateFullScreen();
+			// A full update that has not gone out yet answers this one too
+			if (InterlockedExchange(&m_fullUpdatePending, 1) == 0) {
+				m_update_tracker.add_changed(update_rgn);
+				m_encodemgr.m_buffer->m_desktop->UpdateFullScreen();
+			}
 		}
 		else {
 			if (m_firstExtDesktopIncremental) {
@@ -4902,6 +5008,10 @@ vncClient::NotifyUpdate(rfbFramebufferUpdateRequestMsg fur)
 		OutputDevMessage("Update Rect %i %i %i %i", update.tl.x, update.tl.y, update.br.x - update.tl.x, update.br.y - update.tl.y);
 		OutputDevMessage("++++++ rfbFramebufferUpdateRequestMsg");
 #endif
+	// Counted before the region is armed, the update thread never sees
+	// a request it has no credit for
+	if (InterlockedIncrement(&m_updateRequests) > MAX_QUEUED_UPDATE_REQUESTS)
+		InterlockedDecrement(&m_updateRequests);
 	m_incr_rgn.assign_union(update_rgn);
 
     // Kick the update thread (and create it if not there already)
@@ -4916,6 +5026,22 @@ vncClient::NotifyUpdate(rfbFramebufferUpdateRequestMsg fur)
 	return TRUE;
 }
 
+bool
+vncClient::UpdateRequestAnswered(LONG &queued)
+{
+	LONG pending = m_updateRequests;
+	while (pending > 0) {
+		LONG seen = InterlockedCompareExchange(&m_updateRequests, pending - 1, pending);
+		if (seen == pending) {
+			queued = pending - 1;
+			return true;
+		}
+		pending = seen;
+	}
+	queued = 0;
+	return false;
+}
+
 void
 vncClient::TriggerUpdateThread()
 {
@@ -4934,6 +5060,9 @@ vncClient::TriggerUpdateThread()
 			!m_updatethread->Init(this)) {
 			Kill();
 		}
+		// A clipboard payload wakes the thread when it is compressed
+		else
+			m_clipboard.m_hProvideReady = m_updatethread->TriggerEvent();
 	}				
 	if (m_updatethread)
 		m_updatethread->Trigger();
@@ -5305,6 +5434,8 @@ vncClient::SendUpdate(rfb::SimpleUpdateTracker &update)
 	
 	// 
 	if (!m_encodemgr.IsXCursorSupported()) m_cursor_update_pending=false;
+	// Same bits under another handle, or changed back before the update
+	if (m_cursor_update_pending && m_encodemgr.IsCursorShapeHeld()) m_cursor_update_pending=false;
 	// Tight specific (lastrect)
 	if (updates != 0xFFFF)
 	{
@@ -5796,15 +5927,13 @@ BOOL vncClient::SendCacheZip(const rfb::RectVector &rects)
 	// create a space big enough for the Zlib encoded cache rects list
 	if (m_nRawCacheZipBufSize < rawDataSize)
 	{
-		if (m_pRawCacheZipBuf != NULL)
-		{
-			delete [] m_pRawCacheZipBuf;
-			m_pRawCacheZipBuf = NULL;
-		}
-		m_pRawCacheZipBuf = new BYTE [rawDataSize+1];
+		size_t capacity;
+		BufferPool::Free(m_pRawCacheZipBuf);
+		m_pRawCacheZipBuf = BufferPool::Alloc(rawDataSize+1, &capacity);
+		m_nRawCacheZipBufSize = 0;
 		if (m_pRawCacheZipBuf == NULL) 
 			return false;
-		m_nRawCacheZipBufSize = rawDataSize;
+		m_nRawCacheZipBufSize = (unsigned int)capacity-1;
 	}
 
 	// Copy all the cache rects coordinates into the RawCacheZip Buffer 
@@ -5824,14 +5953,12 @@ BOOL vncClient::SendCacheZip(const rfb::RectVector &rects)
 	// Create a space big enough for the Zlib encoded cache rects list
 	if (m_nCacheZipBufSize < maxCompSize)
 	{
-		if (m_pCacheZipBuf != NULL)
-		{
-			delete [] m_pCacheZipBuf;
-			m_pCacheZipBuf = NULL;
-		}
-		m_pCacheZipBuf = new BYTE [maxCompSize+1000];
+		size_t capacity;
+		BufferPool::Free(m_pCacheZipBuf);
+		m_pCacheZipBuf = BufferPool::Alloc(maxCompSize+1000, &capacity);
+		m_nCacheZipBufSize = 0;
 		if (m_pCacheZipBuf == NULL) return 0;
-		m_nCacheZipBufSize = maxCompSize+999;
+		m_nCacheZipBufSize = (unsigned int)capacity-1;
 	}
 
 	int nRet = compress((unsigned char*)(m_pCacheZipBuf),
@@ -5895,6 +6022,24 @@ void vncClient::TriggerUpdate()
 	m_encodemgr.m_buffer->m_desktop->TriggerUpdate();
 }
 
+void vncClient::JournalUpdated()
+{
+	// Called by the capture thread, which must not wait for the UpdateLock
+	if (m_updatethread)
+		m_updatethread->Trigger();
+}
+
+void vncClient::ReadJournal()
+{
+	if (m_server)
+		m_server->GetChangeJournal().Read(m_journalReader, m_update_tracker);
+}
+
+bool vncClient::JournalUnread()
+{
+	return m_server && m_server->GetChangeJournal().Unread(m_journalReader);
+}
+
 
 ////////////////////////////////////////////////
 // Asynchronous & Delta File Transfer functions
@@ -6725,12 +6870,29 @@ void vncClient::NotifyPluginStreamingSupport()
 	rfbNotifyPluginStreamingMsg msg;
     memset(&msg, 0, sizeof(rfbNotifyPluginStreamingMsg));
 	msg.type = rfbNotifyPluginStreaming;
+	if (m_socket->SupportsRecords())
+		msg.flags = Swap16IfLE(rfbPluginStreamingRecordsSupported);
 
 	//adzm 2010-09 - minimize packets. SendExact flushes the queue.
 	m_socket->SendExact((char *)&msg, sz_rfbNotifyPluginStreamingMsg, rfbNotifyPluginStreaming);
 	m_socket->SetPluginStreamingOut();
 }
 
+// The viewer can read DSM records: say so and switch the output over.
+// Taken under the update lock, nothing may be sent in between.
+void vncClient::NotifyPluginRecords()
+{
+	omni_mutex_lock l(GetUpdateLock(), 105);
+
+	rfbNotifyPluginStreamingMsg msg;
+	memset(&msg, 0, sizeof(rfbNotifyPluginStreamingMsg));
+	msg.type = rfbNotifyPluginStreaming;
+	msg.flags = Swap16IfLE(rfbPluginStreamingRecordsSupported | rfbPluginStreamingRecordsFollow);
+
+	m_socket->SendExact((char *)&msg, sz_rfbNotifyPluginStreamingMsg, rfbNotifyPluginStreaming);
+	m_socket->SetRecordsOut();
+}
+
 DWORD WINAPI CompressFolder(LPVOID lpParam)
 {
 	vncClient *client = (vncClient *)lpParam;
@@ -70,6 +70,9 @@ typedef std::list<vncClientId> vncClientList;
 #include "common/Clipboard.h"
 
 #include "MouseSimulator.h"
+#include "vncUpdateScheduler.h"
+#include "vncSendPacer.h"
+#include "vncChangeJournal.h"
 
 // The vncClient class itself
 typedef UINT (WINAPI *pSendinput)(UINT,LPINPUT,INT);
@@ -83,6 +86,9 @@ class vncClientUpdateThread;
 #define FT_PROTO_VERSION_2   2  // base ft protocol
 #define FT_PROTO_VERSION_3   3  // new ft protocol session messages
 
+// Update requests a viewer may keep queued, one update answers each
+#define MAX_QUEUED_UPDATE_REQUESTS 8
+
 #ifdef _Gii
 struct MyTouchINfo
 {
@@ -114,8 +120,12 @@ public:
 	// Init
 	BOOL Init(vncClient* client);
 
-	// Kick the thread to send an update
+	// Kick the thread to send an update. Needs no lock, a kick that
+	// comes before the thread waits is kept until it does.
 	void Trigger();
+	// The event Trigger() sets, for the clipboard worker to wake
+	// the thread when a payload is compressed
+	HANDLE TriggerEvent() const { return m_trigger; };
 
 	// Kill the thread
 	void Kill();
@@ -131,14 +141,21 @@ public:
 protected:
 	virtual ~vncClientUpdateThread();
 
+	// Waits for Trigger() with the UpdateLock released and takes it
+	// again. The caller must hold it exactly once. Like
+	// omni_condition::wait(), what the lock guards may change
+	// meanwhile. False on timeout.
+	bool WaitForTrigger(DWORD timeout = INFINITE);
+
 	// Fields
 protected:
 	vncClient* m_client;
-	omni_condition* m_signal;
+	HANDLE m_trigger;		// auto-reset event
 	omni_condition* m_sync_sig;
 	BOOL m_active;
 	BOOL m_enable;
 	bool first_run;
+	vncUpdateScheduler m_scheduler;
 };
 
 class vncClient
@@ -167,6 +184,9 @@ public:
 	// Client manipulation functions for use by the server
 	virtual void SetBuffer(vncBuffer *buffer);
 	bool	NotifyUpdate(rfbFramebufferUpdateRequestMsg fur);
+	// Counts an update as sent. False when no request was queued, an
+	// update nobody asked for, else <queued> is the requests left.
+	bool	UpdateRequestAnswered(LONG &queued);
 
 	// Update handling functions
 	// These all lock the UpdateLock themselves
@@ -192,6 +212,9 @@ public:
 #endif
 		if (sendingUpdate == true)		
 			return true;
+		// Changes it has not read yet, it looks at those first
+		if (JournalUnread())
+			return false;
 		BOOL value =!m_incr_rgn.is_empty() && m_incr_rgn.intersect(m_update_tracker.get_changed_region()).is_empty() &&
 			m_incr_rgn.intersect(m_update_tracker.get_cached_region()).is_empty() &&
 			m_incr_rgn.intersect(m_update_tracker.get_copied_region()).is_empty();
@@ -267,6 +290,13 @@ public:
 	void SetOutgoing(bool outgoing) {m_outgoing = outgoing;};
 	void Clear_Update_Tracker();
 	void TriggerUpdate();
+	// The server journaled a change, wakes the update thread
+	void JournalUpdated();
+	// Reads the journaled changes into m_update_tracker, with the
+	// UpdateLock held
+	void ReadJournal();
+	bool JournalUnread();
+	vncChangeJournal::Reader &GetJournalReader() {return m_journalReader;};
 	void UpdateCursorShape();
 	void setTiming(DWORD value) {
 		m_timing = value;
@@ -351,6 +381,7 @@ public:
 	void NotifyExtendedClipboardSupport();
 	// adzm 2010-09 - Notify streaming DSM plugin support
 	void NotifyPluginStreamingSupport();
+	void NotifyPluginRecords();
 	bool cl_connected;
 	int filetransferrequestPart2(int nDirZipRet);
 	char m_szSrcFileName[MAX_PATH + 64]; // Path + timestring
@@ -390,7 +421,9 @@ protected:
 protected:
 
 	// This update tracker stores updates it receives and
-	// kicks the client update thread every time one is received
+	// kicks the client update thread every time one is received.
+	// The server's journal is read in first, so the updates stay
+	// in the order they happened.
 
 	class ClientUpdateTracker : public rfb::SimpleUpdateTracker {
 	public:
@@ -402,6 +435,7 @@ protected:
 		virtual void add_changed(const rfb::Region2D &region) {
 			{
 				// RealVNC 336 change - omni_mutex_lock l(m_client->GetUpdateLock());
+				m_client->ReadJournal();
 				SimpleUpdateTracker::add_changed(region);
 				m_client->TriggerUpdateThread();
 			}
@@ -409,6 +443,7 @@ protected:
 		virtual void add_cached(const rfb::Region2D &region) {
 			{
 				// RealVNC 336 change - omni_mutex_lock l(m_client->GetUpdateLock());
+				m_client->ReadJournal();
 				SimpleUpdateTracker::add_cached(region);
 				m_client->TriggerUpdateThread();
 			}
@@ -417,6 +452,7 @@ protected:
 		virtual void add_copied(const rfb::Region2D &dest, const rfb::Point &delta) {
 			{
 				// RealVNC 336 change - omni_mutex_lock l(m_client->GetUpdateLock());
+				m_client->ReadJournal();
 				SimpleUpdateTracker::add_copied(dest, delta);
 				m_client->TriggerUpdateThread();
 			}
@@ -429,10 +465,12 @@ protected:
 
 		virtual void flush_update(rfb::UpdateInfo &info, const rfb::Region2D &cliprgn) {;
 			// RealVNC 336 change - omni_mutex_lock l(m_client->GetUpdateLock());
+			m_client->ReadJournal();
 			SimpleUpdateTracker::flush_update(info, cliprgn);
 		}
 		virtual void flush_update(rfb::UpdateTracker &to, const rfb::Region2D &cliprgn) {;
 			// RealVNC 336 change - omni_mutex_lock l(m_client->GetUpdateLock());
+			m_client->ReadJournal();
 			SimpleUpdateTracker::flush_update(to, cliprgn);
 		}
 
@@ -528,12 +566,21 @@ protected:
 
 	// Update tracking structures
 	ClientUpdateTracker	m_update_tracker;
+	// Position in the server's change journal
+	vncChangeJournal::Reader m_journalReader;
 
 	// Client update transmission thread
 	vncClientUpdateThread *m_updatethread;
 
 	// Requested update region & requested flag
 	rfb::Region2D	m_incr_rgn;
+	// Requests not answered yet, the viewer may pipeline them. While
+	// some are left the update thread keeps m_incr_rgn armed.
+	volatile LONG	m_updateRequests;
+	// A full request is queued and its update not taken yet
+	volatile LONG	m_fullUpdatePending;
+	// Bytes in flight against the path estimate
+	vncSendPacer	m_pacer;
 
 	// Full screen rectangle
 //	rfb::Rect		m_fullscreen;
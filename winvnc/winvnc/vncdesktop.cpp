@@ -409,31 +409,11 @@ bool vncDesktop::FastDetectChanges(rfb::Region2D &rgn, rfb::Rect &rect, int nZon
 		}
 	}
 	PixelEngine.ReleaseCapture();
-	///////////////////////
-	// We coun the number of idle detects
-	// after x time, force some timeout
-	if (change_found)
-	{
-#ifdef _DEBUG
-		OutputDevMessage("Change found %d", GetTickCount());
-#endif
-		idle_counter = 0;
-	}
-	else
-	{
+	// Idle back-off is done by the desktop thread's update scheduler,
+	// which reads change_found after every pass
 #ifdef _DEBUG
-		OutputDevMessage("Change idle %d", GetTickCount());
+	OutputDevMessage(change_found ? "Change found %d" : "Change idle %d", GetTickCount());
 #endif
-		idle_counter = idle_counter + 5;
-	}
-	if (idle_counter > 20)
-	{
-		//Beep(100,idle_counter);
-		Sleep(idle_counter);
-	}
-	// 250 increased to 500, possible even 1000 will still have a good reaction time
-	if (idle_counter > 1000) idle_counter = 1000;
-	///////////////////////
 
 	if (fIncCycle)
 	{
@@ -452,7 +432,7 @@ vncDesktop::vncDesktop()
 	m_server = NULL;
 	m_thread = NULL;
 #ifdef AVILOG
-	AviGen = NULL;
+	m_recorder = NULL;
 #endif
 	m_Black_window_active = false;
 	m_hwnd = NULL;
@@ -477,6 +457,7 @@ vncDesktop::vncDesktop()
 
 	// Vars for Will Dean's DIBsection patch
 	m_DIBbits = NULL;
+	m_DIBsection = NULL;
 	m_formatmunged = FALSE;
 
 	m_clipboard_active = FALSE;
@@ -511,7 +492,6 @@ vncDesktop::vncDesktop()
 	m_bIsInputDisabledByClient = false;
 	m_input_desktop = 0;
 	m_home_desktop = 0;
-	idle_counter = 0;
 	trigger_events[0] = CreateEvent(NULL, TRUE, FALSE, "timer");
 	trigger_events[1] = CreateEvent(NULL, TRUE, FALSE, "screenupdate");
 	trigger_events[2] = CreateEvent(NULL, TRUE, FALSE, "mouseupdate");
@@ -765,6 +745,10 @@ vncDesktop::Startup()
 			DeleteObject(m_membitmap);
 			m_membitmap = NULL;
 		}
+		if (m_DIBsection != NULL) {
+			CloseHandle(m_DIBsection);
+			m_DIBsection = NULL;
+		}
 		m_DIBbits = m_screenCapture->getFramebuffer();
 		pchanges_buf = m_screenCapture->getChangeBuffer();
 		m_buffer.VideDriverUsed(true);
@@ -809,16 +793,22 @@ vncDesktop::Startup()
 		GetLocalTime(&lt);
 		char str[MAX_PATH + 32]; // 29 January 2008 jdp 
 		_snprintf_s(str, sizeof str, "%02d_%02d_%02d_%02d_%02d", lt.wMonth, lt.wDay, lt.wHour, lt.wMinute, lt.wSecond);
-		strcat_s(str, "_vnc.avi");
-		AviGen = new CAVIGenerator(str, "c:\\temp", &m_bminfo.bmi.bmiHeader, 5);
-		HRESULT hr;
-		hr = AviGen->InitEngine();
-		if (FAILED(hr))
+		strcat_s(str, "_vnc.vncrec");
+		char path[MAX_PATH + 48];
+		_snprintf_s(path, sizeof path, "c:\\temp\\%s", str);
+		// Changed rects only, ConvertSessionToAvi() makes an AVI of it
+		int bpp = m_bminfo.bmi.bmiHeader.biBitCount;
+		int width = m_bminfo.bmi.bmiHeader.biWidth;
+		// DIB rows are padded to a DWORD
+		int stride = ((width * bpp + 31) / 32) * 4;
+		m_recorder = new CSessionRecorder;
+		if (!m_recorder->Open(path, width, abs(m_bminfo.bmi.bmiHeader.biHeight), bpp, stride, 5))
 		{
-			AviGen->ReleaseEngine();
-			delete AviGen;
-			AviGen = NULL;
+			vnclog.Print(LL_INTERR, VNCLOG("session recording to %s failed\n"), path);
+			delete m_recorder;
+			m_recorder = NULL;
 		}
+		m_recordRgn.clear();
 
 	}
 #endif
@@ -826,20 +816,50 @@ vncDesktop::Startup()
 	return 0;
 }
 
+#ifdef AVILOG
+// Writes the area changed since the last recorded frame, at the
+// recorder's rate. The region keeps collecting in between.
+void
+vncDesktop::RecordFrame()
+{
+	if (!m_recorder->FrameDue())
+		return;
+
+	std::vector<rfb::Rect> rects;
+	m_recordRgn.get_rects(rects, 1, 1);
+	m_recordRects.resize(rects.size());
+	for (size_t i = 0; i < rects.size(); i++)
+		SetRect(&m_recordRects[i], rects[i].tl.x, rects[i].tl.y, rects[i].br.x, rects[i].br.y);
+	m_recordRgn.clear();
+	// No monitor capture may still be writing the rows it reads
+	m_monitorWorkers.Finish(m_bmrect);
+
+	if (!m_recorder->AddFrame((BYTE *)m_DIBbits, m_recordRects.empty() ? NULL : &m_recordRects[0], (int)m_recordRects.size()))
+	{
+		vnclog.Print(LL_INTERR, VNCLOG("session recording stopped, write failed\n"));
+		delete m_recorder;
+		m_recorder = NULL;
+	}
+}
+#endif
+
 // Routine to shutdown all the hooks and stuff
 BOOL
 vncDesktop::Shutdown()
 {
 #ifdef AVILOG
-	if (AviGen)
+	if (m_recorder)
 	{
-		AviGen->ReleaseEngine();
-		delete AviGen;
-		AviGen = NULL;
+		m_recorder->Close();
+		delete m_recorder;
+		m_recorder = NULL;
 	}
 #endif	
 	ShutdownInitWindowthread();
 
+	// The workers hold DCs and views of the DIB section
+	m_monitorWorkers.Stop();
+
 	// Now free all the bitmap stuff
 	if (m_hrootdc_Desktop != NULL)
 	{
@@ -866,6 +886,11 @@ vncDesktop::Shutdown()
 		}
 		m_membitmap = NULL;
 	}
+	if (m_DIBsection != NULL)
+	{
+		CloseHandle(m_DIBsection);
+		m_DIBsection = NULL;
+	}
 
 	m_DIBbits = NULL;
 	m_hcursor = NULL;
@@ -1434,9 +1459,18 @@ vncDesktop::EnableOptimisedBlits()
 {
 	vnclog.Print(LL_INTINFO, VNCLOG("attempting to enable DIBsection blits\n"));
 
-	// Create a new DIB section
+	// Create a new DIB section, in a file mapping so the monitor
+	// workers can map views of their rows
 	//HBITMAP tempbitmap=NULL;
-	HBITMAP tempbitmap = CreateDIBSection(m_hmemdc, &m_bminfo.bmi, DIB_RGB_COLORS, &m_DIBbits, NULL, 0);
+	const BITMAPINFOHEADER &bih = m_bminfo.bmi.bmiHeader;
+	DWORD sectionsize = abs(bih.biHeight) * (((bih.biWidth * bih.biBitCount + 31) / 32) * 4);
+	HANDLE tempsection = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sectionsize, NULL);
+	HBITMAP tempbitmap = CreateDIBSection(m_hmemdc, &m_bminfo.bmi, DIB_RGB_COLORS, &m_DIBbits, tempsection, 0);
+	if (tempbitmap == NULL && tempsection != NULL) {
+		CloseHandle(tempsection);
+		tempsection = NULL;
+		tempbitmap = CreateDIBSection(m_hmemdc, &m_bminfo.bmi, DIB_RGB_COLORS, &m_DIBbits, NULL, 0);
+	}
 	if (tempbitmap == NULL) {
 		vnclog.Print(LL_INTINFO, VNCLOG("failed to build DIB section - reverting to slow blits\n"));
 		m_DIBbits = NULL;
@@ -1457,8 +1491,12 @@ vncDesktop::EnableOptimisedBlits()
 		m_membitmap = NULL;
 	}
 
+	if (m_DIBsection != NULL)
+		CloseHandle(m_DIBsection);
+
 	// Replace old membitmap with DIB section
 	m_membitmap = tempbitmap;
+	m_DIBsection = tempsection;
 	return 0;
 }
 
@@ -1718,6 +1756,13 @@ vncDesktop::WriteMessageOnScreenPreConnect(BYTE *scrBuff, UINT scrBuffSize)
 #define CAPTUREBLT  0x40000000
 #endif
 
+// Raster operation of the screen captures
+DWORD
+vncDesktop::CaptureRop()
+{
+	return ((VNC_OSVersion::getInstance()->CaptureAlphaBlending() || m_server->AutoCapt() == 2) && !m_Black_window_active) ? (CAPTUREBLT | SRCCOPY) : SRCCOPY;
+}
+
 // Function to capture an area of the screen immediately prior to sending
 // an update.
 void
@@ -1749,7 +1794,7 @@ vncDesktop::CaptureScreen(const rfb::Rect &rect, BYTE *scrBuff, UINT scrBuffSize
 				m_hrootdc_Desktop,
 				rect.tl.x + m_ScreenOffsetx,
 				rect.tl.y + m_ScreenOffsety,
-				((VNC_OSVersion::getInstance()->CaptureAlphaBlending() || m_server->AutoCapt() == 2) && !m_Black_window_active) ? (CAPTUREBLT | SRCCOPY) : SRCCOPY
+				CaptureRop()
 			);
 		}
 		else
@@ -1763,7 +1808,7 @@ vncDesktop::CaptureScreen(const rfb::Rect &rect, BYTE *scrBuff, UINT scrBuffSize
 				rect.tl.y,
 				(rect.br.x - rect.tl.x),
 				(rect.br.y - rect.tl.y),
-				m_hrootdc_Desktop, rect.tl.x + xoffset, rect.tl.y + yoffset, ((VNC_OSVersion::getInstance()->CaptureAlphaBlending() || m_server->AutoCapt() == 2) && !m_Black_window_active) ? (CAPTUREBLT | SRCCOPY) : SRCCOPY);
+				m_hrootdc_Desktop, rect.tl.x + xoffset, rect.tl.y + yoffset, CaptureRop());
 		}
 		/*#if defined(_DEBUG)
 			DWORD e = GetTimeFunction() - t;
@@ -1859,6 +1904,8 @@ vncDesktop::CaptureMouse(BYTE *scrBuff, UINT scrBuffSize)
 		// Clip the bounding rect to the screen
 		// Copy the mouse cursor into the screen buffer, if any of it is visible
 		m_cursorpos = m_cursorpos.intersect(m_bmrect);
+		// A slow monitor capture must not paint over the cursor
+		m_monitorWorkers.Finish(m_cursorpos);
 
 		if (IconInfo.hbmMask && IconInfo.hbmColor)
 		{
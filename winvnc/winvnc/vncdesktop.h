@@ -53,10 +53,12 @@ class vncServer;
 #include <set>
 #include "TextChat.h"
 #ifdef AVILOG
-#include "avilog/avilog/AVIGenerator.h"
+#include "avilog/avilog/SessionRecorder.h"
 #endif
 #include "common/Clipboard.h"
 #include "IPC.h"
+#include "CursorShapeCache.h"
+#include "MonitorWorkers.h"
 #include <map>
 #include <string>
 
@@ -202,6 +204,8 @@ public:
 	// CURSOR HANDLING
 	BOOL GetRichCursorData(BYTE *databuf, HCURSOR hcursor, int width, int height);
 	HCURSOR GetCursor() { return m_hcursor; }
+	// Prepared cursor shapes, shared by the clients
+	CursorShapeCache m_cursorShapes;
 
 	// Clipboard manipulation
 	void SetClipText(LPSTR text);
@@ -217,6 +221,10 @@ public:
 
 	// Handler for pixel data grabbing and region change checking
 	vncBuffer		m_buffer;
+	// Per monitor capture and checking when all monitors are shown
+	MonitorWorkers	m_monitorWorkers;
+	void UpdateMonitorWorkers();
+	DWORD CaptureRop();
 		//SINGLE WINDOW
 	vncServer		*GetServerPointer() {return m_server;};
 	rfb::Rect		GetSize();
@@ -361,6 +369,7 @@ protected:
 
 	// Extra vars used for the DIBsection optimisation
 	VOID			*m_DIBbits;
+	HANDLE			m_DIBsection;	// file mapping behind m_DIBbits, for the monitor workers' views
 	BOOL			m_formatmunged;
 
 	// Info used for polling modes
@@ -440,14 +449,16 @@ protected:
 
 	bool m_bIsInputDisabledByClient; // 28 March 2008 jdp
 	#ifdef AVILOG
-	CAVIGenerator *AviGen;
+	CSessionRecorder *m_recorder;
+	rfb::Region2D m_recordRgn;			// changed since the last recorded frame
+	std::vector<RECT> m_recordRects;
+	void RecordFrame();
 	#endif
 
 private:
 	HDESK m_input_desktop;
 	HDESK m_home_desktop;
 	PixelCaptureEngine PixelEngine;
-	int idle_counter;
 	bool change_found;
 	//POINT	old_caret_pt;
 };
@@ -393,6 +393,12 @@ DesktopWndProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lParam)
 		}
 		return 0;
 
+	case WM_SETTINGCHANGE:
+		// The system cursors were replaced under the same handles
+		if (wParam == SPI_SETCURSORS)
+			_this->m_cursorShapes.ForgetHandles();
+		return DefWindowProc(hwnd, iMsg, wParam, lParam);
+
 	case WM_SYSCOLORCHANGE:
 	case WM_PALETTECHANGED:
 		if (!_this->m_displaychanged)
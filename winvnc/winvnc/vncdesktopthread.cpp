@@ -56,8 +56,10 @@ ClipRect(int *x, int *y, int *w, int *h,
 
 ////////////////////////////////////////////////////////////////////////////////////
 // Modif rdv@2002 - v1.1.x - videodriver
+// Queues one driver record. The changed rects of a cycle become one region
+// in flush_driver_changes(), copies with the same delta one CopyRect.
 void
-vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::UpdateTracker &tracker)
+vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::UpdateTracker &tracker)
 {
 	
 		rfb::Rect rect;
@@ -104,7 +106,7 @@ vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::Up
                                     rect.tl.y=yy;
                                     rect.br.x=xx+ww;
                                     rect.br.y=yy+hh;
-                                    rgncache.assign_union(rect);
+                                    add_driver_rect(rect);
 									}
 
 //////////////////////
@@ -120,13 +122,13 @@ vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::Up
 									rect.br.y=y+h-dy;
 
 									rfb::Point delta = rfb::Point(-dx,-dy);
-									rgncache.assign_union(rect);
-									tracker.add_copied(rect, delta);
+									add_driver_rect(rect);
+									add_driver_copy(rect, delta, tracker);
 								//	vnclog.Print(LL_INTINFO, VNCLOG("Copyrect \n"));
 								}
 						else
 								{
-									rgncache.assign_union(rect);
+									add_driver_rect(rect);
 								}
 						break;
 					}
@@ -137,7 +139,7 @@ vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::Up
 				case TRANS:
 				case PLG:
 				case BLIT:;
-					rgncache.assign_union(rect);
+					add_driver_rect(rect);
 					break;
 				case POINTERCHANGE:
 					break;
@@ -146,6 +148,70 @@ vncDesktopThread::copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::Up
 			}
 }
 
+// Drivers report a glyph or a span at a time, mostly next to or inside
+// the record before. A rect one of the last few encloses is dropped, one
+// that continues the last row span or column grows it, so the sweep in
+// flush_driver_changes() sees far fewer rects than records.
+void
+vncDesktopThread::add_driver_rect(const rfb::Rect &rect)
+{
+	size_t n = m_driverRects.size();
+	size_t first = n > DRIVER_RECT_WINDOW ? n - DRIVER_RECT_WINDOW : 0;
+	for (size_t k = first; k < n; k++)
+		if (rect.enclosed_by(m_driverRects[k]))
+			return;
+	if (n > 0) {
+		rfb::Rect &last = m_driverRects[n - 1];
+		if ((rect.tl.y == last.tl.y && rect.br.y == last.br.y && rect.tl.x <= last.br.x && rect.br.x >= last.tl.x) ||
+			(rect.tl.x == last.tl.x && rect.br.x == last.br.x && rect.tl.y <= last.br.y && rect.br.y >= last.tl.y)) {
+			last = last.union_boundary(rect);
+			return;
+		}
+	}
+	m_driverRects.push_back(rect);
+}
+
+// Copies with the same delta go to the tracker as one region, which
+// keeps them all as CopyRect; one by one the tracker keeps only the
+// largest. A copy that reads from the run's destination must come after
+// it, so the run is passed on first.
+void
+vncDesktopThread::add_driver_copy(const rfb::Rect &dest, const rfb::Point &delta, rfb::UpdateTracker &tracker)
+{
+	if (!m_copyRects.empty() &&
+		(delta.x != m_copyDelta.x || delta.y != m_copyDelta.y ||
+		 !dest.translate(delta.negate()).intersect(m_copyBounds).is_empty()))
+		flush_driver_copies(tracker);
+	if (m_copyRects.empty()) {
+		m_copyDelta = delta;
+		m_copyBounds = dest;
+	}
+	else
+		m_copyBounds = m_copyBounds.union_boundary(dest);
+	m_copyRects.push_back(dest);
+}
+
+void
+vncDesktopThread::flush_driver_copies(rfb::UpdateTracker &tracker)
+{
+	if (m_copyRects.empty())
+		return;
+	m_copyRegion.setRects(m_copyRects);
+	tracker.add_copied(m_copyRegion, m_copyDelta);
+	m_copyRects.clear();
+}
+
+void
+vncDesktopThread::flush_driver_changes(rfb::Region2D &rgncache, rfb::UpdateTracker &tracker)
+{
+	flush_driver_copies(tracker);
+	if (m_driverRects.empty())
+		return;
+	m_driverRegion.setRects(m_driverRects);
+	rgncache.assign_union(m_driverRegion);
+	m_driverRects.clear();
+}
+
 
 
 // Modif rdv@2002 - v1.1.x - videodriver
@@ -170,7 +236,7 @@ vncDesktopThread::handle_driver_changes(rfb::Region2D &rgncache,rfb::UpdateTrack
 		{
 			for (int i =oldaantal+1; i<=counter;i++)
 				{
-					copy_bitmaps_to_buffer(i,rgncache,tracker);
+					copy_bitmaps_to_buffer(i,tracker);
 				}
 
 		}
@@ -179,13 +245,14 @@ vncDesktopThread::handle_driver_changes(rfb::Region2D &rgncache,rfb::UpdateTrack
 		    int i = 0;
 			for (i =oldaantal+1;i<MAXCHANGES_BUF;i++)
 				{
-					copy_bitmaps_to_buffer(i,rgncache,tracker);
+					copy_bitmaps_to_buffer(i,tracker);
 				}
 			for (i=1;i<=counter;i++)
 				{
-					copy_bitmaps_to_buffer(i,rgncache,tracker);
+					copy_bitmaps_to_buffer(i,tracker);
 				}
 		}	
+	flush_driver_changes(rgncache,tracker);
 //	vnclog.Print(LL_INTINFO, VNCLOG("Nr rects %i \n"),rgncache.Numrects());
 	if (m_desktop->m_screenCapture)
 		m_desktop->m_screenCapture->setPreviousCounter(counter);
@@ -615,11 +682,13 @@ void vncDesktopThread::do_polling(HANDLE& threadHandle, rfb::Region2D& rgncache,
 	DWORD lTime = GetTimeFunction();
 	m_desktop->m_buffer.SetAccuracy(m_desktop->m_server->TurboMode() ? 8 : 4); 
 	if (cursormoved)  {
-		m_desktop->idle_counter=0;
+		m_scheduler.Damage();
 		m_lLastMouseMoveTime = lTime;
 	}
+	// Wakeups without damage (cursor thread, timer) don't shorten the idle back-off
+	bool polldue = m_scheduler.PollDue(lTime);
 
-	if ((m_desktop->m_server->PollFullScreen()) || (!m_desktop->can_be_hooked && !cursormoved)) {
+	if (polldue && ((m_desktop->m_server->PollFullScreen()) || (!m_desktop->can_be_hooked && !cursormoved))) {
 		int timeSinceLastMouseMove = lTime - m_lLastMouseMoveTime;			
 		if (timeSinceLastMouseMove > 50) { // 50 ms pause after a Mouse move 
 			++fullpollcounter;
@@ -628,6 +697,10 @@ void vncDesktopThread::do_polling(HANDLE& threadHandle, rfb::Region2D& rgncache,
 			if (vncService::InputDesktopSelected()!=2) {
 				if (m_desktop->FastDetectChanges(rgncache, r, 0, true)) 
 					capture=false;
+				if (m_desktop->change_found)
+					m_scheduler.Damage();
+				else
+					m_scheduler.Idle(GetTimeFunction());
 			}
 			else
 				capture=false;
@@ -640,7 +713,7 @@ void vncDesktopThread::do_polling(HANDLE& threadHandle, rfb::Region2D& rgncache,
 	}
 		
     HWND hWndToPoll = 0;
-	if (m_desktop->m_server->PollForeground() || !m_desktop->can_be_hooked) {
+	if (polldue && (m_desktop->m_server->PollForeground() || !m_desktop->can_be_hooked)) {
 		// Get the window rectangle for the currently selected window
 		hWndToPoll = GetForegroundWindow();
 		if (hWndToPoll != NULL)
@@ -648,7 +721,7 @@ void vncDesktopThread::do_polling(HANDLE& threadHandle, rfb::Region2D& rgncache,
 		
 	}
 	
-	if (m_desktop->m_server->PollUnderCursor() || !m_desktop->can_be_hooked) {
+	if (polldue && (m_desktop->m_server->PollUnderCursor() || !m_desktop->can_be_hooked)) {
 		// Find the mouse position
 		POINT mousepos;
 		if (GetCursorPos(&mousepos)) {
@@ -807,8 +880,7 @@ vncDesktopThread::run_undetached(void *arg)
 	HANDLE threadHandle=NULL;
 	stop_hookwatch=false;
 	/////////////////////
-	// We use a dynmiac value based on cpu usage
-    //DWORD MIN_UPDATE_INTERVAL=33;
+	// Frame pacing is done by m_scheduler, based on MaxFPS and cpu usage
 	/////////////////////
 	looping=true;
 	SetEvent(m_desktop->restart_event);
@@ -870,7 +942,10 @@ vncDesktopThread::run_undetached(void *arg)
 	{		
 		DWORD result;
 	
-		result=WaitForMultipleObjects(8, m_desktop->trigger_events, FALSE, waittime);
+		// When polling, an idle screen stretches the timeout instead of sleeping,
+		// any hook, driver or cursor event still wakes us up immediately
+		result=WaitForMultipleObjects(8, m_desktop->trigger_events, FALSE, 
+			m_desktop->m_hookdriver ? waittime : m_scheduler.PollWait(waittime, GetTimeFunction()));
 		{
 			
 			// We need to wait until restart is done
@@ -899,25 +974,21 @@ vncDesktopThread::run_undetached(void *arg)
 						sLastCopy3 = now;
 #endif
 								// MaxCpu() == 100  PowerMode
+								m_scheduler.SetTargetFps(m_server->MaxFPS());
 								if (m_server->MaxCpu() != 100) {
 									if ((fullpollcounter==10 || fullpollcounter==0 || fullpollcounter==5)) {
 										cpuUsage = usage.GetUsage();
-										if (cpuUsage > m_server->MaxCpu()) 
-											MIN_UPDATE_INTERVAL+=10;
-										else MIN_UPDATE_INTERVAL-=10;
-										if (MIN_UPDATE_INTERVAL<MIN_UPDATE_INTERVAL_MIN) 
-											MIN_UPDATE_INTERVAL=MIN_UPDATE_INTERVAL_MIN;
-										if (MIN_UPDATE_INTERVAL>MIN_UPDATE_INTERVAL_MAX) 
-											MIN_UPDATE_INTERVAL=MIN_UPDATE_INTERVAL_MAX;
+										m_scheduler.CpuUsage(cpuUsage, m_server->MaxCpu());
 									}
 								}
 								else
-									MIN_UPDATE_INTERVAL = 25;
+									m_scheduler.CpuUsage(0, 100);
 
-								// MAX 30fps
+								// Limit to MaxFPS, changes keep collecting in rgncache meanwhile
 								newtick = GetTimeFunction(); 
-								if ((newtick-oldtick)<MIN_UPDATE_INTERVAL)
-									Sleep(MIN_UPDATE_INTERVAL-(newtick-oldtick));
+								DWORD framewait = m_scheduler.TimeToNextFrame(newtick);
+								if (framewait)
+									Sleep(framewait);
 								
 								if (m_desktop->VideoBuffer() && m_desktop->m_hookdriver) 
 									handle_driver_changes(rgncache,updates);								
@@ -958,7 +1029,7 @@ vncDesktopThread::run_undetached(void *arg)
 								omni_mutex_lock l(m_desktop->m_update_lock, 275);
 								if (m_desktop->m_server->UpdateWanted() || !initialupdate) {
 									//omni_mutex_lock l(m_desktop->m_update_lock, 275);
-									oldtick=newtick;
+									m_scheduler.FrameStart(GetTimeFunction());
 									bool cursormoved = false;
 									POINT cursorpos;
 									if (GetCursorPos(&cursorpos) && ((cursorpos.x != oldcursorpos.x) ||(cursorpos.y != oldcursorpos.y))) {
@@ -1202,6 +1273,13 @@ vncDesktopThread::run_undetached(void *arg)
 										}
 										updates.add_changed(changedrgn);
 										updates.add_cached(cachedrgn);
+					#ifdef AVILOG
+										if (m_desktop->m_recorder) {
+											m_desktop->m_recordRgn.assign_union(changedrgn);
+											m_desktop->m_recordRgn.assign_union(cachedrgn);
+											m_desktop->m_recordRgn.assign_union(clipped_updates.get_copied_region());
+										}
+					#endif
 												
 										clipped_updates.get_update(m_server->GetUpdateTracker());
 									}  // end mutex lock
@@ -1218,7 +1296,7 @@ vncDesktopThread::run_undetached(void *arg)
 									}
 
 					#ifdef AVILOG
-									if (m_desktop->AviGen) m_desktop->AviGen->AddFrame((BYTE*)m_desktop->m_DIBbits);
+									if (m_desktop->m_recorder) m_desktop->RecordFrame();
 					#endif
 								}
 							}
@@ -1227,6 +1305,7 @@ vncDesktopThread::run_undetached(void *arg)
 
 				case WAIT_OBJECT_0+1:
 					ResetEvent(m_desktop->trigger_events[1]);
+					m_scheduler.Damage();
 					m_desktop->lock_region_add=true;
 					rgncache.assign_union(m_desktop->rgnpump);
 					m_desktop->rgnpump.clear();
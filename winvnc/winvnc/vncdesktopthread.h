@@ -32,6 +32,7 @@
 #include "mmsystem.h"
 #include "IPC.h"
 #include "CpuUsage.h"
+#include "vncUpdateScheduler.h"
 
 typedef struct _CURSORINFO
 {
@@ -63,6 +64,7 @@ public:
 
 		m_lLastMouseMoveTime = 0L;
 		m_lLastUpdate = 0L;
+		m_driverRects.reserve(MAXCHANGES_BUF);
 		
 		CHANGEWINDOWMESSAGEFILTER pfnFilter = NULL;
 		if (hUser32)
@@ -76,9 +78,6 @@ public:
 			}
 		}
 		cpuUsage=0;
-		MIN_UPDATE_INTERVAL=33;
-		MIN_UPDATE_INTERVAL_MAX=500;
-		MIN_UPDATE_INTERVAL_MIN=33;
 		// replaced by macpu ini setting
 		//MAX_CPU_USAGE=20;
 		monitor_sleep_timer=0;
@@ -102,7 +101,11 @@ public:
 	void PollWindow(rfb::Region2D &rgn, HWND hwnd);
 	// Modif rdv@2002 - v1.1.x - videodriver
 	virtual BOOL handle_driver_changes(rfb::Region2D &rgncache,rfb::UpdateTracker &tracker);
-	virtual void copy_bitmaps_to_buffer(ULONG i,rfb::Region2D &rgncache,rfb::UpdateTracker &tracker);
+	virtual void copy_bitmaps_to_buffer(ULONG i,rfb::UpdateTracker &tracker);
+	void add_driver_rect(const rfb::Rect &rect);
+	void add_driver_copy(const rfb::Rect &dest, const rfb::Point &delta, rfb::UpdateTracker &tracker);
+	void flush_driver_copies(rfb::UpdateTracker &tracker);
+	void flush_driver_changes(rfb::Region2D &rgncache, rfb::UpdateTracker &tracker);
 	bool Handle_Ringbuffer(mystruct *ringbuffer,rfb::Region2D &rgncache);
 	CIPC g_obIPC;
 	vncDesktop *m_desktop;
@@ -127,13 +130,21 @@ protected:
 	DWORD m_lLastUpdate;
 	CProcessorUsage usage;
 	short cpuUsage;
-	DWORD MIN_UPDATE_INTERVAL;
-	DWORD MIN_UPDATE_INTERVAL_MAX;
-	DWORD MIN_UPDATE_INTERVAL_MIN;
+	// Frame pacing and idle back-off, replaces the fixed MIN_UPDATE_INTERVAL sleeps
+	vncUpdateScheduler m_scheduler;
 	//DWORD MAX_CPU_USAGE;
 	bool capture;
 	bool initialupdate;
 	DWORD monitor_sleep_timer;
 
+	// Driver records of one cycle, see copy_bitmaps_to_buffer()
+	enum { DRIVER_RECT_WINDOW = 4 };
+	rfb::RectVector m_driverRects;
+	rfb::Region2D m_driverRegion;
+	rfb::RectVector m_copyRects;	// destinations of the current copy run
+	rfb::Rect m_copyBounds;
+	rfb::Point m_copyDelta;
+	rfb::Region2D m_copyRegion;
+
 };
 #endif
\ No newline at end of file
@@ -131,6 +131,7 @@ public:
 	inline BOOL SendCursorShape(VSocket *outConn);
 	inline BOOL SendEmptyCursorShape(VSocket *outConn);
 	inline BOOL IsXCursorSupported();
+	inline BOOL IsCursorShapeHeld();
 	// CLIENT OPTIONS
 	inline void AvailableQueueEnabled(BOOL enable){m_use_queue = enable;};
 	inline void AvailableZRLE(BOOL enable){m_use_zrle = enable;};
@@ -200,6 +201,7 @@ protected:
 	// Tight - CURSOR HANDLING
 	BOOL			m_use_xcursor;
 	BOOL			m_use_richcursor;
+	DWORD64			m_cursorHeld;	// hash of the shape the viewer has, 0 if unknown
 
 	// Client detection
 	// if tight->tight zrle->zrle both=ultra
@@ -262,6 +264,7 @@ inline vncEncodeMgr::vncEncodeMgr()
 	// Tight CURSOR HANDLING
 	m_use_xcursor = FALSE;
 	m_use_richcursor = FALSE;
+	m_cursorHeld = 0;
 //	m_hcursor = NULL;
 
 	monitor_Offsetx = 0;
@@ -428,6 +431,7 @@ vncEncodeMgr::CheckBuffer()
 inline BOOL
 vncEncodeMgr::SetEncoding(CARD32 encoding,BOOL reinitialize)
 {
+	m_cursorHeld = 0;
 	if (m_scrinfo.format.bitsPerPixel!=32 && encoding==rfbEncodingUltra2)
 	{
 		//This is not supported, jpeg require 32bit buffers
@@ -786,6 +790,7 @@ vncEncodeMgr::SetClientFormat(rfbPixelFormat &format)
 	// Save the desired format
 	m_clientfmtset = TRUE;
 	m_clientformat = format;
+	m_cursorHeld = 0;
 
 	// Tell the encoder of the new format
 	if (m_encoder != NULL)
@@ -842,7 +847,8 @@ vncEncodeMgr::EncodeRect(const rfb::Rect &rect,VSocket *outconn)
 		return m_encoder->EncodeRect(m_buffer->m_backbuff, outconn, m_clientbuff, TRect); // sf@2002 - For Tight...
 	}
 
-	return m_encoder->EncodeRect(m_buffer->m_backbuff, m_clientbuff, rect);
+	// ZRLE and XZ send their compressed stream directly, the others fall back to dest
+	return m_encoder->EncodeRect(m_buffer->m_backbuff, outconn, m_clientbuff, rect);
 }
 
 inline UINT
@@ -893,6 +899,7 @@ inline void
 vncEncodeMgr::EnableXCursor(BOOL enable)
 {
 	m_use_xcursor = enable;
+	m_cursorHeld = 0;
 	if (m_encoder != NULL) {
 		m_encoder->EnableXCursor(enable);
 	}
@@ -903,6 +910,7 @@ inline void
 vncEncodeMgr::EnableRichCursor(BOOL enable)
 {
 	m_use_richcursor = enable;
+	m_cursorHeld = 0;
 	if (m_encoder != NULL) {
 		m_encoder->EnableRichCursor(enable);
 	}
@@ -929,14 +937,26 @@ vncEncodeMgr::WasCursorUpdatePending()
 
 inline BOOL
 vncEncodeMgr::SendCursorShape(VSocket *outConn) {
-	return m_encoder->SendCursorShape(outConn, m_buffer->m_desktop);
+	return m_encoder->SendCursorShape(outConn, m_buffer->m_desktop, m_cursorHeld);
 }
 
 inline BOOL
 vncEncodeMgr::SendEmptyCursorShape(VSocket *outConn) {
+	m_cursorHeld = 0;
 	return m_encoder->SendEmptyCursorShape(outConn);
 }
 
+// True if the viewer already has the current cursor shape. The
+// handle changes more often than the bits (an application that sets
+// its cursor on every mouse move, a cursor loaded twice).
+inline BOOL
+vncEncodeMgr::IsCursorShapeHeld() {
+	if (m_cursorHeld == 0)
+		return FALSE;
+	vncDesktop *desktop = m_buffer->m_desktop;
+	return desktop->m_cursorShapes.Hash(desktop->GetCursor(), m_scrinfo.format.bitsPerPixel) == m_cursorHeld;
+}
+
 inline BOOL
 vncEncodeMgr::IsXCursorSupported() {
 	return m_encoder->IsXCursorSupported();
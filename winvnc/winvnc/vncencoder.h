@@ -42,6 +42,9 @@ class vncEncoder;
 #include "translate.h"
 #include "vsocket.h"
 #include "vncmemcpy.h"
+#include "../../common/BufferPool.h"
+
+class CursorShape;
 
 #define NUM_SUBSAMPOPT 6
 enum subsamp_type
@@ -106,7 +109,8 @@ public:
 	void EnableXCursor(BOOL enable) { m_use_xcursor = enable; }
 	void EnableRichCursor(BOOL enable) { m_use_richcursor = enable; }
 	BOOL SendEmptyCursorShape(VSocket *outConn);
-	BOOL SendCursorShape(VSocket *outConn, vncDesktop *desktop);
+	// sentHash is the cache hash of the shape sent, 0 if none
+	BOOL SendCursorShape(VSocket *outConn, vncDesktop *desktop, DWORD64 &sentHash);
 	BOOL IsXCursorSupported();
 
 	virtual void LastRect(VSocket *outConn); //xorzlib
@@ -116,9 +120,8 @@ protected:
 	BOOL SetTranslateFunction();
 
 	// Tight - CURSOR HANDLING
-	BOOL SendXCursorShape(VSocket *outConn, BYTE *mask, int xhot,int yhot,int width,int height);
-	BOOL SendRichCursorShape(VSocket *outConn, BYTE *mbits, BYTE *cbits, int xhot,int yhot,int width,int height);
-	void FixCursorMask(BYTE *mbits, BYTE *cbits, int width, int height, int width_bytes);
+	void BuildXCursorRect(const CursorShape *shape, BYTE *dest);
+	void BuildRichCursorRect(const CursorShape *shape, BYTE *dest);
 
 // Implementation
 protected:
@@ -27,6 +27,7 @@
 #include <rdr/MemOutStream.h>
 #include <rdr/ZlibOutStream.h>
 #include <rdr/ZstdOutStream.h>
+#include "PixelScan.h"
 
 
 #define GET_IMAGE_INTO_BUF(tx,ty,tw,th,buf)     \
@@ -93,6 +94,7 @@ vncEncodeZRLE::vncEncodeZRLE()
   zos = new rdr::ZlibOutStream;
   zstdos = new rdr::ZstdOutStream;
   beforeBuf = new rdr::U32[rfbZRLETileWidth * rfbZRLETileHeight + 1];
+  tileState = new ZrleTileState;
   m_use_zywrle = FALSE;
 }
 
@@ -102,6 +104,7 @@ vncEncodeZRLE::~vncEncodeZRLE()
   delete zos;
   delete zstdos;
   delete [] (rdr::U32 *) beforeBuf;
+  delete tileState;
 }
 
 void vncEncodeZRLE::Init()
@@ -119,6 +122,33 @@ UINT vncEncodeZRLE::RequiredBuffSize(UINT width, UINT height)
 }
 
 UINT vncEncodeZRLE::EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect)
+{
+  UINT hdrlen = EncodeToStream(source, dest, rect);
+  memcpy(dest + hdrlen, (rdr::U8*)mos->data(), mos->length());
+  return hdrlen + mos->length();
+}
+
+// Sends the headers from dest and the compressed data straight from mos,
+// the socket hands it to the kernel without copying it into dest first.
+// The DSM plugin needs the whole rect in one buffer, so it keeps the old path.
+UINT vncEncodeZRLE::EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rfb::Rect &rect)
+{
+  if (outConn == NULL || outConn->IsUsePluginEnabled())
+    return EncodeRect(source, dest, rect);
+
+  UINT hdrlen = EncodeToStream(source, dest, rect);
+  // A rect cut short leaves the viewer out of sync, drop the connection
+  if (!outConn->SendExactQueue((char *)dest, hdrlen) ||
+      !outConn->SendExactQueue((char *)mos->data(), mos->length())) {
+    vnclog.Print(LL_CONNERR, VNCLOG("ZRLE rect send failed, closing\n"));
+    outConn->Close();
+  }
+  // 0 == data sent
+  return 0;
+}
+
+// Encodes into mos and writes the rect and ZRLE headers into dest
+UINT vncEncodeZRLE::EncodeToStream(BYTE *source, BYTE *dest, const rfb::Rect &rect)
 {
   int x = rect.tl.x;
   int y = rect.tl.y;
@@ -149,24 +179,24 @@ if (m_use_zstd) {
 	switch (m_remoteformat.bitsPerPixel) {
 
 	case 8:
-		zrleEncode8NE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+		zrleEncode8NE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 		break;
 
 	case 16:
 		if (m_remoteformat.greenMax > 0x1F) {
 			if (m_remoteformat.bigEndian) {
-				zrleEncode16BE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode16BE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode16LE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode16LE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 		}
 		else {
 			if (m_remoteformat.bigEndian) {
-				zrleEncode15BE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode15BE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode15LE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode15LE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 		}
 		break;
@@ -185,29 +215,29 @@ if (m_use_zstd) {
 			(fitsInMS3Bytes && m_remoteformat.bigEndian))
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode24ABE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode24ABE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode24ALE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode24ALE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 		}
 		else if ((fitsInLS3Bytes && m_remoteformat.bigEndian) ||
 			(fitsInMS3Bytes && !m_remoteformat.bigEndian))
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode24BBE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode24BBE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode24BLE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode24BLE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 		}
 		else
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode32BE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode32BE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode32LE(x, y, w, h, mos, zstdos, beforeBuf, source, this);
+				zrleEncode32LE(x, y, w, h, mos, zstdos, beforeBuf, tileState, source, this);
 			}
 		}
 		break;
@@ -217,24 +247,24 @@ else {
 	switch (m_remoteformat.bitsPerPixel) {
 
 	case 8:
-		zrleEncode8NE(x, y, w, h, mos, zos, beforeBuf, source, this);
+		zrleEncode8NE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 		break;
 
 	case 16:
 		if (m_remoteformat.greenMax > 0x1F) {
 			if (m_remoteformat.bigEndian) {
-				zrleEncode16BE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode16BE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode16LE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode16LE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 		}
 		else {
 			if (m_remoteformat.bigEndian) {
-				zrleEncode15BE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode15BE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode15LE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode15LE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 		}
 		break;
@@ -253,29 +283,29 @@ else {
 			(fitsInMS3Bytes && m_remoteformat.bigEndian))
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode24ABE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode24ABE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode24ALE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode24ALE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 		}
 		else if ((fitsInLS3Bytes && m_remoteformat.bigEndian) ||
 			(fitsInMS3Bytes && !m_remoteformat.bigEndian))
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode24BBE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode24BBE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode24BLE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode24BLE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 		}
 		else
 		{
 			if (m_remoteformat.bigEndian) {
-				zrleEncode32BE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode32BE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 			else {
-				zrleEncode32LE(x, y, w, h, mos, zos, beforeBuf, source, this);
+				zrleEncode32LE(x, y, w, h, mos, zos, beforeBuf, tileState, source, this);
 			}
 		}
 		break;
@@ -298,9 +328,6 @@ rfbZRLEHeader* hdr = (rfbZRLEHeader*)(dest +
 
 hdr->length = Swap32IfLE(mos->length());
 
-memcpy(dest + sz_rfbFramebufferUpdateRectHeader + sz_rfbZRLEHeader,
-(rdr::U8*)mos->data(), mos->length());
-
-return sz_rfbFramebufferUpdateRectHeader + sz_rfbZRLEHeader + mos->length();
+return sz_rfbFramebufferUpdateRectHeader + sz_rfbZRLEHeader;
 }
 
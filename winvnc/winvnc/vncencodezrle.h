@@ -25,6 +25,7 @@
 #include "vncencoder.h"
 
 namespace rdr { class ZlibOutStream; class MemOutStream; class ZstdOutStream; }
+struct ZrleTileState;
 class vncEncodeZRLE : public vncEncoder
 {
 public:
@@ -36,14 +37,18 @@ public:
   virtual UINT RequiredBuffSize(UINT width, UINT height);
 
   virtual UINT EncodeRect(BYTE *source, BYTE *dest, const rfb::Rect &rect);
+  virtual UINT EncodeRect(BYTE *source, VSocket *outConn, BYTE *dest, const rfb::Rect &rect);
 
   BOOL m_use_zywrle;
 
 private:
+  UINT EncodeToStream(BYTE *source, BYTE *dest, const rfb::Rect &rect);
+
   rdr::ZlibOutStream* zos;
   rdr::ZstdOutStream* zstdos;
   rdr::MemOutStream* mos;
   void* beforeBuf;
+  ZrleTileState* tileState;
 };
 
 #endif
@@ -57,7 +57,15 @@ const char HTTP_MSG_NOSUCHFILE []	="HTTP/1.0 404 Not found\r\n\r\n"
 */
 
 // HTTP messages / message formats
-const char HTTP_MSG_OK[] = "HTTP/1.0 200 OK\n\n";
+// Status line and headers: status, content type, length, extra headers,
+// Connection value
+const char HTTP_FMT_HEADER[] =
+"HTTP/1.1 %s\r\n"
+"Content-Type: %s\r\n"
+"Content-Length: %d\r\n"
+"%s"
+"Connection: close\r\n"
+"\r\n";
 
 const char HTTP_FMT_INDEX[] =
 "<HTML>\n"
@@ -122,7 +130,6 @@ const char HTTP_MSG_BADPARAMS [] =
 "</HTML>\n";
 
 const char HTTP_MSG_NOSUCHFILE [] =
-"HTTP/1.0 404 Not Found\n\n"
 "<HTML>\n"
 "  <HEAD><TITLE>404 Not Found</TITLE></HEAD>\n"
 "  <BODY>\n"
@@ -149,6 +156,169 @@ const FileMap filemapping2 []	={
 	};
 const int filemappingsize		= 1;
 
+// One request per connection, answered with "Connection: close": the
+// single accept thread never sits on an idle connection
+const int HTTP_MAX_LINE			= 1024;
+const int HTTP_READ_BUFFER		= 4096;
+
+////////////////////////////////////////
+// HTTPRequestReader
+//
+// Cuts the request into lines from a
+// buffer that each recv() fills with all
+// the bytes the browser has sent, so the
+// headers cost one call or two instead
+// of one per byte.
+//
+class HTTPRequestReader
+{
+public:
+	HTTPRequestReader(VSocket *socket) : m_socket(socket), m_pos(0), m_len(0) {};
+
+	// Reads a line without its "\r\n" into line, a longer line is cut
+	// to max-1 chars. FALSE if the connection fails first.
+	BOOL ReadLine(char *line, int max);
+
+private:
+	BOOL Fill();
+
+	VSocket *m_socket;
+	char m_buffer[HTTP_READ_BUFFER];
+	int m_pos, m_len;
+};
+
+BOOL HTTPRequestReader::Fill()
+{
+	for (;;)
+	{
+		int n = m_socket->Read(m_buffer, HTTP_READ_BUFFER);
+		if (n > 0)
+		{
+			m_pos = 0;
+			m_len = n;
+			return TRUE;
+		}
+		if (n == 0)
+		{
+			vnclog.Print(LL_SOCKERR, VNCLOG("zero bytes read3\n"));
+			return FALSE;
+		}
+		if (WSAGetLastError() != WSAEWOULDBLOCK)
+		{
+			vnclog.Print(LL_SOCKERR, VNCLOG("HTTP socket error: %d\n"), WSAGetLastError());
+			return FALSE;
+		}
+	}
+}
+
+BOOL HTTPRequestReader::ReadLine(char *line, int max)
+{
+	int linepos = 0;
+
+	for (;;)
+	{
+		if (m_pos == m_len && !Fill())
+			return FALSE;
+
+		// Take the buffered bytes up to the delimiter in one go
+		char *start = m_buffer + m_pos;
+		char *end = (char *)memchr(start, '\n', m_len - m_pos);
+		int count = (int)((end != NULL ? end : m_buffer + m_len) - start);
+		int copy = count < max - 1 - linepos ? count : max - 1 - linepos;
+		memcpy(line + linepos, start, copy);
+		linepos += copy;
+		m_pos += count;
+
+		if (end != NULL)
+		{
+			m_pos++;
+			if (linepos > 0 && line[linepos - 1] == '\r')
+				linepos--;
+			line[linepos] = 0;
+			return TRUE;
+		}
+	}
+}
+
+////////////////////////////////////////
+// HTTPCachedFile
+//
+// A file of the mappings, loaded from
+// the resources on the first request and
+// kept with its headers ready to send.
+// The ETag
+// is a hash of the content, a browser
+// that has the file gets a 304 back.
+//
+struct HTTPCachedFile
+{
+	const FileMap *file;
+	BOOL loaded;
+	const char *body;		// the locked resource, mapped for the process lifetime
+	int bodySize;
+	char etag[24];
+	char header[256];
+	int headerSize;
+};
+
+static omni_mutex		cachedFilesLock;
+static HTTPCachedFile	cachedFiles[2][filemappingsize];	// filemapping, filemapping2
+
+// NULL if the file is not in the resources
+static HTTPCachedFile *GetCachedFile(const FileMap *mapping, int index)
+{
+	omni_mutex_lock l(cachedFilesLock);
+
+	HTTPCachedFile &cached = cachedFiles[mapping == filemapping2 ? 1 : 0][index];
+	if (cached.loaded)
+		return cached.body != NULL ? &cached : NULL;
+	cached.loaded = TRUE;
+	cached.file = &mapping[index];
+
+	//	[v1.0.2-jp1 fix]
+	HRSRC resource = FindResource(hInstResDLL,
+		MAKEINTRESOURCE(mapping[index].resourceID),
+		mapping[index].type
+		);
+	if (resource == NULL)
+		return NULL;
+	HGLOBAL resourcehan = LoadResource(hInstResDLL, resource);
+	if (resourcehan == NULL)
+		return NULL;
+	const char *resourceptr = (const char *)LockResource(resourcehan);
+	if (resourceptr == NULL)
+		return NULL;
+	int resourcesize = SizeofResource(hInstResDLL, resource);
+
+	// FNV-1a
+	DWORD64 hash = 14695981039346656037ULL;
+	for (int i = 0; i < resourcesize; i++)
+		hash = (hash ^ (BYTE)resourceptr[i]) * 1099511628211ULL;
+	sprintf_s(cached.etag, "\"%016I64x\"", hash);
+
+	char extra[64];
+	sprintf_s(extra, "ETag: %s\r\n", cached.etag);
+	cached.headerSize = sprintf_s(cached.header, HTTP_FMT_HEADER,
+		"200 OK", "application/java-archive", resourcesize, extra);
+	cached.body = resourceptr;
+	cached.bodySize = resourcesize;
+
+	vnclog.Print(LL_INTINFO, VNCLOG("cached %s, %d bytes\n"), mapping[index].filename, resourcesize);
+	return &cached;
+}
+
+// Headers and body in one send
+static BOOL SendHTTPResponse(VSocket *socket, const char *status, const char *type,
+							 const char *body, int bodysize)
+{
+	char header[256];
+	int headersize = sprintf_s(header, HTTP_FMT_HEADER,
+		status, type, bodysize, "");
+	if (!socket->SendQueued(header, headersize))
+		return FALSE;
+	return socket->SendExactHTTP(body, bodysize);
+}
+
 // The function for the spawned thread to run
 class vncHTTPConnectThread : public omni_thread
 {
@@ -161,7 +331,8 @@ public:
 	virtual void *run_undetached(void * arg);
 	// Routines to handle HTTP requests
 	virtual void DoHTTP(VSocket *socket);
-	virtual char *ReadLine(VSocket *socket, char delimiter);
+	// Answers one request, FALSE if the connection failed
+	virtual BOOL DoRequest(VSocket *socket, HTTPRequestReader &reader);
 
 
 	// Fields used internally
@@ -227,11 +398,10 @@ void *vncHTTPConnectThread::run_undetached(void * arg)
 			break;
 		}
 		vnclog.Print(LL_CLIENTS, VNCLOG("HTTP client connected\n"));
-		Sleep(250);
-		// Successful accept - perform the transaction
+		// Successful accept - perform the transaction, the reader
+		// waits for the request itself
 		new_socket->SetTimeout(15000); //ms
 		DoHTTP(new_socket);
-		Sleep(500);
 		// And close the client
 		new_socket->Shutdown();
 		new_socket->Close();
@@ -244,43 +414,45 @@ void *vncHTTPConnectThread::run_undetached(void * arg)
 }
 
 void vncHTTPConnectThread::DoHTTP(VSocket *socket)
+{
+	HTTPRequestReader reader(socket);
+	DoRequest(socket, reader);
+}
 
+BOOL vncHTTPConnectThread::DoRequest(VSocket *socket, HTTPRequestReader &reader)
 {
 	char filename[1024];
-	char *line;
+	char line[HTTP_MAX_LINE];
 
 	// Read in the HTTP header
-	if ((line = ReadLine(socket, '\n')) == NULL)
-		return;
+	if (!reader.ReadLine(line, sizeof(line)))
+		return FALSE;
 
-	// Scan the header for the filename and free the storage
-	int result = sscanf_s(line, "GET %s ", filename, 1024);
-	delete [] line;
+	// Scan the header for the filename
+	int result = sscanf_s(line, "GET %s", filename, 1024);
 	if ((result == 0) || (result == EOF))
-		return;
+		return FALSE;
 
 	vnclog.Print(LL_CLIENTS, VNCLOG("file %s requested\n"), filename);
 
-	// Read in the rest of the browser's request data and discard...
-	BOOL emptyline=TRUE;
+	char etag[64];
+	etag[0] = 0;
 
+	// Read in the rest of the browser's request data, only the
+	// headers that change the answer are kept
 	for (;;)
 	{
-		char c;
-
-		if (!socket->ReadExactHTTP(&c, 1))
-			return;
-		if (c=='\n')
+		if (!reader.ReadLine(line, sizeof(line)))
+			return FALSE;
+		if (line[0] == 0)
+			break;
+		if (_strnicmp(line, "If-None-Match:", 14) == 0)
 		{
-			if (emptyline)
-				break;
-			emptyline = TRUE;
+			const char *value = line + 14;
+			while (*value == ' ')
+				value++;
+			strncpy_s(etag, value, _TRUNCATE);
 		}
-		else
-			if (c >= ' ')
-			{
-				emptyline = FALSE;
-			}
 	}
 
 	vnclog.Print(LL_INTINFO, VNCLOG("parameters read\n"));
@@ -288,8 +460,9 @@ void vncHTTPConnectThread::DoHTTP(VSocket *socket)
     if (filename[0] != '/')
 	{
 		vnclog.Print(LL_CONNERR, VNCLOG("filename didn't begin with '/'\n"));
-		socket->SendExactHTTP(HTTP_MSG_NOSUCHFILE, (const VCard)strlen(HTTP_MSG_NOSUCHFILE));
-		return;
+		SendHTTPResponse(socket, "404 Not Found", "text/html",
+			HTTP_MSG_NOSUCHFILE, (int)strlen(HTTP_MSG_NOSUCHFILE));
+		return FALSE;
 	}
 
 	// Switch, dependent upon the filename:
@@ -299,10 +472,6 @@ void vncHTTPConnectThread::DoHTTP(VSocket *socket)
 
 		vnclog.Print(LL_CLIENTS, VNCLOG("sending main page\n"));
 
-		// Send the OK notification message to the client
-		if (!socket->SendExactHTTP(HTTP_MSG_OK, (const VCard)strlen(HTTP_MSG_OK)))
-			return;
-
 		// Compose the index page
 		if (m_server->SockConnected())
 		{
@@ -340,170 +509,61 @@ void vncHTTPConnectThread::DoHTTP(VSocket *socket)
 			sprintf_s(indexpage, HTTP_MSG_NOSOCKCONN);
 		}
 
-		// Send the page
-		if (socket->SendExactHTTP(indexpage, (const VCard)strlen(indexpage)))
-			vnclog.Print(LL_INTINFO, VNCLOG("sent page\n"));
+		// Send the page, it depends on the screen and is never cached
+		if (!SendHTTPResponse(socket, "200 OK", "text/html",
+							  indexpage, (int)strlen(indexpage)))
+			return FALSE;
+		vnclog.Print(LL_INTINFO, VNCLOG("sent page\n"));
 
-		return;
+		return TRUE;
 	}
 
 	// File requested was not the index so check the mappings
 	// list for a different file.
+	const FileMap *mapping = m_server->MSLogonRequired() ? filemapping2 : filemapping;
 
-	if (m_server->MSLogonRequired())
-	{
-
-		for (int x=0; x < filemappingsize; x++)
-	{
-		if (strcmp(filename, filemapping2[x].filename) == 0)
-		{
-			HRSRC resource;
-			HGLOBAL resourcehan;
-			char *resourceptr;
-			int resourcesize;
-
-			vnclog.Print(LL_INTINFO, VNCLOG("requested file recognised\n"));
-
-			// Find the resource here
-			//	[v1.0.2-jp1 fix]
-			//resource = FindResource(NULL,
-			resource = FindResource(hInstResDLL,
-					MAKEINTRESOURCE(filemapping2[x].resourceID),
-					filemapping2[x].type
-					);
-			if (resource == NULL)
-				return;
-
-			// Get its size
-			//	[v1.0.2-jp1 fix]
-			//resourcesize = SizeofResource(NULL, resource);
-			resourcesize = SizeofResource(hInstResDLL, resource);
-
-			// Load the resource
-			//	[v1.0.2-jp1 fix]
-			//resourcehan = LoadResource(NULL, resource);
-			resourcehan = LoadResource(hInstResDLL, resource);
-			if (resourcehan == NULL)
-				return;
-
-			// Lock the resource
-			resourceptr = (char *)LockResource(resourcehan);
-			if (resourceptr == NULL)
-				return;
-
-			vnclog.Print(LL_INTINFO, VNCLOG("sending file...\n"));
-
-			// Send the OK message
-			if (!socket->SendExactHTTP(HTTP_MSG_OK, (const VCard)strlen(HTTP_MSG_OK)))
-				return;
-
-			// Now send the entirety of the data to the client
-			if (!socket->SendExactHTTP(resourceptr, resourcesize))
-				return;
-
-			vnclog.Print(LL_INTINFO, VNCLOG("file successfully sent\n"));
-
-			return;
-		}
-	}
-	}
-	else
-	{
-	// Now search the mappings for the desired file
 	for (int x=0; x < filemappingsize; x++)
 	{
-		if (strcmp(filename, filemapping[x].filename) == 0)
+		if (strcmp(filename, mapping[x].filename) == 0)
 		{
-			HRSRC resource;
-			HGLOBAL resourcehan;
-			char *resourceptr;
-			int resourcesize;
-
 			vnclog.Print(LL_INTINFO, VNCLOG("requested file recognised\n"));
 
-			// Find the resource here
-			//	[v1.0.2-jp1 fix]
-			//resource = FindResource(NULL,
-			resource = FindResource(hInstResDLL,
-					MAKEINTRESOURCE(filemapping[x].resourceID),
-					filemapping[x].type
-					);
-			if (resource == NULL)
-				return;
-
-			// Get its size
-			//	[v1.0.2-jp1 fix]
-			//resourcesize = SizeofResource(NULL, resource);
-			resourcesize = SizeofResource(hInstResDLL, resource);
-
-			// Load the resource
-			//	[v1.0.2-jp1 fix]
-			//resourcehan = LoadResource(NULL, resource);
-			resourcehan = LoadResource(hInstResDLL, resource);
-			if (resourcehan == NULL)
-				return;
-
-			// Lock the resource
-			resourceptr = (char *)LockResource(resourcehan);
-			if (resourceptr == NULL)
-				return;
+			HTTPCachedFile *cached = GetCachedFile(mapping, x);
+			if (cached == NULL)
+				return FALSE;
 
-			vnclog.Print(LL_INTINFO, VNCLOG("sending file...\n"));
+			// The browser's copy is current
+			if (strcmp(etag, cached->etag) == 0)
+			{
+				char header[256];
+				int headersize = sprintf_s(header,
+					"HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: close\r\n\r\n",
+					cached->etag);
+				if (!socket->SendExactHTTP(header, headersize))
+					return FALSE;
+				vnclog.Print(LL_INTINFO, VNCLOG("file not modified\n"));
+				return TRUE;
+			}
 
-			// Send the OK message
-			if (!socket->SendExactHTTP(HTTP_MSG_OK, (const VCard)strlen(HTTP_MSG_OK)))
-				return;
+			vnclog.Print(LL_INTINFO, VNCLOG("sending file...\n"));
 
-			// Now send the entirety of the data to the client
-			if (!socket->SendExactHTTP(resourceptr, resourcesize))
-				return;
+			// Headers and the entirety of the data, in one send
+			if (!socket->SendQueued(cached->header, cached->headerSize))
+				return FALSE;
+			if (!socket->SendExactHTTP(cached->body, cached->bodySize))
+				return FALSE;
 
 			vnclog.Print(LL_INTINFO, VNCLOG("file successfully sent\n"));
 
-			return;
+			return TRUE;
 		}
 	}
-	}
 
 	// Send the NoSuchFile notification message to the client
-	if (!socket->SendExactHTTP(HTTP_MSG_NOSUCHFILE, (const VCard)strlen(HTTP_MSG_NOSUCHFILE)))
-		return;
-}
-
-char *vncHTTPConnectThread::ReadLine(VSocket *socket, char delimiter)
-
-{
-	int max=1024;
-	// Allocate the maximum required buffer
-	char *buffer = new char[max+1];
-	int buffpos = 0;
-
-	// Read in data until a delimiter is read
-	for (;;)
-	{
-		char c;
-
-		if (!socket->ReadExactHTTP(&c, 1))
-		{
-			delete [] buffer;
-			return NULL;
-		}
-
-		if (c == delimiter)
-		{
-			buffer[buffpos] = 0;
-			return buffer;
-		}
-
-		buffer[buffpos] = c;
-		buffpos++;
-
-		if (buffpos == (max-1))
-		{
-			buffer[buffpos] = 0;
-			return buffer;
-		}
-	}
+	if (!SendHTTPResponse(socket, "404 Not Found", "text/html",
+						  HTTP_MSG_NOSUCHFILE, (int)strlen(HTTP_MSG_NOSUCHFILE)))
+		return FALSE;
+	return TRUE;
 }
 
 // The vncSockConnect class implementation
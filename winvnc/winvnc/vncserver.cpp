@@ -40,6 +40,7 @@
 #include "vncserver.h"
 #include "vncsockconnect.h"
 #include "vncclient.h"
+#include "../../common/BufferPool.h"
 #include "vncservice.h"
 #include "vnctimedmsgbox.h"
 #include "mmsystem.h" // sf@2002
@@ -59,64 +60,35 @@ extern BOOL SPECIAL_SC_PROMPT;
 //extern BOOL G_HTTP;
 // vncServer::UpdateTracker routines
 
+// The update is journaled once, whatever the number of clients. Each
+// client reads it into its own tracker when it builds an update, the
+// capture thread never waits for a client's UpdateLock.
 void
 vncServer::ServerUpdateTracker::add_changed(const rfb::Region2D &rgn) {
-	vncClientList::iterator i;
-	
-	omni_mutex_lock l(m_server->m_clientsLock,5);
-
-	// Post this update to all the connected clients
-	for (i = m_server->m_authClients.begin(); i != m_server->m_authClients.end(); i++)
-	{
-		// Post the update
-		// REalVNC 336 change
-		// m_server->GetClient(*i)->GetUpdateTracker().add_changed(rgn);
-		vncClient* client = m_server->GetClient(*i);
-		omni_mutex_lock ll(client->GetUpdateLock(),6);
-		client->GetUpdateTracker().add_changed(rgn);
-
-	}
+	m_server->m_journal.AddChanged(rgn);
+	m_server->WakeClients();
 }
 
 void
 vncServer::ServerUpdateTracker::add_cached(const rfb::Region2D &rgn) {
-	vncClientList::iterator i;
-	
-	omni_mutex_lock l(m_server->m_clientsLock,7);
-
-	// Post this update to all the connected clients
-	for (i = m_server->m_authClients.begin(); i != m_server->m_authClients.end(); i++)
-	{
-		// Post the update
-		// RealVNC 336 change
-		// m_server->GetClient(*i)->GetUpdateTracker().add_cached(rgn);
-		vncClient* client = m_server->GetClient(*i);
-		omni_mutex_lock ll(client->GetUpdateLock(),8);
-		client->GetUpdateTracker().add_cached(rgn);
-	}
+	m_server->m_journal.AddCached(rgn);
+	m_server->WakeClients();
 }
 
-
-
-
-
 void
 vncServer::ServerUpdateTracker::add_copied(const rfb::Region2D &dest, const rfb::Point &delta) {
+	m_server->m_journal.AddCopied(dest, delta);
+	m_server->WakeClients();
+}
+
+void
+vncServer::WakeClients() {
 	vncClientList::iterator i;
 	
-	omni_mutex_lock l(m_server->m_clientsLock,9);
+	omni_mutex_lock l(m_clientsLock,5);
 
-	// Post this update to all the connected clients
-	for (i = m_server->m_authClients.begin(); i != m_server->m_authClients.end(); i++)
-	{
-		// Post the update
-		// RealVNC 336 change
-		//m_server->GetClient(*i)->GetUpdateTracker().add_copied(dest, delta);
-		vncClient* client = m_server->GetClient(*i);
-		omni_mutex_lock ll(client->GetUpdateLock(),10);
-		client->GetUpdateTracker().add_copied(dest, delta);
-
-	}
+	for (i = m_authClients.begin(); i != m_authClients.end(); i++)
+		GetClient(*i)->JournalUpdated();
 }
 
 
@@ -660,6 +632,7 @@ vncServer::Authenticated(vncClientId clientid)
 
 			// Add the client to the auth list
 			m_authClients.push_back(clientid);
+			m_journal.Attach(client->GetJournalReader());
 
 			//If we are the only client, we give it mouse access.
 			//Other client can take access when the click a mouse button
@@ -1243,6 +1216,9 @@ vncServer::RemoveClient(vncClientId clientid)
 
 					// Yes, so remove the client and kill it
 					m_authClients.erase(i);
+					vncClient *client = GetClient(clientid);
+					if (client != NULL)
+						m_journal.Detach(client->GetJournalReader());
 					if ( clientid>=0 && clientid< 512) m_clientmap[clientid] = NULL;
 
 					done = TRUE;
@@ -1293,6 +1269,13 @@ vncServer::RemoveClient(vncClientId clientid)
 		delete m_desktop;
 		m_desktop = NULL;
 		vnclog.Print(LL_STATE, VNCLOG("desktop deleted\n"));
+
+		// Nobody left to encode for, hand the cached scratch buffers back
+		BufferPool::Stats poolstats;
+		BufferPool::GetStats(poolstats);
+		vnclog.Print(LL_INTINFO, VNCLOG("buffer pool: %I64u requests %I64u hits %I64u heap allocs, peak %u KB\n"),
+			poolstats.requests, poolstats.hits, poolstats.heapAllocs, (unsigned int)(poolstats.peakBytes / 1024));
+		BufferPool::Trim();
 	}
 
 	// Notify anyone interested of the change
@@ -2462,6 +2445,7 @@ void
 vncServer::Clear_Update_Tracker() {
 	vncClientList::iterator i;
 	omni_mutex_lock l(m_clientsLock,68);
+	m_journal.Clear();
 	// Post this update to all the connected clients
 	for (i = m_authClients.begin(); i != m_authClients.end(); i++)
 	{
@@ -48,6 +48,7 @@ class VirtualDisplay;
 #include "vnchttpconnect.h"
 #include "vncclient.h"
 #include "rfbRegion.h"
+#include "vncChangeJournal.h"
 #include "vncpasswd.h"
 
 // Includes
@@ -178,6 +179,8 @@ public:
 	virtual void DoNotify(UINT message, WPARAM wparam, LPARAM lparam);
 	// Update handling, used by the screen server
 	virtual rfb::UpdateTracker &GetUpdateTracker() {return m_update_tracker;};
+	// What the clients read it from
+	vncChangeJournal &GetChangeJournal() {return m_journal;};
 	virtual void UpdateMouse();
 	// adzm - 2010-07 - Extended clipboard
 	//virtual void UpdateClipText(const char* text);
@@ -516,8 +519,8 @@ public:
 
 protected:
 	// The vncServer UpdateTracker class
-	// Behaves like a standard UpdateTracker, but propagates update
-	// information to active clients' trackers
+	// Behaves like a standard UpdateTracker, but journals update
+	// information for the active clients and wakes them
 
 	class ServerUpdateTracker : public rfb::UpdateTracker {
 	public:
@@ -535,6 +538,10 @@ protected:
 	friend class ServerUpdateTracker;
 
 	ServerUpdateTracker	m_update_tracker;
+	vncChangeJournal	m_journal;
+
+	// Kicks the update threads after the journal grew
+	void WakeClients();
 
 	// Internal stuffs
 protected:
@@ -77,6 +77,7 @@ extern unsigned int G_SENDBUFFER_EX;
 // Socket implementation
 
 #include "vsocket.h"
+#include <rdr/OutStream.h>
 
 // The socket timeout value (currently 5 seconds, for no reason...)
 // *** THIS IS NOT CURRENTLY USED ANYWHERE
@@ -86,6 +87,7 @@ const VInt rfbMaxClientWait = 5000;
 // Socket implementation initialisation
 static WORD winsockVersion = 0;
 bool sendall(SOCKET RemoteSocket,char *buff,unsigned int bufflen,int dummy);
+bool sendallv(SOCKET RemoteSocket,char *queue,unsigned int queuelen,char *buff,unsigned int bufflen);
 
 VSocketSystem::VSocketSystem()
 {
@@ -154,13 +156,27 @@ VSocket::VSocket()
 	queuebuffersize=0;
 	memset( queuebuffer, 0, sizeof( queuebuffer ) );
 
+	m_pRecordPlugin = NULL;
+	m_fRecordsIn = false;
+	m_fRecordsOut = false;
+	m_pRecordOutBuf = NULL;
+	m_pRecordInBuf = NULL;
+	m_nRecordOutLen = 0;
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+	m_nRecordInBufSize = 0;
+	m_nRecordOutBufSize = 0;
+
 	//adzm 2010-08-01
 	m_LastSentTick = 0;
+	m_BytesSent = 0;
 
 	//adzm 2010-09
 	m_fPluginStreamingIn = false;
 	m_fPluginStreamingOut = false;	
 	G_SENDBUFFER=G_SENDBUFFER_EX;
+
+	m_pOutputSink = NULL;
 }
 
 ////////////////////////////
@@ -171,6 +187,10 @@ VSocket::~VSocket()
   Close();
   if (m_pNetRectBuf != NULL)
  	delete [] m_pNetRectBuf;
+  if (m_pRecordOutBuf != NULL)
+	delete [] m_pRecordOutBuf;
+  if (m_pRecordInBuf != NULL)
+	delete [] m_pRecordInBuf;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -406,6 +426,7 @@ VSocket::Close4()
 
 	//adzm 2009-06-20
 	if (m_pPluginInterface) {
+		ResetRecords();
 		delete m_pPluginInterface;
 		m_pPluginInterface=NULL;
 		//adzm 2010-05-10
@@ -423,6 +444,7 @@ VSocket::Close6()
 
 	//adzm 2009-06-20
 	if (m_pPluginInterface) {
+		ResetRecords();
 		delete m_pPluginInterface;
 		m_pPluginInterface = NULL;
 		//adzm 2010-05-10
@@ -448,6 +470,7 @@ VSocket::Close()
 
   //adzm 2009-06-20
   if (m_pPluginInterface) {
+    ResetRecords();
     delete m_pPluginInterface;
 	m_pPluginInterface=NULL;
 	//adzm 2010-05-10
@@ -1360,29 +1383,20 @@ VSocket::SendSock(const char *buff, const VCard bufflen, SOCKET allsock)
 {
 	//adzm 2010-08-01
 	m_LastSentTick = GetTickCount();
+	InterlockedExchangeAdd(&m_BytesSent, bufflen);
 
 	unsigned int newsize=queuebuffersize+bufflen;
 	char *buff2;
 	buff2=(char*)buff;
 	unsigned int bufflen2=bufflen;
 
-	// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
+	// Large blocks go out together with the queued bytes in one gather
+	// send, they are never copied into queuebuffer.
 	if (newsize >= G_SENDBUFFER)
 	{
-		memcpy(queuebuffer+queuebuffersize,buff2,G_SENDBUFFER-queuebuffersize);
-		if (!sendall(allsock,queuebuffer,G_SENDBUFFER,0)) return FALSE;
-		//			vnclog.Print(LL_SOCKERR, VNCLOG("SEND  %i\n") ,G_SENDBUFFER);
-		buff2+=(G_SENDBUFFER-queuebuffersize);
-		bufflen2-=(G_SENDBUFFER-queuebuffersize);
+		if (!sendallv(allsock,queuebuffer,queuebuffersize,buff2,bufflen2)) return FALSE;
 		queuebuffersize=0;
-		// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
-		while (bufflen2 >= G_SENDBUFFER)
-		{
-			if (!sendall(allsock,buff2,G_SENDBUFFER,0)) return false;
-			//				vnclog.Print(LL_SOCKERR, VNCLOG("SEND 1 %i\n") ,G_SENDBUFFER);
-			buff2+=G_SENDBUFFER;
-			bufflen2-=G_SENDBUFFER;
-		}
+		return bufflen;
 	}
 	memcpy(queuebuffer+queuebuffersize,buff2,bufflen2);
 	queuebuffersize+=bufflen2;
@@ -1400,29 +1414,20 @@ VSocket::Send(const char *buff, const VCard bufflen)
 {
 	//adzm 2010-08-01
 	m_LastSentTick = GetTickCount();
+	InterlockedExchangeAdd(&m_BytesSent, bufflen);
 
 	unsigned int newsize=queuebuffersize+bufflen;
 	char *buff2;
 	buff2=(char*)buff;
 	unsigned int bufflen2=bufflen;
 
-	// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
+	// Large blocks go out together with the queued bytes in one gather
+	// send, they are never copied into queuebuffer.
 	if (newsize >= G_SENDBUFFER)
 	{
-		    memcpy(queuebuffer+queuebuffersize,buff2,G_SENDBUFFER-queuebuffersize);
-			if (!sendall(sock,queuebuffer,G_SENDBUFFER,0)) return FALSE;
-//			vnclog.Print(LL_SOCKERR, VNCLOG("SEND  %i\n") ,G_SENDBUFFER);
-			buff2+=(G_SENDBUFFER-queuebuffersize);
-			bufflen2-=(G_SENDBUFFER-queuebuffersize);
+			if (!sendallv(sock,queuebuffer,queuebuffersize,buff2,bufflen2)) return FALSE;
 			queuebuffersize=0;
-			// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
-			while (bufflen2 >= G_SENDBUFFER)
-			{
-				if (!sendall(sock,buff2,G_SENDBUFFER,0)) return false;
-//				vnclog.Print(LL_SOCKERR, VNCLOG("SEND 1 %i\n") ,G_SENDBUFFER);
-				buff2+=G_SENDBUFFER;
-				bufflen2-=G_SENDBUFFER;
-			}
+			return bufflen;
 	}
 	memcpy(queuebuffer+queuebuffersize,buff2,bufflen2);
 	queuebuffersize+=bufflen2;
@@ -1448,34 +1453,23 @@ VSocket::SendQueued(const char *buff, const VCard bufflen)
 VInt
 VSocket::SendQueuedSock(const char *buff, const VCard bufflen, SOCKET allsock)
 {
+	InterlockedExchangeAdd(&m_BytesSent, bufflen);
 	unsigned int newsize=queuebuffersize+bufflen;
 	char *buff2;
 	buff2=(char*)buff;
 	unsigned int bufflen2=bufflen;
 
 	// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
+	// The queued bytes and the whole block leave in one gather send, a large
+	// encoded rect is handed to the kernel without a copy into queuebuffer.
 	if (newsize >= G_SENDBUFFER)
 	{	
 		//adzm 2010-08-01
 		m_LastSentTick = GetTickCount();
 
-		memcpy(queuebuffer+queuebuffersize,buff2,G_SENDBUFFER-queuebuffersize);
-		if (!sendall(allsock,queuebuffer,G_SENDBUFFER,0)) return FALSE;
-		//	vnclog.Print(LL_SOCKERR, VNCLOG("SEND Q  %i\n") ,G_SENDBUFFER);
-		buff2+=(G_SENDBUFFER-queuebuffersize);
-		bufflen2-=(G_SENDBUFFER-queuebuffersize);
-		queuebuffersize=0;			
-
-		// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
-		while (bufflen2 >= G_SENDBUFFER)
-		{
-			if (!sendall(allsock,buff2,G_SENDBUFFER,0)) return false;				
-			//adzm 2010-08-01
-			m_LastSentTick = GetTickCount();
-			//	vnclog.Print(LL_SOCKERR, VNCLOG("SEND Q  %i\n") ,G_SENDBUFFER);
-			buff2+=G_SENDBUFFER;
-			bufflen2-=G_SENDBUFFER;
-		}
+		if (!sendallv(allsock,queuebuffer,queuebuffersize,buff2,bufflen2)) return FALSE;
+		queuebuffersize=0;
+		return bufflen;
 	}
 	memcpy(queuebuffer+queuebuffersize,buff2,bufflen2);
 	queuebuffersize+=bufflen2;
@@ -1485,34 +1479,23 @@ VSocket::SendQueuedSock(const char *buff, const VCard bufflen, SOCKET allsock)
 VInt
 VSocket::SendQueued(const char *buff, const VCard bufflen)
 {
+	InterlockedExchangeAdd(&m_BytesSent, bufflen);
 	unsigned int newsize=queuebuffersize+bufflen;
 	char *buff2;
 	buff2=(char*)buff;
 	unsigned int bufflen2=bufflen;
 	
 	// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
+	// The queued bytes and the whole block leave in one gather send, a large
+	// encoded rect is handed to the kernel without a copy into queuebuffer.
 	if (newsize >= G_SENDBUFFER)
 	{	
 			//adzm 2010-08-01
 			m_LastSentTick = GetTickCount();
 
-		    memcpy(queuebuffer+queuebuffersize,buff2,G_SENDBUFFER-queuebuffersize);
-			if (!sendall(sock,queuebuffer,G_SENDBUFFER,0)) return FALSE;
-		//	vnclog.Print(LL_SOCKERR, VNCLOG("SEND Q  %i\n") ,G_SENDBUFFER);
-			buff2+=(G_SENDBUFFER-queuebuffersize);
-			bufflen2-=(G_SENDBUFFER-queuebuffersize);
-			queuebuffersize=0;			
-
-			// adzm 2010-09 - flush as soon as we have a full buffer, not if we have exceeded it.
-			while (bufflen2 >= G_SENDBUFFER)
-			{
-				if (!sendall(sock,buff2,G_SENDBUFFER,0)) return false;				
-				//adzm 2010-08-01
-				m_LastSentTick = GetTickCount();
-			//	vnclog.Print(LL_SOCKERR, VNCLOG("SEND Q  %i\n") ,G_SENDBUFFER);
-				buff2+=G_SENDBUFFER;
-				bufflen2-=G_SENDBUFFER;
-			}
+			if (!sendallv(sock,queuebuffer,queuebuffersize,buff2,bufflen2)) return FALSE;
+			queuebuffersize=0;
+			return bufflen;
 	}
 	memcpy(queuebuffer+queuebuffersize,buff2,bufflen2);
 	queuebuffersize+=bufflen2;
@@ -1625,6 +1608,8 @@ VSocket::SendExactQueue(const char *buff, const VCard bufflen, unsigned char msg
 VBool
 VSocket::SendExact(const char *buff, const VCard bufflen)
 {
+	if (m_pOutputSink != NULL)
+		return SendToOutputSink(buff, bufflen);
 	if (sock4 != INVALID_SOCKET) return SendExactSock(buff, bufflen, sock4);
 	if (sock6 != INVALID_SOCKET) return SendExactSock(buff, bufflen, sock6);
 	return false;
@@ -1645,6 +1630,8 @@ VSocket::SendExactSock(const char *buff, const VCard bufflen, SOCKET allsock)
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
 		// omni_mutex_lock l(m_TransMutex);
+		if (m_fRecordsOut)
+			return SendRecordData(buff, bufflen, true);
 
 		// If required to store data into memory
 		if (m_fWriteToNetRectBuf)
@@ -1676,6 +1663,8 @@ VSocket::SendExactSock(const char *buff, const VCard bufflen, SOCKET allsock)
 VBool
 VSocket::SendExact(const char *buff, const VCard bufflen)
 {	
+	if (m_pOutputSink != NULL)
+		return SendToOutputSink(buff, bufflen);
 	if (sock==-1) return VFalse;
 	//adzm 2010-09
 	if (bufflen <=0) {
@@ -1688,6 +1677,8 @@ VSocket::SendExact(const char *buff, const VCard bufflen)
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
 		// omni_mutex_lock l(m_TransMutex);
+		if (m_fRecordsOut)
+			return SendRecordData(buff, bufflen, true);
 
 		// If required to store data into memory
 		if (m_fWriteToNetRectBuf)
@@ -1716,11 +1707,23 @@ VSocket::SendExact(const char *buff, const VCard bufflen)
   return result == (VInt)nBufflen;
 }
 #endif
+////////////////////////////
+// Encoder benchmarks, see SetOutputSink()
+VBool
+VSocket::SendToOutputSink(const char *buff, const VCard bufflen)
+{
+	if (bufflen > 0)
+		m_pOutputSink->writeBytes(buff, bufflen);
+	return VTrue;
+}
+
 ///////////////////////////////////////
 #ifdef IPV6V4
 VBool
 VSocket::SendExactQueue(const char *buff, const VCard bufflen)
 {
+	if (m_pOutputSink != NULL)
+		return SendToOutputSink(buff, bufflen);
 	if (sock4 != INVALID_SOCKET) return SendExactQueueSock(buff, bufflen, sock4);
 	if (sock6 != INVALID_SOCKET) return SendExactQueueSock(buff, bufflen, sock6);
 	return false;
@@ -1741,6 +1744,8 @@ VSocket::SendExactQueueSock(const char *buff, const VCard bufflen, SOCKET allsoc
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
 		// omni_mutex_lock l(m_TransMutex);
+		if (m_fRecordsOut)
+			return SendRecordData(buff, bufflen, false);
 
 		// If required to store data into memory
 		if (m_fWriteToNetRectBuf)
@@ -1772,6 +1777,8 @@ VSocket::SendExactQueueSock(const char *buff, const VCard bufflen, SOCKET allsoc
 VBool
 VSocket::SendExactQueue(const char *buff, const VCard bufflen)
 {
+	if (m_pOutputSink != NULL)
+		return SendToOutputSink(buff, bufflen);
 	if (sock==-1) return VFalse;
 	//adzm 2010-09
 	if (bufflen <=0) {
@@ -1785,6 +1792,8 @@ VSocket::SendExactQueue(const char *buff, const VCard bufflen)
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
 		// omni_mutex_lock l(m_TransMutex);
+		if (m_fRecordsOut)
+			return SendRecordData(buff, bufflen, false);
 
 		// If required to store data into memory
 		if (m_fWriteToNetRectBuf)
@@ -1818,6 +1827,7 @@ VSocket::SendExactQueue(const char *buff, const VCard bufflen)
 VBool
 VSocket::ClearQueue()
 {
+	if (m_fRecordsOut && !FlushRecord()) return VFalse;
 	if (sock4 != INVALID_SOCKET) return ClearQueueSock(sock4);
 	if (sock6 != INVALID_SOCKET) return ClearQueueSock(sock6);
 	return false;
@@ -1844,6 +1854,7 @@ VBool
 VSocket::ClearQueue()
 {
 	if (sock==-1) return VFalse;
+	if (m_fRecordsOut && !FlushRecord()) return VFalse;
 	if (queuebuffersize!=0)
   {
 	//adzm 2010-08-01
@@ -1909,6 +1920,9 @@ VSocket::ReadExactSock(char *buff, const VCard bufflen, SOCKET allsock)
 	// sf@2002 - DSM Plugin
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
+		if (m_fRecordsIn)
+			return ReadRecordData(buff, bufflen);
+
 		//omni_mutex_lock l(m_pDSMPlugin->m_RestMutex); 
 		//adzm 2009-06-20 - don't lock if we are using the new interface
 		omni_mutex_conditional_lock l(m_pDSMPlugin->m_RestMutex, m_pPluginInterface ? false : true);
@@ -2012,6 +2026,9 @@ VSocket::ReadExact(char *buff, const VCard bufflen)
 	// sf@2002 - DSM Plugin
 	if (m_fUsePlugin && m_pDSMPlugin->IsEnabled())
 	{
+		if (m_fRecordsIn)
+			return ReadRecordData(buff, bufflen);
+
 		//omni_mutex_lock l(m_pDSMPlugin->m_RestMutex); 
 		//adzm 2009-06-20 - don't lock if we are using the new interface
 		omni_mutex_conditional_lock l(m_pDSMPlugin->m_RestMutex, m_pPluginInterface ? false : true);
@@ -2107,6 +2124,7 @@ void VSocket::SetDSMPluginPointer(CDSMPlugin* pDSMPlugin)
 	m_pDSMPlugin = pDSMPlugin;
 
 	if (m_pPluginInterface) {
+		ResetRecords();
 		delete m_pPluginInterface;
 		m_pPluginInterface = NULL;
 		//adzm 2010-05-10
@@ -2118,6 +2136,8 @@ void VSocket::SetDSMPluginPointer(CDSMPlugin* pDSMPlugin)
 		if (m_pDSMPlugin->SupportsIntegrated()) {
 			m_pIntegratedPluginInterface = m_pDSMPlugin->CreateIntegratedPluginInterface();
 			m_pPluginInterface = m_pIntegratedPluginInterface;
+			// Records are only used once both directions stream
+			m_pRecordPlugin = m_pDSMPlugin->GetRecordPluginInterface(m_pIntegratedPluginInterface);
 		} else {
 			m_pIntegratedPluginInterface = NULL;
 			m_pPluginInterface = m_pDSMPlugin->CreatePluginInterface();
@@ -2200,6 +2220,160 @@ void VSocket::CheckNetRectBufferSize(int nBufSize)
 	// vnclog.Print(4, _T("crypt bufsize expanded to %d\n"), m_netbufsize);
 }
 
+//
+// Record framed streaming
+//
+// Once switched, a direction carries only records of the plugin's record
+// layer; the per call TransformBuffer/RestoreBuffer are not used anymore.
+// Sealing and opening happen in place in the two buffers below, which
+// are allocated once per connection.
+//
+void VSocket::ResetRecords()
+{
+	m_pRecordPlugin = NULL;
+	m_fRecordsIn = false;
+	m_fRecordsOut = false;
+	m_nRecordOutLen = 0;
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+}
+
+bool VSocket::SetRecordsIn()
+{
+	if (m_pRecordPlugin == NULL)
+		return false;
+	int nSize = m_pRecordPlugin->GetRecordHeaderSize() + m_pRecordPlugin->GetMaxRecordPayload() + m_pRecordPlugin->GetRecordTrailerSize();
+	// Kept for the connection, grown if a record layer needs more
+	if (m_nRecordInBufSize < nSize) {
+		delete [] m_pRecordInBuf;
+		m_pRecordInBuf = new BYTE[nSize];
+		m_nRecordInBufSize = nSize;
+	}
+	m_nRecordInPos = 0;
+	m_nRecordInEnd = 0;
+	m_fRecordsIn = true;
+	vnclog.Print(LL_INTINFO, VNCLOG("DSMPlugin: incoming data is record framed\n"));
+	return true;
+}
+
+bool VSocket::SetRecordsOut()
+{
+	if (m_pRecordPlugin == NULL)
+		return false;
+	int nSize = m_pRecordPlugin->GetRecordHeaderSize() + m_pRecordPlugin->GetMaxRecordPayload() + m_pRecordPlugin->GetRecordTrailerSize();
+	if (m_nRecordOutBufSize < nSize) {
+		delete [] m_pRecordOutBuf;
+		m_pRecordOutBuf = new BYTE[nSize];
+		m_nRecordOutBufSize = nSize;
+	}
+	m_nRecordOutLen = 0;
+	m_fRecordsOut = true;
+	vnclog.Print(LL_INTINFO, VNCLOG("DSMPlugin: outgoing data is record framed\n"));
+	return true;
+}
+
+VBool
+VSocket::SendRecordData(const char *buff, VCard bufflen, bool fFlush)
+{
+	BYTE* pPayload = m_pRecordOutBuf + m_pRecordPlugin->GetRecordHeaderSize();
+	int nMax = m_pRecordPlugin->GetMaxRecordPayload();
+
+	while (bufflen > 0)
+	{
+		VCard n = nMax - m_nRecordOutLen;
+		if (n > bufflen) n = bufflen;
+		memcpy(pPayload + m_nRecordOutLen, buff, n);
+		m_nRecordOutLen += n;
+		buff += n;
+		bufflen -= n;
+		if (m_nRecordOutLen == nMax && !FlushRecord())
+			return VFalse;
+	}
+	if (fFlush && !FlushRecord())
+		return VFalse;
+	return VTrue;
+}
+
+VBool
+VSocket::FlushRecord()
+{
+	if (m_nRecordOutLen == 0)
+		return VTrue;
+	int nRecordLen = m_pRecordPlugin->SealRecord(m_pRecordOutBuf, m_nRecordOutLen);
+	m_nRecordOutLen = 0;
+	if (nRecordLen <= 0) {
+		vnclog.Print(LL_SOCKERR, VNCLOG("DSMPlugin: SealRecord failed\n"));
+		return VFalse;
+	}
+	return Send((char*)m_pRecordOutBuf, nRecordLen) == nRecordLen;
+}
+
+VBool
+VSocket::ReadRecordData(char *buff, VCard bufflen)
+{
+	while (bufflen > 0)
+	{
+		if (m_nRecordInPos == m_nRecordInEnd)
+		{
+			// Next record: the header tells how much follows
+			int nHeader = m_pRecordPlugin->GetRecordHeaderSize();
+			if (!ReadRaw((char*)m_pRecordInBuf, nHeader))
+				return VFalse;
+			int nRecordLen = m_pRecordPlugin->GetRecordLength(m_pRecordInBuf);
+			if (nRecordLen < nHeader || nRecordLen > m_nRecordInBufSize) {
+				vnclog.Print(LL_SOCKERR, VNCLOG("DSMPlugin: invalid record length\n"));
+				return VFalse;
+			}
+			if (!ReadRaw((char*)m_pRecordInBuf + nHeader, nRecordLen - nHeader))
+				return VFalse;
+			int nDataLen = m_pRecordPlugin->OpenRecord(m_pRecordInBuf, nRecordLen);
+			if (nDataLen < 0) {
+				vnclog.Print(LL_SOCKERR, VNCLOG("DSMPlugin: OpenRecord failed\n"));
+				return VFalse;
+			}
+			m_nRecordInPos = nHeader;
+			m_nRecordInEnd = nHeader + nDataLen;
+			continue;
+		}
+		VCard n = m_nRecordInEnd - m_nRecordInPos;
+		if (n > bufflen) n = bufflen;
+		memcpy(buff, m_pRecordInBuf + m_nRecordInPos, n);
+		m_nRecordInPos += n;
+		buff += n;
+		bufflen -= n;
+	}
+	return VTrue;
+}
+
+// Reads record bytes as they come off the wire. A non-blocking socket
+// with nothing queued waits in select() for data instead of spinning on
+// recv(). The wait is bounded, so a socket closed meanwhile shows up
+// as an error on the next Read().
+VBool
+VSocket::ReadRaw(char *buff, VCard bufflen)
+{
+	while (bufflen > 0)
+	{
+		int n = Read(buff, bufflen);
+		if (n > 0) {
+			buff += n;
+			bufflen -= n;
+		}
+		else if (n == 0) {
+			vnclog.Print(LL_SOCKERR, VNCLOG("zero bytes read3\n"));
+			return VFalse;
+		}
+		else if (WSAGetLastError() == WSAEWOULDBLOCK) {
+			ReadSelect(1000);
+		}
+		else {
+			vnclog.Print(LL_SOCKERR, VNCLOG("socket error 3: %d\n"), WSAGetLastError());
+			return VFalse;
+		}
+	}
+	return VTrue;
+}
+
 
 // sf@2002 - DSMPlugin
 // Necessary for HTTP server (we'll see later if we can do something more intelligent...
@@ -2317,6 +2491,59 @@ int val =0;
 	return 1;
 }
 
+// Gather version of sendall(): queue[queuelen] followed by buff[bufflen],
+// without merging them into one buffer first.
+bool
+sendallv(SOCKET RemoteSocket,char *queue,unsigned int queuelen,char *buff,unsigned int bufflen)
+{
+	if (queuelen == 0)
+		return sendall(RemoteSocket, buff, bufflen, 0);
+
+	WSABUF bufs[2];
+	bufs[0].buf = queue;
+	bufs[0].len = queuelen;
+	bufs[1].buf = buff;
+	bufs[1].len = bufflen;
+	WSABUF *pbufs = bufs;
+	DWORD nbufs = 2;
+	while (nbufs > 0)
+	  {
+		struct fd_set write_fds;
+		struct timeval tm;
+		tm.tv_sec = 1;
+		tm.tv_usec = 0;
+
+		int count;
+		int aa=0;
+		do {
+			FD_ZERO(&write_fds);
+			FD_SET(RemoteSocket, &write_fds);
+			count = select((int)(RemoteSocket+ 1), NULL, &write_fds, NULL, &tm);
+			aa++;
+		} while (count == 0&& !fShutdownOrdered && aa<600);
+		if (aa>=600) return 0;
+		if (fShutdownOrdered) return 0;
+		if (count < 0 || count > 1) return 0;
+
+		DWORD sent = 0;
+		if (WSASend(RemoteSocket, pbufs, nbufs, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+			return false;
+		if (sent == 0)
+			return false;
+		// Skip what went out, a partial send can stop inside either buffer
+		while (nbufs > 0 && sent >= pbufs->len) {
+			sent -= pbufs->len;
+			pbufs++;
+			nbufs--;
+		}
+		if (nbufs > 0) {
+			pbufs->buf += sent;
+			pbufs->len -= sent;
+		}
+	  }
+	return 1;
+}
+
 //method to get congestion window
 bool VSocket::GetOptimalSndBuf()
 {
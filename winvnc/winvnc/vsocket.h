@@ -33,6 +33,11 @@
 //#define FLOWCONTROL
 
 class VSocket;
+namespace rdr { class OutStream; }
+#ifdef _VNC_PORTABLE
+// Only the output sink outside Windows, see winvnc/portable
+#include "../portable/vsocket.h"
+#else
 extern BOOL G_ipv6_allowed;
 #if (!defined(_ATT_VSOCKET_DEFINED))
 #define _ATT_VSOCKET_DEFINED
@@ -274,6 +279,12 @@ public:
   void SetPluginStreamingOut() { m_fPluginStreamingOut = true; }
   bool IsPluginStreamingIn(void) { return m_fPluginStreamingIn; }
   bool IsPluginStreamingOut(void) { return m_fPluginStreamingOut; }
+  // Record framed streaming, see IRecordPlugin
+  bool SupportsRecords(void) { return m_pRecordPlugin != NULL; }
+  bool SetRecordsIn();
+  bool SetRecordsOut();
+  bool IsRecordsIn(void) { return m_fRecordsIn; }
+  bool IsRecordsOut(void) { return m_fRecordsOut; }
 
   void SetWriteToNetRectBuffer(bool fEnable) {m_fWriteToNetRectBuf = fEnable;}; 
   bool GetWriteToNetRectBuffer(void) {return m_fWriteToNetRectBuf;};
@@ -284,11 +295,17 @@ public:
   VBool SendExactHTTP(const char *buff, const VCard bufflen);
   VBool ReadExactHTTP(char *buff, const VCard bufflen);
 
+  // SendExact() and SendExactQueue() append to pSink instead of the
+  // socket while it is set, so encoders can run without a connection
+  void SetOutputSink(rdr::OutStream* pSink) { m_pOutputSink = pSink; }
+
   //adzm 2010-05-10
   IIntegratedPlugin* GetIntegratedPlugin() { return m_pIntegratedPluginInterface; };
 
   //adzm 2010-08-01
   DWORD GetLastSentTick() { return m_LastSentTick; };
+  // Bytes handed to Send() and SendQueued(), wraps
+  DWORD GetBytesSent() { return (DWORD)m_BytesSent; };
   IIntegratedPlugin* m_pIntegratedPluginInterface;
   ////////////////////////////
   // Internal structures
@@ -303,6 +320,7 @@ protected:
 
   //adzm 2010-08-01
   DWORD m_LastSentTick;
+  volatile LONG m_BytesSent;
 
   CDSMPlugin* m_pDSMPlugin; // sf@2002 - DSMPlugin
   //adzm 2009-06-20
@@ -320,6 +338,26 @@ protected:
   BYTE* RestoreBufferStep1(BYTE* pDataBuffer, int nDataLen, int* nRestoredDataLen);
   BYTE* RestoreBufferStep2(BYTE* pDataBuffer, int nDataLen, int* nRestoredDataLen);
 
+  // Outgoing data is collected in m_pRecordOutBuf and sealed in place once
+  // a record is full or the data is flushed. Incoming records are opened
+  // in place in m_pRecordInBuf and read from there.
+  IRecordPlugin* m_pRecordPlugin;
+  bool m_fRecordsIn;
+  bool m_fRecordsOut;
+  BYTE* m_pRecordOutBuf;
+  int m_nRecordOutLen;
+  BYTE* m_pRecordInBuf;
+  int m_nRecordInPos;
+  int m_nRecordInEnd;
+  int m_nRecordInBufSize;
+  int m_nRecordOutBufSize;
+
+  void ResetRecords();
+  VBool SendRecordData(const char *buff, VCard bufflen, bool fFlush);
+  VBool FlushRecord();
+  VBool ReadRecordData(char *buff, VCard bufflen);
+  VBool ReadRaw(char *buff, VCard bufflen);
+
   // All this should be private with accessors -> later
   BYTE* m_pNetRectBuf;
   bool m_fWriteToNetRectBuf;
@@ -329,6 +367,9 @@ protected:
   char queuebuffer[9000];
   DWORD queuebuffersize;
 
+  rdr::OutStream* m_pOutputSink;
+  VBool SendToOutputSink(const char *buff, const VCard bufflen);
+
   // adzm 2010-08
   static int m_defaultSocketKeepAliveTimeout;
 
@@ -337,3 +378,4 @@ protected:
 };
 
 #endif // _ATT_VSOCKET_DEFINED
+#endif // _VNC_PORTABLE